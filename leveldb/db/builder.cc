@@ -1,7 +1,10 @@
 #include "db/builder.h"
 
+#include <vector>
+
 #include "db/dbformat.h"
 #include "db/filename.h"
+#include "db/range_del.h"
 #include "db/table_cache.h"
 #include "db/version_edit.h"
 #include "leveldb/db.h"
@@ -10,14 +13,24 @@
 
 namespace leveldb {
 
-Status BuildTable(const std::string& dbname, Env* env, Option& options,
-                  TableCache* table_cache, Iterator* iter, FileMetaData* meta) {
+Status BuildTable(const std::string& dbname, Env* env, const Options& options,
+                  TableCache* table_cache, Iterator* iter, Iterator* range_del_iter,
+                  FileMetaData* meta) {
     Status s;
     meta->file_size = 0;
     iter->SeekToFirst();
+    // a table holds its tombstones split into fragments, which lookups can
+    // seek in (see db/range_del.h)
+    std::vector<RangeTombstone> fragments;
+    if (range_del_iter != nullptr) {
+        const Comparator* ucmp =
+                static_cast<const InternalKeyComparator*>(options.comparator)->user_comparator();
+        FragmentRangeTombstones(range_del_iter, ucmp, &fragments);
+    }
+    meta->has_range_tombstones = !fragments.empty();
 
     std::string fname = TableFileName(dbname, meta->number);
-    if (iter->Valid()) {
+    if (iter->Valid() || !fragments.empty()) {
         WritableFile* file;
         s = env->NewWritableFile(fname, &file);
         if (!s.ok()) {
@@ -25,13 +38,34 @@ Status BuildTable(const std::string& dbname, Env* env, Option& options,
         }
 
         TableBuilder* builder = new TableBuilder(options, file);
-        meta->smallest.DecodeFrom(iter->key());
+        bool has_keys = iter->Valid();
+        if (has_keys) {
+            meta->smallest.DecodeFrom(iter->key());
+        }
         for (; iter->Valid(); iter->Next()) {
             Slice key = iter->key();
             meta->largest.DecodeFrom(key);
             builder->Add(key, iter->value());
         }
 
+        // the key range of the table has to take in its tombstones, from
+        // the first begin key to just before the last end key, so reads and
+        // compactions of the keys they hide look at this table
+        for (const RangeTombstone& fragment : fragments) {
+            InternalKey begin(fragment.begin, fragment.seq, kTypeRangeDeletion);
+            builder->AddRangeTombstone(begin.Encode(), fragment.end);
+            InternalKey end(fragment.end, kMaxSequenceNumber, kTypeRangeDeletion);
+            if (!has_keys || options.comparator->Compare(begin.Encode(),
+                                                         meta->smallest.Encode()) < 0) {
+                meta->smallest = begin;
+            }
+            if (!has_keys || options.comparator->Compare(end.Encode(),
+                                                         meta->largest.Encode()) > 0) {
+                meta->largest = end;
+            }
+            has_keys = true;
+        }
+
         // finish and check for builder errors
         s = builder->Finish();
         if (s.ok()) {
@@ -56,6 +90,9 @@ Status BuildTable(const std::string& dbname, Env* env, Option& options,
     if (!iter->status().ok()) {
         s = iter->status()
     }
+    if (range_del_iter != nullptr && !range_del_iter->status().ok()) {
+        s = range_del_iter->status();
+    }
 
     if (s.ok() && meta->file_size > 0) {
         // keep it
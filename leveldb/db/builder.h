@@ -13,8 +13,14 @@ class Iterator;
 class TableCache;
 class VersionEdit;
 
+// builds a table from the contents of *iter and the range tombstones of
+// *range_del_iter, which may be nullptr (see db/range_del.h). The file is
+// named after meta->number. On success, the rest of *meta is filled in;
+// its key range covers the tombstones too. If there is nothing to write,
+// meta->file_size is zero and no table file is produced.
 Status BuildTable(const std::string& dbname, Env* env, const Options& options,
-                  TableCache* table_cache, Iterator* iter, FileMetaData* meta);
+                  TableCache* table_cache, Iterator* iter, Iterator* range_del_iter,
+                  FileMetaData* meta);
 
 }  // namespace leveldb
 
@@ -1,41 +1,514 @@
 #include "leveldb/db.h"
 #include "db/db_impl.h"
+#include "db/filename.h"
+#include "db/log_reader.h"
 #include "db/version_set.h"
 #include "leveldb/status.h"
 #include "leveldb/write_batch.h"
-#include <iostream>
+#include "db/write_batch_internal.h"
+#include "table/merger.h"
+#include "util/mutexlock.h"
+#include "util/thread_local.h"
+#include <algorithm>
+#include <chrono>
+#include <vector>
 
 namespace leveldb {
 
 struct DBImpl::Writer {
     explicit DBImpl::Writer(port::Mutex* mu)
-        : batch(nullptr), sync(false), done(false), cv(mu) {}
+        : batch(nullptr), sync(false), done(false), memtable_group(nullptr),
+          delayed_micros(0), delay_report(nullptr), cv(mu) {}
     
     Status status;
     WriteBatch* batch;
     bool sync;
     bool done;
+    // set by the leader when this writer should insert its own batch
+    // (see InsertConcurrently)
+    MemTableGroup* memtable_group;
+    // time the write controller held this writer back while it led the queue
+    uint64_t delayed_micros;
+    uint64_t* delay_report;  // WriteOptions::delay_micros
     port::CondVar cv;
 };
 
+// a batch group whose log record has been written, waiting for its turn
+// to be inserted into the memtable. used by PipelinedWrite(), and by
+// InsertConcurrently() to track the members' parallel inserts.
+struct DBImpl::MemTableGroup {
+    explicit MemTableGroup(port::Mutex* mu)
+        : last_sequence(0), log_ticket(0), log_submit_micros(0), log_sync(false),
+          mem(nullptr), pending_inserts(0), cv(mu) {}
+
+    Status status;                  // result of the log append
+    std::vector<Writer*> writers;   // members of the group, leader first
+    SequenceNumber last_sequence;   // last sequence number used by the group
+
+    // asynchronous log I/O still to wait for, see enable_async_log_write
+    uint64_t log_ticket;
+    uint64_t log_submit_micros;
+    bool log_sync;
+
+    // concurrent insert state
+    MemTable* mem;
+    int pending_inserts;            // followers that have not finished yet
+    Status insert_status;           // first error seen by a follower
+
+    port::CondVar cv;
+};
+
+// mem_, imm_ and the current version at one point in time, referenced as
+// a whole. A read pins all of them by taking a reference to the super
+// version its thread has cached, which does not need mutex_.
+struct DBImpl::SuperVersion {
+    SuperVersion* Ref() {
+        refs.fetch_add(1, std::memory_order_relaxed);
+        return this;
+    }
+
+    // returns true if that was the last reference
+    bool Unref() { return refs.fetch_sub(1, std::memory_order_acq_rel) == 1; }
+
+    // drops the references to the memtables and the version.
+    // REQUIRES: mutex_ is held, the last reference is gone
+    void Cleanup() {
+        mem->Unref();
+        for (MemTable* m : imm) m->Unref();
+        current->Unref();
+    }
+
+    MemTable* mem;
+    std::vector<MemTable*> imm;
+    Version* current;
+    std::atomic<int> refs;
+};
+
+// what a thread's cached super version is set to while a read uses it, and
+// when it has gone stale. Installing a new super version replaces every
+// cached one with kSVObsolete; a read that finds its own replaced drops
+// the reference it holds instead of caching it again.
+static int sv_in_use_dummy;
+static void* const kSVInUse = &sv_in_use_dummy;
+static void* const kSVObsolete = nullptr;
+
 DBImpl::DBImpl(const Options& raw_options, const std::string& dbname)
-    : env_(raw_options.env)  
-    {}
+    : env_(raw_options.env),
+      sync_micros_(0),
+      group_commit_waiting_(false),
+      write_controller_(&options_),
+      last_batch_group_size_(0),
+      write_buffer_manager_(raw_options.write_buffer_manager),
+      write_buffer_consumer_(nullptr),
+      mutable_memory_(0),
+      flush_requested_(false),
+      pending_flush_requests_(0),
+      super_version_(nullptr),
+      local_super_version_(new ThreadLocalPtr(&SuperVersionUnrefHandler)) {
+    if (write_buffer_manager_ != nullptr) {
+        write_buffer_consumer_ = new WriteBufferConsumer(this);
+        write_buffer_manager_->Register(write_buffer_consumer_);
+    }
+}
+
+DBImpl::~DBImpl() {
+    if (write_buffer_consumer_ != nullptr) {
+        // no more flush requests once unregistered. the pending ones are
+        // waited for before background work stops, since they may need it
+        write_buffer_manager_->Unregister(write_buffer_consumer_);
+        delete write_buffer_consumer_;
+    }
+    mutex_.Lock();
+    while (pending_flush_requests_.load(std::memory_order_acquire) > 0) {
+        background_work_finished_signal_.Wait();
+    }
+
+    // wait for background work to finish
+    shutting_down_.store(true, std::memory_order_release);
+    while (background_compaction_scheduled_) {
+        background_work_finished_signal_.Wait();
+    }
+
+    // no reads are left, so the cached super versions only hold references
+    delete local_super_version_;
+    if (super_version_ != nullptr && super_version_->Unref()) {
+        super_version_->Cleanup();
+        delete super_version_;
+    }
+    mutex_.Unlock();
+
+    // returns the memtables' memory to the write buffer manager
+    if (mem_ != nullptr) mem_->Unref();
+    for (MemTable* imm : imm_) {
+        imm->Unref();
+    }
+}
+
+// Lets the write buffer manager see how much memory mem_ takes and ask for
+// it to be flushed.
+class DBImpl::WriteBufferConsumer : public WriteBufferManager::Consumer {
+public:
+    explicit WriteBufferConsumer(DBImpl* db) : db_(db) {}
+
+    size_t MutableMemoryUsage() const override {
+        return db_->mutable_memory_.load(std::memory_order_relaxed);
+    }
+
+    void RequestFlush() override {
+        if (db_->flush_requested_.exchange(true, std::memory_order_relaxed)) {
+            return;  // already on its way
+        }
+        // only the front of the writer queue may switch mem_, so an empty
+        // write forces the switch. it gets a thread of its own as it may
+        // have to wait for earlier memtables to be flushed first.
+        db_->pending_flush_requests_.fetch_add(1, std::memory_order_relaxed);
+        db_->env_->StartThread(&DBImpl::FlushRequestThread, db_);
+    }
+
+private:
+    DBImpl* const db_;
+};
+
+void DBImpl::FlushRequestThread(void* db) {
+    DBImpl* impl = reinterpret_cast<DBImpl*>(db);
+    if (impl->FlushStillRequested()) {
+        // a failure is left for the next write to run into
+        impl->Write(WriteOptions(), nullptr);
+    }
+    MutexLock l(&impl->mutex_);
+    impl->pending_flush_requests_.fetch_sub(1, std::memory_order_release);
+    impl->background_work_finished_signal_.SignalAll();
+}
+
+// Returns true if the flush the write buffer manager asked for is still
+// needed. By the time the request's thread runs, mem_ may have been
+// switched out already, or other DBs may have flushed enough to bring the
+// memtables back within budget; the request is then dropped.
+bool DBImpl::FlushStillRequested() {
+    MutexLock l(&mutex_);
+    if (!flush_requested_.load(std::memory_order_relaxed)) {
+        return false;
+    }
+    if (!write_buffer_manager_->ShouldFlush()) {
+        flush_requested_.store(false, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+// A batch read from a log during recovery, waiting to be inserted into
+// "table".
+struct DBImpl::RecoveryBatch {
+    WriteBatch batch;
+    RecoveryMemTable* table;
+};
+
+// A memtable being filled during recovery. Once sealed, whoever finishes
+// the last insert into it writes it to level 0.
+struct DBImpl::RecoveryMemTable {
+    explicit RecoveryMemTable(MemTable* m)
+        : mem(m), logged_bytes(0), pending_inserts(0), sealed(false),
+          file_number(0) {}
+
+    MemTable* mem;
+    size_t logged_bytes;   // size of the batches assigned to it
+    int pending_inserts;   // assigned batches not inserted yet
+    bool sealed;           // no more batches will be assigned
+    // number of the level-0 table it becomes, taken when it is sealed.
+    // tables may finish in any order, but level 0 is ordered by file
+    // number, so the numbers have to follow the log.
+    uint64_t file_number;
+};
+
+// State shared by the log reader and the insert workers of RecoverLogFiles().
+struct DBImpl::RecoveryState {
+    RecoveryState(DBImpl* d, port::Mutex* mu, VersionEdit* e, bool c)
+        : db(d), edit(e), concurrent(c), queued_bytes(0), reading_done(false),
+          running_workers(0), flushed(false), work_cv(mu), done_cv(mu) {}
+
+    DBImpl* const db;
+    VersionEdit* const edit;
+    const bool concurrent;             // inserts run on worker threads
+    std::deque<RecoveryBatch*> queue;  // in log order
+    size_t queued_bytes;               // how far the reader is ahead
+    bool reading_done;
+    int running_workers;
+    bool flushed;                      // some memtable went to level 0
+    Status status;                     // first insert or flush error
+    port::CondVar work_cv;  // batches were queued, or reading is done
+    port::CondVar done_cv;  // the queue shrank, or a worker exited
+};
 
 Status DBImpl::Recover(VersionEdit* edit, bool* save_manifest) {
+    mutex_.AssertHeld();
+
+    Status s = versions_->Recover(save_manifest);
+    if (!s.ok()) {
+        return s;
+    }
+
+    // recover from all newer log files than the ones named in the
+    // descriptor (new log files may have been added by the previous
+    // incarnation without registering them in the descriptor).
+    //
+    // note that PrevLogNumber() is no longer used, but we pay
+    // attention to it in case we are recovering a database
+    // produced by an older version of leveldb.
+    const uint64_t min_log = versions_->LogNumber();
+    const uint64_t prev_log = versions_->PrevLogNumber();
+    std::vector<std::string> filenames;
+    s = env_->GetChildren(dbname_, &filenames);
+    if (!s.ok()) {
+        return s;
+    }
+    uint64_t number;
+    FileType type;
+    std::vector<uint64_t> logs;
+    for (size_t i = 0; i < filenames.size(); i++) {
+        if (ParseFileName(filenames[i], &number, &type)) {
+            if (type == kLogFile && ((number >= min_log) || (number == prev_log))) {
+                logs.push_back(number);
+            }
+        }
+    }
+
+    // recover in the order in which the logs were generated
+    std::sort(logs.begin(), logs.end());
+    SequenceNumber max_sequence(0);
+    s = RecoverLogFiles(logs, save_manifest, edit, &max_sequence);
+    if (!s.ok()) {
+        return s;
+    }
+    for (uint64_t log : logs) {
+        // the previous incarnation may not have written any MANIFEST
+        // records after allocating this log number.  So we manually
+        // update the file number allocation counter in VersionSet.
+        versions_->MarkFileNumberUsed(log);
+    }
+
+    if (versions_->LastSequence() < max_sequence) {
+        versions_->SetLastSequence(max_sequence);
+    }
+
     return Status::OK();
 }
 
-DB::~DB() = default;
+// Replays "logs" into memtables and writes them all to level-0 tables
+// recorded in *edit. The calling thread reads and decodes the logs; with
+// max_recovery_threads > 1 the batches are queued for that many worker
+// threads to insert. Every memtable covers a contiguous stretch of the
+// logs, so the level-0 tables do not overlap in sequence numbers even
+// though they may be written in parallel.
+Status DBImpl::RecoverLogFiles(const std::vector<uint64_t>& logs,
+                               bool* save_manifest, VersionEdit* edit,
+                               SequenceNumber* max_sequence) {
+    struct LogReporter : public log::Reader::Reporter {
+        Logger* info_log;
+        const char* fname;
+        Status* status;  // null if options_.paranoid_checks==false
+        void Corruption(size_t bytes, const Status& s) override {
+            Log(info_log, "%s%s: dropping %d bytes; %s",
+                (this->status == nullptr ? "(ignoring error) " : ""), fname,
+                static_cast<int>(bytes), s.ToString().c_str());
+            if (this->status != nullptr && this->status->ok()) *this->status = s;
+        }
+    };
 
-Status DB::Open(const Options& options, const std::string& dbname, DB** dbptr) {
-    *dbptr = nullptr;
-    *dbptr = new DBImpl();
+    mutex_.AssertHeld();
+    const int workers = options_.max_recovery_threads > 1
+                        ? options_.max_recovery_threads : 0;
+    RecoveryState state(this, &mutex_, edit, workers > 0);
+    // how far the reader may get ahead of the inserts
+    const size_t max_queued_bytes = 2 * options_.write_buffer_size;
+    for (int i = 0; i < workers; i++) {
+        state.running_workers++;
+        env_->StartThread(&DBImpl::RecoveryWorker, &state);
+    }
+
+    RecoveryMemTable* table = nullptr;
     Status s;
-    std::cout << "OPEN" << std::endl;
-    return s;
+    for (size_t i = 0; i < logs.size() && s.ok() && state.status.ok(); i++) {
+        const std::string fname = LogFileName(dbname_, logs[i]);
+        Log(options_.info_log, "Recovering log #%llu",
+            static_cast<unsigned long long>(logs[i]));
+
+        mutex_.Unlock();
+        SequentialFile* file;
+        s = env_->NewSequentialFile(fname, &file);
+        mutex_.Lock();
+        if (!s.ok()) {
+            break;
+        }
+
+        // we intentionally make log::Reader do checksumming even if
+        // paranoid_checks==false so that corruptions cause entire commits
+        // to be skipped instead of propagating bad information (like overly
+        // large sequence numbers).
+        Status read_status;
+        LogReporter reporter;
+        reporter.info_log = options_.info_log;
+        reporter.fname = fname.c_str();
+        reporter.status = (options_.paranoid_checks ? &read_status : nullptr);
+        log::Reader reader(file, &reporter, true /*checksum*/, 0 /*initial_offset*/,
+                           logs[i]);
+        std::string scratch;
+        Slice record;
+        while (true) {
+            mutex_.Unlock();
+            RecoveryBatch* batch = nullptr;
+            if (reader.ReadRecord(&record, &scratch) && read_status.ok()) {
+                if (record.size() < 12) {
+                    reporter.Corruption(record.size(),
+                                        Status::Corruption("log record too small"));
+                } else {
+                    batch = new RecoveryBatch;
+                    WriteBatchInternal::SetContents(&batch->batch, record);
+                }
+            } else {
+                mutex_.Lock();
+                break;
+            }
+            mutex_.Lock();
+            if (batch == nullptr) {
+                continue;
+            }
+            if (!state.status.ok()) {
+                delete batch;
+                break;
+            }
+
+            const SequenceNumber last_seq =
+                    WriteBatchInternal::Sequence(&batch->batch) +
+                    WriteBatchInternal::Count(&batch->batch) - 1;
+            if (last_seq > *max_sequence) {
+                *max_sequence = last_seq;
+            }
+
+            if (table == nullptr) {
+                MemTable* mem = new MemTable(internal_comparator_, workers > 0, &options_);
+                mem->Ref();
+                table = new RecoveryMemTable(mem);
+            }
+            batch->table = table;
+            table->pending_inserts++;
+            table->logged_bytes += record.size();
+            // seal by logged size; workers may not have inserted much yet
+            const bool full = table->logged_bytes > options_.write_buffer_size;
+            if (full) {
+                table->sealed = true;
+                table->file_number = versions_->NewFileNumber();
+                table = nullptr;
+            }
+
+            if (workers == 0) {
+                ApplyRecoveryBatch(&state, batch);
+                continue;
+            }
+            while (state.queued_bytes >= max_queued_bytes && state.status.ok()) {
+                state.done_cv.Wait();
+            }
+            state.queued_bytes += record.size();
+            state.queue.push_back(batch);
+            state.work_cv.Signal();
+        }
+        if (s.ok()) {
+            s = read_status;
+        }
+        delete file;
+    }
+
+    state.reading_done = true;
+    state.work_cv.SignalAll();
+    while (state.running_workers > 0) {
+        state.done_cv.Wait();
+    }
+    // batches left behind after an error never got inserted
+    for (RecoveryBatch* batch : state.queue) {
+        RecoveryMemTable* queued_table = batch->table;
+        delete batch;
+        if (--queued_table->pending_inserts == 0 && queued_table->sealed) {
+            FlushRecoveryMemTable(&state, queued_table);  // just drops it
+        }
+    }
+    state.queue.clear();
+
+    if (table != nullptr) {
+        table->sealed = true;
+        table->file_number = versions_->NewFileNumber();
+        if (s.ok() && state.status.ok()) {
+            FlushRecoveryMemTable(&state, table);
+        } else {
+            table->mem->Unref();
+            delete table;
+        }
+    }
+    if (state.flushed) {
+        *save_manifest = true;
+    }
+    return s.ok() ? state.status : s;
+}
+
+void DBImpl::RecoveryWorker(void* arg) {
+    RecoveryState* state = reinterpret_cast<RecoveryState*>(arg);
+    DBImpl* db = state->db;
+    MutexLock l(&db->mutex_);
+    while (true) {
+        while (state->queue.empty() && !state->reading_done) {
+            state->work_cv.Wait();
+        }
+        if (state->queue.empty() || !state->status.ok()) {
+            break;
+        }
+        RecoveryBatch* batch = state->queue.front();
+        state->queue.pop_front();
+        state->queued_bytes -= WriteBatchInternal::ByteSize(&batch->batch);
+        state->done_cv.SignalAll();
+        db->ApplyRecoveryBatch(state, batch);
+    }
+    state->running_workers--;
+    state->done_cv.SignalAll();
+}
+
+// Inserts "batch" into its memtable, and writes the memtable to level 0
+// if this was the last insert into a sealed one.
+void DBImpl::ApplyRecoveryBatch(RecoveryState* state, RecoveryBatch* batch) {
+    mutex_.AssertHeld();
+    RecoveryMemTable* table = batch->table;
+    mutex_.Unlock();
+    Status s = WriteBatchInternal::InsertInto(&batch->batch, table->mem,
+                                              state->concurrent);
+    delete batch;
+    mutex_.Lock();
+    if (!s.ok() && state->status.ok()) {
+        state->status = s;
+    }
+    if (--table->pending_inserts == 0 && table->sealed) {
+        FlushRecoveryMemTable(state, table);
+    }
+}
+
+// REQUIRES: table is sealed and has no inserts pending
+void DBImpl::FlushRecoveryMemTable(RecoveryState* state, RecoveryMemTable* table) {
+    mutex_.AssertHeld();
+    table->mem->MarkImmutable();
+    if (state->status.ok()) {
+        // the table is built with mutex_ released, so other memtables
+        // can be written at the same time
+        Status s = WriteLevel0Table({table->mem}, state->edit, nullptr,
+                                    table->file_number);
+        if (s.ok()) {
+            state->flushed = true;
+        } else if (state->status.ok()) {
+            state->status = s;
+        }
+    }
+    table->mem->Unref();
+    delete table;
+}
+
+DB::~DB() = default;
 
-    // real impl
+Status DB::Open(const Options& options, const std::string& dbname, DB** dbptr) {
     *dbptr = nullptr;
 
     DBImpl* impl = new DBImpl(options, dbname);
@@ -47,15 +520,17 @@ Status DB::Open(const Options& options, const std::string& dbname, DB** dbptr) {
     if (s.ok() && impl->mem_ == nullptr) {
         // create new log & a corresponding memtable.
         uint64_t new_log_number = impl->versions_->NewFileNumber();
-        WriteableFile* lfile;
-        s = options.env->NewWritableFile(LogFileName(dbname, new_log_number),
-                                         &lfile);
+        WritableFile* lfile;
+        s = impl->NewLogFile(new_log_number, &lfile);
         if (s.ok()) {
             edit.SetLogNumber(new_log_number);
             impl->logfile_ = lfile;
             impl->logfile_number_ = new_log_number;
-            impl->log_ = new log::Writer(lfile);
-            impl->mem_ = new MemTable(impl->internal_comparator_);
+            impl->log_ = impl->NewLogWriter(lfile, new_log_number);
+            impl->mem_ = new MemTable(impl->internal_comparator_,
+                                      options.allow_concurrent_memtable_write,
+                                      &impl->options_);
+            impl->mem_->SetLogNumber(new_log_number);
             impl->mem_->Ref();
         }
     }
@@ -63,10 +538,15 @@ Status DB::Open(const Options& options, const std::string& dbname, DB** dbptr) {
     if (s.ok() && save_manifest) {
         edit.SetPrevLogNumber(0);  // No older logs needed after recovery
         edit.SetLogNumber(impl->logfile_number_);
-        //s = impl->versions_->LogAndApply(&edit, &impl->mutex_);
+        s = impl->versions_->LogAndApply(&edit, &impl->mutex_);
     }
     if (s.ok()) {
         assert(impl->mem_ != nullptr);
+        impl->InstallSuperVersion();
+        impl->MaybeScheduleCompaction();
+    }
+    impl->mutex_.Unlock();
+    if (s.ok()) {
         *dbptr = impl;
     } else {
         delete impl;
@@ -84,20 +564,78 @@ Status DBImpl::Put(const WriteOptions& o, const Slice& key, const Slice& val) {
     return DB::Put(o, key, val);
 }
 
-Status DBImpl::WriteLevel0Table(Memtable* mem, VersionEdit* edit, Version* base) {
+Status DB::DeleteRange(const WriteOptions& opt, const Slice& begin_key,
+                       const Slice& end_key) {
+    WriteBatch batch;
+    batch.DeleteRange(begin_key, end_key);
+    return Write(opt, &batch);
+}
+
+Status DBImpl::DeleteRange(const WriteOptions& o, const Slice& begin_key,
+                           const Slice& end_key) {
+    return DB::DeleteRange(o, begin_key, end_key);
+}
+
+Status DB::Merge(const WriteOptions& opt, const Slice& key, const Slice& operand) {
+    WriteBatch batch;
+    batch.Merge(key, operand);
+    return Write(opt, &batch);
+}
+
+Status DBImpl::Merge(const WriteOptions& o, const Slice& key, const Slice& operand) {
+    if (options_.merge_operator == nullptr) {
+        return Status::InvalidArgument("Merge() needs Options::merge_operator");
+    }
+    return DB::Merge(o, key, operand);
+}
+
+// Writes the contents of "mems" into a single level-0 (or higher, see
+// PickLevelForMemTableOutput) table. Memtables never share a sequence
+// number, so merging them never has to drop an entry. The table gets
+// "file_number" if the caller reserved one, a new number otherwise.
+Status DBImpl::WriteLevel0Table(const std::vector<MemTable*>& mems,
+                                VersionEdit* edit, Version* base,
+                                uint64_t file_number) {
     mutex_.AssertHeld();
+    assert(!mems.empty());
     const uint64_t start_micros = env_->NowMicros();
     FileMetaData meta;
-    meta.number = versions_->NewFileNumber();
+    meta.number = (file_number != 0) ? file_number : versions_->NewFileNumber();
     pending_outputs_.insert(meta.number);
-    Iterator iter = mem->NewIterator();
-    Log(options_.info_log, "Level-0 table #%llu: started",
-        (unsigned long long)meta.number);
-    
+    Log(options_.info_log, "Level-0 table #%llu: started, %d memtables",
+        (unsigned long long)meta.number, static_cast<int>(mems.size()));
+
     Status s;
+    Iterator* iter;
+    Iterator* range_del_iter = nullptr;
     {
         mutex_.Unlock();
-        s = BuildTable(dbname_, env_, options_, table_cache_, iter, &meta);
+        // creating an iterator may sort the memtable (see
+        // Options::memtable_rep), so do it without holding mutex_
+        std::vector<Iterator*> range_del_list;
+        if (mems.size() == 1) {
+            iter = mems[0]->NewIterator();
+        } else {
+            std::vector<Iterator*> list;
+            list.reserve(mems.size());
+            for (MemTable* mem : mems) {
+                list.push_back(mem->NewIterator());
+            }
+            iter = NewMergingIterator(&internal_comparator_, &list[0], list.size());
+        }
+        for (MemTable* mem : mems) {
+            Iterator* tombstones = mem->NewRangeTombstoneIterator();
+            if (tombstones != nullptr) {
+                range_del_list.push_back(tombstones);
+            }
+        }
+        if (range_del_list.size() == 1) {
+            range_del_iter = range_del_list[0];
+        } else if (!range_del_list.empty()) {
+            range_del_iter = NewMergingIterator(&internal_comparator_, &range_del_list[0],
+                                                range_del_list.size());
+        }
+        s = BuildTable(dbname_, env_, options_, table_cache_, iter, range_del_iter, &meta);
         mutex_.Lock();
     }
 
@@ -105,6 +643,7 @@ Status DBImpl::WriteLevel0Table(Memtable* mem, VersionEdit* edit, Version* base)
         (unsigned long long)meta.number, (unsigned long long)meta.file_size,
         s.ToString().c_str());
     delete iter;
+    delete range_del_iter;
     pending_outputs_.erase(meta.number);
 
     // Note that if file_size is zero, the file has been deleted and
@@ -117,7 +656,7 @@ Status DBImpl::WriteLevel0Table(Memtable* mem, VersionEdit* edit, Version* base)
             level = base->PickLevelForMemtableOutput(min_user_key, max_user_key);
         }
         edit->AddFile(level, meta.number, meta.file_size, meta.smallest,
-                      meta.largest);
+                      meta.largest, meta.has_range_tombstones);
     }
 
     CompactionStats stats;
@@ -129,30 +668,41 @@ Status DBImpl::WriteLevel0Table(Memtable* mem, VersionEdit* edit, Version* base)
 
 void DBImpl::CompactMemtable() {
     mutex_.AssertHeld();
-    assert(imm_ != nullptr);
+    assert(!imm_.empty());
 
-    // save the contents of the memtable as a new Table
+    // save the contents of every memtable queued so far as a new Table.
+    // more may be queued while the table is being built; they are left
+    // for the next round.
+    const std::vector<MemTable*> mems = imm_;
     VersionEdit edit;
     Version* base = versions_->current();
     base->Ref();
-    Status s = WriteLevel0Table(imm_, &edit, base);
+    Status s = WriteLevel0Table(mems, &edit, base);
     base->Unref();
 
     if (s.ok() && shutting_down_.load(std::memory_order_acquire)) {
         s = Status::IOError("Delete DB during memtable compaction");
     }
 
-    // Replace immutable memtable with the generated Table
+    // Replace immutable memtables with the generated Table
     if (s.ok()) {
+        // logs older than the oldest memtable still in memory are no longer needed
+        const uint64_t log_number = (imm_.size() > mems.size())
+                                    ? imm_[mems.size()]->LogNumber()
+                                    : logfile_number_;
         edit.SetPrevLogNumber(0);
-        edit.SetLogNumber(logfile_number_);  // Earlier logs no longer needed
+        edit.SetLogNumber(log_number);
         s = versions_->LogAndApply(&edit, &mutex_);
     }
 
     if (s.ok()) {
-        imm_->Unref();
-        imm_ = nullptr;
-        has_imm_.store(false, std::memory_order_acquire);
+        for (MemTable* mem : mems) {
+            MaybeRecycleLogFile(mem->LogNumber());
+            mem->Unref();
+        }
+        imm_.erase(imm_.begin(), imm_.begin() + mems.size());
+        has_imm_.store(!imm_.empty(), std::memory_order_release);
+        InstallSuperVersion();
         RemoveObsoleteFiles();
     } else {
         RecordBackgroundError(s);
@@ -167,7 +717,7 @@ void DBImpl::MaybeScheduleCompaction() {
         // DB is being deleted; no more background compactions
     } else if (!bg_error_.ok()) {
         // already got an error; no more changes
-    } else if (imm_ == nullptr && manual_compaction_ == nullptr &&
+    } else if (imm_.empty() && manual_compaction_ == nullptr &&
                !versions_->NeedsCompaction()) {
         // no work to be done
     } else {
@@ -196,12 +746,12 @@ void DBImpl::BackgroundCall() {
     // previous compaction may have produced too many files in a level,
     // so reschedule another compaction if needed. 
     MaybeScheduleCompaction();
-    background_work_finish_signal_.SignalAll();
+    background_work_finished_signal_.SignalAll();
 }
 
 void DBImpl::BackgroundCompaction() {
     mutex_.AssertHeld();
-    if (imm_ != nullptr) {
+    if (!imm_.empty()) {
         CompactMemtable();
         return;
     }
@@ -224,11 +774,12 @@ void DBImpl::BackgroundCompaction() {
         FileMetaData* f = c->input(0, 0);
         c->edit()->RemoveFile(c->level(), f->number);
         c->edit()->AddFile(c->level() + 1, f->number, f->file_size, f->smallest,
-                           f->largest);
+                           f->largest, f->has_range_tombstones);
         status = versions_->LogAndApply(c->edit(), &mutex_);
         if (!status.ok()) {
             RecordBackgroundError(status);
         }
+        InstallSuperVersion();
         VersionSet::LevelSummaryStorage tmp;
         Log(options_.info_log, "Move #%lld to level-%d %lld bytes %s: %s\n",
             static_cast<unsigned long long>(f->number), c->level() + 1,
@@ -242,6 +793,7 @@ void DBImpl::BackgroundCompaction() {
         }
         CleanupCompaction(compact);
         c->ReleaseInputs();
+        InstallSuperVersion();
         RemoveObsoleteFiles();
     }
     delete c;
@@ -257,46 +809,122 @@ void DBImpl::BackgroundCompaction() {
     if (is_manual) {}
 }
 
+// Creates the file for log "log_number", reusing an obsolete log file if
+// one has been kept for recycling.
+Status DBImpl::NewLogFile(uint64_t log_number, WritableFile** result) {
+    mutex_.AssertHeld();
+    const std::string fname = LogFileName(dbname_, log_number);
+    Status s;
+    bool recycled = false;
+    if (!log_recycle_files_.empty()) {
+        const uint64_t old_number = log_recycle_files_.front();
+        log_recycle_files_.pop_front();
+        s = env_->ReuseWritableFile(fname, LogFileName(dbname_, old_number), result);
+        recycled = s.ok();
+        if (!s.ok()) {
+            Log(options_.info_log, "Recycling log #%llu failed: %s",
+                static_cast<unsigned long long>(old_number), s.ToString().c_str());
+        }
+    }
+    if (!recycled) {
+        s = env_->NewWritableFile(fname, result);
+    }
+
+    if (s.ok() && !recycled && options_.preallocate_log_files) {
+        // a log holds about one write buffer's worth of batches, plus
+        // record headers and block trailers.
+        const uint64_t size = options_.write_buffer_size +
+                              options_.write_buffer_size / 10;
+        Status ps = (*result)->Allocate(0, size);
+        if (!ps.ok()) {
+            // not fatal, the log just grows as it is written
+            Log(options_.info_log, "Preallocating log #%llu: %s",
+                static_cast<unsigned long long>(log_number), ps.ToString().c_str());
+        }
+    }
+    return s;
+}
+
+log::Writer* DBImpl::NewLogWriter(WritableFile* file, uint64_t log_number) {
+    log::Writer* writer = new log::Writer(file, log_number,
+                                          options_.recycle_log_file_num > 0,
+                                          options_.enable_async_log_write);
+    if (options_.log_compression != kNoCompression) {
+        writer->SetCompression(options_.log_compression,
+                               options_.log_compression_min_bytes,
+                               options_.zstd_compression_level);
+    }
+    return writer;
+}
+
+// Keeps the now obsolete log "log_number" for reuse by NewLogFile() if
+// there is room for it; otherwise it is left for RemoveObsoleteFiles().
+void DBImpl::MaybeRecycleLogFile(uint64_t log_number) {
+    mutex_.AssertHeld();
+    if (log_number == 0 || log_number >= versions_->LogNumber() ||
+        log_recycle_files_.size() >= options_.recycle_log_file_num) {
+        return;
+    }
+    log_recycle_files_.push_back(log_number);
+}
+
 // REQUIRES : mutex_ is held
 // REQUIRES : this thread is currently at the front of the writer queue
 Status DBImpl::MakeRoomForWrite(bool force) {
     mutex_.AssertHeld();
     assert(!writes_.empty());
     bool allow_delay = !force;
+    Writer* leader = writers_.front();
     Status s;
     while (true) {
-        if (bg_error_.ok()) {
+        write_controller_.Update(versions_->NumLevelFile(0),
+                                 versions_->PendingCompactionBytes());
+        if (!bg_error_.ok()) {
             s = bg_error_;
             break;
-        } else if (allow_delay && versions_->NumLevelFile(0) >=
-                                      config::kL0_SlowdownWritesTrigger) {
-            // we are getting close to hitting a hard limit on the number of
-            // L0 files. Rather than delaying a single write by several seconds
-            // when we hit the hard limit, start delaying each individual write
-            // by 1ms to reduce latency varience. Also, this delay hands over some CPU 
-            // to the compaction thread in case it is sharing the same core as the writer
-            mutex_.Unlock();
-            env_->SleepForMicroseconds(1000);
+        } else if (allow_delay && write_controller_.NeedsDelay()) {
+            // compactions are falling behind. Rather than delaying a single write
+            // by several seconds when we hit the hard limit, pace every write at
+            // the controller's rate, which drops smoothly as the tree gets closer
+            // to the limit. Also, this delay hands over some CPU to the
+            // compaction thread in case it is sharing the same core as the writer.
+
+            // charge the whole previous group, not just its leader's batch,
+            // so every logged byte goes through the token bucket once.
+            const uint64_t delay =
+                    write_controller_.GetDelay(env_->NowMicros(), last_batch_group_size_);
+            last_batch_group_size_ = 0;
             allow_delay = false;
-            mutex_.Lock();
-        } else if (!force && (mem_->ApproximateMemoryUsage() <= options_.write_buffer_size)) {
+            if (delay > 0) {
+                mutex_.Unlock();
+                env_->SleepForMicroseconds(static_cast<int>(delay));
+                mutex_.Lock();
+                leader->delayed_micros += delay;
+            }
+        } else if (!force && !MemTableFull()) {
             // there is room is current table
             break;
-        } else if (imm_ != nullptr) {
-            // we have filled up the current memtable, but the previous one 
-            // is still being conpacted, so we wait.
+        } else if (static_cast<int>(imm_.size()) + 1 >=
+                   std::max(options_.max_write_buffer_number, 2)) {
+            // we have filled up the current memtable, but as many previous ones
+            // as we may keep are still being conpacted, so we wait.
             Log(options_->info_log, "Current memtable full; waiting...\n");
             background_work_finished_signal_.Wait();
-        } else if (versions_->NumLevelFile(0) >= config::kL0_StopWritesTrigger){
-            // there are too many level-0 files
-            Log(options_->info_log, "Too many L0 files, waiting...\n");
+        } else if (write_controller_.IsStopped()) {
+            // there are too many level-0 files or too much pending compaction work
+            Log(options_->info_log, "Too many L0 files or pending compaction bytes, waiting...\n");
             background_work_finished_signal_.Wait();
+        } else if (!memtable_groups_.empty()) {
+            // earlier batch groups are still being inserted into mem_, so it
+            // can not become immutable yet. the last group to leave the
+            // memtable stage wakes up the front of the writer queue.
+            writers_.front()->cv.Wait();
         } else {
             // Attempt to switch to a new memtable and trigger compaction of old
             assert(versions_->PrevLogNumber() == 0);
             uint64_t new_log_number = versions_->NewFileNumber();
             WritableFile* lfile = nullptr;
-            s = env_->NewWritableFile(LogFileName(dbname_, new_log_number), &lfile);
+            s = NewLogFile(new_log_number, &lfile);
             if (!s.ok()) {
                 // avoid chewing througth file number space in a tight up
                 versions_->ReuseFileNumber(new_log_number);
@@ -306,11 +934,18 @@ Status DBImpl::MakeRoomForWrite(bool force) {
             delete logfile_;
             logfile_ = lfile;
             logfile_number_ = new_log_number;
-            log_ = new log::Writer(lfile);
-            imm_ = mem_;
+            log_ = NewLogWriter(lfile, new_log_number);
+            mem_->MarkImmutable();
+            imm_.push_back(mem_);
             has_imm_.store(true, std::memory_order_release);
-            mem_ = new MemTable(internal_comparator_);
+            mutable_memory_.store(0, std::memory_order_relaxed);
+            flush_requested_.store(false, std::memory_order_relaxed);
+            mem_ = new MemTable(internal_comparator_,
+                                options_.allow_concurrent_memtable_write,
+                                &options_);
+            mem_->SetLogNumber(new_log_number);
             mem_.Ref();
+            InstallSuperVersion();
             force = false;
             MaybeScheduleCompaction();
         }
@@ -318,17 +953,51 @@ Status DBImpl::MakeRoomForWrite(bool force) {
     return s;
 }
 
+// Returns true if mem_ should be switched out: it has reached this DB's
+// write_buffer_size, or the memtables sharing the write buffer manager
+// are over budget and mem_ is the largest of them.
+bool DBImpl::MemTableFull() {
+    mutex_.AssertHeld();
+    const size_t usage = mem_->ApproximateMemoryUsage();
+    if (usage > options_.write_buffer_size) {
+        return true;
+    }
+    if (write_buffer_manager_ == nullptr) {
+        return false;
+    }
+    mem_->ChargeWriteBuffer();
+    mutable_memory_.store(usage, std::memory_order_relaxed);
+    if (flush_requested_.load(std::memory_order_relaxed)) {
+        return true;
+    }
+    return write_buffer_manager_->ShouldFlush() &&
+           write_buffer_manager_->FlushLargest(write_buffer_consumer_);
+}
+
 Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
+    if (options_.enable_pipelined_write || options_.enable_async_log_write) {
+        // an async log write only frees the writer queue if the group
+        // waits for its I/O in the memtable stage
+        return PipelinedWrite(options, updates);
+    }
+
     Writer w(&mutex_);
     w.batch = updates;
     w.sync = options.sync;
     w.done = false;
+    w.delay_report = options.delay_micros;
 
     MutexLock l(&mutex_);
     writers_.push_back(&w);
-    while (!w.done() && &w != writers_.front()) {
+    if (w.sync && group_commit_waiting_) {
+        group_commit_cv_.notify_one();
+    }
+    while (!w.done && w.memtable_group == nullptr && &w != writers_.front()) {
         w.cv.Wait();
     }
+    if (w.memtable_group != nullptr) {
+        return JoinConcurrentInsert(&w);
+    }
     if (w.done) {
         return w.status;
     }
@@ -338,20 +1007,32 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
     uint64_t last_sequence = versions_->LastSequence();
     Writer* last_writer = &w;
     if (status.ok() && updates != nullptr) {  // nullptr batch is for compactions
-        WriteBatch* write_batch = BuildBatchGroup(&last_sequence);
+        if (w.sync) {
+            WaitForGroupCommit();
+        }
+        WriteBatch* write_batch = BuildBatchGroup(&last_writer);
         WriteBatchInternal::SetSequence(write_batch, last_sequence + 1);
-        last_sequence += WriteBatchInternal::Count(write_batch);
+        MemTableGroup group(&mutex_);
+        const bool parallel = options_.allow_concurrent_memtable_write &&
+                              write_batch == tmp_batch_;
+        if (parallel) {
+            last_sequence = AssignGroupSequences(last_writer, last_sequence, &group);
+        } else {
+            last_sequence += WriteBatchInternal::Count(write_batch);
+        }
         {
             mutex_.Unlock();
-            status = log_->AddRecord(WriteBatchInternal::Contents(write_batch));
+            std::vector<Slice> log_parts;
+            WriteBatchInternal::ContentsParts(write_batch, &log_parts);
+            status = log_->AddRecord(log_parts.data(), log_parts.size());
             bool sync_error = false;
             if (status.ok() && options.sync) {
-                status = logfile_->Sync()
+                status = SyncLog();
                 if (!status.ok()) {
                     sync_error = true;
                 }
             }
-            if (status.ok()) {
+            if (status.ok() && !parallel) {
                 status = WriteBatchInternal::InsertInto(write_batch, mem_);
             }
             mutex_.Lock();
@@ -359,6 +1040,9 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
                 RecordBackgroundError(status);
             }
         }
+        if (status.ok() && parallel) {
+            status = InsertConcurrently(&group, mem_);
+        }
         if (write_batch == tmp_batch_) tmp_batch_->Clear();
 
         versions_->SetLastSequence(last_sequence);
@@ -367,6 +1051,10 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
     while (true) {
         Writer* ready = writers_.front();
         writers_.pop_front();
+        if (ready->delay_report != nullptr) {
+            // the whole group waited for as long as its leader
+            *ready->delay_report = w.delayed_micros;
+        }
         if (ready != &w) {
             ready->status = status;
             ready->done = true;
@@ -382,9 +1070,436 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
     return status;
 }
 
+// Same contract as Write(), but the leader only holds the front of the
+// writer queue while it appends to the log. The logged group then moves to
+// memtable_groups_ so the next leader can start its own log append while
+// this group is still being inserted into the memtable. Groups leave the
+// memtable stage, and publish their sequence numbers, in log order.
+Status DBImpl::PipelinedWrite(const WriteOptions& options, WriteBatch* updates) {
+    Writer w(&mutex_);
+    w.batch = updates;
+    w.sync = options.sync;
+    w.done = false;
+    w.delay_report = options.delay_micros;
+
+    MutexLock l(&mutex_);
+    writers_.push_back(&w);
+    if (w.sync && group_commit_waiting_) {
+        group_commit_cv_.notify_one();
+    }
+    while (!w.done && w.memtable_group == nullptr && &w != writers_.front()) {
+        w.cv.Wait();
+    }
+    if (w.memtable_group != nullptr) {
+        return JoinConcurrentInsert(&w);
+    }
+    if (w.done) {
+        return w.status;
+    }
+
+    // May temporarily unlock and wait
+    Status status = MakeRoomForWrite(updates == nullptr);
+    Writer* last_writer = &w;
+    MemTableGroup group(&mutex_);
+    if (status.ok() && updates != nullptr) {  // nullptr batch is for compactions
+        if (w.sync) {
+            WaitForGroupCommit();
+        }
+        // groups still in the memtable stage have not published their
+        // sequence numbers yet, so continue after the newest of them.
+        uint64_t last_sequence = memtable_groups_.empty()
+                                 ? versions_->LastSequence()
+                                 : memtable_groups_.back()->last_sequence;
+        WriteBatch* write_batch = BuildBatchGroup(&last_writer);
+        WriteBatchInternal::SetSequence(write_batch, last_sequence + 1);
+        group.last_sequence =
+                AssignGroupSequences(last_writer, last_sequence, &group);
+
+        {
+            mutex_.Unlock();
+            std::vector<Slice> log_parts;
+            WriteBatchInternal::ContentsParts(write_batch, &log_parts);
+            status = log_->AddRecord(log_parts.data(), log_parts.size());
+            bool sync_error = false;
+            if (status.ok() && options_.enable_async_log_write) {
+                // don't wait for the I/O, the group does that in the memtable
+                // stage while the next leader appends its own record
+                group.log_sync = options.sync;
+                group.log_submit_micros = env_->NowMicros();
+                status = logfile_->SubmitAsync(options.sync, &group.log_ticket);
+            } else if (status.ok() && options.sync) {
+                status = SyncLog();
+                if (!status.ok()) {
+                    sync_error = true;
+                }
+            }
+            mutex_.Lock();
+            if (sync_error) {
+                RecordBackgroundError(status);
+            }
+        }
+        if (write_batch == tmp_batch_) tmp_batch_->Clear();
+
+        group.status = status;
+        memtable_groups_.push_back(&group);
+    }
+
+    // release the writer queue to the next leader
+    while (true) {
+        Writer* ready = writers_.front();
+        writers_.pop_front();
+        if (ready->delay_report != nullptr) {
+            // the whole group waited for as long as its leader
+            *ready->delay_report = w.delayed_micros;
+        }
+        if (group.writers.empty() && ready != &w) {
+            // nothing was logged, finish the followers right away
+            ready->status = status;
+            ready->done = true;
+            ready->cv.Signal();
+        }
+        if (ready == last_writer) break;
+    }
+    if (!writers_.empty()) {
+        writers_.front()->cv.Signal();
+    }
+    if (group.writers.empty()) {
+        return status;
+    }
+
+    // memtable stage: wait until every group logged before ours is applied
+    while (&group != memtable_groups_.front()) {
+        group.cv.Wait();
+    }
+    if (group.status.ok()) {
+        MemTable* mem = mem_;  // can not be switched while we are queued
+        if (options_.allow_concurrent_memtable_write && group.writers.size() > 1) {
+            status = InsertConcurrently(&group, mem);
+        } else {
+            mutex_.Unlock();
+            for (Writer* writer : group.writers) {
+                if (writer->batch == nullptr) continue;
+                status = WriteBatchInternal::InsertInto(writer->batch, mem);
+                if (!status.ok()) break;
+            }
+            mutex_.Lock();
+        }
+        if (options_.enable_async_log_write) {
+            // the log can not be switched while groups are queued here
+            mutex_.Unlock();
+            Status log_status = WaitForLog(group.log_ticket, group.log_sync,
+                                           group.log_submit_micros);
+            mutex_.Lock();
+            if (!log_status.ok()) {
+                RecordBackgroundError(log_status);
+                if (status.ok()) {
+                    status = log_status;
+                }
+            }
+        }
+    }
+    versions_->SetLastSequence(group.last_sequence);
+
+    memtable_groups_.pop_front();
+    if (!memtable_groups_.empty()) {
+        memtable_groups_.front()->cv.Signal();
+    } else if (!writers_.empty()) {
+        // the queue leader may be waiting in MakeRoomForWrite() for the
+        // memtable stage to drain
+        writers_.front()->cv.Signal();
+    }
+
+    for (Writer* writer : group.writers) {
+        if (writer != &w) {
+            writer->status = status;
+            writer->done = true;
+            writer->cv.Signal();
+        }
+    }
+    return status;
+}
+
+// Stamps the batch of every writer from the front of the queue through
+// "last_writer" with its own slice of the group's sequence range, so the
+// batches can be inserted into the memtable one by one rather than as the
+// combined group batch. Collects the writers in group->writers and returns
+// the last sequence number used.
+SequenceNumber DBImpl::AssignGroupSequences(Writer* last_writer,
+                                            SequenceNumber last_sequence,
+                                            MemTableGroup* group) {
+    mutex_.AssertHeld();
+    for (Writer* writer : writers_) {
+        if (writer->batch != nullptr) {
+            WriteBatchInternal::SetSequence(writer->batch, last_sequence + 1);
+            last_sequence += WriteBatchInternal::Count(writer->batch);
+        }
+        group->writers.push_back(writer);
+        if (writer == last_writer) break;
+    }
+    return last_sequence;
+}
+
+// Has every member of "group" insert its own batch into "mem", the
+// calling leader included, and waits until all of them are done.
+// REQUIRES: mem was created with allow_concurrent_memtable_write
+// REQUIRES: group->writers.front() is the calling leader
+Status DBImpl::InsertConcurrently(MemTableGroup* group, MemTable* mem) {
+    mutex_.AssertHeld();
+    Writer* leader = group->writers.front();
+    group->mem = mem;
+    group->pending_inserts = 0;
+    for (Writer* writer : group->writers) {
+        if (writer != leader && writer->batch != nullptr) {
+            group->pending_inserts++;
+            writer->memtable_group = group;
+            writer->cv.Signal();
+        }
+    }
+
+    mutex_.Unlock();
+    Status s = WriteBatchInternal::InsertInto(leader->batch, mem, true);
+    mutex_.Lock();
+    while (group->pending_inserts > 0) {
+        group->cv.Wait();
+    }
+    if (s.ok()) {
+        s = group->insert_status;
+    }
+    return s;
+}
+
+// Follower side of InsertConcurrently(): insert our own batch, then wait
+// for the leader to finish the group.
+Status DBImpl::JoinConcurrentInsert(Writer* w) {
+    mutex_.AssertHeld();
+    MemTableGroup* group = w->memtable_group;
+    MemTable* mem = group->mem;
+    mutex_.Unlock();
+    Status s = WriteBatchInternal::InsertInto(w->batch, mem, true);
+    mutex_.Lock();
+    if (!s.ok() && group->insert_status.ok()) {
+        group->insert_status = s;
+    }
+    if (--group->pending_inserts == 0) {
+        group->cv.Signal();
+    }
+    // the group may be gone once the leader wakes up, don't touch it again
+    while (!w->done) {
+        w->cv.Wait();
+    }
+    return w->status;
+}
+
+// Called by the leader of a sync write before it forms its batch group.
+// lets std::condition_variable_any release and reacquire a port::Mutex
+namespace {
+class MutexAdapter {
+public:
+    explicit MutexAdapter(port::Mutex* mu) : mu_(mu) {}
+    void lock() { mu_->Lock(); }
+    void unlock() { mu_->Unlock(); }
+
+private:
+    port::Mutex* const mu_;
+};
+}  // namespace
+
+// When a log sync is expensive compared to the configured window, wait a
+// little for more sync writers to queue up behind us, so one sync covers
+// all of them. Stops early once group_commit_max_bytes are queued.
+void DBImpl::WaitForGroupCommit() {
+    mutex_.AssertHeld();
+    const uint64_t max_delay = options_.group_commit_max_delay_micros;
+    if (max_delay == 0) {
+        return;
+    }
+
+    // holding a write back longer than half a sync would cost more
+    // latency than sharing the sync saves.
+    const uint64_t window =
+            std::min(max_delay, sync_micros_.load(std::memory_order_relaxed) / 2);
+    if (window == 0) {
+        return;
+    }
+
+    // new sync writers signal group_commit_cv_ (see Write()), so we only
+    // wake up to recount, or when the window is over. The window is timed
+    // on the steady clock, which a wall clock step can not cut short or
+    // stretch.
+    const std::chrono::steady_clock::time_point deadline =
+            std::chrono::steady_clock::now() + std::chrono::microseconds(window);
+    MutexAdapter lock(&mutex_);
+    group_commit_waiting_ = true;
+    while (true) {
+        size_t queued = 0;
+        for (Writer* w : writers_) {
+            if (!w->sync) break;  // would not join our group anyway
+            if (w->batch != nullptr) {
+                queued += WriteBatchInternal::ByteSize(w->batch);
+            }
+        }
+        if (queued >= options_.group_commit_max_bytes) {
+            break;
+        }
+        if (group_commit_cv_.wait_until(lock, deadline) == std::cv_status::timeout) {
+            break;  // window is over
+        }
+    }
+    group_commit_waiting_ = false;
+}
+
+// Syncs the log and folds the time it took into sync_micros_.
+Status DBImpl::SyncLog() {
+    const uint64_t start_micros = env_->NowMicros();
+    Status s = logfile_->Sync();
+    RecordSyncMicros(env_->NowMicros() - start_micros);
+    return s;
+}
+
+// Waits for the log I/O started by logfile_->SubmitAsync(). For a sync
+// write the time since "submit_micros" counts as the sync latency.
+Status DBImpl::WaitForLog(uint64_t ticket, bool sync, uint64_t submit_micros) {
+    Status s = logfile_->WaitAsync(ticket);
+    if (sync) {
+        RecordSyncMicros(env_->NowMicros() - submit_micros);
+    }
+    return s;
+}
+
+void DBImpl::RecordSyncMicros(uint64_t micros) {
+    const uint64_t average = sync_micros_.load(std::memory_order_relaxed);
+    sync_micros_.store(average == 0 ? micros : (average * 7 + micros) / 8,
+                       std::memory_order_relaxed);
+}
+
+// REQUIRES: writer list must be non-empty
+// REQUIRES: first writer must have a non-null batch
+WriteBatch* DBImpl::BuildBatchGroup(Writer** last_writer) {
+    mutex_.AssertHeld();
+    assert(!writers_.empty());
+    Writer* first = writers_.front();
+    WriteBatch* result = first->batch;
+    assert(result != nullptr);
+
+    size_t size = WriteBatchInternal::ByteSize(first->batch);
+
+    // allow the group to grow up to a maximum size, but if the
+    // original write is small, limit the growth so we do not slow
+    // down the small write too much.
+    size_t max_size = 1 << 20;
+    if (first->sync && options_.group_commit_max_delay_micros > 0) {
+        // the leader already waited for the group to fill up, take it all
+        max_size = options_.group_commit_max_bytes;
+    } else if (size <= (128 << 10)) {
+        max_size = size + (128 << 10);
+    }
+
+    *last_writer = first;
+    std::deque<Writer*>::iterator iter = writers_.begin();
+    ++iter;  // advance past "first"
+    for (; iter != writers_.end(); ++iter) {
+        Writer* w = *iter;
+        if (w->sync && !first->sync) {
+            // do not include a sync write into a batch handled by a non-sync write.
+            break;
+        }
+
+        if (w->batch != nullptr) {
+            size += WriteBatchInternal::ByteSize(w->batch);
+            if (size > max_size) {
+                // do not make batch too big
+                break;
+            }
+
+            // append to *result
+            if (result == first->batch) {
+                // switch to temporary batch instead of disturbing caller's batch
+                result = tmp_batch_;
+                assert(WriteBatchInternal::Count(result) == 0);
+                WriteBatchInternal::Append(result, first->batch);
+            }
+            WriteBatchInternal::Append(result, w->batch);
+        }
+        *last_writer = w;
+    }
+    last_batch_group_size_ = WriteBatchInternal::ByteSize(result);
+    return result;
+}
+
+void DBImpl::InstallSuperVersion() {
+    mutex_.AssertHeld();
+    SuperVersion* sv = new SuperVersion;
+    sv->mem = mem_;
+    sv->imm = imm_;
+    sv->current = versions_->current();
+    sv->mem->Ref();
+    for (MemTable* m : sv->imm) m->Ref();
+    sv->current->Ref();
+    sv->refs.store(1, std::memory_order_relaxed);  // held by super_version_
+
+    SuperVersion* old = super_version_;
+    super_version_ = sv;
+
+    // take the cached references back before dropping the one of
+    // super_version_, so a cached super version never outlives it
+    std::vector<void*> cached;
+    local_super_version_->Scrape(&cached, kSVObsolete);
+    for (void* ptr : cached) {
+        SuperVersion* c = static_cast<SuperVersion*>(ptr);
+        // a read in progress drops its reference itself, see ReturnSuperVersion()
+        if (ptr != kSVInUse && c->Unref()) {
+            c->Cleanup();
+            delete c;
+        }
+    }
+    if (old != nullptr && old->Unref()) {
+        old->Cleanup();
+        delete old;
+    }
+}
+
+DBImpl::SuperVersion* DBImpl::GetAndRefSuperVersion() {
+    // marking the cached super version in use keeps an install from taking
+    // its reference away while the read runs
+    void* ptr = local_super_version_->Swap(kSVInUse);
+    assert(ptr != kSVInUse);
+    if (ptr != kSVObsolete) {
+        return static_cast<SuperVersion*>(ptr);
+    }
+    MutexLock l(&mutex_);
+    return super_version_->Ref();
+}
+
+void DBImpl::ReturnSuperVersion(SuperVersion* sv) {
+    void* expected = kSVInUse;
+    if (local_super_version_->CompareAndSwap(sv, expected)) {
+        return;  // cached for the next read, along with the reference
+    }
+    // a newer super version has been installed meanwhile
+    assert(expected == kSVObsolete);
+    if (sv->Unref()) {
+        MutexLock l(&mutex_);
+        sv->Cleanup();
+        delete sv;
+    }
+}
+
+void DBImpl::SuperVersionUnrefHandler(void* ptr) {
+    // the thread of a cached super version exited, or the DB is being
+    // closed. Either way super_version_ still holds a reference to it, as
+    // installs scrape the caches before dropping that, so this never has
+    // to take mutex_ for Cleanup()
+    SuperVersion* sv = static_cast<SuperVersion*>(ptr);
+    const bool last_ref = sv->Unref();
+    assert(!last_ref);
+    (void)last_ref;
+}
+
 Status DBImpl::Get(const ReadOptions& options, const Slice& key, std::string* value) {
     Status s;
-    MutexLock l(&mutex_);
+    // pin the memtables and the version first: once the sequence number is
+    // read, entries up to it are in them
+    SuperVersion* sv = GetAndRefSuperVersion();
     SequenceNumber snapshot;
     if (options.snapshot != nullptr) {
         snapshot = static_cast<const SnapShotImpl*>(options.snapshot)->sequence_number();
@@ -392,39 +1507,105 @@ Status DBImpl::Get(const ReadOptions& options, const Slice& key, std::string* va
         snapshot = versions_->LastSequence();
     }
 
-    MemTable* mem = mem_;
-    MemTable* imm = imm_;
-    Version* current = versions_->current();
-    mem->Ref();
-    if (imm != nullptr) imm->Ref();
-    current->Ref();
-
     bool have_stat_update = false;
     Version::GetStats stats;
 
-    // unlock while reading from files and memtables
-    {
-        mutex_.Unlock();
-        // first look in the memtable, then in the imm if any.
-        LookupKey lkey(key, snapshot);
-        if (mem->Get(lkey, value, s)) {
-            // Done
-        } else if (imm != nullptr && imm->Get(lkey, value, s)) {
-            // Done
-        } else {
-            s = current->Get(options, lkey, value, &stats);
-            have_stat_update = true;
-        }
-        mutex_.Lock();
+    // first look in the memtable, then in the imms from newest to oldest.
+    LookupKey lkey(key, snapshot);
+    SequenceNumber max_covering_tombstone_seq = 0;
+    MergeContext merge_context;
+    bool done = sv->mem->Get(lkey, value, &s, &max_covering_tombstone_seq, &merge_context);
+    for (auto it = sv->imm.rbegin(); !done && it != sv->imm.rend(); ++it) {
+        done = (*it)->Get(lkey, value, &s, &max_covering_tombstone_seq, &merge_context);
+    }
+    if (!done) {
+        s = sv->current->Get(options, lkey, value, &stats, &merge_context);
+        have_stat_update = true;
     }
 
-    if (have_stat_update && current->UpdateStats(stats)) {
-        MaybeScheduleCompaction();
+    // only reads that went through more than one file charge a seek, so
+    // only those need mutex_
+    if (have_stat_update && stats.seek_file != nullptr) {
+        MutexLock l(&mutex_);
+        if (sv->current->UpdateStats(stats)) {
+            MaybeScheduleCompaction();
+        }
     }
-    mem->Unref();
-    if (imm != nullptr) imm->Unref();
-    current->Unref();
+    ReturnSuperVersion(sv);
     return s;
 }
 
+std::vector<Status> DBImpl::MultiGet(const ReadOptions& options, const std::vector<Slice>& keys,
+                                     std::vector<std::string>* values) {
+    const size_t n = keys.size();
+    std::vector<Status> statuses(n);
+    values->resize(n);
+
+    SuperVersion* sv = GetAndRefSuperVersion();
+    SequenceNumber snapshot;
+    if (options.snapshot != nullptr) {
+        snapshot = static_cast<const SnapShotImpl*>(options.snapshot)->sequence_number();
+    } else {
+        snapshot = versions_->LastSequence();
+    }
+
+    // go through the keys in order: lookups in a memtable then follow
+    // each other closely, and Version::MultiGet() needs them sorted
+    const Comparator* ucmp = internal_comparator_.user_comparator();
+    std::vector<size_t> order(n);
+    for (size_t i = 0; i < n; i++) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&keys, ucmp](size_t a, size_t b) {
+        return ucmp->Compare(keys[a], keys[b]) < 0;
+    });
+
+    std::deque<LookupKey> lkeys;  // a deque since LookupKey cannot be moved
+    std::vector<MergeContext> merge_contexts(n);
+    std::vector<Version::MultiGetKey> version_keys;
+    for (size_t i : order) {
+        lkeys.emplace_back(keys[i], snapshot);
+        const LookupKey& lkey = lkeys.back();
+        std::string* value = &(*values)[i];
+        SequenceNumber max_covering_tombstone_seq = 0;
+        bool done = sv->mem->Get(lkey, value, &statuses[i], &max_covering_tombstone_seq,
+                                 &merge_contexts[i]);
+        for (auto it = sv->imm.rbegin(); !done && it != sv->imm.rend(); ++it) {
+            done = (*it)->Get(lkey, value, &statuses[i], &max_covering_tombstone_seq,
+                              &merge_contexts[i]);
+        }
+        if (!done) {
+            Version::MultiGetKey key;
+            key.lkey = &lkey;
+            key.value = value;
+            key.status = &statuses[i];
+            key.merge_context = &merge_contexts[i];
+            version_keys.push_back(key);
+        }
+    }
+
+    if (!version_keys.empty()) {
+        sv->current->MultiGet(options, &version_keys);
+
+        bool have_seek_charge = false;
+        for (const Version::MultiGetKey& key : version_keys) {
+            have_seek_charge |= (key.stats.seek_file != nullptr);
+        }
+        if (have_seek_charge) {
+            MutexLock l(&mutex_);
+            bool compact = false;
+            for (const Version::MultiGetKey& key : version_keys) {
+                if (key.stats.seek_file != nullptr && sv->current->UpdateStats(key.stats)) {
+                    compact = true;
+                }
+            }
+            if (compact) {
+                MaybeScheduleCompaction();
+            }
+        }
+    }
+    ReturnSuperVersion(sv);
+    return statuses;
+}
+
 }
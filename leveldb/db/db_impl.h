@@ -1,16 +1,23 @@
 #ifndef STORAGE_LEVELDB_DB_DB_IMPL_H_
 #define STORAGE_LEVELDB_DB_DB_IMPL_H_
 
+#include <atomic>
+#include <condition_variable>
 #include <string>
 #include <deque>
+#include <vector>
 
 #include "leveldb/db.h"
+#include "leveldb/write_buffer_manager.h"
 #include "db/memtable.h"
 #include "db/table_cache.h"
 #include "db/log_writer.h"
+#include "db/write_controller.h"
 
 namespace leveldb {
 
+class ThreadLocalPtr;
+
 class DBImpl : public DB {
 public:
     DBImpl(const Options& options, const std::string& dbname);
@@ -18,25 +25,80 @@ public:
     DBImpl(DBImpl&) = delete;
     DBImpl& operator=(DBImpl&) = delete;
 
+    ~DBImpl() override;
+
     Status Put(const WriteOptions&, const Slice& key, const Slice& value) override;
+    Status DeleteRange(const WriteOptions&, const Slice& begin_key,
+                       const Slice& end_key) override;
+    Status Merge(const WriteOptions&, const Slice& key, const Slice& operand) override;
     Status Write(const WriteOptions& options, WriteBatch* updates) override;
     Status Get(const ReadOptions& options, const Slice& key, std::string* value) override;
+    std::vector<Status> MultiGet(const ReadOptions& options, const std::vector<Slice>& keys,
+                                 std::vector<std::string>* values) override;
 
 private:
     friend class DB;
     struct Writer;
-
+    struct MemTableGroup;
+    class WriteBufferConsumer;
+    struct SuperVersion;
 
     void CompactMemtable() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
-    Status WriteLevel0Table(Memtable* mem, VersionEdit* edit, Version* base)
+    struct RecoveryBatch;
+    struct RecoveryMemTable;
+    struct RecoveryState;
+
+    Status Recover(VersionEdit* edit, bool* save_manifest)
+        EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+    Status RecoverLogFiles(const std::vector<uint64_t>& logs, bool* save_manifest,
+                           VersionEdit* edit, SequenceNumber* max_sequence)
+        EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+    static void RecoveryWorker(void* state);
+    void ApplyRecoveryBatch(RecoveryState* state, RecoveryBatch* batch)
+        EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+    void FlushRecoveryMemTable(RecoveryState* state, RecoveryMemTable* table)
+        EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+    Status WriteLevel0Table(const std::vector<MemTable*>& mems,
+                            VersionEdit* edit, Version* base,
+                            uint64_t file_number = 0)
            EXCLUSIVE_LOCKS_REQUIRED(mutex_); 
 
+    Status PipelinedWrite(const WriteOptions& options, WriteBatch* updates);
+
     Status MakeRoomForWrite(bool force) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+    bool MemTableFull() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+    static void FlushRequestThread(void* db);
+    bool FlushStillRequested();
+    WriteBatch* BuildBatchGroup(Writer** last_writer)
+        EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+    SequenceNumber AssignGroupSequences(Writer* last_writer,
+                                        SequenceNumber last_sequence,
+                                        MemTableGroup* group)
+        EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+    Status InsertConcurrently(MemTableGroup* group, MemTable* mem)
+        EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+    Status JoinConcurrentInsert(Writer* w) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+    void WaitForGroupCommit() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+    Status NewLogFile(uint64_t log_number, WritableFile** result)
+        EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+    void MaybeRecycleLogFile(uint64_t log_number) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+    log::Writer* NewLogWriter(WritableFile* file, uint64_t log_number);
+    Status SyncLog();
+    Status WaitForLog(uint64_t ticket, bool sync, uint64_t submit_micros);
+    void RecordSyncMicros(uint64_t micros);
     void MaybeScheduleCompaction() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
     static void BGWork(void* db);
     void BackgroundCall();
     void BackgroundCompaction() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+    // publishes mem_, imm_ and the current version to readers. Must be
+    // called whenever one of them changes
+    void InstallSuperVersion() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+    SuperVersion* GetAndRefSuperVersion();
+    void ReturnSuperVersion(SuperVersion* sv);
+    static void SuperVersionUnrefHandler(void* ptr);
+
     // constant after construction
     Env* const env_;
     const InternalKeyComparator internal_comparator_;
@@ -49,18 +111,58 @@ private:
     port::Mutex mutex_;
     std::atomic<bool> shutting_down_;
     MemTable* mem_;
-    MemTable* imm_ GUARDED_BY(mutex_);
+    // memtables waiting to be flushed, oldest first
+    std::vector<MemTable*> imm_ GUARDED_BY(mutex_);
     WritableFile* logfile_;
     uint64_t logfile_number_ GUARDED_BY(mutex_);
+    // obsolete log files kept for reuse by NewLogFile(), oldest first.
+    // the obsolete file sweep must leave these alone
+    std::deque<uint64_t> log_recycle_files_ GUARDED_BY(mutex_);
     log::Writer* log_;
+    // moving average of recent log sync latencies, sizes the group commit
+    // window. only updated by the writer that owns the log
+    std::atomic<uint64_t> sync_micros_;
+    // set while a sync leader holds its group commit window open, so that
+    // queueing sync writers wake it up to recount the queued bytes
+    bool group_commit_waiting_ GUARDED_BY(mutex_);
+    // what the sync leader waits on, with mutex_, during that window
+    std::condition_variable_any group_commit_cv_;
     VersionSet* const versions_ GUARDED_BY(mutex_);
 
     // queue of writers.
     std::deque<Writer*> writers_ GUARDED_BY(mutex_);
+    WriteBatch* tmp_batch_ GUARDED_BY(mutex_);
+
+    // batch groups that have been logged and are waiting for (or busy with)
+    // their memtable insert. only used when options_.enable_pipelined_write
+    std::deque<MemTableGroup*> memtable_groups_ GUARDED_BY(mutex_);
 
     std::set<uint64_t> pending_outputs_ GUARDED_BY(mutex_);
     bool background_compaction_scheduled_ GUARDED_BY(mutex_);
     Status bg_error_ GUARDED_BY(mutex_);
+
+    // paces writes while compactions are behind, see MakeRoomForWrite()
+    WriteController write_controller_ GUARDED_BY(mutex_);
+    // size of the last batch group, what the next leader charges to
+    // write_controller_ (the group it leads is only formed after the delay)
+    uint64_t last_batch_group_size_ GUARDED_BY(mutex_);
+
+    // options_.write_buffer_manager as the DB was opened with, if any
+    WriteBufferManager* const write_buffer_manager_;
+    // registered with write_buffer_manager_, if there is one
+    WriteBufferConsumer* write_buffer_consumer_;
+    // memory charged for mem_, for the manager to compare DBs by
+    std::atomic<size_t> mutable_memory_;
+    // the manager asked for mem_ to be switched out
+    std::atomic<bool> flush_requested_;
+    // threads started by flush requests that have not finished yet
+    std::atomic<int> pending_flush_requests_;
+
+    // what Get() reads from, see InstallSuperVersion()
+    SuperVersion* super_version_ GUARDED_BY(mutex_);
+    // per thread, a referenced copy of super_version_ for Get() to use
+    // without taking mutex_
+    ThreadLocalPtr* local_super_version_;
 };
 
 }  // namespace leveldb
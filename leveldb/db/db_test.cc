@@ -0,0 +1,281 @@
+#include "leveldb/db.h"
+
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "leveldb/env.h"
+#include "leveldb/options.h"
+#include "leveldb/write_batch.h"
+
+namespace leveldb {
+
+static std::string Key(int i) {
+    char buf[100];
+    std::snprintf(buf, sizeof(buf), "key%06d", i);
+    return std::string(buf);
+}
+
+class DBTest : public testing::Test {
+public:
+    DBTest() : env_(Env::Default()), dbname_(testing::TempDir() + "db_test"), db_(nullptr) {
+        RemoveFiles();
+    }
+
+    ~DBTest() override {
+        delete db_;
+        RemoveFiles();
+    }
+
+    Status Open(const Options& options) {
+        Close();
+        Options opts = options;
+        opts.create_if_missing = true;
+        opts.env = env_;
+        return DB::Open(opts, dbname_, &db_);
+    }
+
+    void Reopen(const Options& options) { ASSERT_TRUE(Open(options).ok()); }
+
+    void Close() {
+        delete db_;
+        db_ = nullptr;
+    }
+
+    Status Put(const std::string& k, const std::string& v) {
+        return db_->Put(WriteOptions(), k, v);
+    }
+
+    std::string Get(const std::string& k) {
+        std::string result;
+        Status s = db_->Get(ReadOptions(), k, &result);
+        if (s.IsNotFound()) {
+            result = "NOT_FOUND";
+        } else if (!s.ok()) {
+            result = s.ToString();
+        }
+        return result;
+    }
+
+    // MultiGet() of "keys", each result as Get() renders it, joined by ","
+    std::string MultiGet(const std::vector<std::string>& keys) {
+        std::vector<Slice> slices(keys.begin(), keys.end());
+        std::vector<std::string> values;
+        std::vector<Status> statuses = db_->MultiGet(ReadOptions(), slices, &values);
+        EXPECT_EQ(keys.size(), statuses.size());
+        std::string result;
+        for (size_t i = 0; i < statuses.size(); i++) {
+            if (i > 0) {
+                result += ",";
+            }
+            if (statuses[i].IsNotFound()) {
+                result += "NOT_FOUND";
+            } else if (!statuses[i].ok()) {
+                result += statuses[i].ToString();
+            } else {
+                result += values[i];
+            }
+        }
+        return result;
+    }
+
+    // has "num_threads" threads write "per_thread" keys each, one batch at
+    // a time, and checks that every key reads back
+    void WriteFromThreads(int num_threads, int per_thread, const WriteOptions& write_options) {
+        std::vector<std::thread> threads;
+        for (int t = 0; t < num_threads; t++) {
+            threads.emplace_back([this, t, per_thread, &write_options]() {
+                for (int i = 0; i < per_thread; i++) {
+                    const int k = t * per_thread + i;
+                    WriteBatch batch;
+                    batch.Put(Key(k), "v" + Key(k));
+                    ASSERT_TRUE(db_->Write(write_options, &batch).ok());
+                }
+            });
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+        for (int k = 0; k < num_threads * per_thread; k++) {
+            ASSERT_EQ("v" + Key(k), Get(Key(k)));
+        }
+    }
+
+    Env* const env_;
+    const std::string dbname_;
+    DB* db_;
+
+private:
+    void RemoveFiles() {
+        std::vector<std::string> files;
+        if (env_->GetChildren(dbname_, &files).ok()) {
+            for (const std::string& f : files) {
+                env_->RemoveFile(dbname_ + "/" + f);
+            }
+        }
+    }
+};
+
+TEST_F(DBTest, PipelinedWrite) {
+    Options options;
+    options.enable_pipelined_write = true;
+    Reopen(options);
+    WriteFromThreads(8, 500, WriteOptions());
+
+    // the writes are replayed from the log
+    Reopen(options);
+    for (int k = 0; k < 8 * 500; k++) {
+        ASSERT_EQ("v" + Key(k), Get(Key(k)));
+    }
+}
+
+TEST_F(DBTest, PipelinedWriteOverwritesInLogOrder) {
+    Options options;
+    options.enable_pipelined_write = true;
+    Reopen(options);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([this]() {
+            for (int i = 0; i < 1000; i++) {
+                ASSERT_TRUE(Put("same", "v").ok());
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    ASSERT_TRUE(Put("same", "last").ok());
+    ASSERT_EQ("last", Get("same"));
+}
+
+TEST_F(DBTest, ConcurrentMemTableWrite) {
+    Options options;
+    options.allow_concurrent_memtable_write = true;
+    Reopen(options);
+    WriteFromThreads(8, 500, WriteOptions());
+}
+
+TEST_F(DBTest, PipelinedConcurrentMemTableWrite) {
+    Options options;
+    options.enable_pipelined_write = true;
+    options.allow_concurrent_memtable_write = true;
+    Reopen(options);
+    WriteFromThreads(8, 500, WriteOptions());
+}
+
+TEST_F(DBTest, GroupCommitSyncWrites) {
+    Options options;
+    options.group_commit_max_delay_micros = 2000;
+    options.group_commit_max_bytes = 4 << 10;
+    Reopen(options);
+    WriteOptions write_options;
+    write_options.sync = true;
+    WriteFromThreads(8, 100, write_options);
+
+    // a lone sync writer does not wait past the window
+    const uint64_t start = env_->NowMicros();
+    WriteBatch batch;
+    batch.Put("lone", "v");
+    ASSERT_TRUE(db_->Write(write_options, &batch).ok());
+    ASSERT_LT(env_->NowMicros() - start, 1000000u);
+    ASSERT_EQ("v", Get("lone"));
+
+    Reopen(options);
+    for (int k = 0; k < 8 * 100; k++) {
+        ASSERT_EQ("v" + Key(k), Get(Key(k)));
+    }
+}
+
+TEST_F(DBTest, ImmutableMemTableQueue) {
+    Options options;
+    options.write_buffer_size = 64 << 10;
+    options.max_write_buffer_number = 4;
+    Reopen(options);
+
+    // several memtables fill up faster than they are flushed, reads have
+    // to look through all of them, newest first
+    const std::string big(1000, 'x');
+    for (int round = 0; round < 3; round++) {
+        for (int k = 0; k < 500; k++) {
+            ASSERT_TRUE(Put(Key(k), big + std::to_string(round)).ok());
+        }
+    }
+    for (int k = 0; k < 500; k++) {
+        ASSERT_EQ(big + "2", Get(Key(k)));
+    }
+
+    Reopen(options);
+    for (int k = 0; k < 500; k++) {
+        ASSERT_EQ(big + "2", Get(Key(k)));
+    }
+}
+
+TEST_F(DBTest, ParallelRecoveryKeepsNewestValue) {
+    Options options;
+    options.write_buffer_size = 64 << 20;  // everything stays in the log
+    Reopen(options);
+    const std::string big(1000, 'x');
+    for (int round = 0; round < 10; round++) {
+        for (int k = 0; k < 200; k++) {
+            ASSERT_TRUE(Put(Key(k), big + std::to_string(round)).ok());
+        }
+    }
+
+    // replaying the log fills several memtables, and the workers may
+    // finish them in any order. The newer values have to win anyway.
+    options.write_buffer_size = 32 << 10;
+    options.max_recovery_threads = 4;
+    Reopen(options);
+    for (int k = 0; k < 200; k++) {
+        ASSERT_EQ(big + "9", Get(Key(k)));
+    }
+    Reopen(options);
+    for (int k = 0; k < 200; k++) {
+        ASSERT_EQ(big + "9", Get(Key(k)));
+    }
+}
+
+TEST_F(DBTest, MultiGet) {
+    Options options;
+    options.write_buffer_size = 32 << 10;
+    Reopen(options);
+    ASSERT_EQ("NOT_FOUND,NOT_FOUND", MultiGet({"a", "b"}));
+
+    // enough to spread the keys over several tables, with newer values and
+    // deletions in the memtable
+    const std::string big(500, 'x');
+    for (int k = 0; k < 500; k++) {
+        ASSERT_TRUE(Put(Key(k), big + std::to_string(k)).ok());
+    }
+    ASSERT_TRUE(Put(Key(7), "new7").ok());
+    ASSERT_TRUE(db_->Delete(WriteOptions(), Key(8)).ok());
+
+    // keys in any order, repeated, and missing
+    const std::vector<std::string> keys = {Key(400), Key(7), "missing", Key(8), Key(0),
+                                           Key(400)};
+    const std::string expected = big + "400,new7,NOT_FOUND,NOT_FOUND," + big + "0," + big +
+                                 "400";
+    ASSERT_EQ(expected, MultiGet(keys));
+    // the same as a Get() of each key
+    for (const std::string& key : keys) {
+        ASSERT_EQ(Get(key), MultiGet({key}));
+    }
+
+    // with everything in tables
+    Reopen(options);
+    ASSERT_EQ(expected, MultiGet(keys));
+    std::vector<std::string> all;
+    std::string all_expected;
+    for (int k = 0; k < 500; k++) {
+        all.push_back(Key(k));
+        if (k > 0) {
+            all_expected += ",";
+        }
+        all_expected += Get(Key(k));
+    }
+    ASSERT_EQ(all_expected, MultiGet(all));
+}
+
+}  // namespace leveldb
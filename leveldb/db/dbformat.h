@@ -14,6 +14,32 @@ typedef uint64_t SequenceNumber;
 // we leave 8bits empty at the bottom so a type and sequence# can be packed together into 64-bits/
 static const SequenceNumber kMaxSequenceNumber = ((0x1ull << 56) - 1);
 
+// value types encoded as the last component of internal keys.
+// DO NOT CHANGE THESE ENUM VALUES: they are embedded in the on-disk
+// data structures.
+//
+// a kTypeMerge entry holds an operand for Options::merge_operator, which
+// reads combine with the entries of the key that are older than it.
+//
+// a kTypeRangeDeletion entry is a range tombstone: its key is the first
+// user key of the range, its value the user key the range ends before.
+// range tombstones are kept apart from the other entries, in their own
+// memtable rep and their own table meta block (see db/range_del.h).
+enum ValueType {
+    kTypeDeletion = 0x0,
+    kTypeValue = 0x1,
+    kTypeRangeDeletion = 0x2,
+    kTypeMerge = 0x3,
+};
+
+// kValueTypeForSeek defines the ValueType that should be passed when
+// constructing a ParsedInternalKey object for seeking to a particular
+// sequence number (since we sort sequence numbers in decreasing order
+// and the value type is embedded as the low 8 bits in the sequence
+// number in internal keys, we need to use the highest-numbered
+// ValueType, not the lowest).
+static const ValueType kValueTypeForSeek = kTypeMerge;
+
 
 class InternalKey {
 private:
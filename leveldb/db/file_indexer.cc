@@ -0,0 +1,167 @@
+#include "db/file_indexer.h"
+
+#include <algorithm>
+
+#include "db/version_edit.h"
+#include "leveldb/comparator.h"
+
+namespace leveldb {
+
+// up to the first 7 bytes of "user_key", followed by a byte holding its
+// length capped at 7, as a big-endian number. Same as
+// MemTableKeyComparator::KeyPrefix(): where the codes of two keys differ,
+// they order the keys like the bytewise comparator does.
+static uint64_t KeyCode(const Slice& user_key) {
+    const size_t n = std::min<size_t>(user_key.size(), 7);
+    uint64_t code = 0;
+    for (size_t i = 0; i < 7; i++) {
+        const uint64_t byte = (i < n) ? static_cast<unsigned char>(user_key[i]) : 0;
+        code = (code << 8) | byte;
+    }
+    return (code << 8) | n;
+}
+
+FileIndexer::FileIndexer() : icmp_(nullptr), use_codes_(false), files_(nullptr) {}
+
+void FileIndexer::Build(const InternalKeyComparator* icmp,
+                        const std::vector<FileMetaData*>* files) {
+    icmp_ = icmp;
+    files_ = files;
+    const Comparator* ucmp = icmp->user_comparator();
+    use_codes_ = (ucmp == BytewiseComparator());
+
+    level0_ = files[0];
+    std::sort(level0_.begin(), level0_.end(),
+              [](FileMetaData* a, FileMetaData* b) { return a->number > b->number; });
+
+    for (int level = 0; level < config::kNumLevels; level++) {
+        const std::vector<FileMetaData*>& level_files = files[level];
+        const size_t n = level_files.size();
+        LevelIndex* index = &levels_[level];
+        index->smallest_codes.resize(n);
+        index->largest_codes.resize(n);
+        for (size_t i = 0; i < n; i++) {
+            index->smallest_codes[i] = KeyCode(level_files[i]->smallest.user_key());
+            index->largest_codes[i] = KeyCode(level_files[i]->largest.user_key());
+        }
+
+        index->cascade.clear();
+        if (level == 0 || level + 1 == config::kNumLevels) {
+            continue;  // level-0 files overlap, so searching level 1 starts over
+        }
+        const std::vector<FileMetaData*>& next = files[level + 1];
+        const size_t m = next.size();
+        index->cascade.resize(n);
+        // the bounds only move forward along the level, so each takes one
+        // pass over the next level. The rb ones are found as the first file
+        // past the bound.
+        size_t smallest_lb = 0, largest_lb = 0, smallest_rb = 0, largest_rb = 0;
+        for (size_t i = 0; i < n; i++) {
+            const Slice smallest = level_files[i]->smallest.user_key();
+            const Slice largest = level_files[i]->largest.user_key();
+            while (smallest_lb < m && ucmp->Compare(next[smallest_lb]->largest.user_key(), smallest) < 0) {
+                smallest_lb++;
+            }
+            while (largest_lb < m && ucmp->Compare(next[largest_lb]->largest.user_key(), largest) < 0) {
+                largest_lb++;
+            }
+            while (smallest_rb < m && ucmp->Compare(next[smallest_rb]->smallest.user_key(), smallest) <= 0) {
+                smallest_rb++;
+            }
+            while (largest_rb < m && ucmp->Compare(next[largest_rb]->smallest.user_key(), largest) <= 0) {
+                largest_rb++;
+            }
+            Cascade* c = &index->cascade[i];
+            c->smallest_lb = static_cast<int32_t>(smallest_lb);
+            c->largest_lb = static_cast<int32_t>(largest_lb);
+            c->smallest_rb = static_cast<int32_t>(smallest_rb) - 1;
+            c->largest_rb = static_cast<int32_t>(largest_rb) - 1;
+        }
+    }
+}
+
+bool FileIndexer::LargestBefore(int level, int i, const Slice& ikey, uint64_t code) const {
+    if (use_codes_) {
+        const uint64_t largest = levels_[level].largest_codes[i];
+        if (largest != code) {
+            return largest < code;
+        }
+    }
+    return icmp_->Compare(files_[level][i]->largest.Encode(), ikey) < 0;
+}
+
+int FileIndexer::CompareSmallest(int level, int i, const Slice& user_key, uint64_t code) const {
+    if (use_codes_) {
+        const uint64_t smallest = levels_[level].smallest_codes[i];
+        if (code != smallest) {
+            return (code < smallest) ? -1 : +1;
+        }
+    }
+    return icmp_->user_comparator()->Compare(user_key, files_[level][i]->smallest.user_key());
+}
+
+FileIndexer::Search::Search(const FileIndexer* index, const Slice& internal_key)
+    : index_(index),
+      ikey_(internal_key),
+      user_key_(ExtractUserKey(internal_key)),
+      code_(index->use_codes_ ? KeyCode(user_key_) : 0),
+      next_level_(-1),
+      left_(0),
+      right_(-1) {}
+
+FileMetaData* FileIndexer::Search::FileAt(int level) {
+    assert(level >= 1 && level < config::kNumLevels);
+    const std::vector<FileMetaData*>& files = index_->files_[level];
+    const int n = static_cast<int>(files.size());
+
+    // look for the first file whose largest key is at or after the key. If
+    // the range the level above led to has none, that is the file right
+    // after the range, see Build()
+    int left = 0;
+    int right = n;
+    if (level == next_level_) {
+        left = left_;
+        right = std::max(left_, right_ + 1);
+    }
+    while (left < right) {
+        const int mid = left + (right - left) / 2;
+        if (index_->LargestBefore(level, mid, ikey_, code_)) {
+            left = mid + 1;
+        } else {
+            right = mid;
+        }
+    }
+    const int i = left;
+
+    FileMetaData* f = nullptr;
+    int cmp_smallest = 0;
+    if (i < n) {
+        cmp_smallest = index_->CompareSmallest(level, i, user_key_, code_);
+        if (cmp_smallest >= 0) {
+            f = files[i];
+        }
+    }
+
+    // narrow down the search of the next level
+    next_level_ = -1;
+    const std::vector<Cascade>& cascade = index_->levels_[level].cascade;
+    if (n > 0 && !cascade.empty()) {
+        next_level_ = level + 1;
+        if (i == n) {
+            // past the last file
+            left_ = cascade[n - 1].largest_lb;
+            right_ = static_cast<int>(index_->files_[level + 1].size()) - 1;
+        } else if (cmp_smallest < 0) {
+            // between file i - 1 and file i
+            left_ = (i > 0) ? cascade[i - 1].largest_lb : 0;
+            right_ = cascade[i].smallest_rb;
+        } else {
+            // within file i
+            left_ = cascade[i].smallest_lb;
+            right_ = cascade[i].largest_rb;
+        }
+    }
+    return f;
+}
+
+}  // namespace leveldb
@@ -0,0 +1,103 @@
+#ifndef STORAGE_LEVELDB_DB_FILE_INDEXER_H_
+#define STORAGE_LEVELDB_DB_FILE_INDEXER_H_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "db/dbformat.h"
+
+namespace leveldb {
+
+struct FileMetaData;
+
+// an index over the files of a Version for point lookups, built once by
+// VersionSet::Finalize().
+//
+// for every level the smallest and largest user keys of the files are also
+// kept as 8 byte codes in contiguous arrays (see KeyCode() in the .cc), so
+// a binary search mostly compares integers, and only compares keys where
+// the codes of two keys are equal.
+//
+// levels 1 and up are also connected by fractional cascading: for every
+// file, the index holds the range of files of the next level that a key
+// can fall into, given where it fell in this level. A search of the next
+// level is then limited to that range instead of the whole level.
+class FileIndexer {
+public:
+    FileIndexer();
+
+    FileIndexer(const FileIndexer&) = delete;
+    FileIndexer& operator=(const FileIndexer&) = delete;
+
+    // indexes files[0, config::kNumLevels), the files of a version by level.
+    // "files" must stay unchanged while the index is in use.
+    void Build(const InternalKeyComparator* icmp, const std::vector<FileMetaData*>* files);
+
+    // the level-0 files, newest first
+    const std::vector<FileMetaData*>& Level0NewestFirst() const { return level0_; }
+
+    // finds the file of each level whose key range holds a key, going down
+    // the levels one at a time
+    class Search {
+    public:
+        // REQUIRES: "index" was built and outlives the search
+        Search(const FileIndexer* index, const Slice& internal_key);
+
+        Search(const Search&) = delete;
+        Search& operator=(const Search&) = delete;
+
+        // the file of "level" whose key range holds the user key of the
+        // internal key, or nullptr. The search of a level is narrowed down
+        // when the level just above was searched last.
+        // REQUIRES: level >= 1
+        FileMetaData* FileAt(int level);
+
+    private:
+        const FileIndexer* const index_;
+        const Slice ikey_;
+        const Slice user_key_;
+        const uint64_t code_;
+        // the range of files of next_level_ the key can fall into, inclusive
+        int next_level_;
+        int left_;
+        int right_;
+    };
+
+private:
+    // where a file of one level leads into the next one. For the key range
+    // of the file, "lb" is the first file of the next level that may hold
+    // keys at or after a bound of the range and "rb" the last file of the
+    // next level that may hold keys at or before it, or -1.
+    struct Cascade {
+        int32_t smallest_lb;
+        int32_t largest_lb;
+        int32_t smallest_rb;
+        int32_t largest_rb;
+    };
+
+    struct LevelIndex {
+        std::vector<uint64_t> smallest_codes;
+        std::vector<uint64_t> largest_codes;
+        std::vector<Cascade> cascade;  // empty for level 0 and the last level
+    };
+
+    // whether the largest key of file "i" of "level" is before "ikey",
+    // whose user key has code "code"
+    bool LargestBefore(int level, int i, const Slice& ikey, uint64_t code) const;
+    // compares "user_key", whose code is "code", to the smallest user key of
+    // file "i" of "level"
+    int CompareSmallest(int level, int i, const Slice& user_key, uint64_t code) const;
+
+    const InternalKeyComparator* icmp_;
+    // codes are only comparable for the bytewise user comparator. With any
+    // other the index falls back to comparing keys throughout.
+    bool use_codes_;
+    const std::vector<FileMetaData*>* files_;
+    std::vector<FileMetaData*> level0_;
+    LevelIndex levels_[config::kNumLevels];
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_FILE_INDEXER_H_
@@ -0,0 +1,136 @@
+#include "db/file_indexer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "db/dbformat.h"
+#include "db/version_edit.h"
+#include "leveldb/comparator.h"
+#include "util/random.h"
+
+namespace leveldb {
+
+// orders keys like the bytewise comparator, but is not it, so the index
+// has to compare keys instead of codes
+class OtherBytewiseComparator : public Comparator {
+public:
+    const char* Name() const override { return "test.OtherBytewiseComparator"; }
+    int Compare(const Slice& a, const Slice& b) const override {
+        return BytewiseComparator()->Compare(a, b);
+    }
+    void FindShortestSeparator(std::string* start, const Slice& limit) const override {}
+    void FindShortSuccessor(std::string* key) const override {}
+};
+
+// keys that share their first 7 bytes in runs of 100, so their codes tie
+static std::string Key(int i) {
+    char buf[100];
+    std::snprintf(buf, sizeof(buf), "%07d.%04d", i / 100, i % 100);
+    return std::string(buf);
+}
+
+class FileIndexerTest : public testing::TestWithParam<bool> {
+public:
+    FileIndexerTest()
+        : icmp_(GetParam() ? BytewiseComparator() : &other_), files_(config::kNumLevels) {}
+
+    ~FileIndexerTest() override {
+        for (const std::vector<FileMetaData*>& level : files_) {
+            for (FileMetaData* f : level) {
+                delete f;
+            }
+        }
+    }
+
+    void AddFile(int level, uint64_t number, int smallest, int largest) {
+        FileMetaData* f = new FileMetaData;
+        f->number = number;
+        f->smallest = InternalKey(Key(smallest), 100, kTypeValue);
+        f->largest = InternalKey(Key(largest), 100, kTypeValue);
+        files_[level].push_back(f);
+    }
+
+    // the file of "level" that holds "key", by looking at every file
+    FileMetaData* Expected(int level, const std::string& key) {
+        for (FileMetaData* f : files_[level]) {
+            if (key >= f->smallest.user_key().ToString() &&
+                key <= f->largest.user_key().ToString()) {
+                return f;
+            }
+        }
+        return nullptr;
+    }
+
+    OtherBytewiseComparator other_;
+    InternalKeyComparator icmp_;
+    std::vector<std::vector<FileMetaData*>> files_;
+};
+
+TEST_P(FileIndexerTest, Empty) {
+    FileIndexer index;
+    index.Build(&icmp_, files_.data());
+    ASSERT_TRUE(index.Level0NewestFirst().empty());
+    InternalKey key(Key(5), kMaxSequenceNumber, kValueTypeForSeek);
+    FileIndexer::Search search(&index, key.Encode());
+    for (int level = 1; level < config::kNumLevels; level++) {
+        ASSERT_EQ(nullptr, search.FileAt(level));
+    }
+}
+
+TEST_P(FileIndexerTest, Level0NewestFirst) {
+    AddFile(0, 3, 0, 10);
+    AddFile(0, 7, 5, 20);
+    AddFile(0, 5, 0, 30);
+    FileIndexer index;
+    index.Build(&icmp_, files_.data());
+    ASSERT_EQ(3, index.Level0NewestFirst().size());
+    ASSERT_EQ(7, index.Level0NewestFirst()[0]->number);
+    ASSERT_EQ(5, index.Level0NewestFirst()[1]->number);
+    ASSERT_EQ(3, index.Level0NewestFirst()[2]->number);
+}
+
+TEST_P(FileIndexerTest, SameFilesAsLinearSearch) {
+    // levels of files with gaps between them, deeper levels with more files
+    Random rnd(301);
+    uint64_t number = 1;
+    for (int level = 1; level < config::kNumLevels; level++) {
+        int k = rnd.Uniform(50);
+        const int files = 1 << level;
+        for (int i = 0; i < files; i++) {
+            const int smallest = k;
+            const int largest = smallest + rnd.Uniform(20000 >> level);
+            AddFile(level, number++, smallest, largest);
+            k = largest + 1 + (rnd.OneIn(3) ? rnd.Uniform(300) : 0);
+        }
+    }
+    // and a level left empty in between
+    files_[3].swap(files_[2]);
+    for (FileMetaData* f : files_[3]) {
+        delete f;
+    }
+    files_[3].clear();
+
+    FileIndexer index;
+    index.Build(&icmp_, files_.data());
+    for (int i = 0; i < 20000; i++) {
+        const std::string user_key = Key(rnd.Uniform(30000));
+        InternalKey key(user_key, kMaxSequenceNumber, kValueTypeForSeek);
+        // levels one after another, as a lookup goes, and with levels
+        // skipped, which searches a level in full
+        FileIndexer::Search search(&index, key.Encode());
+        for (int level = 1; level < config::kNumLevels; level++) {
+            if (i % 2 == 1 && rnd.OneIn(3)) {
+                continue;
+            }
+            ASSERT_EQ(Expected(level, user_key), search.FileAt(level))
+                    << user_key << " at level " << level;
+        }
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(Comparators, FileIndexerTest, testing::Bool());
+
+}  // namespace leveldb
@@ -53,4 +53,56 @@ Status SetCurrentFile(Env* env, const std::string& dbname, uint64_t descriptor_n
     return s;
 }
 
+// owned filenames have the form:
+//    dbname/CURRENT
+//    dbname/LOCK
+//    dbname/LOG
+//    dbname/LOG.old
+//    dbname/MANIFEST-[0-9]+
+//    dbname/[0-9]+.(log|sst|ldb)
+bool ParseFileName(const std::string& filename, uint64_t* number,
+                   FileType* type) {
+    Slice rest(filename);
+    if (rest == "CURRENT") {
+        *number = 0;
+        *type = kCurrentFile;
+    } else if (rest == "LOCK") {
+        *number = 0;
+        *type = kDBLockFile;
+    } else if (rest == "LOG" || rest == "LOG.old") {
+        *number = 0;
+        *type = kInfoLogFile;
+    } else if (rest.starts_with("MANIFEST-")) {
+        rest.remove_prefix(strlen("MANIFEST-"));
+        uint64_t num;
+        if (!ConsumeDecimalNumber(&rest, &num)) {
+            return false;
+        }
+        if (!rest.empty()) {
+            return false;
+        }
+        *type = kDescriptorFile;
+        *number = num;
+    } else {
+        // avoid strtoull() to keep filename format independent of the
+        // current locale
+        uint64_t num;
+        if (!ConsumeDecimalNumber(&rest, &num)) {
+            return false;
+        }
+        Slice suffix = rest;
+        if (suffix == Slice(".log")) {
+            *type = kLogFile;
+        } else if (suffix == Slice(".sst") || suffix == Slice(".ldb")) {
+            *type = kTableFile;
+        } else if (suffix == Slice(".dbtmp")) {
+            *type = kTempFile;
+        } else {
+            return false;
+        }
+        *number = num;
+    }
+    return true;
+}
+
 }  // namespace leveldb
\ No newline at end of file
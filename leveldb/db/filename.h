@@ -1,12 +1,33 @@
 #ifndef STORAGE_LEVELDB_DB_FILENAME_H_
 #define STORAGE_LEVELDB_DB_FILENAME_H_
 
+#include <stdint.h>
+
 #include <string>
 
 namespace leveldb {
 
+enum FileType {
+    kLogFile,
+    kDBLockFile,
+    kTableFile,
+    kDescriptorFile,
+    kCurrentFile,
+    kTempFile,
+    kInfoLogFile  // either the current one, or an old one
+};
+
+// return the name of the log file with the specified number
+// in the db named by "dbname".  The result will be prefixed with
+// "dbname".
 std::string LogFileName(const std::string& dbname, uint64_t number);
 
+// if filename is a leveldb file, store the type of the file in *type.
+// the number encoded in the filename is stored in *number.  If the
+// filename was successfully parsed, returns true.  Else return false.
+bool ParseFileName(const std::string& filename, uint64_t* number,
+                   FileType* type);
+
 }  // namespace leveldb
 
 #endif  // STORAGE_LEVELDB_DB_FILENAME_H_
\ No newline at end of file
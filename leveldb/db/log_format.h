@@ -13,16 +13,47 @@ enum RecordType {
     // For fragments
     kFirstType = 2,
     kMiddleType = 3,
-    kLastType = 4
+    kLastType = 4,
+
+    // Same as above, for log files that may be recycled. The header also
+    // carries the number of the log the record was written to, so that
+    // records left over from the file's previous life can be told apart
+    // from the ones written since.
+    kRecyclableFullType = 5,
+    kRecyclableFirstType = 6,
+    kRecyclableMiddleType = 7,
+    kRecyclableLastType = 8,
+
+    // Start of a logical record whose payload is compressed: one byte of
+    // CompressionType followed by the compressed contents. The payload is
+    // fragmented like any other, so the rest of a compressed record uses
+    // the plain kMiddleType and kLastType.
+    kCompressedFullType = 9,
+    kCompressedFirstType = 10,
+
+    // Same as above, for log files that may be recycled.
+    kRecyclableCompressedFullType = 11,
+    kRecyclableCompressedFirstType = 12
 };
 
-static const int kMaxRecordType = kLastType;
+static const int kMaxRecordType = kRecyclableCompressedFirstType;
+
+// Returns true for record types that carry the log number in their header.
+inline bool IsRecyclableType(unsigned int type) {
+    return (type >= kRecyclableFullType && type <= kRecyclableLastType) ||
+           type == kRecyclableCompressedFullType ||
+           type == kRecyclableCompressedFirstType;
+}
 static const int kBlockSize = 32768;
 
 // Header is checksum (4 bytes), length (2 bytes), type (1 byte).
 static const int kHeaderSize = 4 + 2 + 1;
 
+// Recyclable header is checksum (4 bytes), length (2 bytes), type (1 byte),
+// log number (4 bytes).
+static const int kRecyclableHeaderSize = 4 + 2 + 1 + 4;
+
 }  // namespace log
 }  // namespace leveldb
 
-#endif  // STORAGE_LEVELDB_DB_LOG_FORMAT_H_
\ No newline at end of file
+#endif  // STORAGE_LEVELDB_DB_LOG_FORMAT_H_
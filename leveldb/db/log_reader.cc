@@ -0,0 +1,369 @@
+#include "db/log_reader.h"
+
+#include <cstdio>
+
+#include "leveldb/env.h"
+#include "leveldb/options.h"
+#include "port/port.h"
+#include "util/coding.h"
+#include "util/crc32c.h"
+
+namespace leveldb {
+namespace log {
+
+Reader::Reporter::~Reporter() = default;
+
+Reader::Reader(SequentialFile* file, Reporter* reporter, bool checksum,
+               uint64_t initial_offset, uint64_t log_number)
+    : file_(file),
+      reporter_(reporter),
+      checksum_(checksum),
+      backing_store_(new char[kBlockSize]),
+      buffer_(),
+      eof_(false),
+      last_record_offset_(0),
+      end_of_buffer_offset_(0),
+      initial_offset_(initial_offset),
+      resyncing_(initial_offset > 0),
+      log_number_(log_number),
+      recycled_(false) {}
+
+Reader::~Reader() { delete[] backing_store_; }
+
+bool Reader::SkipToInitialBlock() {
+    const size_t offset_in_block = initial_offset_ % kBlockSize;
+    uint64_t block_start_location = initial_offset_ - offset_in_block;
+
+    // don't search a block if we'd be in the trailer
+    if (offset_in_block > kBlockSize - 6) {
+        block_start_location += kBlockSize;
+    }
+
+    end_of_buffer_offset_ = block_start_location;
+
+    // skip to start of first block that can contain the initial record
+    if (block_start_location > 0) {
+        Status skip_status = file_->Skip(block_start_location);
+        if (!skip_status.ok()) {
+            ReportDrop(block_start_location, skip_status);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool Reader::ReadRecord(Slice* record, std::string* scratch) {
+    if (last_record_offset_ < initial_offset_) {
+        if (!SkipToInitialBlock()) {
+            return false;
+        }
+    }
+
+    scratch->clear();
+    record->clear();
+    bool in_fragmented_record = false;
+    bool compressed = false;  // the logical record being read is compressed
+    // record offset of the logical record that we're reading
+    // 0 is a dummy value to make compilers happy
+    uint64_t prospective_record_offset = 0;
+
+    Slice fragment;
+    while (true) {
+        const unsigned int record_type = ReadPhysicalRecord(&fragment);
+
+        // ReadPhysicalRecord may have only had an empty trailer remaining in its
+        // internal buffer. Calculate the offset of the next physical record now
+        // that it has returned, properly accounting for its header size.
+        uint64_t physical_record_offset =
+                end_of_buffer_offset_ - buffer_.size() - fragment.size() -
+                (recycled_ ? kRecyclableHeaderSize : kHeaderSize);
+
+        if (resyncing_) {
+            if (record_type == kMiddleType) {
+                continue;
+            } else if (record_type == kLastType) {
+                resyncing_ = false;
+                continue;
+            } else {
+                resyncing_ = false;
+            }
+        }
+
+        switch (record_type) {
+            case kFullType:
+            case kCompressedFullType:
+                if (in_fragmented_record) {
+                    // handle bug in earlier versions of log::Writer where
+                    // it could emit an empty kFirstType record at the tail end
+                    // of a block followed by a kFullType or kFirstType record
+                    // at the beginning of the next block.
+                    if (!scratch->empty()) {
+                        ReportCorruption(scratch->size(), "partial record without end(1)");
+                    }
+                }
+                prospective_record_offset = physical_record_offset;
+                scratch->clear();
+                in_fragmented_record = false;
+                if (record_type == kCompressedFullType) {
+                    if (!Uncompress(fragment, record)) {
+                        ReportCorruption(fragment.size(), "bad compressed record");
+                        break;
+                    }
+                } else {
+                    *record = fragment;
+                }
+                last_record_offset_ = prospective_record_offset;
+                return true;
+
+            case kFirstType:
+            case kCompressedFirstType:
+                if (in_fragmented_record) {
+                    // handle bug in earlier versions of log::Writer where
+                    // it could emit an empty kFirstType record at the tail end
+                    // of a block followed by a kFullType or kFirstType record
+                    // at the beginning of the next block.
+                    if (!scratch->empty()) {
+                        ReportCorruption(scratch->size(), "partial record without end(2)");
+                    }
+                }
+                prospective_record_offset = physical_record_offset;
+                scratch->assign(fragment.data(), fragment.size());
+                in_fragmented_record = true;
+                compressed = (record_type == kCompressedFirstType);
+                break;
+
+            case kMiddleType:
+                if (!in_fragmented_record) {
+                    ReportCorruption(fragment.size(),
+                                     "missing start of fragmented record(1)");
+                } else {
+                    scratch->append(fragment.data(), fragment.size());
+                }
+                break;
+
+            case kLastType:
+                if (!in_fragmented_record) {
+                    ReportCorruption(fragment.size(),
+                                     "missing start of fragmented record(2)");
+                } else {
+                    scratch->append(fragment.data(), fragment.size());
+                    in_fragmented_record = false;
+                    if (compressed) {
+                        if (!Uncompress(Slice(*scratch), record)) {
+                            ReportCorruption(scratch->size(), "bad compressed record");
+                            scratch->clear();
+                            break;
+                        }
+                    } else {
+                        *record = Slice(*scratch);
+                    }
+                    last_record_offset_ = prospective_record_offset;
+                    return true;
+                }
+                break;
+
+            case kEof:
+            case kOldRecord:
+                if (in_fragmented_record) {
+                    // this can be caused by the writer dying immediately after
+                    // writing a physical record but before completing the next; don't
+                    // treat it as a corruption, just ignore the entire logical record.
+                    scratch->clear();
+                }
+                return false;
+
+            case kBadRecord:
+                if (in_fragmented_record) {
+                    ReportCorruption(scratch->size(), "error in middle of record");
+                    in_fragmented_record = false;
+                    scratch->clear();
+                }
+                break;
+
+            default: {
+                char buf[40];
+                std::snprintf(buf, sizeof(buf), "unknown record type %u", record_type);
+                ReportCorruption(
+                        (fragment.size() + (in_fragmented_record ? scratch->size() : 0)),
+                        buf);
+                in_fragmented_record = false;
+                scratch->clear();
+                break;
+            }
+        }
+    }
+    return false;
+}
+
+uint64_t Reader::LastRecordOffset() { return last_record_offset_; }
+
+bool Reader::Uncompress(const Slice& input, Slice* record) {
+    if (input.empty()) {
+        return false;
+    }
+    const char* data = input.data() + 1;
+    const size_t n = input.size() - 1;
+    size_t ulength = 0;
+    switch (static_cast<CompressionType>(input[0])) {
+        case kSnappyCompression:
+            if (!port::Snappy_GetUncompressedLength(data, n, &ulength)) {
+                return false;
+            }
+            uncompressed_.resize(ulength);
+            if (!port::Snappy_Uncompress(data, n, &uncompressed_[0])) {
+                return false;
+            }
+            break;
+        case kZstdCompression:
+            if (!port::Zstd_GetUncompressedLength(data, n, &ulength)) {
+                return false;
+            }
+            uncompressed_.resize(ulength);
+            if (!port::Zstd_Uncompress(data, n, &uncompressed_[0])) {
+                return false;
+            }
+            break;
+        default:
+            return false;
+    }
+    *record = Slice(uncompressed_);
+    return true;
+}
+
+void Reader::ReportCorruption(uint64_t bytes, const char* reason) {
+    ReportDrop(bytes, Status::Corruption(reason));
+}
+
+void Reader::ReportDrop(uint64_t bytes, const Status& reason) {
+    if (reporter_ != nullptr &&
+        end_of_buffer_offset_ - buffer_.size() - bytes >= initial_offset_) {
+        reporter_->Corruption(static_cast<size_t>(bytes), reason);
+    }
+}
+
+unsigned int Reader::ReadPhysicalRecord(Slice* result) {
+    while (true) {
+        if (buffer_.size() < kHeaderSize) {
+            if (!eof_) {
+                // last read was a full read, so this is a trailer to skip
+                buffer_.clear();
+                Status status = file_->Read(kBlockSize, &buffer_, backing_store_);
+                end_of_buffer_offset_ += buffer_.size();
+                if (!status.ok()) {
+                    buffer_.clear();
+                    ReportDrop(kBlockSize, status);
+                    eof_ = true;
+                    return kEof;
+                } else if (buffer_.size() < kBlockSize) {
+                    eof_ = true;
+                }
+                continue;
+            } else {
+                // note that if buffer_ is non-empty, we have a truncated header at the
+                // end of the file, which can be caused by the writer crashing in the
+                // middle of writing the header. Instead of considering this an error,
+                // just report EOF.
+                buffer_.clear();
+                return kEof;
+            }
+        }
+
+        // parse the header
+        const char* header = buffer_.data();
+        const uint32_t a = static_cast<uint32_t>(header[4]) & 0xff;
+        const uint32_t b = static_cast<uint32_t>(header[5]) & 0xff;
+        const unsigned int type = static_cast<unsigned char>(header[6]);
+        const uint32_t length = a | (b << 8);
+
+        size_t header_size = kHeaderSize;
+        const bool recyclable = IsRecyclableType(type);
+        if (recyclable) {
+            header_size = kRecyclableHeaderSize;
+            if (buffer_.size() < header_size) {
+                // truncated header at the end of the file, see above
+                buffer_.clear();
+                return eof_ ? kEof : kBadRecord;
+            }
+            const uint32_t log_number = DecodeFixed32(header + kHeaderSize);
+            if (log_number != static_cast<uint32_t>(log_number_)) {
+                // written before this file was recycled for our log
+                buffer_.clear();
+                return kOldRecord;
+            }
+            recycled_ = true;
+        } else if (recycled_ && (type != kZeroType || length != 0)) {
+            // a recycled log only ever holds recyclable records, anything
+            // else is data from the file's previous life
+            buffer_.clear();
+            return kOldRecord;
+        }
+
+        if (header_size + length > buffer_.size()) {
+            size_t drop_size = buffer_.size();
+            buffer_.clear();
+            if (recycled_) {
+                // a torn write of ours, or the tail of an old record
+                return kOldRecord;
+            }
+            if (!eof_) {
+                ReportCorruption(drop_size, "bad record length");
+                return kBadRecord;
+            }
+            // if the end of the file has been reached without reading |length| bytes
+            // of payload, assume the writer died in the middle of writing the record.
+            // don't report a corruption.
+            return kEof;
+        }
+
+        if (type == kZeroType && length == 0) {
+            // skip zero length record without reporting any drops since
+            // such records are produced by the mmap based writing code in
+            // env_posix.cc that preallocates file regions, and by the zeroed
+            // range a preallocated log has past its last record.
+            buffer_.clear();
+            return kBadRecord;
+        }
+
+        // check crc
+        if (checksum_) {
+            uint32_t expected_crc = crc32c::Unmask(DecodeFixed32(header));
+            uint32_t actual_crc = crc32c::Value(header + 6, header_size - 6 + length);
+            if (actual_crc != expected_crc) {
+                // drop the rest of the buffer since "length" itself may have
+                // been corrupted and if we trust it, we could find some
+                // fragment of a real log record that just happens to look
+                // like a valid log record.
+                size_t drop_size = buffer_.size();
+                buffer_.clear();
+                if (recycled_) {
+                    // in a recycled log this is where our records end and
+                    // the previous use of the file shows through
+                    return kOldRecord;
+                }
+                ReportCorruption(drop_size, "checksum mismatch");
+                return kBadRecord;
+            }
+        }
+
+        buffer_.remove_prefix(header_size + length);
+
+        // skip physical record that started before initial_offset_
+        if (end_of_buffer_offset_ - buffer_.size() - header_size - length <
+            initial_offset_) {
+            result->clear();
+            return kBadRecord;
+        }
+
+        *result = Slice(header + header_size, length);
+        if (!recyclable) {
+            return type;
+        } else if (type >= kRecyclableCompressedFullType) {
+            return type - (kRecyclableCompressedFullType - kCompressedFullType);
+        }
+        return type - (kRecyclableFullType - kFullType);
+    }
+}
+
+}  // namespace log
+}  // namespace leveldb
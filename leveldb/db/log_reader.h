@@ -0,0 +1,132 @@
+#ifndef STORAGE_LEVELDB_DB_LOG_READER_H_
+#define STORAGE_LEVELDB_DB_LOG_READER_H_
+
+#include <stdint.h>
+
+#include <string>
+
+#include "db/log_format.h"
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+class SequentialFile;
+
+namespace log {
+
+class Reader {
+public:
+    // interface for reporting errors.
+    class Reporter {
+    public:
+        virtual ~Reporter();
+
+        // some corruption was detected.  "bytes" is the approximate number
+        // of bytes dropped due to the corruption.
+        virtual void Corruption(size_t bytes, const Status& status) = 0;
+    };
+
+    // create a reader that will return log records from "*file".
+    // "*file" must remain live while this Reader is in use.
+    //
+    // if "reporter" is non-null, it is notified whenever some data is
+    // dropped due to a detected corruption.  "*reporter" must remain
+    // live while this Reader is in use.
+    //
+    // if "checksum" is true, verify checksums if available.
+    //
+    // the Reader will start reading at the first record located at physical
+    // position >= initial_offset within the file.
+    //
+    // "log_number" is the number of the log being read. a recyclable record
+    // stamped with a different number is left over from a previous use of
+    // the file and ends the log.
+    Reader(SequentialFile* file, Reporter* reporter, bool checksum,
+           uint64_t initial_offset, uint64_t log_number = 0);
+
+    Reader(const Reader&) = delete;
+    Reader& operator=(const Reader&) = delete;
+
+    ~Reader();
+
+    // read the next record into *record.  Returns true if read
+    // successfully, false if we hit end of the input.  May use
+    // "*scratch" as temporary storage.  The contents filled in *record
+    // will only be valid until the next mutating operation on this
+    // reader or the next mutation to *scratch.
+    bool ReadRecord(Slice* record, std::string* scratch);
+
+    // returns the physical offset of the last record returned by ReadRecord.
+    //
+    // undefined before the first call to ReadRecord.
+    uint64_t LastRecordOffset();
+
+private:
+    // extend record types with the following special values
+    enum {
+        kEof = kMaxRecordType + 1,
+        // returned whenever we find an invalid physical record.
+        // currently there are three situations in which this happens:
+        // * The record has an invalid CRC (ReadPhysicalRecord reports a drop)
+        // * The record is a 0-length record (No drop is reported)
+        // * The record is below constructor's initial_offset (No drop is reported)
+        kBadRecord = kMaxRecordType + 2,
+        // returned once a recycled log runs into data from an earlier use
+        // of the file (a foreign log number, a legacy record, or a record
+        // with a bad length or checksum): everything from here on is stale.
+        kOldRecord = kMaxRecordType + 3
+    };
+
+    // skips all blocks that are completely before "initial_offset_".
+    //
+    // returns true on success. Handles reporting.
+    bool SkipToInitialBlock();
+
+    // return type, or one of the preceding special values. recyclable
+    // types are returned as their plain (or plain compressed) counterparts.
+    unsigned int ReadPhysicalRecord(Slice* result);
+
+    // uncompresses the payload of a compressed logical record into
+    // uncompressed_ and points *record at it. Returns false if the payload
+    // is corrupt or of an unsupported compression type.
+    bool Uncompress(const Slice& input, Slice* record);
+
+    // reports dropped bytes to the reporter.
+    // buffer_ must be updated to remove the dropped bytes prior to invocation.
+    void ReportCorruption(uint64_t bytes, const char* reason);
+    void ReportDrop(uint64_t bytes, const Status& reason);
+
+    SequentialFile* const file_;
+    Reporter* const reporter_;
+    bool const checksum_;
+    char* const backing_store_;
+    Slice buffer_;
+    bool eof_;  // last Read() indicated EOF by returning < kBlockSize
+
+    // offset of the last record returned by ReadRecord.
+    uint64_t last_record_offset_;
+    // offset of the first location past the end of buffer_.
+    uint64_t end_of_buffer_offset_;
+
+    // offset at which to start looking for the first record to return
+    uint64_t const initial_offset_;
+
+    // true if we are resynchronizing after a seek (initial_offset_ > 0). In
+    // particular, a run of kMiddleType and kLastType records can be silently
+    // skipped in this mode
+    bool resyncing_;
+
+    uint64_t const log_number_;
+    // set once a recyclable record of this log has been read. legacy
+    // records after that can only be stale.
+    bool recycled_;
+
+    // backing store of records returned after uncompressing
+    std::string uncompressed_;
+};
+
+}  // namespace log
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_LOG_READER_H_
@@ -0,0 +1,305 @@
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "db/log_reader.h"
+#include "db/log_writer.h"
+#include "leveldb/env.h"
+#include "port/port.h"
+#include "util/coding.h"
+#include "util/crc32c.h"
+
+namespace leveldb {
+namespace log {
+
+// construct a string of the specified length made out of the supplied
+// partial string.
+static std::string BigString(const std::string& partial_string, size_t n) {
+    std::string result;
+    while (result.size() < n) {
+        result.append(partial_string);
+    }
+    result.resize(n);
+    return result;
+}
+
+// construct a string from a number
+static std::string NumberString(int n) {
+    char buf[50];
+    std::snprintf(buf, sizeof(buf), "%d.", n);
+    return std::string(buf);
+}
+
+class LogTest : public testing::Test {
+public:
+    LogTest() : writer_(new Writer(&dest_)), reader_(nullptr) {}
+
+    ~LogTest() override {
+        delete writer_;
+        delete reader_;
+    }
+
+    // start writing a recyclable log numbered "log_number" over what was
+    // written so far, as if the file had been recycled.
+    void RecycleAs(uint64_t log_number) {
+        delete writer_;
+        old_contents_ = dest_.contents_;
+        dest_.contents_.clear();
+        writer_ = new Writer(&dest_, log_number, true /* recycle_log_files */);
+        log_number_ = log_number;
+    }
+
+    void Write(const std::string& msg) { writer_->AddRecord(Slice(msg)); }
+
+    void SetCompression(CompressionType type, size_t min_bytes) {
+        writer_->SetCompression(type, min_bytes, 1 /* level */);
+    }
+
+    // append raw bytes, e.g. a hand made physical record
+    void WriteRaw(const std::string& bytes) { dest_.contents_.append(bytes); }
+
+    size_t WrittenBytes() const { return dest_.contents_.size(); }
+
+    void IncrementByte(int offset, int delta) {
+        dest_.contents_[offset] += delta;
+    }
+
+    std::string Read() {
+        if (reader_ == nullptr) {
+            // the stale tail of the file's previous use shows through
+            // past our records
+            std::string contents = dest_.contents_;
+            if (old_contents_.size() > contents.size()) {
+                contents.append(old_contents_, contents.size(), std::string::npos);
+            }
+            source_.Reset(contents);
+            reader_ = new Reader(&source_, &report_, true /* checksum */,
+                                 0 /* initial_offset */, log_number_);
+        }
+        std::string scratch;
+        Slice record;
+        if (reader_->ReadRecord(&record, &scratch)) {
+            return record.ToString();
+        } else {
+            return "EOF";
+        }
+    }
+
+    size_t DroppedBytes() const { return report_.dropped_bytes_; }
+
+    std::string ReportMessage() const { return report_.message_; }
+
+private:
+    class StringDest : public WritableFile {
+    public:
+        Status Close() override { return Status::OK(); }
+        Status Flush() override { return Status::OK(); }
+        Status Sync() override { return Status::OK(); }
+        Status Append(const Slice& slice) override {
+            contents_.append(slice.data(), slice.size());
+            return Status::OK();
+        }
+
+        std::string contents_;
+    };
+
+    class StringSource : public SequentialFile {
+    public:
+        void Reset(const std::string& contents) {
+            backing_ = contents;
+            contents_ = Slice(backing_);
+        }
+
+        Status Read(size_t n, Slice* result, char* scratch) override {
+            if (n > contents_.size()) {
+                n = contents_.size();
+            }
+            std::memcpy(scratch, contents_.data(), n);
+            *result = Slice(scratch, n);
+            contents_.remove_prefix(n);
+            return Status::OK();
+        }
+
+        Status Skip(uint64_t n) override {
+            if (n > contents_.size()) {
+                contents_.clear();
+                return Status::NotFound("in-memory file skipped past end");
+            }
+            contents_.remove_prefix(n);
+            return Status::OK();
+        }
+
+    private:
+        std::string backing_;
+        Slice contents_;
+    };
+
+    class ReportCollector : public Reader::Reporter {
+    public:
+        ReportCollector() : dropped_bytes_(0) {}
+        void Corruption(size_t bytes, const Status& status) override {
+            dropped_bytes_ += bytes;
+            message_.append(status.ToString());
+        }
+
+        size_t dropped_bytes_;
+        std::string message_;
+    };
+
+    StringDest dest_;
+    StringSource source_;
+    ReportCollector report_;
+    std::string old_contents_;
+    uint64_t log_number_ = 0;
+    Writer* writer_;
+    Reader* reader_;
+};
+
+TEST_F(LogTest, Empty) { ASSERT_EQ("EOF", Read()); }
+
+TEST_F(LogTest, ReadWrite) {
+    Write("foo");
+    Write("bar");
+    Write("");
+    Write("xxxx");
+    ASSERT_EQ("foo", Read());
+    ASSERT_EQ("bar", Read());
+    ASSERT_EQ("", Read());
+    ASSERT_EQ("xxxx", Read());
+    ASSERT_EQ("EOF", Read());
+    ASSERT_EQ("EOF", Read());  // make sure reads at eof work
+}
+
+TEST_F(LogTest, Fragmentation) {
+    Write("small");
+    Write(BigString("medium", 50000));
+    Write(BigString("large", 100000));
+    ASSERT_EQ("small", Read());
+    ASSERT_EQ(BigString("medium", 50000), Read());
+    ASSERT_EQ(BigString("large", 100000), Read());
+    ASSERT_EQ("EOF", Read());
+}
+
+TEST_F(LogTest, ChecksumMismatch) {
+    Write("foo");
+    IncrementByte(0, 10);
+    ASSERT_EQ("EOF", Read());
+    ASSERT_EQ(10, DroppedBytes());
+    ASSERT_NE(std::string::npos, ReportMessage().find("checksum mismatch"));
+}
+
+TEST_F(LogTest, RecyclableReadWrite) {
+    RecycleAs(7);
+    for (int i = 0; i < 1000; i++) {
+        Write(NumberString(i));
+    }
+    Write(BigString("large", 100000));
+    for (int i = 0; i < 1000; i++) {
+        ASSERT_EQ(NumberString(i), Read());
+    }
+    ASSERT_EQ(BigString("large", 100000), Read());
+    ASSERT_EQ("EOF", Read());
+}
+
+TEST_F(LogTest, RecycledLogIgnoresOldRecords) {
+    RecycleAs(7);
+    for (int i = 0; i < 1000; i++) {
+        Write("old" + NumberString(i));
+    }
+    RecycleAs(8);
+    for (int i = 0; i < 10; i++) {
+        Write("new" + NumberString(i));
+    }
+    for (int i = 0; i < 10; i++) {
+        ASSERT_EQ("new" + NumberString(i), Read());
+    }
+    ASSERT_EQ("EOF", Read());
+    ASSERT_EQ(0, DroppedBytes());
+}
+
+TEST_F(LogTest, RecycledLogStopsAtStaleZeroTypeRecord) {
+    RecycleAs(8);
+    Write("foo");
+    Write("bar");
+    // a legacy header of type zero with a payload can not be ours
+    std::string stale("\x01\x02\x03\x04", 4);
+    stale.push_back(5);
+    stale.push_back(0);
+    stale.push_back(static_cast<char>(kZeroType));
+    stale.append("stale");
+    WriteRaw(stale);
+    ASSERT_EQ("foo", Read());
+    ASSERT_EQ("bar", Read());
+    ASSERT_EQ("EOF", Read());
+    ASSERT_EQ(0, DroppedBytes());
+}
+
+TEST_F(LogTest, RecycledLogStopsAtBadChecksum) {
+    RecycleAs(8);
+    Write("foo");
+    Write("bar");
+    // corrupt the payload of "bar", which is then indistinguishable from a
+    // stale record that happens to carry our log number
+    IncrementByte(static_cast<int>(WrittenBytes()) - 1, 1);
+    ASSERT_EQ("foo", Read());
+    ASSERT_EQ("EOF", Read());
+    ASSERT_EQ(0, DroppedBytes());
+}
+
+TEST_F(LogTest, RecycledLogStopsAtBadLength) {
+    RecycleAs(8);
+    Write("foo");
+    // a header of ours whose length runs past the end of the block
+    std::string stale(kRecyclableHeaderSize, '\0');
+    stale[4] = static_cast<char>(0xff);
+    stale[5] = static_cast<char>(0x7f);
+    stale[6] = static_cast<char>(kRecyclableFullType);
+    EncodeFixed32(&stale[kHeaderSize], 8);
+    WriteRaw(stale);
+    WriteRaw(BigString("x", kBlockSize));
+    ASSERT_EQ("foo", Read());
+    ASSERT_EQ("EOF", Read());
+    ASSERT_EQ(0, DroppedBytes());
+}
+
+static bool SnappyCompressionSupported() {
+    std::string out;
+    Slice in = "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa";
+    return port::Snappy_Compress(in.data(), in.size(), &out);
+}
+
+TEST_F(LogTest, CompressedReadWrite) {
+    SetCompression(kSnappyCompression, 100);
+    Write("small");
+    Write(BigString("m", 50000));
+    Write(BigString("l", 100000));
+    Write("");
+    Write(BigString("x", 200));
+    ASSERT_EQ("small", Read());
+    ASSERT_EQ(BigString("m", 50000), Read());
+    ASSERT_EQ(BigString("l", 100000), Read());
+    ASSERT_EQ("", Read());
+    ASSERT_EQ(BigString("x", 200), Read());
+    ASSERT_EQ("EOF", Read());
+    ASSERT_EQ(0, DroppedBytes());
+    if (SnappyCompressionSupported()) {
+        ASSERT_LT(WrittenBytes(), 50000u + 100000u);
+    }
+}
+
+TEST_F(LogTest, RecyclableCompressedReadWrite) {
+    RecycleAs(9);
+    SetCompression(kSnappyCompression, 100);
+    for (int i = 0; i < 100; i++) {
+        Write(BigString(NumberString(i), 1000 + i));
+    }
+    for (int i = 0; i < 100; i++) {
+        ASSERT_EQ(BigString(NumberString(i), 1000 + i), Read());
+    }
+    ASSERT_EQ("EOF", Read());
+    ASSERT_EQ(0, DroppedBytes());
+}
+
+}  // namespace log
+}  // namespace leveldb
@@ -1,5 +1,13 @@
 #include "db/log_writer.h"
 
+#include <algorithm>
+#include <cassert>
+
+#include "leveldb/env.h"
+#include "port/port.h"
+#include "util/coding.h"
+#include "util/crc32c.h"
+
 namespace leveldb {
 
 namespace log {
@@ -11,23 +19,216 @@ static void InitTypeCrc(uint32_t* type_crc) {
     }
 }
 
-Writer::Writer(WritableFile* dest) : dest_(dest), block_offset_(0) {
+Writer::Writer(WritableFile* dest)
+    : dest_(dest),
+      block_offset_(0),
+      log_number_(0),
+      recycle_log_files_(false),
+      manual_flush_(false),
+      compression_(kNoCompression),
+      compression_min_bytes_(0),
+      compression_level_(0) {
     InitTypeCrc(type_crc_);
 }
 
 Writer::Writer(WritableFile* dest, uint64_t dest_length)
-    : dest_(dest), block_offset_(dest_length % kBlockSize) {
+    : dest_(dest),
+      block_offset_(dest_length % kBlockSize),
+      log_number_(0),
+      recycle_log_files_(false),
+      manual_flush_(false),
+      compression_(kNoCompression),
+      compression_min_bytes_(0),
+      compression_level_(0) {
+    InitTypeCrc(type_crc_);
+}
+
+Writer::Writer(WritableFile* dest, uint64_t log_number, bool recycle_log_files,
+               bool manual_flush)
+    : dest_(dest),
+      block_offset_(0),
+      log_number_(log_number),
+      recycle_log_files_(recycle_log_files),
+      manual_flush_(manual_flush),
+      compression_(kNoCompression),
+      compression_min_bytes_(0),
+      compression_level_(0) {
     InitTypeCrc(type_crc_);
 }
 
 Writer::~Writer() = default;
 
-Writer::AddRecord(const Slice& slice) {
-    const char* ptr = slice.data();
+void Writer::SetCompression(CompressionType type, size_t min_bytes, int level) {
+    compression_ = type;
+    compression_min_bytes_ = min_bytes;
+    compression_level_ = level;
 }
 
+Status Writer::AddRecord(const Slice& slice) { return AddRecord(&slice, 1); }
+
+Status Writer::AddRecord(const Slice* parts, size_t n) {
+    size_t left = 0;
+    for (size_t i = 0; i < n; i++) {
+        left += parts[i].size();
+    }
+
+    bool compressed = false;
+    Slice compressed_payload;
+    if (compression_ != kNoCompression && left >= compression_min_bytes_) {
+        // compression needs the record in one piece
+        Slice record = parts[0];
+        if (n > 1) {
+            gathered_.clear();
+            for (size_t i = 0; i < n; i++) {
+                gathered_.append(parts[i].data(), parts[i].size());
+            }
+            record = Slice(gathered_);
+        }
+        compressed = Compress(record);
+        if (compressed) {
+            compressed_payload = Slice(compressed_);
+            parts = &compressed_payload;
+            n = 1;
+            left = compressed_payload.size();
+        }
+    }
+    const int header_size = recycle_log_files_ ? kRecyclableHeaderSize : kHeaderSize;
+
+    // fragment the record if necessary and emit it.  Note that if slice
+    // is empty, we still want to iterate once to emit a single
+    // zero-length record
+    Status s;
+    bool begin = true;
+    size_t part = 0;         // parts[part] holds the next byte to emit
+    size_t part_offset = 0;  // offset of that byte within parts[part]
+    do {
+        const int leftover = kBlockSize - block_offset_;
+        assert(leftover >= 0);
+        if (leftover < header_size) {
+            // switch to a new block
+            if (leftover > 0) {
+                // fill the trailer (literal below relies on kRecyclableHeaderSize
+                // being 11)
+                static_assert(kRecyclableHeaderSize == 11, "");
+                dest_->Append(Slice("\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00",
+                                    leftover));
+            }
+            block_offset_ = 0;
+        }
+
+        // invariant: we never leave < header_size bytes in a block.
+        assert(kBlockSize - block_offset_ - header_size >= 0);
+
+        const size_t avail = kBlockSize - block_offset_ - header_size;
+        const size_t fragment_length = (left < avail) ? left : avail;
+
+        // the pieces of the parts this fragment is made of
+        fragment_.clear();
+        for (size_t need = fragment_length; need > 0;) {
+            const size_t take = std::min(need, parts[part].size() - part_offset);
+            if (take > 0) {
+                fragment_.emplace_back(parts[part].data() + part_offset, take);
+            }
+            part_offset += take;
+            need -= take;
+            if (part_offset == parts[part].size()) {
+                part++;
+                part_offset = 0;
+            }
+        }
+
+        const bool end = (left == fragment_length);
+        s = EmitPhysicalRecord(FragmentType(begin, end, compressed), fragment_.data(),
+                               fragment_.size(), fragment_length);
+        left -= fragment_length;
+        begin = false;
+    } while (s.ok() && left > 0);
+    return s;
+}
 
+Status Writer::EmitPhysicalRecord(RecordType t, const Slice* pieces, size_t n,
+                                  size_t length) {
+    assert(length <= 0xffff);  // must fit in two bytes
+
+    // format the header
+    char buf[kRecyclableHeaderSize];
+    int header_size = kHeaderSize;
+    buf[4] = static_cast<char>(length & 0xff);
+    buf[5] = static_cast<char>(length >> 8);
+    buf[6] = static_cast<char>(t);
+
+    // compute the crc of the record type, the log number of a recyclable
+    // record, and the payload.
+    uint32_t crc = type_crc_[t];
+    if (IsRecyclableType(t)) {
+        header_size = kRecyclableHeaderSize;
+        EncodeFixed32(buf + kHeaderSize, static_cast<uint32_t>(log_number_));
+        crc = crc32c::Extend(crc, buf + kHeaderSize, 4);
+    }
+    assert(block_offset_ + header_size + length <= kBlockSize);
+    for (size_t i = 0; i < n; i++) {
+        crc = crc32c::Extend(crc, pieces[i].data(), pieces[i].size());
+    }
+    crc = crc32c::Mask(crc);  // adjust for storage
+    EncodeFixed32(buf, crc);
+
+    // write the header and the payload
+    iov_.clear();
+    iov_.emplace_back(buf, header_size);
+    iov_.insert(iov_.end(), pieces, pieces + n);
+    Status s = dest_->AppendV(iov_.data(), iov_.size());
+    if (s.ok() && !manual_flush_) {
+        s = dest_->Flush();
+    }
+    block_offset_ += header_size + length;
+    return s;
+}
+
+RecordType Writer::FragmentType(bool begin, bool end, bool compressed) const {
+    if (begin && end) {
+        if (compressed) {
+            return recycle_log_files_ ? kRecyclableCompressedFullType
+                                      : kCompressedFullType;
+        }
+        return recycle_log_files_ ? kRecyclableFullType : kFullType;
+    } else if (begin) {
+        if (compressed) {
+            return recycle_log_files_ ? kRecyclableCompressedFirstType
+                                      : kCompressedFirstType;
+        }
+        return recycle_log_files_ ? kRecyclableFirstType : kFirstType;
+    } else if (end) {
+        return recycle_log_files_ ? kRecyclableLastType : kLastType;
+    } else {
+        return recycle_log_files_ ? kRecyclableMiddleType : kMiddleType;
+    }
+}
+
+// Compresses "input" into compressed_, prefixed by the compression type.
+// Returns false if the compression is unavailable or not worth it.
+bool Writer::Compress(const Slice& input) {
+    std::string output;
+    bool ok = false;
+    switch (compression_) {
+        case kSnappyCompression:
+            ok = port::Snappy_Compress(input.data(), input.size(), &output);
+            break;
+        case kZstdCompression:
+            ok = port::Zstd_Compress(compression_level_, input.data(),
+                                     input.size(), &output);
+            break;
+        default:
+            break;
+    }
+    if (!ok || output.size() >= input.size() - (input.size() / 8u)) {
+        return false;
+    }
+    compressed_.clear();
+    compressed_.push_back(static_cast<char>(compression_));
+    compressed_.append(output);
+    return true;
+}
 
 }  // namespace log
 
-}  // namespace leveldb
\ No newline at end of file
+}  // namespace leveldb
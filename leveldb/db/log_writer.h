@@ -3,7 +3,11 @@
 
 #include <stdint.h>
 
+#include <string>
+#include <vector>
+
 #include "db/log_format.h"
+#include "leveldb/options.h"
 #include "leveldb/status.h"
 #include "leveldb/slice.h"
 
@@ -20,17 +24,55 @@ public:
     explicit Writer(WritableFile* dest);
     Writer(WritableFile* dest, uint64_t dest_length);
 
+    // create a writer for log number "log_number" that, if
+    // "recycle_log_files" is set, writes the recyclable record format,
+    // stamping every record with the log number.
+    // *dest must be empty or a recycled log positioned at offset 0.
+    // if "manual_flush" is set, records are only appended to *dest and the
+    // caller is responsible for flushing it, e.g. through
+    // WritableFile::SubmitAsync().
+    Writer(WritableFile* dest, uint64_t log_number, bool recycle_log_files,
+           bool manual_flush = false);
+
     Writer(const Writer&) = delete;
     Writer& operator=(const Writer&) = delete;
 
     ~Writer();
 
+    // compress records of at least "min_bytes" with "type" from now on.
+    // a record is only stored compressed if that saves at least 1/8th of
+    // its size. "level" is only used by kZstdCompression.
+    void SetCompression(CompressionType type, size_t min_bytes, int level);
+
     Status AddRecord(const Slice& slice);
 
+    // add the concatenation of parts[0,n-1] as a single record, handing
+    // the parts to the file as they are instead of gathering them first.
+    Status AddRecord(const Slice* parts, size_t n);
+
 private:
+    Status EmitPhysicalRecord(RecordType type, const Slice* pieces, size_t n,
+                              size_t length);
+    RecordType FragmentType(bool begin, bool end, bool compressed) const;
+    bool Compress(const Slice& input);
+
     WritableFile* dest_;
     int block_offset_;  // current offset in block
 
+    uint64_t log_number_;
+    const bool recycle_log_files_;
+    const bool manual_flush_;
+
+    CompressionType compression_;
+    size_t compression_min_bytes_;
+    int compression_level_;
+    std::string compressed_;  // payload of the last compressed record
+    std::string gathered_;    // record in one piece, for compression
+
+    // scratch space of AddRecord() and EmitPhysicalRecord()
+    std::vector<Slice> fragment_;
+    std::vector<Slice> iov_;
+
     // crc32 values for all supported record types. These are 
     // pre-computed to reduce the overhead of computing the crc of the
     // record type stored in the header.
@@ -41,4 +83,4 @@ private:
 
 }  // namespace leveldb
 
-#endif  // STORAGE_LEVELDB_DB_LOG_WRITER_H_
\ No newline at end of file
+#endif  // STORAGE_LEVELDB_DB_LOG_WRITER_H_
@@ -1,8 +1,354 @@
 #include "db/memtable.h"
 
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+#include "db/range_del.h"
+#include "leveldb/iterator.h"
+#include "leveldb/options.h"
+#include "leveldb/write_buffer_manager.h"
+#include "util/coding.h"
+#include "util/mutexlock.h"
+
 namespace leveldb {
 
-MemTable::MemTable(const InternalKeyCompartor& compartor)
-    : compartor_(compartor), refs_(0), table_(compartor_, &arena_) {}
+static Slice GetLengthPrefixedSlice(const char* data) {
+    uint32_t len;
+    const char* p = data;
+    p = GetVarint32Ptr(p, p + 5, &len);  // +5: we assume "p" is not corrupted
+    return Slice(p, len);
+}
+
+MemTable::MemTable(const InternalKeyComparator& comparator, bool concurrent,
+                   const Options* options)
+    : comparator_(comparator),
+      concurrent_(concurrent),
+      sort_batches_(options != nullptr && options->memtable_sort_batch_inserts),
+      merge_operator_(options != nullptr ? options->merge_operator : nullptr),
+      write_buffer_manager_(options != nullptr ? options->write_buffer_manager : nullptr),
+      charged_bytes_(0),
+      immutable_(false),
+      refs_(0),
+      log_number_(0),
+      arena_(concurrent,
+             options != nullptr ? options->memtable_huge_page_size : 0,
+             options != nullptr && options->memtable_numa_local),
+      range_del_rep_(NewSkipListRep(comparator_, &arena_)),
+      num_range_deletions_(0),
+      fragmented_deletions_(0) {
+    switch (options != nullptr ? options->memtable_rep : kSkipListMemTableRep) {
+        case kHashMemTableRep:
+            rep_ = NewHashRep(comparator_, &arena_, options->memtable_hash_bucket_count);
+            break;
+        case kVectorMemTableRep:
+            rep_ = NewVectorRep(comparator_);
+            break;
+        default:
+            rep_ = NewSkipListRep(comparator_, &arena_);
+            break;
+    }
+    bloom_ = nullptr;
+    if (options != nullptr && options->memtable_bloom_size_ratio > 0) {
+        const size_t bits = static_cast<size_t>(options->write_buffer_size *
+                                                options->memtable_bloom_size_ratio * 8);
+        bloom_ = new (arena_.AllocateAligned(sizeof(DynamicBloom)))
+                DynamicBloom(&arena_, bits);
+    }
+}
+
+MemTable::~MemTable() {
+    assert(refs_ == 0);
+    if (write_buffer_manager_ != nullptr) {
+        if (!immutable_) {
+            write_buffer_manager_->ScheduleFreeMem(charged_bytes_);
+        }
+        write_buffer_manager_->FreeMem(charged_bytes_);
+    }
+    delete rep_;
+    delete range_del_rep_;
+}
+
+void MemTable::MarkImmutable() {
+    if (immutable_) {
+        return;
+    }
+    ChargeWriteBuffer();
+    if (write_buffer_manager_ != nullptr) {
+        write_buffer_manager_->ScheduleFreeMem(charged_bytes_);
+    }
+    immutable_ = true;
+    rep_->MarkReadOnly();
+}
+
+void MemTable::ChargeWriteBuffer() {
+    if (write_buffer_manager_ == nullptr || immutable_) {
+        return;
+    }
+    const size_t usage = ApproximateMemoryUsage();
+    if (usage > charged_bytes_) {
+        write_buffer_manager_->ReserveMem(usage - charged_bytes_);
+        charged_bytes_ = usage;
+    }
+}
+
+size_t MemTable::ApproximateMemoryUsage() {
+    return arena_.MemoryUsage() + rep_->ApproximateMemoryUsage();
+}
+
+// encode a suitable internal key target for "target" and return it.
+// uses *scratch as scratch space, and the returned pointer will point
+// into this scratch space.
+static const char* EncodeKey(std::string* scratch, const Slice& target) {
+    scratch->clear();
+    PutVarint32(scratch, target.size());
+    scratch->append(target.data(), target.size());
+    return scratch->data();
+}
+
+class MemTableIterator : public Iterator {
+public:
+    explicit MemTableIterator(MemTableRep* rep) : iter_(rep->NewIterator()) {}
+
+    MemTableIterator(const MemTableIterator&) = delete;
+    MemTableIterator& operator=(const MemTableIterator&) = delete;
+
+    ~MemTableIterator() override { delete iter_; }
+
+    bool Valid() const override { return iter_->Valid(); }
+    void Seek(const Slice& k) override { iter_->Seek(EncodeKey(&tmp_, k)); }
+    void SeekToFirst() override { iter_->SeekToFirst(); }
+    void SeekToLast() override { iter_->SeekToLast(); }
+    void Next() override { iter_->Next(); }
+    void Prev() override { iter_->Prev(); }
+    Slice key() const override { return GetLengthPrefixedSlice(iter_->key()); }
+    Slice value() const override {
+        Slice key_slice = GetLengthPrefixedSlice(iter_->key());
+        return GetLengthPrefixedSlice(key_slice.data() + key_slice.size());
+    }
+
+    Status status() const override { return Status::OK(); }
+
+private:
+    MemTableRep::Iterator* iter_;
+    std::string tmp_;  // for passing to EncodeKey
+};
+
+Iterator* MemTable::NewIterator() { return new MemTableIterator(rep_); }
+
+Iterator* MemTable::NewRangeTombstoneIterator() {
+    if (num_range_deletions_.load(std::memory_order_acquire) == 0) {
+        return nullptr;
+    }
+    return new MemTableIterator(range_del_rep_);
+}
+
+std::shared_ptr<const FragmentedRangeTombstoneList> MemTable::RangeTombstoneFragments() {
+    const uint64_t deletions = num_range_deletions_.load(std::memory_order_acquire);
+    if (deletions == 0) {
+        return nullptr;
+    }
+    MutexLock l(&fragments_mu_);
+    if (fragments_ == nullptr || fragmented_deletions_ != deletions) {
+        // tombstones added meanwhile may be included too, which only makes
+        // the next rebuild come sooner than needed
+        MemTableIterator iter(range_del_rep_);
+        fragments_ = std::make_shared<const FragmentedRangeTombstoneList>(
+                &iter, &comparator_.comparator, comparator_.comparator.user_comparator());
+        fragmented_deletions_ = deletions;
+    }
+    return fragments_;
+}
+
+const char* MemTable::EncodeEntry(SequenceNumber s, ValueType type,
+                                  const Slice& key, const Slice& value) {
+    // format of an entry is concatenation of:
+    //  key_size     : varint32 of internal_key.size()
+    //  key bytes    : char[internal_key.size()]
+    //  tag          : uint64((sequence << 8) | type)
+    //  value_size   : varint32 of value.size()
+    //  value bytes  : char[value.size()]
+    size_t key_size = key.size();
+    size_t val_size = value.size();
+    size_t internal_key_size = key_size + 8;
+    const size_t encoded_len = VarintLength(internal_key_size) +
+                               internal_key_size + VarintLength(val_size) +
+                               val_size;
+    char* buf = arena_.Allocate(encoded_len);
+    char* p = EncodeVarint32(buf, internal_key_size);
+    std::memcpy(p, key.data(), key_size);
+    p += key_size;
+    EncodeFixed64(p, (s << 8) | type);
+    p += 8;
+    p = EncodeVarint32(p, val_size);
+    std::memcpy(p, value.data(), val_size);
+    assert(p + val_size == buf + encoded_len);
+    return buf;
+}
+
+void MemTable::AddToBloom(const Slice& key, bool concurrently) {
+    if (bloom_ == nullptr) {
+        return;
+    }
+    // the key is added before its entry is inserted, so a reader that can
+    // see the entry always finds the key in the filter
+    if (concurrently) {
+        bloom_->AddConcurrently(key);
+    } else {
+        bloom_->Add(key);
+    }
+}
+
+bool MemTable::EmptyRange(const Slice& begin_key, const Slice& end_key) const {
+    return comparator_.comparator.user_comparator()->Compare(begin_key, end_key) >= 0;
+}
+
+void MemTable::Add(SequenceNumber s, ValueType type, const Slice& key,
+                   const Slice& value) {
+    if (type == kTypeRangeDeletion) {
+        if (EmptyRange(key, value)) {
+            return;
+        }
+        range_del_rep_->Insert(EncodeEntry(s, type, key, value));
+        num_range_deletions_.fetch_add(1, std::memory_order_release);
+        return;
+    }
+    AddToBloom(key, concurrent_);
+    rep_->Insert(EncodeEntry(s, type, key, value));
+}
+
+void MemTable::AddConcurrently(SequenceNumber s, ValueType type,
+                               const Slice& key, const Slice& value) {
+    assert(concurrent_);
+    if (type == kTypeRangeDeletion) {
+        if (EmptyRange(key, value)) {
+            return;
+        }
+        range_del_rep_->InsertConcurrently(EncodeEntry(s, type, key, value));
+        num_range_deletions_.fetch_add(1, std::memory_order_release);
+        return;
+    }
+    AddToBloom(key, true);
+    rep_->InsertConcurrently(EncodeEntry(s, type, key, value));
+}
+
+const char* MemTable::Prepare(SequenceNumber s, ValueType type, const Slice& key,
+                              const Slice& value) {
+    assert(type != kTypeRangeDeletion);
+    AddToBloom(key, concurrent_);
+    return EncodeEntry(s, type, key, value);
+}
+
+void MemTable::AddPrepared(std::vector<const char*>* entries, bool concurrently) {
+    assert(!concurrently || concurrent_);
+    if (sort_batches_) {
+        const MemTableKeyComparator& compare = comparator_;
+        auto less = [&compare](const char* a, const char* b) { return compare(a, b) < 0; };
+        if (!std::is_sorted(entries->begin(), entries->end(), less)) {
+            std::sort(entries->begin(), entries->end(), less);
+        }
+    }
+    rep_->InsertBatch(entries->data(), entries->size(), concurrently);
+}
+
+namespace {
+// what MemTable::Get() has found out about its key so far
+struct Saver {
+    enum State { kNotFound, kFound, kDeleted };
+
+    State state;
+    const Comparator* ucmp;
+    Slice user_key;
+    SequenceNumber max_covering_tombstone_seq;
+    MergeContext* merge_context;
+    Slice value;  // if state == kFound
+};
+}  // namespace
+
+// called on the entries of the key from the newest visible one on, until
+// it returns false
+static bool SaveEntry(void* arg, const char* entry) {
+    Saver* saver = reinterpret_cast<Saver*>(arg);
+    // entry format is:
+    //    klength  varint32
+    //    userkey  char[klength]
+    //    tag      uint64
+    //    vlength  varint32
+    //    value    char[vlength]
+    // check that it belongs to same user key.  We do not check the
+    // sequence number since the lookup already skipped all entries
+    // with overly large sequence numbers.
+    uint32_t key_length;
+    const char* key_ptr = GetVarint32Ptr(entry, entry + 5, &key_length);
+    if (saver->ucmp->Compare(Slice(key_ptr, key_length - 8), saver->user_key) != 0) {
+        return false;
+    }
+    const uint64_t tag = DecodeFixed64(key_ptr + key_length - 8);
+    if ((tag >> 8) < saver->max_covering_tombstone_seq) {
+        // a range tombstone hides this entry and every older one
+        saver->state = Saver::kDeleted;
+        return false;
+    }
+    switch (static_cast<ValueType>(tag & 0xff)) {
+        case kTypeValue:
+            saver->state = Saver::kFound;
+            saver->value = GetLengthPrefixedSlice(key_ptr + key_length);
+            return false;
+        case kTypeMerge:
+            saver->merge_context->PushOperand(GetLengthPrefixedSlice(key_ptr + key_length));
+            return true;
+        default:
+            saver->state = Saver::kDeleted;
+            return false;
+    }
+}
+
+bool MemTable::Get(const LookupKey& key, std::string* value, Status* s,
+                   SequenceNumber* max_covering_tombstone_seq, MergeContext* merge_context) {
+    const Comparator* ucmp = comparator_.comparator.user_comparator();
+    std::shared_ptr<const FragmentedRangeTombstoneList> fragments = RangeTombstoneFragments();
+    if (fragments != nullptr) {
+        const Slice ikey = key.internal_key();
+        const SequenceNumber snapshot = DecodeFixed64(ikey.data() + ikey.size() - 8) >> 8;
+        FragmentedRangeTombstoneIterator tombstones(fragments.get());
+        *max_covering_tombstone_seq =
+                std::max(*max_covering_tombstone_seq,
+                         MaxCoveringTombstoneSeq(&tombstones, ucmp, key.user_key(), snapshot));
+    }
+
+    Saver saver;
+    saver.state = Saver::kNotFound;
+    saver.ucmp = ucmp;
+    saver.user_key = key.user_key();
+    saver.max_covering_tombstone_seq = *max_covering_tombstone_seq;
+    saver.merge_context = merge_context;
+    if (bloom_ == nullptr || bloom_->MayContain(key.user_key())) {
+        rep_->Get(key.memtable_key().data(), &saver, &SaveEntry);
+    }
+    if (saver.state == Saver::kNotFound && *max_covering_tombstone_seq > 0) {
+        // older memtables and tables only hold older entries, which the
+        // tombstone hides as well
+        saver.state = Saver::kDeleted;
+    }
+
+    switch (saver.state) {
+        case Saver::kFound:
+            if (merge_context->empty()) {
+                value->assign(saver.value.data(), saver.value.size());
+            } else {
+                *s = merge_context->Merge(merge_operator_, key.user_key(), &saver.value, value);
+            }
+            return true;
+        case Saver::kDeleted:
+            if (merge_context->empty()) {
+                *s = Status::NotFound(Slice());
+            } else {
+                *s = merge_context->Merge(merge_operator_, key.user_key(), nullptr, value);
+            }
+            return true;
+        default:
+            return false;
+    }
+}
 
-}  // namespace leveldb
\ No newline at end of file
+}  // namespace leveldb
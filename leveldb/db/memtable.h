@@ -1,19 +1,33 @@
 #ifndef STORAGE_LEVELDB_DB_MEMTABLE_H_
 #define STORAGE_LEVELDB_DB_MEMTABLE_H_
 
+#include <atomic>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "db/dbformat.h"
+#include "db/merge_context.h"
+#include "db/memtable_rep.h"
+#include "db/range_del.h"
 #include "leveldb/db.h"
+#include "port/port.h"
+#include "util/arena.h"
+#include "util/dynamic_bloom.h"
 
 namespace leveldb {
 
-class InternalKeyCompartor;
+class InternalKeyComparator;
 class MemTableIterator;
 
 class MemTable {
 public:
-    explicit MemTable(const InternalKeyCompartor& compartor);
+    // if "concurrent" is true, AddConcurrently() may be used to insert
+    // from several threads at once. "options", if not null, selects the
+    // memtable representation (Options::memtable_rep); the default is a
+    // skiplist.
+    explicit MemTable(const InternalKeyComparator& comparator,
+                      bool concurrent = false, const Options* options = nullptr);
 
     MemTable(MemTable&) = delete;
     MemTable& operator=(MemTable&) = delete;
@@ -28,42 +42,119 @@ public:
         }
     }
 
+    // number of the log file that holds the writes to this memtable
+    uint64_t LogNumber() const { return log_number_; }
+    void SetLogNumber(uint64_t number) { log_number_ = number; }
+
+    // called once nothing will be added to the memtable any more
+    void MarkImmutable();
+
+    // brings the memory charged to Options::write_buffer_manager, if any,
+    // up to date with ApproximateMemoryUsage(). Memory is only charged when
+    // this is called, when the memtable becomes immutable, and uncharged
+    // when it is deleted.
+    // REQUIRES: external synchronization
+    void ChargeWriteBuffer();
+
     // returns an estimate of the number of bytes of data in use by this
     // data structure. It is safe to call when MemTable is being modified
     size_t ApproximateMemoryUsage();
 
-    // todo NewIterator
+    // return an iterator that yields the contents of the memtable.
+    //
+    // the caller must ensure that the underlying MemTable remains live
+    // while the returned iterator is live.  The keys returned by this
+    // iterator are internal keys encoded by AppendInternalKey in the
+    // db/format.{h,cc} module.
+    Iterator* NewIterator();
+
+    // returns an iterator over the range tombstones of the memtable, in the
+    // format described in db/range_del.h, or nullptr if it has none. Same
+    // lifetime requirements as NewIterator().
+    Iterator* NewRangeTombstoneIterator();
 
     // add an entry into memtable that maps key to value at the
     // specified sequence number and with the specified type.
-    // Typically value will be empty if type = kTypeDeletion.
+    // Typically value will be empty if type = kTypeDeletion. For
+    // kTypeRangeDeletion, key is the begin and value the end of the range;
+    // an empty range is dropped.
     void Add(SequenceNumber seq, ValueType type, const Slice& key,
              const Slice& value);
 
+    // same as Add(), but safe to call from several threads at once.
+    // REQUIRES: memtable was created with concurrent == true
+    void AddConcurrently(SequenceNumber seq, ValueType type, const Slice& key,
+                         const Slice& value);
+
+    // a group of entries, like those of one write batch, may be added in
+    // one go instead: Prepare() each entry, then pass them all to
+    // AddPrepared(). That lets the memtable insert them in key order, each
+    // starting from the position of the last.
+    const char* Prepare(SequenceNumber seq, ValueType type, const Slice& key,
+                        const Slice& value);
+
+    // adds the entries made by Prepare(), like Add() or, if "concurrently",
+    // AddConcurrently(). May reorder *entries.
+    // REQUIRES: none of the entries is a range tombstone
+    void AddPrepared(std::vector<const char*>* entries, bool concurrently);
+
     // If memtable contains a value for key, store it in *value and return true.
     // If memtable contains a deletion for key, store a NotFound() error
     // in *status and return true.
     // Else return false
-    bool Get(const LookupKey& key, std::string* value, Status* s);
+    //
+    //
+    // *max_covering_tombstone_seq holds the newest range tombstone visible
+    // to the lookup that covers key in the newer memtables searched so far,
+    // or 0, and is raised to include those of this memtable. A value older
+    // than that tombstone counts as deleted.
+    //
+    // merge operands of key are added to *merge_context. Once a value or
+    // deletion is found, the operands collected so far are combined with
+    // it (see Options::merge_operator) and the result is returned instead.
+    bool Get(const LookupKey& key, std::string* value, Status* s,
+             SequenceNumber* max_covering_tombstone_seq, MergeContext* merge_context);
 
 private:
     friend class MemTableIterator;
     friend class MemTableBackwardIterator;
 
-    struct KeyCompartor {
-        const InternalKeyCompartor comparator;
-        explicit KeyCompartor(const InternalKeyComparator& c) : comparator(c) {}
-        int operator()(const char* a, const char* b);
-    };
+    ~MemTable();  // private since only Unref() should be used to delete it
 
-    typedef SkipList<const char*, KeyCompartor> Table;
+    // encode an entry into memory allocated from arena_
+    const char* EncodeEntry(SequenceNumber seq, ValueType type,
+                            const Slice& key, const Slice& value);
 
-    ~MemTable();  // private since only Unref() should be used to delete it
+    // adds "key" to bloom_, if there is one
+    void AddToBloom(const Slice& key, bool concurrently);
+
+    // true if no key is in ["begin_key", "end_key"), so a range tombstone
+    // over it hides nothing and is not stored
+    bool EmptyRange(const Slice& begin_key, const Slice& end_key) const;
+
+    // the fragments of the range tombstones, rebuilt if any were added
+    // since they were last made, or nullptr if there are none
+    std::shared_ptr<const FragmentedRangeTombstoneList> RangeTombstoneFragments();
 
-    KeyCompartor compartor_;
+    MemTableKeyComparator comparator_;
+    const bool concurrent_;
+    const bool sort_batches_;  // Options::memtable_sort_batch_inserts
+    const MergeOperator* const merge_operator_;
+    WriteBufferManager* const write_buffer_manager_;
+    size_t charged_bytes_;  // memory charged to write_buffer_manager_
+    bool immutable_;
     int refs_;
+    uint64_t log_number_;
     Arena arena_;
-    Table table_;
+    MemTableRep* rep_;
+    MemTableRep* range_del_rep_;  // a skiplist, whatever rep_ is
+    // bumped after each range tombstone is inserted
+    std::atomic<uint64_t> num_range_deletions_;
+    port::Mutex fragments_mu_;
+    std::shared_ptr<const FragmentedRangeTombstoneList> fragments_ GUARDED_BY(fragments_mu_);
+    // num_range_deletions_ when fragments_ was made
+    uint64_t fragmented_deletions_ GUARDED_BY(fragments_mu_);
+    DynamicBloom* bloom_;  // of user keys, allocated from arena_, may be null
 };
 
 }  // namespace leveldb
@@ -0,0 +1,417 @@
+#include "db/memtable_rep.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include "db/skiplist.h"
+#include "leveldb/comparator.h"
+#include "port/port.h"
+#include "port/thread_annotations.h"
+#include "util/arena.h"
+#include "util/coding.h"
+#include "util/hash.h"
+#include "util/mutexlock.h"
+
+namespace leveldb {
+
+static Slice GetLengthPrefixedSlice(const char* data) {
+    uint32_t len;
+    const char* p = data;
+    p = GetVarint32Ptr(p, p + 5, &len);  // +5: we assume "p" is not corrupted
+    return Slice(p, len);
+}
+
+// the user key of an entry
+static Slice UserKey(const char* entry) {
+    Slice internal_key = GetLengthPrefixedSlice(entry);
+    assert(internal_key.size() >= 8);
+    return Slice(internal_key.data(), internal_key.size() - 8);
+}
+
+MemTableKeyComparator::MemTableKeyComparator(const InternalKeyComparator& c)
+    : comparator(c), bytewise(c.user_comparator() == BytewiseComparator()) {}
+
+uint64_t MemTableKeyComparator::KeyPrefix(const char* entry) const {
+    if (!bytewise) {
+        return 0;
+    }
+    Slice internal_key = GetLengthPrefixedSlice(entry);
+    assert(internal_key.size() >= 8);
+    const size_t n = std::min<size_t>(internal_key.size() - 8, 7);
+    uint64_t prefix = 0;
+    for (size_t i = 0; i < 7; i++) {
+        const uint64_t byte = (i < n) ? static_cast<unsigned char>(internal_key[i]) : 0;
+        prefix = (prefix << 8) | byte;
+    }
+    return (prefix << 8) | n;
+}
+
+int MemTableKeyComparator::operator()(const char* aptr, const char* bptr) const {
+    // internal keys are encoded as length-prefixed strings.
+    Slice a = GetLengthPrefixedSlice(aptr);
+    Slice b = GetLengthPrefixedSlice(bptr);
+    return comparator.Compare(a, b);
+}
+
+void MemTableRep::InsertBatch(const char* const* entries, size_t n,
+                              bool concurrently) {
+    for (size_t i = 0; i < n; i++) {
+        if (concurrently) {
+            InsertConcurrently(entries[i]);
+        } else {
+            Insert(entries[i]);
+        }
+    }
+}
+
+namespace {
+
+// strict weak ordering of entries for the standard algorithms
+struct EntryLess {
+    explicit EntryLess(const MemTableKeyComparator& c) : compare(c) {}
+    bool operator()(const char* a, const char* b) const { return compare(a, b) < 0; }
+
+    const MemTableKeyComparator& compare;
+};
+
+// iterates over a sorted vector of entries
+class SortedIterator : public MemTableRep::Iterator {
+public:
+    SortedIterator(const MemTableKeyComparator& compare,
+                   std::shared_ptr<const std::vector<const char*>> entries)
+        : compare_(compare), entries_(std::move(entries)), pos_(entries_->size()) {}
+
+    bool Valid() const override { return pos_ < entries_->size(); }
+    const char* key() const override { return (*entries_)[pos_]; }
+    void Next() override { pos_++; }
+    void Prev() override { pos_ = (pos_ == 0) ? entries_->size() : pos_ - 1; }
+    void Seek(const char* target) override {
+        pos_ = std::lower_bound(entries_->begin(), entries_->end(), target,
+                                EntryLess(compare_)) - entries_->begin();
+    }
+    void SeekToFirst() override { pos_ = 0; }
+    void SeekToLast() override {
+        pos_ = entries_->empty() ? 0 : entries_->size() - 1;
+    }
+
+private:
+    const MemTableKeyComparator compare_;
+    const std::shared_ptr<const std::vector<const char*>> entries_;
+    size_t pos_;  // entries_->size() when not valid
+};
+
+class SkipListRep : public MemTableRep {
+public:
+    SkipListRep(const MemTableKeyComparator& comparator, Arena* arena)
+        : table_(comparator, arena) {}
+
+    void Insert(const char* entry) override { table_.Insert(entry); }
+
+    void InsertConcurrently(const char* entry) override {
+        table_.InsertConcurrently(entry);
+    }
+
+    void InsertBatch(const char* const* entries, size_t n, bool concurrently) override {
+        // each search starts from where the last insert went
+        Table::Hint hint;
+        for (size_t i = 0; i < n; i++) {
+            if (concurrently) {
+                table_.InsertConcurrently(entries[i], &hint);
+            } else {
+                table_.Insert(entries[i], &hint);
+            }
+        }
+    }
+
+    void Get(const char* key, void* arg,
+             bool (*callback)(void* arg, const char* entry)) const override {
+        Table::Iterator iter(&table_);
+        for (iter.Seek(key); iter.Valid() && (*callback)(arg, iter.key()); iter.Next()) {
+        }
+    }
+
+    MemTableRep::Iterator* NewIterator() const override {
+        return new Iterator(&table_);
+    }
+
+private:
+    typedef SkipList<const char*, MemTableKeyComparator> Table;
+
+    class Iterator : public MemTableRep::Iterator {
+    public:
+        explicit Iterator(const Table* table) : iter_(table) {}
+
+        bool Valid() const override { return iter_.Valid(); }
+        const char* key() const override { return iter_.key(); }
+        void Next() override { iter_.Next(); }
+        void Prev() override { iter_.Prev(); }
+        void Seek(const char* target) override { iter_.Seek(target); }
+        void SeekToFirst() override { iter_.SeekToFirst(); }
+        void SeekToLast() override { iter_.SeekToLast(); }
+
+    private:
+        Table::Iterator iter_;
+    };
+
+    Table table_;
+};
+
+class HashRep : public MemTableRep {
+public:
+    HashRep(const MemTableKeyComparator& comparator, Arena* arena,
+            size_t bucket_count)
+        : compare_(comparator),
+          arena_(arena),
+          bucket_count_(std::max<size_t>(bucket_count, 1)) {
+        char* mem = arena_->AllocateAligned(sizeof(std::atomic<Node*>) * bucket_count_);
+        buckets_ = reinterpret_cast<std::atomic<Node*>*>(mem);
+        for (size_t i = 0; i < bucket_count_; i++) {
+            new (&buckets_[i]) std::atomic<Node*>(nullptr);
+        }
+    }
+
+    void Insert(const char* entry) override {
+        Node* node = NewNode(entry);
+        std::atomic<Node*>* link = &buckets_[BucketFor(entry)];
+        Node* next = link->load(std::memory_order_acquire);
+        while (next != nullptr && compare_(next->key, entry) < 0) {
+            link = &next->next;
+            next = link->load(std::memory_order_acquire);
+        }
+        // publish the node only once its next pointer is set
+        node->next.store(next, std::memory_order_relaxed);
+        link->store(node, std::memory_order_release);
+    }
+
+    void InsertConcurrently(const char* entry) override {
+        Node* node = NewNode(entry);
+        std::atomic<Node*>* link = &buckets_[BucketFor(entry)];
+        Node* next = link->load(std::memory_order_acquire);
+        while (true) {
+            while (next != nullptr && compare_(next->key, entry) < 0) {
+                link = &next->next;
+                next = link->load(std::memory_order_acquire);
+            }
+            node->next.store(next, std::memory_order_relaxed);
+            // on failure "next" is reloaded; nodes are only ever added, so
+            // the insert position is still at or after "link"
+            if (link->compare_exchange_weak(next, node, std::memory_order_release,
+                                            std::memory_order_acquire)) {
+                return;
+            }
+        }
+    }
+
+    void Get(const char* key, void* arg,
+             bool (*callback)(void* arg, const char* entry)) const override {
+        Node* node = buckets_[BucketFor(key)].load(std::memory_order_acquire);
+        while (node != nullptr && compare_(node->key, key) < 0) {
+            node = node->next.load(std::memory_order_acquire);
+        }
+        while (node != nullptr && (*callback)(arg, node->key)) {
+            node = node->next.load(std::memory_order_acquire);
+        }
+    }
+
+    MemTableRep::Iterator* NewIterator() const override {
+        std::vector<const char*> entries;
+        for (size_t i = 0; i < bucket_count_; i++) {
+            for (Node* node = buckets_[i].load(std::memory_order_acquire);
+                 node != nullptr; node = node->next.load(std::memory_order_acquire)) {
+                entries.push_back(node->key);
+            }
+        }
+        std::sort(entries.begin(), entries.end(), EntryLess(compare_));
+        return new SortedIterator(compare_, std::make_shared<const std::vector<const char*>>(
+                                                    std::move(entries)));
+    }
+
+private:
+    struct Node {
+        explicit Node(const char* k) : key(k), next(nullptr) {}
+
+        const char* const key;
+        std::atomic<Node*> next;
+    };
+
+    Node* NewNode(const char* entry) {
+        char* mem = arena_->AllocateAligned(sizeof(Node));
+        return new (mem) Node(entry);
+    }
+
+    size_t BucketFor(const char* entry) const {
+        // hash the user key, so all versions of a key share a bucket
+        Slice internal_key = GetLengthPrefixedSlice(entry);
+        assert(internal_key.size() >= 8);
+        return Hash(internal_key.data(), internal_key.size() - 8, 0) % bucket_count_;
+    }
+
+    const MemTableKeyComparator compare_;
+    Arena* const arena_;
+    const size_t bucket_count_;
+    std::atomic<Node*>* buckets_;  // allocated from arena_
+};
+
+
+// smallest number of entries worth handing to a sorting thread of its own
+static const size_t kMinEntriesPerSortThread = 64 * 1024;
+
+// sorts *entries by splitting it into runs that are sorted on separate
+// threads, then merging neighbouring runs pairwise, again in parallel.
+static void ParallelSort(std::vector<const char*>* entries, const EntryLess& less) {
+    const size_t n = entries->size();
+    size_t runs = std::min<size_t>(std::thread::hardware_concurrency(),
+                                   n / kMinEntriesPerSortThread);
+    if (runs <= 1) {
+        std::sort(entries->begin(), entries->end(), less);
+        return;
+    }
+
+    // run i is [bounds[i], bounds[i + 1])
+    std::vector<std::vector<const char*>::iterator> bounds;
+    for (size_t i = 0; i <= runs; i++) {
+        bounds.push_back(entries->begin() + n * i / runs);
+    }
+
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < runs; i++) {
+        threads.emplace_back([&bounds, &less, i]() {
+            std::sort(bounds[i], bounds[i + 1], less);
+        });
+    }
+    std::sort(bounds[0], bounds[1], less);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    for (size_t width = 1; width < runs; width *= 2) {
+        threads.clear();
+        for (size_t i = 0; i + width < runs; i += 2 * width) {
+            const size_t last = std::min(i + 2 * width, runs);
+            threads.emplace_back([&bounds, &less, i, width, last]() {
+                std::inplace_merge(bounds[i], bounds[i + width], bounds[last], less);
+            });
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+    }
+}
+
+class VectorRep : public MemTableRep {
+public:
+    explicit VectorRep(const MemTableKeyComparator& comparator)
+        : compare_(comparator), read_only_(false) {}
+
+    void Insert(const char* entry) override {
+        MutexLock l(&mu_);
+        assert(!read_only_);
+        entries_.push_back(entry);
+    }
+
+    void InsertConcurrently(const char* entry) override { Insert(entry); }
+
+    void InsertBatch(const char* const* entries, size_t n, bool concurrently) override {
+        MutexLock l(&mu_);
+        assert(!read_only_);
+        entries_.insert(entries_.end(), entries, entries + n);
+    }
+
+    void Get(const char* key, void* arg,
+             bool (*callback)(void* arg, const char* entry)) const override {
+        std::shared_ptr<const std::vector<const char*>> sorted;
+        std::vector<const char*> matches;
+        {
+            MutexLock l(&mu_);
+            sorted = sorted_;
+            if (sorted == nullptr) {
+                // the entries of the user key at or after key
+                const Slice user_key = UserKey(key);
+                const Comparator* ucmp = compare_.comparator.user_comparator();
+                for (const char* entry : entries_) {
+                    if (compare_(entry, key) >= 0 && ucmp->Compare(UserKey(entry), user_key) == 0) {
+                        matches.push_back(entry);
+                    }
+                }
+            }
+        }
+
+        // the callback runs without holding mu_
+        if (sorted != nullptr) {
+            auto iter = std::lower_bound(sorted->begin(), sorted->end(), key, EntryLess(compare_));
+            while (iter != sorted->end() && (*callback)(arg, *iter)) {
+                ++iter;
+            }
+            return;
+        }
+        std::sort(matches.begin(), matches.end(), EntryLess(compare_));
+        for (const char* entry : matches) {
+            if (!(*callback)(arg, entry)) {
+                break;
+            }
+        }
+    }
+
+    MemTableRep::Iterator* NewIterator() const override {
+        std::vector<const char*> entries;
+        {
+            MutexLock l(&mu_);
+            if (sorted_ != nullptr) {
+                return new SortedIterator(compare_, sorted_);
+            }
+            entries = entries_;
+        }
+
+        // sort without holding mu_, so lookups can go on meanwhile
+        ParallelSort(&entries, EntryLess(compare_));
+        auto sorted = std::make_shared<const std::vector<const char*>>(std::move(entries));
+
+        MutexLock l(&mu_);
+        if (read_only_ && sorted_ == nullptr) {
+            // this order is final, keep it for lookups and later iterators
+            sorted_ = sorted;
+            entries_.clear();
+            entries_.shrink_to_fit();
+        }
+        return new SortedIterator(compare_, sorted);
+    }
+
+    void MarkReadOnly() override {
+        MutexLock l(&mu_);
+        read_only_ = true;
+    }
+
+    size_t ApproximateMemoryUsage() const override {
+        MutexLock l(&mu_);
+        return (sorted_ != nullptr ? sorted_->capacity() : entries_.capacity()) *
+               sizeof(const char*);
+    }
+
+private:
+    const MemTableKeyComparator compare_;
+    mutable port::Mutex mu_;
+    // entries in insertion order, until they are sorted into sorted_
+    mutable std::vector<const char*> entries_ GUARDED_BY(mu_);
+    mutable std::shared_ptr<const std::vector<const char*>> sorted_ GUARDED_BY(mu_);
+    bool read_only_ GUARDED_BY(mu_);
+};
+}  // namespace
+
+MemTableRep* NewSkipListRep(const MemTableKeyComparator& comparator, Arena* arena) {
+    return new SkipListRep(comparator, arena);
+}
+
+MemTableRep* NewHashRep(const MemTableKeyComparator& comparator, Arena* arena,
+                        size_t bucket_count) {
+    return new HashRep(comparator, arena, bucket_count);
+}
+
+MemTableRep* NewVectorRep(const MemTableKeyComparator& comparator) {
+    return new VectorRep(comparator);
+}
+
+}  // namespace leveldb
@@ -0,0 +1,112 @@
+#ifndef STORAGE_LEVELDB_DB_MEMTABLE_REP_H_
+#define STORAGE_LEVELDB_DB_MEMTABLE_REP_H_
+
+#include <stddef.h>
+
+#include "db/dbformat.h"
+#include "leveldb/options.h"
+
+namespace leveldb {
+
+class Arena;
+
+// orders memtable entries, which are length prefixed internal keys
+// followed by the value (see MemTable::EncodeEntry).
+struct MemTableKeyComparator {
+    const InternalKeyComparator comparator;
+    explicit MemTableKeyComparator(const InternalKeyComparator& c);
+    int operator()(const char* a, const char* b) const;
+
+    // up to the first 7 bytes of the user key, followed by a byte holding
+    // the user key length capped at 7, as a big-endian number. Codes order
+    // entries like operator() does wherever they differ, but only for the
+    // bytewise user comparator; with any other every entry gets code 0.
+    uint64_t KeyPrefix(const char* entry) const;
+
+    const bool bytewise;  // the user comparator is BytewiseComparator()
+};
+
+// the structure a MemTable keeps its entries in. Entries are encoded by the
+// memtable and allocated from its arena; a rep only keeps them in order.
+// Entries are never removed.
+//
+// Insert() needs external synchronization, everything else may be called
+// while another thread inserts.
+class MemTableRep {
+public:
+    // iterates over the entries of a rep in MemTableKeyComparator order
+    class Iterator {
+    public:
+        virtual ~Iterator() = default;
+
+        virtual bool Valid() const = 0;
+        // REQUIRES: Valid()
+        virtual const char* key() const = 0;
+        // REQUIRES: Valid()
+        virtual void Next() = 0;
+        // REQUIRES: Valid()
+        virtual void Prev() = 0;
+        // advance to the first entry at or after target
+        virtual void Seek(const char* target) = 0;
+        virtual void SeekToFirst() = 0;
+        virtual void SeekToLast() = 0;
+    };
+
+    MemTableRep() = default;
+
+    MemTableRep(const MemTableRep&) = delete;
+    MemTableRep& operator=(const MemTableRep&) = delete;
+
+    virtual ~MemTableRep() = default;
+
+    // REQUIRES: nothing that compares equal to entry is in the rep
+    virtual void Insert(const char* entry) = 0;
+
+    // same as Insert(), but safe to call from several threads at once.
+    // REQUIRES: the arena is thread safe
+    virtual void InsertConcurrently(const char* entry) = 0;
+
+    // inserts entries[0..n-1], e.g. the entries of one write batch, with
+    // Insert() or, if "concurrently", InsertConcurrently(). A rep may use
+    // the position of each entry to speed up the search for the next.
+    virtual void InsertBatch(const char* const* entries, size_t n, bool concurrently);
+
+    // calls (*callback)(arg, entry) on the entries at or after "key", in
+    // order, until it returns false or no entries that may have the same
+    // user key as "key" are left. Point lookups only need these entries,
+    // so a rep can search just the ones that could match instead of the
+    // whole ordering.
+    virtual void Get(const char* key, void* arg,
+                     bool (*callback)(void* arg, const char* entry)) const = 0;
+
+    // returns an iterator over all entries. The iterator of a rep that
+    // does not keep a total order may not see entries inserted after it
+    // was created.
+    virtual Iterator* NewIterator() const = 0;
+
+    // called once no more entries will be inserted, e.g. when the memtable
+    // becomes immutable. A rep may then put its entries in their final order.
+    virtual void MarkReadOnly() {}
+
+    // bytes the rep holds outside the arena
+    virtual size_t ApproximateMemoryUsage() const { return 0; }
+};
+
+// the ordering a single skiplist gives: every operation is O(log n).
+MemTableRep* NewSkipListRep(const MemTableKeyComparator& comparator, Arena* arena);
+
+// entries are hashed by user key into "bucket_count" buckets, each a list
+// sorted by MemTableKeyComparator. A point lookup only walks the bucket of
+// its key; an iterator has to sort all entries when it is created.
+MemTableRep* NewHashRep(const MemTableKeyComparator& comparator, Arena* arena,
+                        size_t bucket_count);
+
+// entries are appended to a vector in insertion order and only sorted, on
+// several threads, the first time the rep is iterated over after
+// MarkReadOnly(). Inserts are O(1), but point lookups scan every entry
+// until then, so this is only meant for bulk loads.
+MemTableRep* NewVectorRep(const MemTableKeyComparator& comparator);
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_MEMTABLE_REP_H_
@@ -0,0 +1,384 @@
+#include "db/memtable.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "db/dbformat.h"
+#include "leveldb/comparator.h"
+#include "leveldb/iterator.h"
+#include "leveldb/merge_operator.h"
+#include "leveldb/options.h"
+#include "util/random.h"
+
+namespace leveldb {
+
+static std::string Key(int i) {
+    char buf[100];
+    std::snprintf(buf, sizeof(buf), "key%06d", i);
+    return std::string(buf);
+}
+
+// runs every test against each memtable rep
+class MemTableTest : public testing::TestWithParam<MemTableRepType> {
+public:
+    MemTableTest() : cmp_(BytewiseComparator()) {
+        options_.memtable_rep = GetParam();
+        options_.memtable_hash_bucket_count = 16;
+        mem_ = new MemTable(cmp_, false, &options_);
+        mem_->Ref();
+    }
+
+    ~MemTableTest() override { mem_->Unref(); }
+
+    // what a read at "seq" sees for "key": its value, "DELETED" or "MISSING"
+    std::string Get(const std::string& key, SequenceNumber seq) {
+        LookupKey lkey(key, seq);
+        std::string value;
+        Status s;
+        SequenceNumber max_covering_tombstone_seq = 0;
+        MergeContext merge_context;
+        if (!mem_->Get(lkey, &value, &s, &max_covering_tombstone_seq, &merge_context)) {
+            return "MISSING";
+        }
+        if (s.IsNotFound()) {
+            return "DELETED";
+        }
+        return s.ok() ? value : s.ToString();
+    }
+
+    // the memtable's entries in iteration order, as "user_key@seq=value"
+    std::string Contents() {
+        std::string result;
+        Iterator* iter = mem_->NewIterator();
+        for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+            ParsedInternalKey ikey;
+            EXPECT_TRUE(ParseInternalKey(iter->key(), &ikey));
+            if (!result.empty()) {
+                result += ",";
+            }
+            result += ikey.user_key.ToString() + "@" + std::to_string(ikey.sequence) +
+                      "=" + iter->value().ToString();
+        }
+        delete iter;
+        return result;
+    }
+
+    InternalKeyComparator cmp_;
+    Options options_;
+    MemTable* mem_;
+};
+
+TEST_P(MemTableTest, Empty) {
+    ASSERT_EQ("MISSING", Get("foo", 100));
+    mem_->MarkImmutable();
+    ASSERT_EQ("", Contents());
+}
+
+TEST_P(MemTableTest, AddAndGet) {
+    mem_->Add(1, kTypeValue, "foo", "v1");
+    mem_->Add(2, kTypeValue, "bar", "v2");
+    mem_->Add(3, kTypeDeletion, "foo", "");
+    mem_->Add(4, kTypeValue, "foo", "v4");
+
+    ASSERT_EQ("MISSING", Get("foo", 0));
+    ASSERT_EQ("v1", Get("foo", 1));
+    ASSERT_EQ("v1", Get("foo", 2));
+    ASSERT_EQ("DELETED", Get("foo", 3));
+    ASSERT_EQ("v4", Get("foo", 4));
+    ASSERT_EQ("v4", Get("foo", 100));
+    ASSERT_EQ("MISSING", Get("bar", 1));
+    ASSERT_EQ("v2", Get("bar", 2));
+    ASSERT_EQ("MISSING", Get("baz", 100));
+    // a prefix or an extension of a key is a different key
+    ASSERT_EQ("MISSING", Get("fo", 100));
+    ASSERT_EQ("MISSING", Get("fooo", 100));
+}
+
+TEST_P(MemTableTest, IteratesInOrder) {
+    // newer entries of a key come first
+    mem_->Add(1, kTypeValue, "b", "b1");
+    mem_->Add(2, kTypeValue, "a", "a2");
+    mem_->Add(3, kTypeValue, "c", "c3");
+    mem_->Add(4, kTypeValue, "b", "b4");
+    mem_->MarkImmutable();
+    ASSERT_EQ("a@2=a2,b@4=b4,b@1=b1,c@3=c3", Contents());
+
+    Iterator* iter = mem_->NewIterator();
+    iter->Seek(InternalKey("b", 2, kValueTypeForSeek).Encode());
+    ASSERT_TRUE(iter->Valid());
+    ASSERT_EQ("b1", iter->value().ToString());
+    iter->SeekToLast();
+    ASSERT_TRUE(iter->Valid());
+    ASSERT_EQ("c3", iter->value().ToString());
+    iter->Prev();
+    ASSERT_TRUE(iter->Valid());
+    ASSERT_EQ("b1", iter->value().ToString());
+    delete iter;
+}
+
+TEST_P(MemTableTest, ManyKeys) {
+    const int kNum = 2000;
+    std::vector<int> order(kNum);
+    for (int i = 0; i < kNum; i++) {
+        order[i] = i;
+    }
+    Random rnd(301);
+    for (int i = kNum - 1; i > 0; i--) {
+        std::swap(order[i], order[rnd.Uniform(i + 1)]);
+    }
+    SequenceNumber seq = 1;
+    for (int i : order) {
+        mem_->Add(seq++, kTypeValue, Key(i), "v" + Key(i));
+    }
+    for (int i = 0; i < kNum; i++) {
+        ASSERT_EQ("v" + Key(i), Get(Key(i), seq));
+    }
+
+    mem_->MarkImmutable();
+    Iterator* iter = mem_->NewIterator();
+    int count = 0;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+        ASSERT_EQ(Key(count), ExtractUserKey(iter->key()).ToString());
+        count++;
+    }
+    ASSERT_EQ(kNum, count);
+    delete iter;
+}
+
+TEST_P(MemTableTest, PreparedBatch) {
+    // the entries of a batch go in together, in any order
+    std::vector<const char*> entries;
+    entries.push_back(mem_->Prepare(10, kTypeValue, "k3", "v3"));
+    entries.push_back(mem_->Prepare(11, kTypeValue, "k1", "v1"));
+    entries.push_back(mem_->Prepare(12, kTypeDeletion, "k2", ""));
+    entries.push_back(mem_->Prepare(13, kTypeValue, "k1", "v1b"));
+    mem_->AddPrepared(&entries, false);
+
+    ASSERT_EQ("v3", Get("k3", 100));
+    ASSERT_EQ("v1b", Get("k1", 100));
+    ASSERT_EQ("v1", Get("k1", 12));
+    ASSERT_EQ("DELETED", Get("k2", 100));
+    mem_->MarkImmutable();
+    ASSERT_EQ("k1@13=v1b,k1@11=v1,k2@12=,k3@10=v3", Contents());
+}
+
+TEST(VectorMemTableTest, SortedOnceImmutable) {
+    InternalKeyComparator cmp(BytewiseComparator());
+    Options options;
+    options.memtable_rep = kVectorMemTableRep;
+    MemTable* mem = new MemTable(cmp, false, &options);
+    mem->Ref();
+    mem->Add(1, kTypeValue, "c", "c1");
+    mem->Add(2, kTypeValue, "a", "a2");
+
+    // an iterator over a mutable vector sees a sorted copy, and later
+    // entries still go in
+    Iterator* iter = mem->NewIterator();
+    iter->SeekToFirst();
+    ASSERT_TRUE(iter->Valid());
+    ASSERT_EQ("a2", iter->value().ToString());
+    mem->Add(3, kTypeValue, "b", "b3");
+    iter->Next();
+    ASSERT_TRUE(iter->Valid());
+    ASSERT_EQ("c1", iter->value().ToString());
+    delete iter;
+
+    // after the first iterator over the immutable vector, lookups search
+    // the sorted entries
+    mem->MarkImmutable();
+    iter = mem->NewIterator();
+    std::string keys;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+        keys += ExtractUserKey(iter->key()).ToString();
+    }
+    ASSERT_EQ("abc", keys);
+    delete iter;
+
+    std::string value;
+    Status s;
+    SequenceNumber max_covering_tombstone_seq = 0;
+    MergeContext merge_context;
+    ASSERT_TRUE(mem->Get(LookupKey("b", 10), &value, &s, &max_covering_tombstone_seq,
+                         &merge_context));
+    ASSERT_EQ("b3", value);
+    ASSERT_FALSE(mem->Get(LookupKey("b", 2), &value, &s, &max_covering_tombstone_seq,
+                          &merge_context));
+    mem->Unref();
+}
+
+TEST(MemTableBloomTest, FindsEveryKey) {
+    InternalKeyComparator cmp(BytewiseComparator());
+    Options options;
+    options.write_buffer_size = 1 << 20;
+    options.memtable_bloom_size_ratio = 0.02;
+    MemTable* mem = new MemTable(cmp, false, &options);
+    mem->Ref();
+    for (int i = 0; i < 1000; i += 2) {
+        mem->Add(i + 1, kTypeValue, Key(i), "v" + Key(i));
+    }
+    mem->Add(2000, kTypeDeletion, Key(10), "");
+
+    // the filter only skips keys that were never added
+    std::string value;
+    Status s;
+    SequenceNumber max_covering_tombstone_seq = 0;
+    MergeContext merge_context;
+    for (int i = 0; i < 1000; i++) {
+        value.clear();
+        s = Status::OK();
+        const bool found = mem->Get(LookupKey(Key(i), 3000), &value, &s,
+                                    &max_covering_tombstone_seq, &merge_context);
+        if (i % 2 == 1) {
+            ASSERT_FALSE(found) << i;
+        } else if (i == 10) {
+            ASSERT_TRUE(found);
+            ASSERT_TRUE(s.IsNotFound());
+        } else {
+            ASSERT_TRUE(found) << i;
+            ASSERT_EQ("v" + Key(i), value);
+        }
+    }
+    mem->Unref();
+}
+
+// joins a value and its operands with ',', and fails on a "bad" operand
+class AppendOperator : public MergeOperator {
+public:
+    const char* Name() const override { return "test.AppendOperator"; }
+
+    bool FullMerge(const Slice& key, const Slice* existing_value,
+                   const std::vector<Slice>& operands, std::string* new_value) const override {
+        new_value->clear();
+        if (existing_value != nullptr) {
+            new_value->assign(existing_value->data(), existing_value->size());
+        }
+        for (const Slice& operand : operands) {
+            if (operand == Slice("bad")) {
+                return false;
+            }
+            if (!new_value->empty()) {
+                new_value->push_back(',');
+            }
+            new_value->append(operand.data(), operand.size());
+        }
+        return true;
+    }
+};
+
+class MemTableMergeTest : public testing::Test {
+public:
+    MemTableMergeTest() : cmp_(BytewiseComparator()) {
+        options_.merge_operator = &append_;
+        mem_ = NewMemTable();
+    }
+
+    ~MemTableMergeTest() override { mem_->Unref(); }
+
+    MemTable* NewMemTable() {
+        MemTable* mem = new MemTable(cmp_, false, &options_);
+        mem->Ref();
+        return mem;
+    }
+
+    // looks "key" up at "seq" in "mems", newest first, as the DB does:
+    // the value, "DELETED", "MISSING" or the error
+    std::string Get(const std::vector<MemTable*>& mems, const std::string& key,
+                    SequenceNumber seq) {
+        LookupKey lkey(key, seq);
+        std::string value;
+        Status s;
+        SequenceNumber max_covering_tombstone_seq = 0;
+        MergeContext merge_context;
+        for (MemTable* mem : mems) {
+            if (mem->Get(lkey, &value, &s, &max_covering_tombstone_seq, &merge_context)) {
+                if (s.IsNotFound()) {
+                    return "DELETED";
+                }
+                return s.ok() ? value : s.ToString();
+            }
+        }
+        return merge_context.empty() ? "MISSING" : "UNMERGED";
+    }
+
+    std::string Get(const std::string& key, SequenceNumber seq) { return Get({mem_}, key, seq); }
+
+    AppendOperator append_;
+    InternalKeyComparator cmp_;
+    Options options_;
+    MemTable* mem_;
+};
+
+TEST_F(MemTableMergeTest, MergeWithValue) {
+    mem_->Add(1, kTypeValue, "k", "v");
+    mem_->Add(2, kTypeMerge, "k", "a");
+    mem_->Add(3, kTypeMerge, "k", "b");
+    ASSERT_EQ("v", Get("k", 1));
+    ASSERT_EQ("v,a", Get("k", 2));
+    ASSERT_EQ("v,a,b", Get("k", 3));
+}
+
+TEST_F(MemTableMergeTest, MergeWithDeletion) {
+    mem_->Add(1, kTypeValue, "k", "v");
+    mem_->Add(2, kTypeDeletion, "k", "");
+    mem_->Add(3, kTypeMerge, "k", "a");
+    ASSERT_EQ("DELETED", Get("k", 2));
+    ASSERT_EQ("a", Get("k", 3));
+
+    // a range tombstone hides the value just like a deletion
+    mem_->Add(4, kTypeValue, "j", "v");
+    mem_->Add(5, kTypeRangeDeletion, "a", "z");
+    mem_->Add(6, kTypeMerge, "j", "b");
+    ASSERT_EQ("v", Get("j", 4));
+    ASSERT_EQ("DELETED", Get("j", 5));
+    ASSERT_EQ("b", Get("j", 6));
+}
+
+TEST_F(MemTableMergeTest, OperandsAcrossMemTables) {
+    // the operands of the newer memtable wait for the older one's value
+    MemTable* old_mem = NewMemTable();
+    old_mem->Add(1, kTypeValue, "k", "v");
+    old_mem->Add(2, kTypeMerge, "k", "a");
+    mem_->Add(3, kTypeMerge, "k", "b");
+    mem_->Add(4, kTypeMerge, "k", "c");
+    ASSERT_EQ("UNMERGED", Get("k", 4));
+    ASSERT_EQ("v,a,b,c", Get({mem_, old_mem}, "k", 4));
+    ASSERT_EQ("v,a,b", Get({mem_, old_mem}, "k", 3));
+    ASSERT_EQ("v,a", Get({mem_, old_mem}, "k", 2));
+    old_mem->Unref();
+}
+
+TEST_F(MemTableMergeTest, Errors) {
+    mem_->Add(1, kTypeValue, "k", "v");
+    mem_->Add(2, kTypeMerge, "k", "bad");
+    LookupKey lkey("k", 2);
+    std::string value;
+    Status s;
+    SequenceNumber max_covering_tombstone_seq = 0;
+    MergeContext merge_context;
+    ASSERT_TRUE(mem_->Get(lkey, &value, &s, &max_covering_tombstone_seq, &merge_context));
+    ASSERT_TRUE(s.IsCorruption());
+
+    // operands without a merge operator
+    options_.merge_operator = nullptr;
+    MemTable* mem = NewMemTable();
+    mem->Add(1, kTypeValue, "k", "v");
+    mem->Add(2, kTypeMerge, "k", "a");
+    mem->Add(3, kTypeValue, "j", "v");
+    MergeContext merge_context2;
+    s = Status::OK();
+    ASSERT_TRUE(mem->Get(LookupKey("k", 2), &value, &s, &max_covering_tombstone_seq,
+                         &merge_context2));
+    ASSERT_TRUE(s.IsInvalidArgument());
+    ASSERT_EQ("v", Get({mem}, "k", 1));
+    ASSERT_EQ("v", Get({mem}, "j", 3));
+    mem->Unref();
+}
+
+INSTANTIATE_TEST_SUITE_P(Reps, MemTableTest,
+                         testing::Values(kSkipListMemTableRep, kHashMemTableRep,
+                                         kVectorMemTableRep));
+
+}  // namespace leveldb
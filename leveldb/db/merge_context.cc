@@ -0,0 +1,21 @@
+#include "db/merge_context.h"
+
+#include "leveldb/merge_operator.h"
+
+namespace leveldb {
+
+Status MergeContext::Merge(const MergeOperator* merge_operator, const Slice& user_key,
+                           const Slice* existing_value, std::string* value) const {
+    if (merge_operator == nullptr) {
+        return Status::InvalidArgument("merge operand found, but no merge_operator is set");
+    }
+    std::vector<Slice> operands(operands_.rbegin(), operands_.rend());
+    std::string result;
+    if (!merge_operator->FullMerge(user_key, existing_value, operands, &result)) {
+        return Status::Corruption("merge failed for", user_key);
+    }
+    value->swap(result);
+    return Status::OK();
+}
+
+}  // namespace leveldb
@@ -0,0 +1,43 @@
+#ifndef STORAGE_LEVELDB_DB_MERGE_CONTEXT_H_
+#define STORAGE_LEVELDB_DB_MERGE_CONTEXT_H_
+
+#include <string>
+#include <vector>
+
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+class MergeOperator;
+
+// the merge operands of a key that a point lookup has come across so far,
+// while it goes from the newest memtable to the oldest table. The operands
+// are copied, since the memtable or block they were read from may be gone
+// by the time the lookup reaches the value they apply to.
+class MergeContext {
+public:
+    MergeContext() = default;
+
+    MergeContext(const MergeContext&) = delete;
+    MergeContext& operator=(const MergeContext&) = delete;
+
+    // REQUIRES: "operand" is older than the operands pushed before it
+    void PushOperand(const Slice& operand) {
+        operands_.emplace_back(operand.data(), operand.size());
+    }
+
+    bool empty() const { return operands_.empty(); }
+
+    // combines the operands with "existing_value", nullptr if the key has
+    // no older value, into *value. "existing_value" may point into *value.
+    Status Merge(const MergeOperator* merge_operator, const Slice& user_key,
+                 const Slice* existing_value, std::string* value) const;
+
+private:
+    std::vector<std::string> operands_;  // newest first
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_MERGE_CONTEXT_H_
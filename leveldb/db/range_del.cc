@@ -0,0 +1,126 @@
+#include "db/range_del.h"
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+#include "leveldb/comparator.h"
+#include "leveldb/iterator.h"
+#include "util/coding.h"
+
+namespace leveldb {
+
+static SequenceNumber TombstoneSeq(const Slice& begin) {
+    return DecodeFixed64(begin.data() + begin.size() - 8) >> 8;
+}
+
+void FragmentRangeTombstones(Iterator* iter, const Comparator* ucmp,
+                             std::vector<RangeTombstone>* fragments) {
+    // the tombstones come ordered by begin key
+    std::vector<RangeTombstone> tombstones;
+    std::vector<std::string> bounds;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+        const Slice begin = iter->key();
+        if (begin.size() < 8 || ucmp->Compare(ExtractUserKey(begin), iter->value()) >= 0) {
+            continue;
+        }
+        tombstones.push_back(RangeTombstone{ExtractUserKey(begin).ToString(),
+                                            iter->value().ToString(), TombstoneSeq(begin)});
+        bounds.push_back(tombstones.back().begin);
+        bounds.push_back(tombstones.back().end);
+    }
+    auto less = [ucmp](const std::string& a, const std::string& b) {
+        return ucmp->Compare(a, b) < 0;
+    };
+    auto equal = [ucmp](const std::string& a, const std::string& b) {
+        return ucmp->Compare(a, b) == 0;
+    };
+    std::sort(bounds.begin(), bounds.end(), less);
+    bounds.erase(std::unique(bounds.begin(), bounds.end(), equal), bounds.end());
+
+    // sweep the bounds, keeping the tombstones that cover the fragment
+    // starting at each one
+    std::vector<const RangeTombstone*> active;
+    std::vector<SequenceNumber> seqs;
+    size_t next = 0;
+    for (size_t i = 0; i + 1 < bounds.size(); i++) {
+        const std::string& begin = bounds[i];
+        while (next < tombstones.size() && ucmp->Compare(tombstones[next].begin, begin) <= 0) {
+            active.push_back(&tombstones[next++]);
+        }
+        active.erase(std::remove_if(active.begin(), active.end(),
+                                    [ucmp, &begin](const RangeTombstone* t) {
+                                        return ucmp->Compare(t->end, begin) <= 0;
+                                    }),
+                     active.end());
+        seqs.clear();
+        for (const RangeTombstone* t : active) {
+            seqs.push_back(t->seq);
+        }
+        // newest first, as in internal key order
+        std::sort(seqs.begin(), seqs.end(), std::greater<SequenceNumber>());
+        seqs.erase(std::unique(seqs.begin(), seqs.end()), seqs.end());
+        for (SequenceNumber seq : seqs) {
+            fragments->push_back(RangeTombstone{begin, bounds[i + 1], seq});
+        }
+    }
+}
+
+SequenceNumber MaxCoveringTombstoneSeq(Iterator* iter, const Comparator* ucmp,
+                                       const Slice& user_key, SequenceNumber snapshot) {
+    // only the fragment that begins last at or before user_key can cover
+    // it. its entries come right before the first tombstone past user_key,
+    // which sorts after the smallest possible internal key of user_key.
+    const InternalKey target(user_key, 0, kTypeDeletion);
+    iter->Seek(target.Encode());
+    if (iter->Valid()) {
+        iter->Prev();
+    } else {
+        iter->SeekToLast();
+    }
+    if (!iter->Valid() || iter->key().size() < 8 || ucmp->Compare(user_key, iter->value()) >= 0) {
+        return 0;
+    }
+
+    // the entries of the fragment, oldest first from here on
+    const std::string fragment_begin = ExtractUserKey(iter->key()).ToString();
+    SequenceNumber max_seq = 0;
+    for (; iter->Valid(); iter->Prev()) {
+        const Slice begin = iter->key();
+        if (begin.size() < 8 || ucmp->Compare(ExtractUserKey(begin), fragment_begin) != 0) {
+            break;
+        }
+        const SequenceNumber seq = TombstoneSeq(begin);
+        if (seq > snapshot) {
+            break;
+        }
+        max_seq = seq;
+    }
+    return max_seq;
+}
+
+FragmentedRangeTombstoneList::FragmentedRangeTombstoneList(Iterator* iter,
+                                                           const Comparator* icmp,
+                                                           const Comparator* ucmp)
+    : icmp_(icmp) {
+    std::vector<RangeTombstone> fragments;
+    FragmentRangeTombstones(iter, ucmp, &fragments);
+    begins_.reserve(fragments.size());
+    ends_.reserve(fragments.size());
+    for (RangeTombstone& fragment : fragments) {
+        begins_.push_back(
+                InternalKey(fragment.begin, fragment.seq, kTypeRangeDeletion).Encode().ToString());
+        ends_.push_back(std::move(fragment.end));
+    }
+}
+
+void FragmentedRangeTombstoneIterator::Seek(const Slice& target) {
+    const Comparator* icmp = list_->icmp_;
+    pos_ = std::lower_bound(list_->begins_.begin(), list_->begins_.end(), target,
+                            [icmp](const std::string& begin, const Slice& t) {
+                                return icmp->Compare(begin, t) < 0;
+                            }) -
+           list_->begins_.begin();
+}
+
+}  // namespace leveldb
@@ -0,0 +1,98 @@
+#ifndef STORAGE_LEVELDB_DB_RANGE_DEL_H_
+#define STORAGE_LEVELDB_DB_RANGE_DEL_H_
+
+#include <string>
+#include <vector>
+
+#include "db/dbformat.h"
+#include "leveldb/iterator.h"
+
+namespace leveldb {
+
+class Comparator;
+
+// range tombstones, written by DB::DeleteRange(), are stored as entries
+// whose internal key is the begin key of the range with type
+// kTypeRangeDeletion and whose value is the user key the range ends
+// before. A memtable keeps them in a rep of their own and a table in its
+// "leveldb.range_del" meta block, both in internal key order, i.e. ordered
+// by begin key. Ranges that are empty, with an end key not past the begin
+// key, are never stored.
+//
+// a tombstone with sequence number s hides every entry of a key in its
+// range whose sequence number is below s, from readers at snapshots at or
+// above s.
+//
+// the tombstones of a memtable may overlap. Those of a table are split into
+// fragments first (see FragmentRangeTombstones()): any two fragments either
+// cover the same range, and only differ in their sequence numbers, or do
+// not overlap at all. A memtable looks up the fragments of its tombstones
+// too (see FragmentedRangeTombstoneList).
+
+struct RangeTombstone {
+    std::string begin;  // user keys
+    std::string end;
+    SequenceNumber seq;
+};
+
+// reads the tombstones of "iter", in internal key order, and appends them
+// to *fragments split into fragments, also in internal key order. Empty
+// ranges are skipped.
+void FragmentRangeTombstones(Iterator* iter, const Comparator* ucmp,
+                             std::vector<RangeTombstone>* fragments);
+
+// returns the largest sequence number, at most "snapshot", of the range
+// tombstones in "iter" that cover "user_key", or 0 if none does.
+// REQUIRES: the tombstones in "iter" are fragments, as in a table
+SequenceNumber MaxCoveringTombstoneSeq(Iterator* iter, const Comparator* ucmp,
+                                       const Slice& user_key, SequenceNumber snapshot);
+
+// the fragments of tombstones that may overlap, held in memory in the
+// format of the tombstones of a table, so that MaxCoveringTombstoneSeq()
+// finds the ones covering a key with a binary search. A memtable keeps one,
+// rebuilt once tombstones were added since.
+class FragmentedRangeTombstoneList {
+public:
+    // fragments the tombstones of "iter". "icmp" orders their internal keys,
+    // "ucmp" the user keys
+    FragmentedRangeTombstoneList(Iterator* iter, const Comparator* icmp,
+                                 const Comparator* ucmp);
+
+    FragmentedRangeTombstoneList(const FragmentedRangeTombstoneList&) = delete;
+    FragmentedRangeTombstoneList& operator=(const FragmentedRangeTombstoneList&) = delete;
+
+    bool empty() const { return begins_.empty(); }
+
+private:
+    friend class FragmentedRangeTombstoneIterator;
+
+    const Comparator* const icmp_;
+    std::vector<std::string> begins_;  // internal keys, in order
+    std::vector<std::string> ends_;    // user keys
+};
+
+// iterates over the fragments of "list", which must outlive the iterator.
+// Cheap enough to construct on the stack for every lookup.
+class FragmentedRangeTombstoneIterator : public Iterator {
+public:
+    explicit FragmentedRangeTombstoneIterator(const FragmentedRangeTombstoneList* list)
+        : list_(list), pos_(list->begins_.size()) {}
+
+    bool Valid() const override { return pos_ < list_->begins_.size(); }
+    void SeekToFirst() override { pos_ = 0; }
+    void SeekToLast() override { pos_ = list_->begins_.empty() ? 0 : list_->begins_.size() - 1; }
+    void Seek(const Slice& target) override;
+    void Next() override { pos_++; }
+    void Prev() override { pos_ = (pos_ == 0) ? list_->begins_.size() : pos_ - 1; }
+    Slice key() const override { return list_->begins_[pos_]; }
+    Slice value() const override { return list_->ends_[pos_]; }
+    Status status() const override { return Status::OK(); }
+
+private:
+    const FragmentedRangeTombstoneList* const list_;
+    size_t pos_;  // list_->begins_.size() if not valid
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_RANGE_DEL_H_
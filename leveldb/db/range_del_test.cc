@@ -0,0 +1,189 @@
+#include "db/range_del.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "db/memtable.h"
+#include "leveldb/comparator.h"
+#include "leveldb/iterator.h"
+#include "util/random.h"
+
+namespace leveldb {
+
+class RangeDelTest : public testing::Test {
+public:
+    RangeDelTest() : cmp_(BytewiseComparator()), mem_(NewMemTable()), fragmented_(nullptr) {}
+
+    ~RangeDelTest() override {
+        mem_->Unref();
+        if (fragmented_ != nullptr) {
+            fragmented_->Unref();
+        }
+    }
+
+    MemTable* NewMemTable() {
+        MemTable* mem = new MemTable(cmp_, false, nullptr);
+        mem->Ref();
+        return mem;
+    }
+
+    void DeleteRange(SequenceNumber seq, const std::string& begin, const std::string& end) {
+        mem_->Add(seq, kTypeRangeDeletion, begin, end);
+    }
+
+    // fragments the tombstones added so far, as "begin-end@seq,...", and
+    // keeps them in fragmented_ the way a table would
+    std::string Fragment() {
+        std::vector<RangeTombstone> fragments;
+        Iterator* iter = mem_->NewRangeTombstoneIterator();
+        if (iter != nullptr) {
+            FragmentRangeTombstones(iter, BytewiseComparator(), &fragments);
+            delete iter;
+        }
+        fragmented_ = NewMemTable();
+        std::string result;
+        for (const RangeTombstone& t : fragments) {
+            fragmented_->Add(t.seq, kTypeRangeDeletion, t.begin, t.end);
+            if (!result.empty()) {
+                result += ",";
+            }
+            result += t.begin + "-" + t.end + "@" + std::to_string(t.seq);
+        }
+        return result;
+    }
+
+    // what covers "key" at "snapshot" among the tombstones as added, by
+    // looking at all of them, among their fragments, and among the
+    // fragments a memtable keeps for lookups
+    SequenceNumber Covering(const std::string& key, SequenceNumber snapshot) {
+        Iterator* iter = mem_->NewRangeTombstoneIterator();
+        if (iter == nullptr) {
+            return 0;
+        }
+        SequenceNumber max_seq = 0;
+        for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+            ParsedInternalKey begin;
+            EXPECT_TRUE(ParseInternalKey(iter->key(), &begin));
+            if (begin.user_key.ToString() <= key && key < iter->value().ToString() &&
+                begin.sequence <= snapshot) {
+                max_seq = std::max(max_seq, begin.sequence);
+            }
+        }
+        delete iter;
+        return max_seq;
+    }
+
+    SequenceNumber ListCovering(const std::string& key, SequenceNumber snapshot) {
+        Iterator* iter = mem_->NewRangeTombstoneIterator();
+        if (iter == nullptr) {
+            return 0;
+        }
+        FragmentedRangeTombstoneList list(iter, &cmp_, BytewiseComparator());
+        delete iter;
+        FragmentedRangeTombstoneIterator fragments(&list);
+        return MaxCoveringTombstoneSeq(&fragments, BytewiseComparator(), key, snapshot);
+    }
+
+    // whether a lookup of "key" at "snapshot" in the memtable finds it
+    // deleted by a tombstone
+    bool GetDeleted(const std::string& key, SequenceNumber snapshot) {
+        LookupKey lkey(key, snapshot);
+        std::string value;
+        Status s;
+        SequenceNumber max_covering_tombstone_seq = 0;
+        MergeContext merge_context;
+        return mem_->Get(lkey, &value, &s, &max_covering_tombstone_seq, &merge_context) &&
+               s.IsNotFound();
+    }
+
+    SequenceNumber FragmentCovering(const std::string& key, SequenceNumber snapshot) {
+        Iterator* iter = fragmented_->NewRangeTombstoneIterator();
+        if (iter == nullptr) {
+            return 0;
+        }
+        const SequenceNumber seq =
+                MaxCoveringTombstoneSeq(iter, BytewiseComparator(), key, snapshot);
+        delete iter;
+        return seq;
+    }
+
+    InternalKeyComparator cmp_;
+    MemTable* mem_;
+    MemTable* fragmented_;
+};
+
+TEST_F(RangeDelTest, Empty) {
+    ASSERT_EQ("", Fragment());
+    ASSERT_EQ(0, Covering("a", 100));
+    ASSERT_EQ(0, FragmentCovering("a", 100));
+}
+
+TEST_F(RangeDelTest, EmptyRangesAreDropped) {
+    DeleteRange(1, "b", "b");
+    DeleteRange(2, "d", "c");
+    ASSERT_EQ(nullptr, mem_->NewRangeTombstoneIterator());
+    DeleteRange(3, "c", "d");
+    ASSERT_EQ("c-d@3", Fragment());
+    ASSERT_EQ(0, Covering("b", 100));
+    ASSERT_EQ(3, Covering("c", 100));
+    ASSERT_EQ(0, Covering("d", 100));
+}
+
+TEST_F(RangeDelTest, Fragments) {
+    DeleteRange(1, "a", "e");
+    DeleteRange(2, "c", "g");
+    DeleteRange(3, "c", "d");
+    DeleteRange(4, "h", "j");
+    ASSERT_EQ("a-c@1,c-d@3,c-d@2,c-d@1,d-e@2,d-e@1,e-g@2,h-j@4", Fragment());
+
+    ASSERT_EQ(1, FragmentCovering("a", 100));
+    ASSERT_EQ(1, FragmentCovering("b", 100));
+    ASSERT_EQ(3, FragmentCovering("c", 100));
+    ASSERT_EQ(2, FragmentCovering("c", 2));
+    ASSERT_EQ(1, FragmentCovering("c", 1));
+    ASSERT_EQ(0, FragmentCovering("c", 0));
+    ASSERT_EQ(2, FragmentCovering("dd", 100));
+    ASSERT_EQ(2, FragmentCovering("f", 100));
+    ASSERT_EQ(0, FragmentCovering("g", 100));
+    ASSERT_EQ(4, FragmentCovering("i", 100));
+    ASSERT_EQ(0, FragmentCovering("j", 100));
+    ASSERT_EQ(0, FragmentCovering("0", 100));
+}
+
+TEST_F(RangeDelTest, FragmentsCoverTheSameKeys) {
+    Random rnd(301);
+    for (SequenceNumber seq = 1; seq <= 200; seq++) {
+        const int begin = rnd.Uniform(1000);
+        DeleteRange(seq, std::to_string(10000 + begin),
+                    std::to_string(10000 + begin + rnd.Uniform(100)));
+    }
+    Fragment();
+    for (int i = 0; i < 1000; i++) {
+        const std::string key = std::to_string(9990 + rnd.Uniform(1200));
+        const SequenceNumber snapshot = rnd.Uniform(220);
+        ASSERT_EQ(Covering(key, snapshot), FragmentCovering(key, snapshot))
+                << key << " at " << snapshot;
+        ASSERT_EQ(Covering(key, snapshot), ListCovering(key, snapshot))
+                << key << " at " << snapshot;
+    }
+}
+
+TEST_F(RangeDelTest, MemTableLookupsSeeNewTombstones) {
+    // the fragments a memtable keeps are rebuilt once tombstones are added
+    Random rnd(301);
+    for (SequenceNumber seq = 1; seq <= 100; seq++) {
+        const int begin = rnd.Uniform(1000);
+        DeleteRange(seq, std::to_string(10000 + begin),
+                    std::to_string(10000 + begin + rnd.Uniform(100)));
+        for (int i = 0; i < 20; i++) {
+            const std::string key = std::to_string(9990 + rnd.Uniform(1200));
+            const SequenceNumber snapshot = rnd.Uniform(120);
+            ASSERT_EQ(Covering(key, snapshot) > 0, GetDeleted(key, snapshot))
+                    << key << " at " << snapshot;
+        }
+    }
+}
+
+}  // namespace leveldb
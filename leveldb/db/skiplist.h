@@ -1,7 +1,9 @@
 #ifndef STORAGE_LEVELDB_DB_SKIPLIST_H_
 #define STORAGE_LEVELDB_DB_SKIPLIST_H_
 
+#include <algorithm>
 #include <atomic>
+#include <cstdint>
 #include <cstdlib>
 #include <cassert>
 
@@ -10,13 +12,39 @@
 
 namespace leveldb {
 
-class Arena; 
+class Arena;
+
+namespace skiplist_internal {
+
+// a comparator may let the list keep an 8 byte prefix code of every key in
+// its node by providing
+//
+//     uint64_t KeyPrefix(const Key& key) const;
+//
+// which must order keys like the comparator does wherever codes differ:
+// KeyPrefix(a) < KeyPrefix(b) implies compare(a, b) < 0. Nodes whose code
+// differs from the searched key's are then ordered without touching the
+// key itself. without KeyPrefix() every key gets the same code.
+template <class Comparator, typename Key>
+inline auto KeyPrefix(const Comparator& cmp, const Key& key, int)
+        -> decltype(cmp.KeyPrefix(key)) {
+    return cmp.KeyPrefix(key);
+}
+
+template <class Comparator, typename Key>
+inline uint64_t KeyPrefix(const Comparator&, const Key&, long) {
+    return 0;
+}
+
+}  // namespace skiplist_internal
 
 template <typename Key, class Comparator>
 class SkipList {
 private:
     struct Node;
 
+    enum { kMaxHeight = 12 };
+
 public:
     // create a new SkipList object that will use "cmp" for comparing keys,
     // and will allocate memory using "*arena". Objects allocated in the arena
@@ -30,6 +58,34 @@ public:
     // REQUIRES: nothing that compares equal to key is currently in the list
     void Insert(const Key& key);
 
+    // like Insert(), but may be called by several threads at once, and
+    // concurrently with readers. requires that the arena allocates in
+    // concurrent mode.
+    // REQUIRES: nothing that compares equal to key is currently in the list,
+    // or is being inserted concurrently
+    void InsertConcurrently(const Key& key);
+
+    // remembers where the last insert through it went, so an insert of a
+    // key close after it can start its search there instead of at the head
+    // of the list. keys inserted in increasing order then take about
+    // constant time each. a hint may only be used with one list and by one
+    // thread at a time.
+    class Hint {
+    public:
+        Hint() : height_(0) {}
+
+    private:
+        friend class SkipList;
+
+        int height_;               // levels of prev_ that are set
+        Node* prev_[kMaxHeight];  // node before the last inserted key, per level
+    };
+
+    // like Insert() and InsertConcurrently(), but the search for the
+    // insert position starts from *hint, which is updated to the new key.
+    void Insert(const Key& key, Hint* hint);
+    void InsertConcurrently(const Key& key, Hint* hint);
+
     bool Contains(const Key& key) const;
 
     class Iterator {
@@ -55,18 +111,45 @@ public:
     };
 
 private:
-    enum { kMaxHeight = 12 };
-
     inline int GetMaxHeight() const {
         return max_height_.load(std::memory_order_relaxed);
     }
 
-    Node* NewNode(const Key& key, int height);
-    int RandomHeight();
+    Node* NewNode(const Key& key, int height, uint64_t prefix);
+    int RandomHeight(Random* rnd);
+
+    // draws the height of a node to insert concurrently and raises
+    // max_height_ to it if needed
+    int ConcurrentRandomHeight();
+
     bool Equal(const Key& a, const Key& b) const { return (compare_(a, b) == 0); }
 
+    uint64_t KeyPrefix(const Key& key) const {
+        return skiplist_internal::KeyPrefix(compare_, key, 0);
+    }
+
+    // compares the key of n with key, whose prefix code is key_prefix.
+    // the key of n is only read if the prefix codes are equal.
+    int CompareNode(Node* n, const Key& key, uint64_t key_prefix) const {
+        if (n->prefix != key_prefix) {
+            return (n->prefix < key_prefix) ? -1 : +1;
+        }
+        return compare_(n->key, key);
+    }
+
+    // hint the cache about the node that follows n at "level", which is
+    // where the search goes next if it moves past n
+    static void PrefetchNext(Node* n, int level) {
+#if defined(__GNUC__) || defined(__clang__)
+        __builtin_prefetch(n->NoBarrier_Next(level));
+#else
+        (void)n;
+        (void)level;
+#endif
+    }
+
     // return true if the key is greater than the data store in n
-    bool KeyIsAfterNode(const Key& key, Node* n) const;
+    bool KeyIsAfterNode(const Key& key, uint64_t key_prefix, Node* n) const;
 
     // return the earliest node that comes at or after key.
     // return nullptr if there is no such node
@@ -75,6 +158,23 @@ private:
     // node at "level" for every level in [0 .. max_height_-1].
     Node* FindGreaterOrEqual(const Key& key, Node** prev) const;
 
+    // starting at "before", which must come before key, walk along "level"
+    // and store in *prev and *next the pair of adjacent nodes at that level
+    // between which key belongs.
+    void FindSpliceForLevel(const Key& key, uint64_t key_prefix, Node* before,
+                            int level, Node** prev, Node** next) const;
+
+    // fills prev[level] and next[level] for every level in
+    // [0 .. max_height_-1] with the adjacent nodes between which key
+    // belongs, starting the search from the positions in *hint.
+    void FindSpliceWithHint(const Key& key, uint64_t key_prefix, Hint* hint,
+                            Node** prev, Node** next) const;
+
+    // links x, of the given height, in between prev[i] and next[i] at
+    // every level below height, retrying against concurrent inserts.
+    void LinkConcurrently(Node* x, int height, uint64_t key_prefix,
+                          Node** prev, Node** next);
+
     // return the latest node with a key < key
     // return head_ if there is no such node
     Node* FindLessThan(const Key& key) const;
@@ -94,10 +194,13 @@ private:
 // Implementation detail follow
 
 /***** Node *****/
+// the key prefix code sits between the key and the links, so a search that
+// follows a link finds the code it compares against on the same cache line.
 template <typename Key, class Comparator>
 struct SkipList<Key, Comparator>::Node {
-    explicit Node(const Key& k) : key(k) {}
+    Node(const Key& k, uint64_t p) : key(k), prefix(p) {}
     Key const key;
+    uint64_t const prefix;  // KeyPrefix(key)
 
     // accessors/mutators for links. Wrapped in methods so we can add 
     // the appropriate barriers as necessary.
@@ -124,16 +227,25 @@ struct SkipList<Key, Comparator>::Node {
         next_[n].store(x, std::memory_order_relaxed);
     }
 
+    // link x in at level n if the link still points at "expected". the
+    // successful exchange has release semantics like SetNext().
+    bool CASNext(int n, Node* expected, Node* x) {
+        assert(n >= 0);
+        return next_[n].compare_exchange_strong(expected, x,
+                                                std::memory_order_release,
+                                                std::memory_order_relaxed);
+    }
+
 private:
     std::atomic<Node*> next_[1];
 };
 
 template <typename Key, class Comparator>
 typename SkipList<Key, Comparator>::Node* SkipList<Key,Comparator>::NewNode(
-        const Key& key, int height) {
+        const Key& key, int height, uint64_t prefix) {
     char* const node_memory = arena_->AllocateAligned(
             sizeof(Node) + sizeof(std::atomic<Node*>) * (height - 1));
-    return new (node_memory) Node(key);
+    return new (node_memory) Node(key, prefix);
 }
 
 /***** Iterator *****/
@@ -190,11 +302,11 @@ inline void SkipList<Key, Comparator>::Iterator::SeekToLast() {
 
 /***** Others *****/
 template <typename Key, class Comparator>
-int SkipList<Key, Comparator>::RandomHeight() {
+int SkipList<Key, Comparator>::RandomHeight(Random* rnd) {
     // increase height with probability 1 in kBranching
     static const unsigned int kBranching = 4;
     int height = 1;
-    while (height < kMaxHeight && ((rnd_.Next() % kBranching) == 0)) {
+    while (height < kMaxHeight && ((rnd->Next() % kBranching) == 0)) {
         height++;
     }
     assert(height > 0);
@@ -203,19 +315,24 @@ int SkipList<Key, Comparator>::RandomHeight() {
 }
 
 template <typename Key, class Comparator>
-bool SkipList<Key, Comparator>::KeyIsAfterNode(const Key& key, Node* n) const {
+bool SkipList<Key, Comparator>::KeyIsAfterNode(const Key& key, uint64_t key_prefix,
+                                               Node* n) const {
     // null n is considered infinite
-    return (n != nullptr) && (compare_(n->key, key) < 0);
+    return (n != nullptr) && (CompareNode(n, key, key_prefix) < 0);
 }
 
 template <typename Key, class Comparator>
 typename SkipList<Key, Comparator>::Node*
 SkipList<Key, Comparator>::FindGreaterOrEqual(const Key& key, Node** prev) const {
+    const uint64_t key_prefix = KeyPrefix(key);
     Node* x = head_;
     int level = GetMaxHeight() - 1;
     while (true) {
         Node* next = x->Next(level);
-        if (KeyIsAfterNode(key, next)) {
+        if (next != nullptr) {
+            PrefetchNext(next, level);
+        }
+        if (KeyIsAfterNode(key, key_prefix, next)) {
             // keep searching in this list
             x = next;
         } else {
@@ -230,15 +347,36 @@ SkipList<Key, Comparator>::FindGreaterOrEqual(const Key& key, Node** prev) const
     }
 }
 
+template <typename Key, class Comparator>
+void SkipList<Key, Comparator>::FindSpliceForLevel(const Key& key, uint64_t key_prefix,
+                                                   Node* before, int level,
+                                                   Node** prev, Node** next) const {
+    Node* x = before;
+    while (true) {
+        Node* n = x->Next(level);
+        if (n != nullptr) {
+            PrefetchNext(n, level);
+        }
+        if (KeyIsAfterNode(key, key_prefix, n)) {
+            x = n;
+        } else {
+            *prev = x;
+            *next = n;
+            return;
+        }
+    }
+}
+
 template <typename Key, class Comparator>
 typename SkipList<Key, Comparator>::Node*
 SkipList<Key, Comparator>::FindLessThan(const Key& key) const {
+    const uint64_t key_prefix = KeyPrefix(key);
     Node* x = head_;
     int level = GetMaxHeight() - 1;
     while (true) {
         assert(x == head_ || compare_(x->key, key) < 0);
         Node* next = x->Next(level);
-        if (next == nullptr || compare_(next->key, key) > 0) {
+        if (next == nullptr || CompareNode(next, key, key_prefix) >= 0) {
             if (level == 0) {
                 return x;
             } else {
@@ -270,10 +408,10 @@ SkipList<Key, Comparator>::FindLast() const {
 }
 
 template <typename Key, class Comparator>
-SkipList<Key, Comparator>::SkipList(Comparator cmp, Arena arena)
+SkipList<Key, Comparator>::SkipList(Comparator cmp, Arena* arena)
     : compare_(cmp),
       arena_(arena),
-      head_(NewNode(0/* any key will do */, kMaxHeight)),
+      head_(NewNode(0/* any key will do */, kMaxHeight, 0/* never compared */)),
       max_height_(1),
       rnd_(0xdeadbeef) {
     for (int i = 0; i < kMaxHeight; i++) {
@@ -290,7 +428,7 @@ void SkipList<Key, Comparator>::Insert(const Key& key) {
     // our data structure does not allow duplicate insertion
     assert(x == nullptr || !Equal(key, x->key));
 
-    int height = RandomHeight();
+    int height = RandomHeight(&rnd_);
     if (height > GetMaxHeight()) {
         for (int i = GetMaxHeight(); i < height; i++) {
             prev[i] = head_;
@@ -298,13 +436,175 @@ void SkipList<Key, Comparator>::Insert(const Key& key) {
         max_height_.store(height, std::memory_order_relaxed);
     }
 
-    x = NewNode(key, height);
+    x = NewNode(key, height, KeyPrefix(key));
     for (int i = 0; i < height; i++) {
         x->NoBarrier_SetNext(i, prev[i]->NoBarrier_Next(i));
         prev[i]->SetNext(i, x);
     }
 }
 
+template <typename Key, class Comparator>
+int SkipList<Key, Comparator>::ConcurrentRandomHeight() {
+    // rnd_ is only safe to use under external synchronization, so every
+    // inserting thread draws heights from its own generator.
+    static std::atomic<uint32_t> next_seed(0xdeadbeef);
+    static thread_local Random rnd(next_seed.fetch_add(1, std::memory_order_relaxed));
+    int height = RandomHeight(&rnd);
+
+    // publish the new height first. a reader that sees it before the new
+    // node is linked in just finds nullptr links from head_ at the new
+    // levels, same as in Insert().
+    int max_height = GetMaxHeight();
+    while (height > max_height) {
+        if (max_height_.compare_exchange_weak(max_height, height,
+                                              std::memory_order_relaxed)) {
+            break;
+        }
+    }
+    return height;
+}
+
+// INSERT CONCURRENTLY
+template <typename Key, class Comparator>
+void SkipList<Key, Comparator>::InsertConcurrently(const Key& key) {
+    const int height = ConcurrentRandomHeight();
+
+    // compute the splice at every level from the top down, each level
+    // starting at the predecessor found one level up.
+    const uint64_t key_prefix = KeyPrefix(key);
+    Node* prev[kMaxHeight];
+    Node* next[kMaxHeight];
+    Node* before = head_;
+    for (int i = GetMaxHeight() - 1; i >= 0; i--) {
+        FindSpliceForLevel(key, key_prefix, before, i, &prev[i], &next[i]);
+        before = prev[i];
+    }
+
+    // our data structure does not allow duplicate insertion
+    assert(next[0] == nullptr || !Equal(key, next[0]->key));
+
+    LinkConcurrently(NewNode(key, height, key_prefix), height, key_prefix, prev, next);
+}
+
+template <typename Key, class Comparator>
+void SkipList<Key, Comparator>::LinkConcurrently(Node* x, int height,
+                                                 uint64_t key_prefix,
+                                                 Node** prev, Node** next) {
+    // link from the bottom up, level 0 being the point at which the key
+    // becomes visible. if another writer got in between prev[i] and next[i]
+    // first, prev[i] still comes before key, so search again from there.
+    for (int i = 0; i < height; i++) {
+        while (true) {
+            x->NoBarrier_SetNext(i, next[i]);
+            if (prev[i]->CASNext(i, next[i], x)) {
+                break;
+            }
+            FindSpliceForLevel(x->key, key_prefix, prev[i], i, &prev[i], &next[i]);
+        }
+    }
+}
+
+template <typename Key, class Comparator>
+void SkipList<Key, Comparator>::FindSpliceWithHint(const Key& key,
+                                                   uint64_t key_prefix,
+                                                   Hint* hint, Node** prev,
+                                                   Node** next) const {
+    const int max_height = GetMaxHeight();
+    // levels the list grew since the hint was last used start at head_
+    for (int i = hint->height_; i < max_height; i++) {
+        hint->prev_[i] = head_;
+    }
+    hint->height_ = std::max(hint->height_, max_height);
+
+    // the hinted nodes are ordered: prev_[i + 1] never comes after
+    // prev_[i]. so once prev_[level] is directly before key at "level",
+    // the hinted nodes of all levels above come before key as well.
+    int level = 0;
+    for (; level < max_height; level++) {
+        Node* before = hint->prev_[level];
+        if (before != head_ && CompareNode(before, key, key_prefix) >= 0) {
+            continue;
+        }
+        if (!KeyIsAfterNode(key, key_prefix, before->Next(level))) {
+            break;
+        }
+    }
+
+    Node* before;
+    if (level < max_height) {
+        for (int i = max_height - 1; i > level; i--) {
+            FindSpliceForLevel(key, key_prefix, hint->prev_[i], i, &prev[i], &next[i]);
+        }
+        before = hint->prev_[level];
+    } else {
+        // the hint is no help, search from the top
+        level = max_height - 1;
+        before = hint->prev_[level];
+        if (before != head_ && CompareNode(before, key, key_prefix) >= 0) {
+            before = head_;
+        }
+    }
+    for (int i = level; i >= 0; i--) {
+        FindSpliceForLevel(key, key_prefix, before, i, &prev[i], &next[i]);
+        before = prev[i];
+    }
+}
+
+// INSERT WITH HINT
+template <typename Key, class Comparator>
+void SkipList<Key, Comparator>::Insert(const Key& key, Hint* hint) {
+    const uint64_t key_prefix = KeyPrefix(key);
+    Node* prev[kMaxHeight];
+    Node* next[kMaxHeight];
+    FindSpliceWithHint(key, key_prefix, hint, prev, next);
+
+    // our data structure does not allow duplicate insertion
+    assert(next[0] == nullptr || !Equal(key, next[0]->key));
+
+    int height = RandomHeight(&rnd_);
+    if (height > GetMaxHeight()) {
+        for (int i = GetMaxHeight(); i < height; i++) {
+            prev[i] = head_;
+        }
+        max_height_.store(height, std::memory_order_relaxed);
+    }
+
+    Node* x = NewNode(key, height, key_prefix);
+    for (int i = 0; i < height; i++) {
+        x->NoBarrier_SetNext(i, prev[i]->NoBarrier_Next(i));
+        prev[i]->SetNext(i, x);
+    }
+
+    // the next key most likely goes right after this one
+    const int hint_height = std::max(hint->height_, height);
+    for (int i = 0; i < hint_height; i++) {
+        hint->prev_[i] = (i < height) ? x : prev[i];
+    }
+    hint->height_ = hint_height;
+}
+
+// INSERT CONCURRENTLY WITH HINT
+template <typename Key, class Comparator>
+void SkipList<Key, Comparator>::InsertConcurrently(const Key& key, Hint* hint) {
+    const int height = ConcurrentRandomHeight();
+    const uint64_t key_prefix = KeyPrefix(key);
+    Node* prev[kMaxHeight];
+    Node* next[kMaxHeight];
+    FindSpliceWithHint(key, key_prefix, hint, prev, next);
+
+    // our data structure does not allow duplicate insertion
+    assert(next[0] == nullptr || !Equal(key, next[0]->key));
+
+    Node* x = NewNode(key, height, key_prefix);
+    LinkConcurrently(x, height, key_prefix, prev, next);
+
+    // the splice is computed over the height at the time of the search,
+    // which covers the new node's levels since its height was published first
+    for (int i = 0; i < hint->height_; i++) {
+        hint->prev_[i] = (i < height) ? x : prev[i];
+    }
+}
+
 // CONTAINS
 template <typename Key, class Comparator>
 bool SkipList<Key, Comparator>::Contains(const Key& key) const {
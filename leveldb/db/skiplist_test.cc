@@ -0,0 +1,234 @@
+#include "db/skiplist.h"
+
+#include <atomic>
+#include <cstring>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "util/arena.h"
+#include "util/random.h"
+
+namespace leveldb {
+
+typedef uint64_t Key;
+
+struct Comparator {
+    int operator()(const Key& a, const Key& b) const {
+        if (a < b) {
+            return -1;
+        } else if (a > b) {
+            return +1;
+        } else {
+            return 0;
+        }
+    }
+};
+
+// orders c strings, and gives each the code of its first 8 bytes, the way
+// the memtable does for its entries. the code dereferences the key.
+struct PrefixComparator {
+    int operator()(const char* a, const char* b) const { return std::strcmp(a, b); }
+
+    uint64_t KeyPrefix(const char* key) const {
+        uint64_t code = 0;
+        for (int i = 0; i < 8 && key[i] != '\0'; i++) {
+            code |= static_cast<uint64_t>(static_cast<unsigned char>(key[i])) << (56 - 8 * i);
+        }
+        return code;
+    }
+};
+
+// checks that "list" holds exactly "keys", in order, both by iteration and
+// by lookup
+template <class List>
+static void CheckContents(const List& list, const std::set<Key>& keys) {
+    typename List::Iterator iter(&list);
+    iter.SeekToFirst();
+    for (Key k : keys) {
+        ASSERT_TRUE(iter.Valid());
+        ASSERT_EQ(k, iter.key());
+        ASSERT_TRUE(list.Contains(k));
+        iter.Next();
+    }
+    ASSERT_TRUE(!iter.Valid());
+}
+
+TEST(SkipTest, Empty) {
+    Arena arena;
+    Comparator cmp;
+    SkipList<Key, Comparator> list(cmp, &arena);
+    ASSERT_TRUE(!list.Contains(10));
+
+    SkipList<Key, Comparator>::Iterator iter(&list);
+    ASSERT_TRUE(!iter.Valid());
+    iter.SeekToFirst();
+    ASSERT_TRUE(!iter.Valid());
+    iter.Seek(100);
+    ASSERT_TRUE(!iter.Valid());
+    iter.SeekToLast();
+    ASSERT_TRUE(!iter.Valid());
+}
+
+TEST(SkipTest, PrefixCodes) {
+    Arena arena;
+    PrefixComparator cmp;
+    SkipList<const char*, PrefixComparator> list(cmp, &arena);
+
+    // many keys share their first 8 bytes, so both the codes and the keys
+    // get compared
+    Random rnd(301);
+    std::set<std::string> keys;
+    std::vector<std::string> inserted;
+    inserted.reserve(2000);
+    while (inserted.size() < 2000) {
+        std::string key = (rnd.OneIn(2) ? "prefix__" : "prefix_") + std::to_string(rnd.Uniform(100000));
+        if (keys.insert(key).second) {
+            inserted.push_back(key);
+            list.Insert(inserted.back().c_str());
+        }
+    }
+
+    SkipList<const char*, PrefixComparator>::Iterator iter(&list);
+    iter.SeekToFirst();
+    for (const std::string& key : keys) {
+        ASSERT_TRUE(iter.Valid());
+        ASSERT_EQ(key, iter.key());
+        ASSERT_TRUE(list.Contains(key.c_str()));
+        iter.Next();
+    }
+    ASSERT_TRUE(!iter.Valid());
+    ASSERT_TRUE(!list.Contains("prefix"));
+    ASSERT_TRUE(!list.Contains("prefix__x"));
+
+    iter.Seek("prefix__");
+    ASSERT_TRUE(iter.Valid());
+    ASSERT_EQ(*keys.lower_bound("prefix__"), iter.key());
+}
+
+TEST(SkipTest, InsertWithHint) {
+    Arena arena;
+    Comparator cmp;
+    SkipList<Key, Comparator> list(cmp, &arena);
+    std::set<Key> keys;
+
+    // ascending runs, as in a sorted batch, each starting anywhere; the hint
+    // is also followed by keys that go before it
+    Random rnd(301);
+    for (int run = 0; run < 50; run++) {
+        SkipList<Key, Comparator>::Hint hint;
+        Key k = rnd.Uniform(100000);
+        for (int i = 0; i < 100; i++) {
+            k += 1 + rnd.Uniform(10);
+            if (keys.insert(k).second) {
+                list.Insert(k, &hint);
+            }
+        }
+        const Key before = rnd.Uniform(100000);
+        if (keys.insert(before).second) {
+            list.Insert(before, &hint);
+        }
+    }
+    CheckContents(list, keys);
+}
+
+TEST(SkipTest, InsertConcurrentlyWithHint) {
+    const int kThreads = 4;
+    const int kPerThread = 5000;
+    Arena arena(true /* concurrent */);
+    Comparator cmp;
+    SkipList<Key, Comparator> list(cmp, &arena);
+
+    // each thread inserts ascending keys next to the other threads' keys,
+    // so the nodes around its hint keep changing
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; t++) {
+        threads.emplace_back([&list, t]() {
+            SkipList<Key, Comparator>::Hint hint;
+            for (int i = 0; i < kPerThread; i++) {
+                list.InsertConcurrently(static_cast<Key>(i) * kThreads + t, &hint);
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    std::set<Key> keys;
+    for (Key k = 0; k < static_cast<Key>(kThreads) * kPerThread; k++) {
+        keys.insert(k);
+    }
+    CheckContents(list, keys);
+}
+
+TEST(SkipTest, InsertConcurrently) {
+    const int kThreads = 4;
+    const int kPerThread = 5000;
+    Arena arena(true /* concurrent */);
+    Comparator cmp;
+    SkipList<Key, Comparator> list(cmp, &arena);
+
+    // the threads interleave their keys, so they keep inserting next to
+    // each other
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; t++) {
+        threads.emplace_back([&list, t]() {
+            for (int i = 0; i < kPerThread; i++) {
+                list.InsertConcurrently(static_cast<Key>(i) * kThreads + t);
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    std::set<Key> keys;
+    for (Key k = 0; k < static_cast<Key>(kThreads) * kPerThread; k++) {
+        keys.insert(k);
+    }
+    CheckContents(list, keys);
+}
+
+TEST(SkipTest, ReadWhileInsertingConcurrently) {
+    Arena arena(true /* concurrent */);
+    Comparator cmp;
+    SkipList<Key, Comparator> list(cmp, &arena);
+
+    std::atomic<bool> done(false);
+    std::thread reader([&list, &done]() {
+        // whatever a reader sees must be in order
+        while (!done.load(std::memory_order_acquire)) {
+            SkipList<Key, Comparator>::Iterator iter(&list);
+            Key last = 0;
+            bool first = true;
+            for (iter.SeekToFirst(); iter.Valid(); iter.Next()) {
+                ASSERT_TRUE(first || last < iter.key());
+                last = iter.key();
+                first = false;
+            }
+        }
+    });
+    std::vector<std::thread> writers;
+    for (int t = 0; t < 2; t++) {
+        writers.emplace_back([&list, t]() {
+            for (Key i = 0; i < 20000; i++) {
+                list.InsertConcurrently(i * 2 + t);
+            }
+        });
+    }
+    for (std::thread& writer : writers) {
+        writer.join();
+    }
+    done.store(true, std::memory_order_release);
+    reader.join();
+
+    std::set<Key> keys;
+    for (Key k = 0; k < 40000; k++) {
+        keys.insert(k);
+    }
+    CheckContents(list, keys);
+}
+
+}  // namespace leveldb
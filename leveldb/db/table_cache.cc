@@ -70,9 +70,26 @@ Status TableCache::FindTable(uint64_t file_number, uint64_t file_size,
     return s;
 }
 
+Iterator* TableCache::NewRangeTombstoneIterator(const ReadOptions& options,
+                                                uint64_t file_number, uint64_t file_size) {
+    Cache::Handle* handle = nullptr;
+    Status s = FindTable(file_number, file_size, &handle);
+    if (!s.ok()) {
+        return NewErrorIterator(s);
+    }
+    Table* t = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
+    Iterator* result = t->NewRangeTombstoneIterator(options);
+    if (result == nullptr) {
+        cache_->Release(handle);
+    } else {
+        result->RegisterCleanup(&UnrefEntry, cache_, handle);
+    }
+    return result;
+}
+
 Status TableCache::Get(const ReadOptions& options, uint64_t file_number,
                        uint64_t file_size, const Slice& k, void* arg,
-                       void (*handle_result)(void*, const Slice&, const Slice&)) {
+                       bool (*handle_result)(void*, const Slice&, const Slice&)) {
     Cache::Handle* handle = nullptr;
     Status s = FindTable(file_number, file_size, &handle);
     if (s.ok()) {
@@ -83,4 +100,17 @@ Status TableCache::Get(const ReadOptions& options, uint64_t file_number,
     return s;
 }
 
+Status TableCache::MultiGet(const ReadOptions& options, uint64_t file_number,
+                            uint64_t file_size, size_t n, const Slice* keys, void* const* args,
+                            bool (*handle_result)(void*, const Slice&, const Slice&)) {
+    Cache::Handle* handle = nullptr;
+    Status s = FindTable(file_number, file_size, &handle);
+    if (s.ok()) {
+        Table* t = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
+        s = t->InternalMultiGet(options, n, keys, args, handle_result);
+        cache_->Release(handle);
+    }
+    return s;
+}
+
 }  // namespace leveldb
\ No newline at end of file
@@ -20,9 +20,22 @@ public:
     Iterator* NewIterator(const ReadOptions& options, uint64_t file_number,
                           uint64_t file_size, Table** tableptr = nullptr);
 
+    // return an iterator over the range tombstones of the specified file,
+    // or nullptr if it has none (see Table::NewRangeTombstoneIterator).
+    Iterator* NewRangeTombstoneIterator(const ReadOptions& options, uint64_t file_number,
+                                        uint64_t file_size);
+
     Status Get(const ReadOptions& options, uint64_t file_number,
                uint64_t file_size, const Slice& k, void* arg,
-               void (*handle_result)(void*, const Slice&, const Slice&));
+               bool (*handle_result)(void*, const Slice&, const Slice&));
+
+    // Get() for the internal keys keys[0, n), which must be in order, with
+    // args[i] passed to handle_result for keys[i]. The table is looked up
+    // once, and keys that fall into the same data block share one read of
+    // it (see Table::InternalMultiGet).
+    Status MultiGet(const ReadOptions& options, uint64_t file_number, uint64_t file_size,
+                    size_t n, const Slice* keys, void* const* args,
+                    bool (*handle_result)(void*, const Slice&, const Slice&));
 
     // Evict any entry for the specified file number
     void Evict(uint64_t file_number);
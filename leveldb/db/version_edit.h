@@ -10,7 +10,7 @@
 namespace leveldb {
 
 struct FileMetaData {
-    FileMetaData() : refs(0), allowed_seeks(1 << 30), file_size(0) {}
+    FileMetaData() : refs(0), allowed_seeks(1 << 30), file_size(0), has_range_tombstones(false) {}
 
     int refs;
     int allowed_seeks;  // seeks allowed until compaction
@@ -18,6 +18,7 @@ struct FileMetaData {
     uint64_t file_size;  // File size in bytes
     InternalKey smallest;
     InternalKey largest; 
+    bool has_range_tombstones;  // the table has a range_del meta block
 };
 
 class VersionEdit {
@@ -60,12 +61,14 @@ public:
     // REQUIRES: this version has not been saved (see VersionSet::SaveTo)
     // REQUIRES: "smallest" and "largest" are smallest and largest keys in file
     void AddFile(int level, uint64_t file, uint64_t file_size,
-                 const InternalKey& smallest, const InternalKey& largest) {
+                 const InternalKey& smallest, const InternalKey& largest,
+                 bool has_range_tombstones = false) {
         FileMetaData f;
         f.number = file;
         f.file_size = file_size;
         f.smallest = smallest;
         f.largest = largest;
+        f.has_range_tombstones = has_range_tombstones;
         new_files_.push_back(std::make_pair(level, f));
     }
 
@@ -1,5 +1,11 @@
 #include "db/version_set.h"
+
+#include <algorithm>
+
+#include "db/merge_context.h"
+#include "db/range_del.h"
 #include "leveldb/status.h"
+#include "util/coding.h"
 
 namespace leveldb {
 
@@ -16,11 +22,61 @@ struct Saver {
     const Comparator* ucmp;
     Slice user_key;
     std::string* value;
+    // newest range tombstone of the file being searched that hides the key
+    SequenceNumber tombstone_seq;
+    MergeContext* merge_context;
 };
 }  // namespace
 
+// returns true while the entries that follow may be of the key too and
+// are needed, i.e. after a merge operand
+static bool SaveValue(void* arg, const Slice& ikey, const Slice& v) {
+    Saver* s = reinterpret_cast<Saver*>(arg);
+    ParsedInternalKey parsed_key;
+    if (!ParseInternalKey(ikey, &parsed_key)) {
+        s->state = kCorrupt;
+    } else if (s->ucmp->Compare(parsed_key.user_key, s->user_key) == 0) {
+        if (parsed_key.sequence < s->tombstone_seq) {
+            s->state = kDeleted;
+        } else if (parsed_key.type == kTypeMerge) {
+            s->merge_context->PushOperand(v);
+            return true;
+        } else {
+            s->state = (parsed_key.type == kTypeValue) ? kFound : kDeleted;
+        }
+        if (s->state == kFound) {
+            s->value->assign(v.data(), v.size());
+        }
+    }
+    return false;
+}
+
+void Version::ForEachOverlapping(Slice user_key, Slice internal_key, void* arg,
+                                 bool (*func)(void*, int, FileMetaData*)) {
+    const Comparator* ucmp = vset_->icmp_.user_comparator();
+
+    // search level-0 in order from newest to oldest.
+    for (FileMetaData* f : file_indexer_.Level0NewestFirst()) {
+        if (ucmp->Compare(user_key, f->smallest.user_key()) >= 0 &&
+                ucmp->Compare(user_key, f->largest.user_key()) <= 0) {
+            if (!(*func)(arg, 0, f)) {
+                return;
+            }
+        }
+    }
+
+    // search other levels, each within the files the level above leads to
+    FileIndexer::Search search(&file_indexer_, internal_key);
+    for (int level = 1; level < config::kNumLevels; level++) {
+        FileMetaData* f = search.FileAt(level);
+        if (f != nullptr && !(*func)(arg, level, f)) {
+            return;
+        }
+    }
+}
+
 Status Version::Get(const ReadOptions& options, const LookupKey& k,
-                    std::string* value, GetStats* stats) {
+                    std::string* value, GetStats* stats, MergeContext* merge_context) {
     stats->seek_file = nullptr;
     stats->seek_file_level = -1;
 
@@ -29,6 +85,7 @@ Status Version::Get(const ReadOptions& options, const LookupKey& k,
         GetStats* stats;
         const ReadOptions* options;
         Slice ikey;
+        SequenceNumber snapshot;
         FileMetaData* last_file_read;
         int last_file_read_level;
 
@@ -49,6 +106,25 @@ Status Version::Get(const ReadOptions& options, const LookupKey& k,
             state->last_file_read = f;
             state->last_file_read_level = level;
 
+            // a range tombstone of this file hides the older entries of the
+            // key in it and in the files searched after it
+            state->saver.tombstone_seq = 0;
+            Iterator* tombstones = nullptr;
+            if (f->has_range_tombstones) {
+                tombstones = state->vset->table_cache_->NewRangeTombstoneIterator(
+                        *state->options, f->number, f->file_size);
+            }
+            if (tombstones != nullptr) {
+                state->saver.tombstone_seq = MaxCoveringTombstoneSeq(
+                        tombstones, state->saver.ucmp, state->saver.user_key, state->snapshot);
+                state->s = tombstones->status();
+                delete tombstones;
+                if (!state->s.ok()) {
+                    state->found = true;
+                    return false;
+                }
+            }
+
             state->s = state->vset->table_cache_->Get(*state->options, f->number,
                                                       f->file_size, state->ikey,
                                                       &state->saver, SaveValue);
@@ -56,6 +132,9 @@ Status Version::Get(const ReadOptions& options, const LookupKey& k,
                 state->found = true;
                 return false;
             }
+            if (state->saver.state == kNotFound && state->saver.tombstone_seq > 0) {
+                state->saver.state = kDeleted;
+            }
             switch (state->saver.state) {
                 case kNotFound:
                     return true;  // keep search in other files
@@ -84,16 +163,215 @@ Status Version::Get(const ReadOptions& options, const LookupKey& k,
 
     state.options = &options;
     state.ikey = k.internal_key();
+    state.snapshot = DecodeFixed64(state.ikey.data() + state.ikey.size() - 8) >> 8;
     state.vset = vset_;
 
     state.saver.state = kNotFound;
     state.saver.ucmp = vset_->icmp_.user_comparator();
     state.saver.user_key = k.user_key();
     state.saver.value = value;
+    state.saver.tombstone_seq = 0;
+    state.saver.merge_context = merge_context;
 
     ForEachOverlapping(state.saver.user_key, state.ikey, &state, &State::Match);
 
-    return state.found ? state.s : Status::NotFound(Slice());
+    if (merge_context->empty() || (state.found && !state.s.ok())) {
+        return state.found ? state.s : Status::NotFound(Slice());
+    }
+    // the operands apply to the value found, if any, or else to nothing
+    const MergeOperator* merge_operator = vset_->options_->merge_operator;
+    if (state.saver.state == kFound) {
+        const Slice existing_value(*value);
+        return merge_context->Merge(merge_operator, state.saver.user_key, &existing_value, value);
+    }
+    return merge_context->Merge(merge_operator, state.saver.user_key, nullptr, value);
+}
+
+void Version::MultiGet(const ReadOptions& options, std::vector<MultiGetKey>* keys) {
+    // what State is to Get(), for one key
+    struct KeyState {
+        MultiGetKey* key;
+        Saver saver;
+        Slice ikey;
+        SequenceNumber snapshot;
+        FileMetaData* last_file_read;
+        int last_file_read_level;
+        Status s;
+        bool found;
+        bool done;  // no older file needs to be searched
+    };
+
+    // the keys to search one file for
+    struct FileBatch {
+        VersionSet* vset;
+        const ReadOptions* options;
+        int level;
+        FileMetaData* file;
+        std::vector<KeyState*> keys;  // sorted by user key
+
+        void Search() {
+            std::vector<Slice> ikeys;
+            std::vector<void*> args;
+            for (KeyState* k : keys) {
+                GetStats* stats = &k->key->stats;
+                if (stats->seek_file == nullptr && k->last_file_read != nullptr) {
+                    // we have had more than one seek for this key. charge the 1st file
+                    stats->seek_file = k->last_file_read;
+                    stats->seek_file_level = k->last_file_read_level;
+                }
+                k->last_file_read = file;
+                k->last_file_read_level = level;
+                k->saver.tombstone_seq = 0;
+                ikeys.push_back(k->ikey);
+                args.push_back(&k->saver);
+            }
+
+            Status s;
+            Iterator* tombstones = nullptr;
+            if (file->has_range_tombstones) {
+                tombstones = vset->table_cache_->NewRangeTombstoneIterator(
+                        *options, file->number, file->file_size);
+            }
+            if (tombstones != nullptr) {
+                for (KeyState* k : keys) {
+                    k->saver.tombstone_seq = MaxCoveringTombstoneSeq(
+                            tombstones, k->saver.ucmp, k->saver.user_key, k->snapshot);
+                }
+                s = tombstones->status();
+                delete tombstones;
+            }
+            if (s.ok()) {
+                s = vset->table_cache_->MultiGet(*options, file->number, file->file_size,
+                                                 ikeys.size(), ikeys.data(), args.data(),
+                                                 SaveValue);
+            }
+
+            for (KeyState* k : keys) {
+                if (!s.ok()) {
+                    k->s = s;
+                    k->found = true;
+                    k->done = true;
+                    continue;
+                }
+                if (k->saver.state == kNotFound && k->saver.tombstone_seq > 0) {
+                    k->saver.state = kDeleted;
+                }
+                switch (k->saver.state) {
+                    case kNotFound:
+                        break;  // keep search in other files
+                    case kFound:
+                        k->found = true;
+                        k->done = true;
+                        break;
+                    case kDeleted:
+                        k->done = true;
+                        break;
+                    case kCorrupt:
+                        k->s = Status::Corruption("corrupted key for ", k->saver.user_key);
+                        k->found = true;
+                        k->done = true;
+                        break;
+                }
+            }
+            keys.clear();
+        }
+    };
+
+    const InternalKeyComparator& icmp = vset_->icmp_;
+    const Comparator* ucmp = icmp.user_comparator();
+
+    std::vector<KeyState> states(keys->size());
+    for (size_t i = 0; i < keys->size(); i++) {
+        MultiGetKey* key = &(*keys)[i];
+        key->stats.seek_file = nullptr;
+        key->stats.seek_file_level = -1;
+
+        KeyState* k = &states[i];
+        k->key = key;
+        k->ikey = key->lkey->internal_key();
+        k->snapshot = DecodeFixed64(k->ikey.data() + k->ikey.size() - 8) >> 8;
+        k->last_file_read = nullptr;
+        k->last_file_read_level = -1;
+        k->found = false;
+        k->done = false;
+        k->saver.state = kNotFound;
+        k->saver.ucmp = ucmp;
+        k->saver.user_key = key->lkey->user_key();
+        k->saver.value = key->value;
+        k->saver.tombstone_seq = 0;
+        k->saver.merge_context = key->merge_context;
+    }
+
+    FileBatch batch;
+    batch.vset = vset_;
+    batch.options = &options;
+    batch.file = nullptr;
+
+    // level-0 files may overlap each other. Search them from newest to
+    // oldest, each for all the keys in its range.
+    batch.level = 0;
+    for (FileMetaData* f : file_indexer_.Level0NewestFirst()) {
+        batch.file = f;
+        for (KeyState& k : states) {
+            if (!k.done && ucmp->Compare(k.saver.user_key, f->smallest.user_key()) >= 0 &&
+                    ucmp->Compare(k.saver.user_key, f->largest.user_key()) <= 0) {
+                batch.keys.push_back(&k);
+            }
+        }
+        if (!batch.keys.empty()) {
+            batch.Search();
+        }
+    }
+
+    // the files of other levels are disjoint and sorted, so the search for
+    // the file of a key can start at the file of the key before it. Runs of
+    // keys that land in the same file make up a batch.
+    auto ends_before = [&icmp](FileMetaData* f, const Slice& ikey) {
+        return icmp.Compare(f->largest.Encode(), ikey) < 0;
+    };
+    for (int level = 1; level < config::kNumLevels; level++) {
+        const std::vector<FileMetaData*>& files = files_[level];
+        batch.level = level;
+        size_t index = 0;
+        for (KeyState& k : states) {
+            if (k.done) {
+                continue;
+            }
+            index = std::lower_bound(files.begin() + index, files.end(), k.ikey, ends_before) -
+                    files.begin();
+            if (index == files.size()) {
+                break;  // this key and all after it are past the last file
+            }
+            FileMetaData* f = files[index];
+            if (ucmp->Compare(k.saver.user_key, f->smallest.user_key()) < 0) {
+                continue;  // falls between two files
+            }
+            if (f != batch.file && !batch.keys.empty()) {
+                batch.Search();
+            }
+            batch.file = f;
+            batch.keys.push_back(&k);
+        }
+        if (!batch.keys.empty()) {
+            batch.Search();
+        }
+    }
+
+    // same as the end of Get()
+    const MergeOperator* merge_operator = vset_->options_->merge_operator;
+    for (KeyState& k : states) {
+        MultiGetKey* key = k.key;
+        if (key->merge_context->empty() || (k.found && !k.s.ok())) {
+            *key->status = k.found ? k.s : Status::NotFound(Slice());
+        } else if (k.saver.state == kFound) {
+            const Slice existing_value(*key->value);
+            *key->status = key->merge_context->Merge(merge_operator, k.saver.user_key,
+                                                     &existing_value, key->value);
+        } else {
+            *key->status = key->merge_context->Merge(merge_operator, k.saver.user_key,
+                                                     nullptr, key->value);
+        }
+    }
 }
 
 // a helper class so we can efficiently apply a whole sequence of
@@ -271,6 +549,35 @@ void VersionSet::Finallize(Version* v) {
     }
     v->compaction_level_ = best_level;
     v->compaction_score_ = best_score;
+
+    // estimate the pending compaction work: everything in level-0 once it
+    // is due for compaction, and for every other level the bytes over its
+    // limit, plus what they would rewrite in the next level.
+    uint64_t pending_bytes = 0;
+    uint64_t incoming_bytes = 0;  // pushed down from the level above
+    for (int level = 0; level < config::kNumLevels - 1; level++) {
+        const uint64_t level_bytes = TotalFileSize(v->files_[level]) + incoming_bytes;
+        uint64_t excess = 0;
+        if (level == 0) {
+            if (v->files_[level].size() >= static_cast<size_t>(config::kL0_CompactionTrigger)) {
+                excess = level_bytes;
+            }
+        } else if (level_bytes > MaxByteForLevel(options_, level)) {
+            excess = level_bytes - static_cast<uint64_t>(MaxByteForLevel(options_, level));
+        }
+        if (excess > 0) {
+            const uint64_t next_bytes = TotalFileSize(v->files_[level + 1]);
+            const uint64_t this_bytes = std::max<uint64_t>(level_bytes, 1);
+            // rewriting "excess" also rewrites the overlapping share of the
+            // next level, approximated by the ratio of the level sizes
+            pending_bytes += excess + static_cast<uint64_t>(
+                    static_cast<double>(excess) * next_bytes / this_bytes);
+        }
+        incoming_bytes = excess;
+    }
+    v->pending_compaction_bytes_ = pending_bytes;
+
+    v->file_indexer_.Build(&icmp_, v->files_);
 }
 
 Status VersionSet::WriteSnapshot(log::Writer* log) {
@@ -292,7 +599,8 @@ Status VersionSet::WriteSnapshot(log::Writer* log) {
         const std::vector<FileMetaData*>& files = current_->files_[level];
         for (size_t i = 0; i < files.size(); i++) {
             const FileMetaData* f = files[i];
-            edit.AddFile(level, f->number, f->file_size, f->smallest, f->largest);
+            edit.AddFile(level, f->number, f->file_size, f->smallest, f->largest,
+                         f->has_range_tombstones);
         }
     }
 
@@ -314,7 +622,7 @@ Status VersionSet::LogAndApply(VersionEdit* edit, port::Mutex* mu) {
     }
 
     edit->SetNextFile(next_file_number_);
-    edit->SetLastSequence(last_sequence_);
+    edit->SetLastSequence(LastSequence());
 
     Version* v = new Version(this);
     {
@@ -1,15 +1,18 @@
 #ifndef STORAGE_LEVELDB_DB_VERSION_SET_H_
 #define STORAGE_LEVELDB_DB_VERSION_SET_H_
 
+#include <atomic>
 #include <map>
 #include <set>
 #include <vector>
 
 #include "db/dbformat.h"
+#include "db/file_indexer.h"
 #include "db/version_edit.h"
 
 namespace leveldb {
 
+class MergeContext;
 
 class Version {
 public:
@@ -21,8 +24,31 @@ public:
 
     void AddIterators(const ReadOptions&, std::vector<Iterator*>* iters);
 
+    // lookup the value for key. If found, store it in *val and return OK.
+    // else return a non-OK status. Merge operands of key found in the files
+    // are added to *merge_context, which may hold the operands of newer
+    // memtables already, and combined with the value they apply to.
+    // fills *stats.
+    // REQUIRES: lock is not held
     Status Get(const ReadOption&, const LookupKey& key, std::string* val,
-               GetStats* stats);
+               GetStats* stats, MergeContext* merge_context);
+
+    // a key looked up by MultiGet()
+    struct MultiGetKey {
+        const LookupKey* lkey;
+        std::string* value;
+        Status* status;
+        // may hold merge operands of the key from the memtables already
+        MergeContext* merge_context;
+        GetStats stats;
+    };
+
+    // Get() for each of *keys, which must be sorted by user key. The keys
+    // that overlap one file are searched for together, so the file is
+    // visited once and each of its data blocks read at most once (see
+    // TableCache::MultiGet()). Fills the status, value and stats of each key.
+    // REQUIRES: lock is not held
+    void MultiGet(const ReadOptions&, std::vector<MultiGetKey>* keys);
 
     bool UpdateStats(const GetStats& stats);
 
@@ -60,7 +86,8 @@ private:
           file_to_compact_(nullptr),
           file_to_compact_level_(-1),
           compaction_score_(-1),
-          compaction_level_(-1) {}
+          compaction_level_(-1),
+          pending_compaction_bytes_(0) {}
 
     Version(const Version&) = delete;
     Version& operator=(const Version&) = delete;
@@ -79,11 +106,18 @@ private:
 
     std::vector<FileMetaData*> files_[config::kNumLevels];
 
+    // for finding the files that overlap a key, built by VersionSet::Finalize()
+    FileIndexer file_indexer_;
+
     FileMetaData* file_to_compact_;
     int file_to_compact_level_;
 
     double compaction_score_;
     int compaction_level_;
+
+    // estimate of the bytes compactions have to rewrite before every
+    // level is back within its size limit. computed by Finalize()
+    uint64_t pending_compaction_bytes_;
 };
 
 class VersionSet {
@@ -93,10 +127,42 @@ public:
     VersionSet(const VersionSet&) = delete;
     VersionSet& operator=(const VersionSet&) = delete;
 
+    // recover the last saved descriptor from persistent storage.
+    Status Recover(bool* save_manifest);
+
     uint64_t NewFileNumber() { return next_file_number_++; }
 
+    // mark the specified file number as used.
+    void MarkFileNumberUsed(uint64_t number) {
+        if (next_file_number_ <= number) {
+            next_file_number_ = number + 1;
+        }
+    }
+
+    // return the last sequence number. Safe to call without the DB mutex,
+    // e.g. from Get()
+    uint64_t LastSequence() const { return last_sequence_.load(std::memory_order_acquire); }
+
+    // set the last sequence number to s.
+    void SetLastSequence(uint64_t s) {
+        assert(s >= last_sequence_.load(std::memory_order_relaxed));
+        last_sequence_.store(s, std::memory_order_release);
+    }
+
+    // return the current log file number
+    uint64_t LogNumber() const { return log_number_; }
+
+    // return the log file number for the log file that is currently
+    // being compacted, or zero if there is no such log file.
+    uint64_t PrevLogNumber() const { return prev_log_number_; }
+
     Status LogAndApply(VersionEdit* edit, port::Mutex* mu);
 
+    // estimate of the compaction work the current version is behind by
+    uint64_t PendingCompactionBytes() const {
+        return current_->pending_compaction_bytes_;
+    }
+
 private:
     class Builder;
 
@@ -123,7 +189,7 @@ private:
     const InternalKeyComparator icmp_;
     uint64_t next_file_number_;
     uint64_t manifest_file_number_;
-    uint64_t last_sequence_;
+    std::atomic<uint64_t> last_sequence_;
     uint64_t log_number_;
     uint64_t prev_log_number_;  // 0 or backing store for memtable being compacted
 
@@ -0,0 +1,262 @@
+// WriteBatch::rep_ :=
+//    sequence: fixed64
+//    count: fixed32
+//    data: record[count]
+// record :=
+//    kTypeValue varstring varstring         |
+//    kTypeDeletion varstring                |
+//    kTypeRangeDeletion varstring varstring |
+//    kTypeMerge varstring varstring
+// varstring :=
+//    len: varint32
+//    data: uint8[len]
+//
+// the data of a value added with PutRef() is not stored in rep_ but in
+// refs_, tagged with the offset of rep_ it logically belongs at. The
+// serialized batch is rep_ with those values spliced back in.
+
+#include "leveldb/write_batch.h"
+
+#include "db/dbformat.h"
+#include "db/memtable.h"
+#include "db/write_batch_internal.h"
+#include "leveldb/db.h"
+#include "util/coding.h"
+
+namespace leveldb {
+
+// WriteBatch header has an 8-byte sequence number followed by a 4-byte count.
+static const size_t kHeader = 12;
+
+// PutRef() values smaller than this are copied anyway: tracking them costs
+// more than the copy it saves.
+static const size_t kMinRefValueSize = 4096;
+
+WriteBatch::WriteBatch() { Clear(); }
+
+WriteBatch::~WriteBatch() = default;
+
+WriteBatch::Handler::~Handler() = default;
+
+void WriteBatch::Handler::DeleteRange(const Slice& begin_key, const Slice& end_key) {}
+
+void WriteBatch::Handler::Merge(const Slice& key, const Slice& operand) {}
+
+void WriteBatch::Clear() {
+    rep_.clear();
+    rep_.resize(kHeader);
+    refs_.clear();
+    ref_bytes_ = 0;
+}
+
+size_t WriteBatch::ApproximateSize() const { return rep_.size() + ref_bytes_; }
+
+Status WriteBatch::Iterate(Handler* handler) const {
+    Slice input(rep_);
+    if (input.size() < kHeader) {
+        return Status::Corruption("malformed WriteBatch (too small)");
+    }
+
+    input.remove_prefix(kHeader);
+    Slice key, value;
+    uint32_t value_length;
+    size_t next_ref = 0;
+    int found = 0;
+    while (!input.empty()) {
+        found++;
+        char tag = input[0];
+        input.remove_prefix(1);
+        switch (tag) {
+            case kTypeValue:
+                if (!GetLengthPrefixedSlice(&input, &key) ||
+                    !GetVarint32(&input, &value_length)) {
+                    return Status::Corruption("bad WriteBatch Put");
+                }
+                if (next_ref < refs_.size() &&
+                    refs_[next_ref].offset ==
+                            static_cast<size_t>(input.data() - rep_.data())) {
+                    value = refs_[next_ref++].value;
+                    assert(value.size() == value_length);
+                } else if (input.size() >= value_length) {
+                    value = Slice(input.data(), value_length);
+                    input.remove_prefix(value_length);
+                } else {
+                    return Status::Corruption("bad WriteBatch Put");
+                }
+                handler->Put(key, value);
+                break;
+            case kTypeDeletion:
+                if (GetLengthPrefixedSlice(&input, &key)) {
+                    handler->Delete(key);
+                } else {
+                    return Status::Corruption("bad WriteBatch Delete");
+                }
+                break;
+            case kTypeRangeDeletion:
+                if (GetLengthPrefixedSlice(&input, &key) &&
+                    GetLengthPrefixedSlice(&input, &value)) {
+                    handler->DeleteRange(key, value);
+                } else {
+                    return Status::Corruption("bad WriteBatch DeleteRange");
+                }
+                break;
+            case kTypeMerge:
+                if (GetLengthPrefixedSlice(&input, &key) &&
+                    GetLengthPrefixedSlice(&input, &value)) {
+                    handler->Merge(key, value);
+                } else {
+                    return Status::Corruption("bad WriteBatch Merge");
+                }
+                break;
+            default:
+                return Status::Corruption("unknown WriteBatch tag");
+        }
+    }
+    if (found != WriteBatchInternal::Count(this)) {
+        return Status::Corruption("WriteBatch has wrong count");
+    } else {
+        return Status::OK();
+    }
+}
+
+int WriteBatchInternal::Count(const WriteBatch* b) {
+    return DecodeFixed32(b->rep_.data() + 8);
+}
+
+void WriteBatchInternal::SetCount(WriteBatch* b, int n) {
+    EncodeFixed32(&b->rep_[8], n);
+}
+
+SequenceNumber WriteBatchInternal::Sequence(const WriteBatch* b) {
+    return SequenceNumber(DecodeFixed64(b->rep_.data()));
+}
+
+void WriteBatchInternal::SetSequence(WriteBatch* b, SequenceNumber seq) {
+    EncodeFixed64(&b->rep_[0], seq);
+}
+
+void WriteBatch::Put(const Slice& key, const Slice& value) {
+    WriteBatchInternal::SetCount(this, WriteBatchInternal::Count(this) + 1);
+    rep_.push_back(static_cast<char>(kTypeValue));
+    PutLengthPrefixedSlice(&rep_, key);
+    PutLengthPrefixedSlice(&rep_, value);
+}
+
+void WriteBatch::PutRef(const Slice& key, const Slice& value) {
+    if (value.size() < kMinRefValueSize) {
+        Put(key, value);
+        return;
+    }
+    WriteBatchInternal::SetCount(this, WriteBatchInternal::Count(this) + 1);
+    rep_.push_back(static_cast<char>(kTypeValue));
+    PutLengthPrefixedSlice(&rep_, key);
+    PutVarint32(&rep_, value.size());
+    refs_.push_back(ValueRef{rep_.size(), value});
+    ref_bytes_ += value.size();
+}
+
+void WriteBatch::Delete(const Slice& key) {
+    WriteBatchInternal::SetCount(this, WriteBatchInternal::Count(this) + 1);
+    rep_.push_back(static_cast<char>(kTypeDeletion));
+    PutLengthPrefixedSlice(&rep_, key);
+}
+
+void WriteBatch::DeleteRange(const Slice& begin_key, const Slice& end_key) {
+    WriteBatchInternal::SetCount(this, WriteBatchInternal::Count(this) + 1);
+    rep_.push_back(static_cast<char>(kTypeRangeDeletion));
+    PutLengthPrefixedSlice(&rep_, begin_key);
+    PutLengthPrefixedSlice(&rep_, end_key);
+}
+
+void WriteBatch::Merge(const Slice& key, const Slice& operand) {
+    WriteBatchInternal::SetCount(this, WriteBatchInternal::Count(this) + 1);
+    rep_.push_back(static_cast<char>(kTypeMerge));
+    PutLengthPrefixedSlice(&rep_, key);
+    PutLengthPrefixedSlice(&rep_, operand);
+}
+
+void WriteBatch::Append(const WriteBatch& source) {
+    WriteBatchInternal::Append(this, &source);
+}
+
+namespace {
+// encodes the entries of a batch; they are added to the memtable together
+// once the whole batch has been read. Range tombstones go in right away,
+// they are not part of the ordering the batch insert speeds up.
+class MemTableInserter : public WriteBatch::Handler {
+public:
+    SequenceNumber sequence_;
+    MemTable* mem_;
+    bool concurrent_;
+    std::vector<const char*> entries_;
+
+    void Put(const Slice& key, const Slice& value) override {
+        Add(kTypeValue, key, value);
+    }
+    void Delete(const Slice& key) override {
+        Add(kTypeDeletion, key, Slice());
+    }
+    void DeleteRange(const Slice& begin_key, const Slice& end_key) override {
+        if (concurrent_) {
+            mem_->AddConcurrently(sequence_, kTypeRangeDeletion, begin_key, end_key);
+        } else {
+            mem_->Add(sequence_, kTypeRangeDeletion, begin_key, end_key);
+        }
+        sequence_++;
+    }
+    void Merge(const Slice& key, const Slice& operand) override {
+        Add(kTypeMerge, key, operand);
+    }
+
+private:
+    void Add(ValueType type, const Slice& key, const Slice& value) {
+        entries_.push_back(mem_->Prepare(sequence_, type, key, value));
+        sequence_++;
+    }
+};
+}  // namespace
+
+Status WriteBatchInternal::InsertInto(const WriteBatch* b, MemTable* memtable,
+                                      bool concurrent) {
+    MemTableInserter inserter;
+    inserter.sequence_ = WriteBatchInternal::Sequence(b);
+    inserter.mem_ = memtable;
+    inserter.concurrent_ = concurrent;
+    inserter.entries_.reserve(WriteBatchInternal::Count(b));
+    Status s = b->Iterate(&inserter);
+    // entries read before a corrupt record still go in
+    memtable->AddPrepared(&inserter.entries_, concurrent);
+    return s;
+}
+
+void WriteBatchInternal::ContentsParts(const WriteBatch* b,
+                                       std::vector<Slice>* parts) {
+    size_t pos = 0;
+    for (const WriteBatch::ValueRef& ref : b->refs_) {
+        parts->emplace_back(b->rep_.data() + pos, ref.offset - pos);
+        parts->push_back(ref.value);
+        pos = ref.offset;
+    }
+    parts->emplace_back(b->rep_.data() + pos, b->rep_.size() - pos);
+}
+
+void WriteBatchInternal::SetContents(WriteBatch* b, const Slice& contents) {
+    assert(contents.size() >= kHeader);
+    b->rep_.assign(contents.data(), contents.size());
+    b->refs_.clear();
+    b->ref_bytes_ = 0;
+}
+
+void WriteBatchInternal::Append(WriteBatch* dst, const WriteBatch* src) {
+    SetCount(dst, Count(dst) + Count(src));
+    assert(src->rep_.size() >= kHeader);
+    // referenced values stay where they are, only their offsets move
+    const size_t base = dst->rep_.size() - kHeader;
+    for (const WriteBatch::ValueRef& ref : src->refs_) {
+        dst->refs_.push_back(WriteBatch::ValueRef{base + ref.offset, ref.value});
+    }
+    dst->ref_bytes_ += src->ref_bytes_;
+    dst->rep_.append(src->rep_.data() + kHeader, src->rep_.size() - kHeader);
+}
+
+}  // namespace leveldb
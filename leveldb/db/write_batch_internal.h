@@ -1,11 +1,14 @@
 #ifndef STORAGE_LEVELDB_DB_WRITE_BATCH_INTERNAL_H_
 #define STORAGE_LEVELDB_DB_WRITE_BATCH_INTERNAL_H_
 
+#include <vector>
+
+#include "db/dbformat.h"
 #include "leveldb/write_batch.h"
 
 namespace leveldb {
 
-class Memtable;
+class MemTable;
 
 // WriteBatchInternal provides static methods for manipulating a
 // writebatch that we don't want in the public WriteBatch interface
@@ -14,25 +17,38 @@ public:
     // return the number of entries in the batch
     static int Count(const WriteBatch* batch);
 
-    static void SetCount(const WriteBatch* batch);
+    // set the count for the number of entries in the batch
+    static void SetCount(WriteBatch* batch, int n);
 
     // return the sequence number for the start of this batch
     static SequenceNumber Sequence(const WriteBatch* batch);
 
-    static void SetSequenceNumber(const WriteBatch* batch, SequenceNumber seq);
+    // store the specified number as the sequence number for the start of
+    // this batch
+    static void SetSequence(WriteBatch* batch, SequenceNumber seq);
+
+    // REQUIRES: batch holds no values added with PutRef()
+    static Slice Contents(const WriteBatch* batch) { return Slice(batch->rep_); }
 
-    static Slice Contents(const WriteBatch* batch) { return Slice(batch->rep_); } 
+    // appends to *parts the pieces the serialized batch is made of, to be
+    // written out without copying the values added with PutRef().
+    static void ContentsParts(const WriteBatch* batch, std::vector<Slice>* parts);
 
-    static size_t ByteSize(const WriteBatch* batch) { return batch->rep_.size(); }
+    static size_t ByteSize(const WriteBatch* batch) {
+        return batch->rep_.size() + batch->ref_bytes_;
+    }
 
     static void SetContents(WriteBatch* batch, const Slice& contents);
 
-    static Status InsertInto(const WriteBatch* batch, Memtable* memtable);
+    // if "concurrent" is true, other threads may be inserting into
+    // "memtable" at the same time (see MemTable::AddConcurrently)
+    static Status InsertInto(const WriteBatch* batch, MemTable* memtable,
+                             bool concurrent = false);
 
-    static void Append(WriteBatch* dst, WriteBatch* src);
+    static void Append(WriteBatch* dst, const WriteBatch* src);
 };
 
 }  // namespace leveldb
 
 
-#endif  // STORAGE_LEVELDB_DB_WRITE_BATCH_INTERNAL_H_
\ No newline at end of file
+#endif  // STORAGE_LEVELDB_DB_WRITE_BATCH_INTERNAL_H_
@@ -0,0 +1,128 @@
+#include "leveldb/write_batch.h"
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "db/write_batch_internal.h"
+
+namespace leveldb {
+
+// renders what a batch holds, in order
+class PrintHandler : public WriteBatch::Handler {
+public:
+    void Put(const Slice& key, const Slice& value) override {
+        state_ += "Put(" + key.ToString() + ", " + value.ToString() + ")";
+    }
+    void Delete(const Slice& key) override {
+        state_ += "Delete(" + key.ToString() + ")";
+    }
+    void DeleteRange(const Slice& begin_key, const Slice& end_key) override {
+        state_ += "DeleteRange(" + begin_key.ToString() + ", " + end_key.ToString() + ")";
+    }
+    void Merge(const Slice& key, const Slice& operand) override {
+        state_ += "Merge(" + key.ToString() + ", " + operand.ToString() + ")";
+    }
+
+    std::string state_;
+};
+
+static std::string PrintContents(const WriteBatch* b) {
+    PrintHandler handler;
+    Status s = b->Iterate(&handler);
+    if (!s.ok()) {
+        handler.state_ += "ParseError()";
+    }
+    return handler.state_;
+}
+
+// the serialized batch, with the values added by PutRef() spliced in
+static std::string Gather(const WriteBatch* b) {
+    std::vector<Slice> parts;
+    WriteBatchInternal::ContentsParts(b, &parts);
+    std::string result;
+    for (const Slice& part : parts) {
+        result.append(part.data(), part.size());
+    }
+    return result;
+}
+
+TEST(WriteBatchTest, Empty) {
+    WriteBatch batch;
+    ASSERT_EQ("", PrintContents(&batch));
+    ASSERT_EQ(0, WriteBatchInternal::Count(&batch));
+}
+
+TEST(WriteBatchTest, Multiple) {
+    WriteBatch batch;
+    batch.Put(Slice("foo"), Slice("bar"));
+    batch.Delete(Slice("box"));
+    batch.Merge(Slice("baz"), Slice("boo"));
+    WriteBatchInternal::SetSequence(&batch, 100);
+    ASSERT_EQ(100, WriteBatchInternal::Sequence(&batch));
+    ASSERT_EQ(3, WriteBatchInternal::Count(&batch));
+    ASSERT_EQ("Put(foo, bar)Delete(box)Merge(baz, boo)", PrintContents(&batch));
+}
+
+TEST(WriteBatchTest, PutRefSmallValueIsCopied) {
+    std::string value = "small";
+    WriteBatch batch;
+    batch.PutRef(Slice("foo"), Slice(value));
+    value[0] = 'S';  // not referenced, so the batch keeps its own copy
+    ASSERT_EQ("Put(foo, small)", PrintContents(&batch));
+    ASSERT_EQ(WriteBatchInternal::Contents(&batch).ToString(), Gather(&batch));
+}
+
+TEST(WriteBatchTest, PutRef) {
+    const std::string big1(10000, 'x');
+    const std::string big2(5000, 'y');
+    WriteBatch batch;
+    batch.Put(Slice("a"), Slice("1"));
+    batch.PutRef(Slice("b"), Slice(big1));
+    batch.Delete(Slice("c"));
+    batch.PutRef(Slice("d"), Slice(big2));
+    WriteBatchInternal::SetSequence(&batch, 7);
+
+    WriteBatch copied;
+    copied.Put(Slice("a"), Slice("1"));
+    copied.Put(Slice("b"), Slice(big1));
+    copied.Delete(Slice("c"));
+    copied.Put(Slice("d"), Slice(big2));
+    WriteBatchInternal::SetSequence(&copied, 7);
+
+    // the referenced values are part of the batch, just not of its buffer
+    ASSERT_EQ(PrintContents(&copied), PrintContents(&batch));
+    ASSERT_EQ(WriteBatchInternal::ByteSize(&copied), WriteBatchInternal::ByteSize(&batch));
+    ASSERT_EQ(WriteBatchInternal::Contents(&copied).ToString(), Gather(&batch));
+
+    // what is written to the log reads back as the same batch
+    WriteBatch replayed;
+    WriteBatchInternal::SetContents(&replayed, Gather(&batch));
+    ASSERT_EQ(PrintContents(&copied), PrintContents(&replayed));
+}
+
+TEST(WriteBatchTest, AppendWithRefs) {
+    const std::string big(8000, 'z');
+    WriteBatch b1, b2;
+    WriteBatchInternal::SetSequence(&b1, 200);
+    WriteBatchInternal::SetSequence(&b2, 300);
+    b1.Put(Slice("a"), Slice("va"));
+    b2.PutRef(Slice("b"), Slice(big));
+    b2.Put(Slice("c"), Slice("vc"));
+    WriteBatchInternal::Append(&b1, &b2);
+
+    WriteBatch copied;
+    WriteBatchInternal::SetSequence(&copied, 200);
+    copied.Put(Slice("a"), Slice("va"));
+    copied.Put(Slice("b"), Slice(big));
+    copied.Put(Slice("c"), Slice("vc"));
+    ASSERT_EQ(3, WriteBatchInternal::Count(&b1));
+    ASSERT_EQ(PrintContents(&copied), PrintContents(&b1));
+    ASSERT_EQ(WriteBatchInternal::Contents(&copied).ToString(), Gather(&b1));
+
+    b1.Clear();
+    ASSERT_EQ("", PrintContents(&b1));
+    ASSERT_EQ(WriteBatchInternal::Contents(&b1).ToString(), Gather(&b1));
+}
+
+}  // namespace leveldb
@@ -0,0 +1,85 @@
+#include "db/write_controller.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "db/dbformat.h"
+#include "leveldb/options.h"
+
+namespace leveldb {
+
+WriteController::WriteController(const Options* options)
+    : max_rate_(options->delayed_write_rate),
+      soft_pending_bytes_(options->soft_pending_compaction_bytes_limit),
+      hard_pending_bytes_(options->hard_pending_compaction_bytes_limit),
+      stopped_(false),
+      rate_(0),
+      available_bytes_(0),
+      last_refill_micros_(0) {}
+
+void WriteController::Update(int level0_files,
+                             uint64_t pending_compaction_bytes) {
+    // how far we are from the slowdown point (0) to the stop point (1),
+    // taking whichever of the two signals is worse.
+    double pressure = -1;
+    if (level0_files >= config::kL0_SlowdownWritesTrigger) {
+        pressure = static_cast<double>(level0_files -
+                                       config::kL0_SlowdownWritesTrigger) /
+                   (config::kL0_StopWritesTrigger -
+                    config::kL0_SlowdownWritesTrigger);
+    }
+    if (soft_pending_bytes_ > 0 &&
+        pending_compaction_bytes >= soft_pending_bytes_) {
+        double p = 1.0;
+        if (hard_pending_bytes_ > soft_pending_bytes_) {
+            p = static_cast<double>(pending_compaction_bytes - soft_pending_bytes_) /
+                (hard_pending_bytes_ - soft_pending_bytes_);
+        }
+        pressure = std::max(pressure, p);
+    }
+
+    stopped_ = (pressure >= 1.0);
+    if (pressure < 0) {
+        // back to full speed, start the next slowdown with an empty bucket
+        rate_ = 0;
+        available_bytes_ = 0;
+        last_refill_micros_ = 0;
+        return;
+    }
+
+    const uint64_t min_rate = std::max<uint64_t>(max_rate_ / kMinRateDivisor, 1);
+    const double target = max_rate_ * (1.0 - std::min(pressure, 1.0));
+    rate_ = std::max(min_rate, static_cast<uint64_t>(target));
+}
+
+uint64_t WriteController::GetDelay(uint64_t now_micros, uint64_t bytes) {
+    assert(rate_ > 0);
+    if (last_refill_micros_ == 0) {
+        last_refill_micros_ = now_micros;
+    }
+
+    // refill. the bucket holds at most 1ms worth of writes, so a burst
+    // after an idle period can not run far ahead of the target rate.
+    if (now_micros > last_refill_micros_) {
+        available_bytes_ += static_cast<double>(now_micros - last_refill_micros_) *
+                            rate_ / 1000000;
+        last_refill_micros_ = now_micros;
+        available_bytes_ = std::min(available_bytes_, rate_ / 1000.0);
+    }
+
+    if (available_bytes_ >= bytes) {
+        available_bytes_ -= bytes;
+        return 0;
+    }
+
+    // go into debt and wait until the bucket has paid for this write. the
+    // refill clock moves to that point so the next writer queues behind us.
+    const double missing = bytes - available_bytes_;
+    const uint64_t pay_micros =
+            static_cast<uint64_t>(missing * 1000000 / rate_) + 1;
+    available_bytes_ = 0;
+    last_refill_micros_ = std::max(last_refill_micros_, now_micros) + pay_micros;
+    return last_refill_micros_ - now_micros;
+}
+
+}  // namespace leveldb
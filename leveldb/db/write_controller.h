@@ -0,0 +1,60 @@
+#ifndef STORAGE_LEVELDB_DB_WRITE_CONTROLLER_H_
+#define STORAGE_LEVELDB_DB_WRITE_CONTROLLER_H_
+
+#include <stdint.h>
+
+namespace leveldb {
+
+struct Options;
+
+// WriteController paces foreground writes while compactions fall behind.
+// Instead of switching between full speed and a fixed per-write sleep, it
+// derives a target ingest rate from how far the tree is between its
+// slowdown and stop thresholds (level-0 file count and pending compaction
+// bytes), and spreads writes out over time with a token bucket.
+//
+// Not thread-safe: DBImpl only calls it with its mutex held.
+class WriteController {
+public:
+    explicit WriteController(const Options* options);
+
+    WriteController(const WriteController&) = delete;
+    WriteController& operator=(const WriteController&) = delete;
+
+    // recompute the target rate from the current shape of the tree.
+    void Update(int level0_files, uint64_t pending_compaction_bytes);
+
+    // true if writes have to wait for compactions to catch up
+    bool IsStopped() const { return stopped_; }
+
+    // true if writes are currently being paced
+    bool NeedsDelay() const { return rate_ > 0; }
+
+    // take "bytes" out of the token bucket and return how many
+    // micro-seconds the caller has to wait before it may write them.
+    // REQUIRES: NeedsDelay()
+    uint64_t GetDelay(uint64_t now_micros, uint64_t bytes);
+
+    // current target rate in bytes per second, 0 if writes are not paced.
+    uint64_t rate() const { return rate_; }
+
+private:
+    // never pace writes slower than max_rate_ / kMinRateDivisor, otherwise a
+    // tree right below the stop thresholds would barely make progress.
+    static const int kMinRateDivisor = 32;
+
+    const uint64_t max_rate_;        // bytes/s right past the slowdown point
+    const uint64_t soft_pending_bytes_;
+    const uint64_t hard_pending_bytes_;
+
+    bool stopped_;
+    uint64_t rate_;
+
+    // token bucket state
+    double available_bytes_;
+    uint64_t last_refill_micros_;
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_WRITE_CONTROLLER_H_
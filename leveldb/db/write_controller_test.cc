@@ -0,0 +1,77 @@
+#include "db/write_controller.h"
+
+#include "db/dbformat.h"
+#include "gtest/gtest.h"
+#include "leveldb/options.h"
+
+namespace leveldb {
+
+TEST(WriteControllerTest, FullSpeedBelowSlowdown) {
+    Options options;
+    WriteController controller(&options);
+    controller.Update(config::kL0_SlowdownWritesTrigger - 1, 0);
+    ASSERT_TRUE(!controller.NeedsDelay());
+    ASSERT_TRUE(!controller.IsStopped());
+}
+
+TEST(WriteControllerTest, StopsAtStopTrigger) {
+    Options options;
+    WriteController controller(&options);
+    controller.Update(config::kL0_StopWritesTrigger, 0);
+    ASSERT_TRUE(controller.IsStopped());
+
+    controller.Update(0, options.hard_pending_compaction_bytes_limit);
+    ASSERT_TRUE(controller.IsStopped());
+}
+
+TEST(WriteControllerTest, RateDropsWithPressure) {
+    Options options;
+    WriteController controller(&options);
+    controller.Update(config::kL0_SlowdownWritesTrigger, 0);
+    ASSERT_EQ(options.delayed_write_rate, controller.rate());
+    const uint64_t slowdown_rate = controller.rate();
+    controller.Update(config::kL0_StopWritesTrigger - 1, 0);
+    ASSERT_LT(controller.rate(), slowdown_rate);
+    ASSERT_GT(controller.rate(), 0u);
+}
+
+TEST(WriteControllerTest, ChargesEveryByte) {
+    Options options;
+    options.delayed_write_rate = 1 << 20;
+    WriteController controller(&options);
+    controller.Update(config::kL0_SlowdownWritesTrigger, 0);
+
+    // ten 100KB batches, each writer sleeping off its delay, take as long
+    // as one 1000KB group
+    const uint64_t start = 1000000;
+    uint64_t now = start;
+    for (int i = 0; i < 10; i++) {
+        now += controller.GetDelay(now, 100 << 10);
+    }
+    const uint64_t total = now - start;
+    WriteController group_controller(&options);
+    group_controller.Update(config::kL0_SlowdownWritesTrigger, 0);
+    const uint64_t group_delay = group_controller.GetDelay(start, 1000 << 10);
+
+    const uint64_t expected = (1000ull << 10) * 1000000 / (1 << 20);
+    ASSERT_GE(total, expected);
+    ASSERT_LE(total, expected + 10);
+    ASSERT_GE(group_delay, expected);
+    ASSERT_LE(group_delay, expected + 10);
+}
+
+TEST(WriteControllerTest, RefillsOverTime) {
+    Options options;
+    options.delayed_write_rate = 1 << 20;
+    WriteController controller(&options);
+    controller.Update(config::kL0_SlowdownWritesTrigger, 0);
+
+    uint64_t now = 1000000;
+    ASSERT_EQ(0u, controller.GetDelay(now, 0));
+    // the bucket holds at most 1ms worth of writes, however long we idle
+    now += 1000000;
+    ASSERT_EQ(0u, controller.GetDelay(now, (1 << 20) / 1000));
+    ASSERT_GT(controller.GetDelay(now, 1 << 10), 0u);
+}
+
+}  // namespace leveldb
@@ -4,6 +4,9 @@
 #include <stdint.h>
 #include <stdio.h>
 
+#include <string>
+#include <vector>
+
 #include "leveldb/options.h"
 #include "leveldb/export.h"
 #include "leveldb/status.h"
@@ -36,6 +39,22 @@ public:
     // Note: consider setting options.sync = true.
     virtual Status Put(const WriteOptions& options, const Slice& key,
 		       const Slice& value) = 0;
+
+    // remove every key in ["begin_key", "end_key") at once. The range is
+    // recorded as a single tombstone, which is only applied by point
+    // lookups (Get() and MultiGet()) while it is in a memtable or a level-0
+    // table: iterators still return the keys it covers, and compactions
+    // neither drop those keys nor keep the tombstone. Does nothing unless
+    // begin_key < end_key.
+    // return OK on success, and a non-OK status on error.
+    virtual Status DeleteRange(const WriteOptions& options, const Slice& begin_key,
+                               const Slice& end_key) = 0;
+    // record "operand" for Options::merge_operator to combine with the
+    // current value of "key" when it is read, without reading it now.
+    // returns an InvalidArgument error if there is no merge operator.
+    virtual Status Merge(const WriteOptions& options, const Slice& key,
+                         const Slice& operand) = 0;
+
     // if hit, value in *value and return OK.
     //
     // if not, *value unchanged and return a status
@@ -45,6 +64,16 @@ public:
     virtual Status Get(const ReadOptions& options, const Slice& key,
 		       std::string* value) = 0;
 
+    // Get() for several keys at once, from the same snapshot. Returns the
+    // status of each key, in the order of "keys", and sets (*values)[i] to
+    // the value of keys[i] where that status is OK.
+    //
+    // cheaper than a Get() per key: keys that fall into the same table file
+    // are searched together, and a data block is read once for all of them.
+    virtual std::vector<Status> MultiGet(const ReadOptions& options,
+                                         const std::vector<Slice>& keys,
+                                         std::vector<std::string>* values) = 0;
+
     // apply the specified updates to the database.
     // Return OK on success, non-OK on failure.
     // Note: consider setting options.sync = true.
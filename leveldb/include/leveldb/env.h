@@ -1,11 +1,21 @@
 #ifndef STORAGE_LEVELDB_INCLUDE_ENV_H_
 #define STORAGE_LEVELDB_INCLUDE_ENV_H_
 
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
 #include "leveldb/export.h"
+#include "leveldb/slice.h"
 #include "leveldb/status.h"
 
 namespace leveldb {
 
+class RandomAccessFile;
+class SequentialFile;
+class WritableFile;
+
 class LEVELDB_EXPORT Env {
 public:
     Env();
@@ -15,26 +25,182 @@ public:
     
     virtual ~Env();
 
+    // create an object that sequentially reads the file with the specified name.
+    // on success, stores a pointer to the new file in *result and returns OK.
+    // on failure stores nullptr in *result and returns non-OK.  If the file does
+    // not exist, returns a non-OK status.
+    //
+    // the returned file will only be accessed by one thread at a time.
+    virtual Status NewSequentialFile(const std::string& fname,
+                                     SequentialFile** result) = 0;
+
+    // create an object supporting random-access reads from the file with the
+    // specified name.  On success, stores a pointer to the new file in
+    // *result and returns OK.  On failure stores nullptr in *result and
+    // returns non-OK.  If the file does not exist, returns a non-OK
+    // status.
+    //
+    // the returned file may be concurrently accessed by multiple threads.
+    virtual Status NewRandomAccessFile(const std::string& fname,
+                                       RandomAccessFile** result) = 0;
+
     virtual Status NewWritableFile(const std::string& fname,
-                                   WriteFile** result) = 0;
+                                   WritableFile** result) = 0;
+
+    // store in *result the names of the children of the specified directory.
+    // the names are relative to "dir".
+    // original contents of *results are dropped.
+    virtual Status GetChildren(const std::string& dir,
+                               std::vector<std::string>* result) = 0;
+
+    // rename the existing file "old_fname" to "fname" and open it for
+    // writing from offset 0 without truncating it, so the blocks it already
+    // has can be overwritten in place. Used to recycle log files.
+    //
+    // the default implementation does a rename followed by
+    // NewWritableFile(), which does truncate the file.
+    virtual Status ReuseWritableFile(const std::string& fname,
+                                     const std::string& old_fname,
+                                     WritableFile** result);
+
+    // delete the named file.
+    virtual Status RemoveFile(const std::string& fname) = 0;
+
+    // rename file src to target.
+    virtual Status RenameFile(const std::string& src,
+                              const std::string& target) = 0;
+
+    // start a new thread, invoking "function(arg)" within the new thread.
+    // when "function(arg)" returns, the thread will be destroyed.
+    virtual void StartThread(void (*function)(void* arg), void* arg) = 0;
+
+    // returns the number of micro-seconds since some fixed point in time. Only
+    // useful for computing deltas of time.
+    virtual uint64_t NowMicros() = 0;
+
+    // sleep/delay the thread for the prescribed number of micro-seconds.
+    virtual void SleepForMicroseconds(int micros) = 0;
+};
+
+// A file abstraction for reading sequentially through a file
+class LEVELDB_EXPORT SequentialFile {
+public:
+    SequentialFile() = default;
+
+    SequentialFile(const SequentialFile&) = delete;
+    SequentialFile& operator=(const SequentialFile&) = delete;
+
+    virtual ~SequentialFile();
+
+    // read up to "n" bytes from the file.  "scratch[0..n-1]" may be
+    // written by this routine.  Sets "*result" to the data that was
+    // read (including if fewer than "n" bytes were successfully read).
+    // may set "*result" to point at data in "scratch[0..n-1]", so
+    // "scratch[0..n-1]" must be live when "*result" is used.
+    // if an error was encountered, returns a non-OK status.
+    //
+    // REQUIRES: external synchronization
+    virtual Status Read(size_t n, Slice* result, char* scratch) = 0;
+
+    // skip "n" bytes from the file. This is guaranteed to be no
+    // slower that reading the same data, but may be faster.
+    //
+    // if end of file is reached, skipping will stop at the end of the
+    // file, and Skip will return OK.
+    //
+    // REQUIRES: external synchronization
+    virtual Status Skip(uint64_t n) = 0;
+};
+
+// A file abstraction for randomly reading the contents of a file.
+class LEVELDB_EXPORT RandomAccessFile {
+public:
+    // one read of a MultiRead() call
+    struct ReadRequest {
+        uint64_t offset;
+        size_t n;
+        char* scratch;  // n bytes that the read may write to
+        Slice result;   // set as by Read()
+        Status status;
+    };
+
+    RandomAccessFile() = default;
+
+    RandomAccessFile(const RandomAccessFile&) = delete;
+    RandomAccessFile& operator=(const RandomAccessFile&) = delete;
+
+    virtual ~RandomAccessFile();
+
+    // read up to "n" bytes from the file starting at "offset".
+    // "scratch[0..n-1]" may be written by this routine.  Sets "*result"
+    // to the data that was read (including if fewer than "n" bytes were
+    // successfully read).  May set "*result" to point at data in
+    // "scratch[0..n-1]", so "scratch[0..n-1]" must be live when
+    // "*result" is used.  If an error was encountered, returns a non-OK
+    // status.
+    //
+    // safe for concurrent use by multiple threads.
+    virtual Status Read(uint64_t offset, size_t n, Slice* result,
+                        char* scratch) const = 0;
+
+    // do the reads reqs[0, n) as if by Read(), and store the result and
+    // status of each in its request. Implementations may issue all of them
+    // at once and wait for them together, which is what keeps a fast device
+    // busy, where reads done one after the other would leave it mostly idle.
+    //
+    // the default implementation reads one request after another.
+    // safe for concurrent use by multiple threads.
+    virtual void MultiRead(ReadRequest* reqs, size_t n) const;
 };
 
 // A file abstraction for sequential writing. The implementation
 // must provide buffering since callers may append small fragments
 // at a time to the file.
-class LEVELDB_EXPORT WriteableFile {
+class LEVELDB_EXPORT WritableFile {
 public:
-    WriteableFile() = default;
+    WritableFile() = default;
 
-    WriteableFile(const WriteableFile&) = delete;
-    WriteableFile& operator=(const WriteableFile&) = delete;
+    WritableFile(const WritableFile&) = delete;
+    WritableFile& operator=(const WritableFile&) = delete;
 
-    virtual ~WriteableFile();
+    virtual ~WritableFile();
 
     virtual Status Append(const Slice& data) = 0;
+
+    // append the concatenation of data[0,n-1]. Implementations may write
+    // large pieces straight from the caller's memory with a single gathered
+    // write instead of copying them into their buffer first.
+    // the default implementation appends the pieces one by one.
+    virtual Status AppendV(const Slice* data, size_t n);
+
     virtual Status Close() = 0;
     virtual Status Flush() = 0;
     virtual Status Sync() = 0;
+
+    // hint that bytes [offset, offset + len) of the file are about to be
+    // written, so the file system can reserve the space up front without
+    // changing the file size. Later appends into the range then do not
+    // need to allocate blocks. The default implementation does nothing.
+    virtual Status Allocate(uint64_t offset, uint64_t len) {
+        return Status::OK();
+    }
+
+    // start writing out everything appended so far, followed by a sync of
+    // the file data if "sync" is true, without waiting for the I/O to
+    // complete. Stores in *ticket a number to hand to WaitAsync(). More data
+    // may be appended while the I/O is in flight.
+    //
+    // the default implementation does the work synchronously.
+    virtual Status SubmitAsync(bool sync, uint64_t* ticket) {
+        *ticket = 0;
+        return sync ? Sync() : Flush();
+    }
+
+    // wait until the I/O started by the SubmitAsync() call that returned
+    // "ticket", and by every call before it, is complete. Returns the first
+    // error any of them ran into. May be called from a different thread
+    // than the one appending to the file.
+    virtual Status WaitAsync(uint64_t ticket) { return Status::OK(); }
 };
 
 }  // namespace leveldb
@@ -0,0 +1,106 @@
+#ifndef STORAGE_LEVELDB_INCLUDE_ITERATOR_H_
+#define STORAGE_LEVELDB_INCLUDE_ITERATOR_H_
+
+#include <cassert>
+
+#include "leveldb/export.h"
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+// an iterator yields a sequence of key/value pairs from a source.
+//
+// multiple threads can invoke const methods on an Iterator without
+// external synchronization, but if any of the threads may call a
+// non-const method, all threads accessing the same Iterator must use
+// external synchronization.
+class LEVELDB_EXPORT Iterator {
+public:
+    Iterator();
+
+    Iterator(const Iterator&) = delete;
+    Iterator& operator=(const Iterator&) = delete;
+
+    virtual ~Iterator();
+
+    // an iterator is either positioned at a key/value pair, or
+    // not valid.  This method returns true iff the iterator is valid.
+    virtual bool Valid() const = 0;
+
+    // position at the first key in the source.  The iterator is Valid()
+    // after this call iff the source is not empty.
+    virtual void SeekToFirst() = 0;
+
+    // position at the last key in the source.  The iterator is
+    // Valid() after this call iff the source is not empty.
+    virtual void SeekToLast() = 0;
+
+    // position at the first key in the source that is at or past target.
+    // the iterator is Valid() after this call iff the source contains
+    // an entry that comes at or past target.
+    virtual void Seek(const Slice& target) = 0;
+
+    // moves to the next entry in the source.  After this call, Valid() is
+    // true iff the iterator was not positioned at the last entry in the source.
+    // REQUIRES: Valid()
+    virtual void Next() = 0;
+
+    // moves to the previous entry in the source.  After this call, Valid() is
+    // true iff the iterator was not positioned at the first entry in source.
+    // REQUIRES: Valid()
+    virtual void Prev() = 0;
+
+    // return the key for the current entry.  The underlying storage for
+    // the returned slice is valid only until the next modification of
+    // the iterator.
+    // REQUIRES: Valid()
+    virtual Slice key() const = 0;
+
+    // return the value for the current entry.  The underlying storage for
+    // the returned slice is valid only until the next modification of
+    // the iterator.
+    // REQUIRES: Valid()
+    virtual Slice value() const = 0;
+
+    // if an error has occurred, return it.  Else return an ok status.
+    virtual Status status() const = 0;
+
+    // clients are allowed to register function/arg1/arg2 triples that
+    // will be invoked when this iterator is destroyed.
+    //
+    // note that unlike all of the preceding methods, this method is
+    // not abstract and therefore clients should not override it.
+    using CleanupFunction = void (*)(void* arg1, void* arg2);
+    void RegisterCleanup(CleanupFunction function, void* arg1, void* arg2);
+
+private:
+    // cleanup functions are stored in a single-linked list.
+    // the list's head node is inlined in the iterator.
+    struct CleanupNode {
+        // true if the node is not used. Only head nodes might be unused.
+        bool IsEmpty() const { return function == nullptr; }
+        // invokes the cleanup function.
+        void Run() {
+            assert(function != nullptr);
+            (*function)(arg1, arg2);
+        }
+
+        // the head node is used if the function pointer is not null.
+        CleanupFunction function;
+        void* arg1;
+        void* arg2;
+        CleanupNode* next;
+    };
+    CleanupNode cleanup_head_;
+};
+
+// return an empty iterator (yields nothing).
+LEVELDB_EXPORT Iterator* NewEmptyIterator();
+
+// return an empty iterator with the specified status.
+LEVELDB_EXPORT Iterator* NewErrorIterator(const Status& status);
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_ITERATOR_H_
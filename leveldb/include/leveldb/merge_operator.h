@@ -0,0 +1,40 @@
+#ifndef STORAGE_LEVELDB_INCLUDE_MERGE_OPERATOR_H_
+#define STORAGE_LEVELDB_INCLUDE_MERGE_OPERATOR_H_
+
+#include <string>
+#include <vector>
+
+#include "leveldb/export.h"
+#include "leveldb/slice.h"
+
+namespace leveldb {
+
+// a MergeOperator turns read-modify-write updates, like incrementing a
+// counter or appending to a list, into blind writes: DB::Merge() only
+// records an operand, and the operands of a key are combined with its
+// value when the key is read.
+//
+// a MergeOperator must be thread-safe, since its methods may be invoked
+// concurrently from multiple threads.
+class LEVELDB_EXPORT MergeOperator {
+public:
+    virtual ~MergeOperator();
+
+    // the name of the operator. The operands in a database only make sense
+    // to the operator that wrote them, so a different operator should get
+    // a different name.
+    virtual const char* Name() const = 0;
+
+    // combines "operands", oldest first, with "existing_value", the value
+    // of "key" before the first operand or nullptr if it had none or was
+    // deleted, and stores the result in *new_value. Returns false if the
+    // operands cannot be combined, which reads of the key report as a
+    // corruption.
+    virtual bool FullMerge(const Slice& key, const Slice* existing_value,
+                           const std::vector<Slice>& operands,
+                           std::string* new_value) const = 0;
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_MERGE_OPERATOR_H_
@@ -2,20 +2,234 @@
 #define STORAGE_LEVELDB_INCLUDE_OPTIONS_H_
 
 #include <stddef.h>
+#include <stdint.h>
 #include "leveldb/export.h"
 
+namespace leveldb {
 
+class MergeOperator;
+class WriteBufferManager;
 
-namespace leveldb {
+// Structure a memtable keeps its entries in.
+enum MemTableRepType {
+    kSkipListMemTableRep = 0,
+    kHashMemTableRep = 1,
+    kVectorMemTableRep = 2,
+};
+
+// Log records and table blocks may be compressed before being written.
+// The following enum describes which compression method (if any) is used.
+enum CompressionType {
+    // NOTE: do not change the values of existing entries, as these are
+    // part of the persistent format on disk.
+    kNoCompression = 0x0,
+    kSnappyCompression = 0x1,
+    kZstdCompression = 0x2,
+};
 
 struct LEVELDB_EXPORT Options {
     Options();
 
     bool create_if_missing = false;
+
+    // If true, the implementation will do aggressive checking of the
+    // data it is processing and will stop early if it detects any
+    // errors.  This may have unforeseen ramifications: for example, a
+    // corruption of one DB entry may cause a large number of entries to
+    // become unreadable or for the entire DB to become unopenable.
+    bool paranoid_checks = false;
+
+    // Combines the operands written with DB::Merge() with the value of
+    // their key when it is read. Must be set to use DB::Merge(), and the
+    // same operator has to be used every time the DB is opened after.
+    const MergeOperator* merge_operator = nullptr;
+
+    // Amount of data to build up in memory (backed by an unsorted log
+    // on disk) before converting to a sorted on-disk file.
+    //
+    // Larger values increase performance, especially during bulk loads.
+    // Up to two write buffers may be held in memory at the same time,
+    // so you may wish to adjust this parameter to control memory usage.
+    // Also, a larger write buffer will result in a longer recovery time
+    // the next time the database is opened.
+    size_t write_buffer_size = 4 * 1024 * 1024;
+
+    // Number of threads replaying the logs left by the previous session
+    // when the database is opened. With more than one, a single thread
+    // reads and decodes the logs ahead of a pool of this many threads that
+    // insert the batches into memtables, and full memtables are written to
+    // level-0 tables in parallel. 1 replays the logs serially.
+    int max_recovery_threads = 1;
+
+    // Maximum number of memtables, the active one included, held in memory
+    // at once. When the active memtable fills up while earlier ones are
+    // still being flushed, writes only stall once this many exist. A flush
+    // writes all immutable memtables queued at that point into a single
+    // level-0 table. Values below 2 are treated as 2.
+    int max_write_buffer_number = 2;
+
+    // If non-null, the memtables of this DB count against the budget of
+    // this manager, which may be shared with other DBs. When the combined
+    // memtables get close to the budget, the DB with the largest memtable
+    // flushes it, even if it has not reached write_buffer_size yet.
+    WriteBufferManager* write_buffer_manager = nullptr;
+
+    // Structure memtables keep their entries in. kSkipListMemTableRep keeps
+    // them in a single skiplist. kHashMemTableRep hashes the user key into
+    // memtable_hash_bucket_count buckets, each a short sorted list, so a
+    // point lookup only walks one bucket; but an iterator over a memtable
+    // has to sort all its entries first, which makes scans and memtable
+    // flushes slower. Only use kHashMemTableRep with a comparator that
+    // treats user keys as equal only if their bytes are equal.
+    //
+    // kVectorMemTableRep only appends entries and sorts a memtable once, on
+    // several threads, when it is written to a level-0 table. This makes
+    // writes much cheaper, but a read has to scan the whole active memtable,
+    // so it is meant for bulk loads that do not read until they are done.
+    MemTableRepType memtable_rep = kSkipListMemTableRep;
+    size_t memtable_hash_bucket_count = 50000;
+
+    // If true, the entries of a write batch are sorted by key before they
+    // are inserted into the memtable. The skiplist memtable starts the
+    // search for each insert of a batch where the previous one went, which
+    // is cheapest when keys come in order; sorting pays off for large
+    // batches of keys that are close to each other but not quite in order.
+    // Batches whose keys are in order already are not sorted.
+    bool memtable_sort_batch_inserts = false;
+
+    // If non-zero, memtables allocate their memory in blocks of this many
+    // bytes backed by huge pages, e.g. 2MB, which cuts TLB misses when
+    // searching large memtables. Pages from the huge page pool reserved
+    // with vm.nr_hugepages are used if there are any, transparent huge
+    // pages otherwise. Memory usage grows in steps of this size, so it
+    // should be well below write_buffer_size. Must be a multiple of the
+    // system page size.
+    size_t memtable_huge_page_size = 0;
+
+    // If true and memtable_huge_page_size is set, each block of a memtable
+    // is placed on the NUMA node of the thread that writes to it first.
+    // Blocks allocated with new[] because no huge pages could be mapped at
+    // all are left to the default NUMA policy.
+    bool memtable_numa_local = false;
+
+    // If non-zero, each memtable keeps a bloom filter over its user keys of
+    // write_buffer_size * memtable_bloom_size_ratio bytes, so reads of keys
+    // that are not in a memtable skip searching it. 0.02 gives about one
+    // false positive per hundred lookups for entries of around 100 bytes.
+    double memtable_bloom_size_ratio = 0;
+
+    // Number of obsolete log files to keep around for reuse instead of
+    // deleting them. A new log then takes over the blocks of an old one,
+    // so appends overwrite already allocated space instead of growing the
+    // file, and syncs do not have to update file metadata. Logs are written
+    // in a format that lets recovery tell records left over from the
+    // file's previous use apart from current ones. 0 disables recycling.
+    size_t recycle_log_file_num = 0;
+
+    // If true, space for a new log file is reserved up front (about one
+    // write buffer's worth) so appends do not allocate blocks one at a time.
+    bool preallocate_log_files = false;
+
+    // Compression applied to log records of at least
+    // log_compression_min_bytes. A record is stored compressed only if that
+    // saves at least 1/8th of its size, so incompressible batches pay for
+    // the attempt but not for a bigger log. Logs written with compression
+    // can not be read by versions of leveldb that predate it.
+    CompressionType log_compression = kNoCompression;
+    size_t log_compression_min_bytes = 256;
+
+    // Compression level for kZstdCompression. Higher levels compress better
+    // but slower.
+    int zstd_compression_level = 1;
+
+    // If non-zero, tables also get a learned index: a piecewise-linear
+    // model from keys to data blocks that is off by at most this many
+    // blocks. Batched lookups (DB::MultiGet) in a table that has one go
+    // straight to the block the model predicts instead of seeking the
+    // index block; Get() and iterators still use the index block. The
+    // model reads the first 8 bytes of a user key as a big-endian integer,
+    // so it fits keys that are fixed-width integers or start with one,
+    // spread fairly evenly; the more irregular the keys, the more segments
+    // the model needs. Tables with a learned index can still be read by
+    // versions of leveldb that predate it.
+    //
+    // Ignored unless comparator is the bytewise comparator, both when
+    // tables are built and when they are read.
+    int learned_index_max_error = 0;
+
+    // If non-zero, each data block of a table gets a hash index from the
+    // user keys of its entries to the restart interval they are in, with
+    // this many keys per bucket on average, so a point lookup in a block
+    // goes straight to the restart point of its key instead of
+    // binary-searching the restart array. The index takes one byte per
+    // bucket, so 0.75 costs about 4 bytes for every 3 entries. Blocks of
+    // more than 253 restart intervals are written without one. Tables with
+    // hash indexes can not be read by versions of leveldb that predate them.
+    //
+    // REQUIRES: comparator is the bytewise comparator, if set
+    double data_block_hash_table_util_ratio = 0;
+
+    // If true, a write is carried out in two pipelined stages: the log
+    // append of one batch group may proceed while the previous group is
+    // still being inserted into the memtable. Sequence numbers still become
+    // visible to readers in the order the groups were logged.
+    bool enable_pipelined_write = false;
+
+    // If true, every writer of a batch group inserts its own batch into
+    // the memtable in parallel with the others, instead of the group leader
+    // inserting the whole group. Each writer then allocates from a small
+    // block of its own, which only takes the arena's lock to refill, so
+    // this mostly pays off with many concurrent writers.
+    bool allow_concurrent_memtable_write = false;
+
+    // If true, the leader of a batch group only submits the log write (and
+    // the log sync of a sync write) and hands the writer queue to the next
+    // leader while the I/O is in flight. The group waits for its log I/O
+    // in the memtable stage, before its writes become visible, so writes go
+    // through the pipelined path as with enable_pipelined_write. Uses
+    // io_uring where leveldb was built with it, otherwise the log is
+    // written synchronously as usual.
+    bool enable_async_log_write = false;
+
+    // Upper bound on how long the leader of a batch group made of sync
+    // writes may wait for more writers to join before it syncs the log.
+    // The actual wait adapts to the recently observed sync latency: it is
+    // only worth holding a write back for a fraction of what one sync costs.
+    // 0 disables the commit window.
+    uint64_t group_commit_max_delay_micros = 0;
+
+    // Size at which a sync batch group stops waiting for more writers and
+    // at which it stops growing. Only used when the commit window is enabled.
+    size_t group_commit_max_bytes = 1 << 20;
+
+    // Ingest rate, in bytes per second, that writes are paced at once the
+    // number of level-0 files reaches the slowdown trigger or the estimated
+    // pending compaction bytes reach the soft limit. The rate drops
+    // linearly towards 1/32 of this value as the tree approaches the level-0
+    // stop trigger or the hard limit, where writes stop altogether.
+    uint64_t delayed_write_rate = 16 << 20;
+
+    // Pending compaction bytes at which writes start being paced. 0 disables
+    // this signal, leaving only the level-0 file count.
+    uint64_t soft_pending_compaction_bytes_limit = 64ull << 30;
+
+    // Pending compaction bytes at which writes stop until compactions
+    // catch up.
+    uint64_t hard_pending_compaction_bytes_limit = 256ull << 30;
 };
 
 struct LEVELDB_EXPORT WriteOptions {
     WriteOptions() = default;
+
+    // If true, the write will be flushed from the operating system
+    // buffer cache (by calling WritableFile::Sync()) before the write
+    // is considered complete.  If this flag is true, writes will be
+    // slower.
+    bool sync = false;
+
+    // If non-null, set to the number of micro-seconds this write was held
+    // back to let compactions catch up.
+    uint64_t* delay_micros = nullptr;
 };
 
 struct LEVELDB_EXPORT ReadOptions {
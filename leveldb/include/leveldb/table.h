@@ -1,6 +1,7 @@
 #ifndef STORAGE_LEVELDB_INCLUDE_TABLE_H_
 #define STORAGE_LEVELDB_INCLUDE_TABLE_H_
 
+#include <stddef.h>
 #include <stdint.h>
 
 #include "leveldb/export.h"
@@ -9,6 +10,7 @@
 namespace leveldb {
 
 class Block;
+struct BlockContents;
 class BlockHandle;
 class Footer;
 class Options;
@@ -44,6 +46,12 @@ public:
     // must call one Seek on the iterator before using it)
     Iterator* NewIterator(const ReadOptions&) const;
 
+    // return a new iterator over the range tombstones of the table, keyed
+    // by the internal key each range begins at, with the user key it ends
+    // before as the value. Returns nullptr if the table has none, and an
+    // iterator with a non-ok status if they could not be read.
+    Iterator* NewRangeTombstoneIterator(const ReadOptions&) const;
+
     // given a key, return an approximate byte offset in the file where the data
     // for that key begins (or would begin if the key were present in the file). the 
     // returned value is in terms of file bytes, and so includes effects like compression of
@@ -55,15 +63,34 @@ private:
     struct Rep;
 
     static Iterator* BlockReader(void*, const ReadOptions&, const Slice&);
+    // an iterator over the block at "handle" if the block cache has it,
+    // else nullptr
+    Iterator* CachedBlockIterator(const BlockHandle& handle) const;
+    // an iterator over the block at "handle", just read into "contents".
+    // Adds the block to the block cache, if "options" allow it
+    Iterator* NewBlockIterator(const ReadOptions& options, const BlockHandle& handle,
+                               const BlockContents& contents) const;
 
     explicit Table(Rep* rep) : rep_(rep) {}
 
-    // calls (*handle_result)(arg, ...) with the entry found after a call to Seek(key).
-    // may not make such a call if filter policy  says that key is not present
+    // calls (*handle_result)(arg, ...) with the entry found after a call to Seek(key),
+    // then with the entries after it for as long as handle_result returns true,
+    // e.g. to collect merge operands. may not make such a call if filter policy
+    // says that key is not present
     Status InternalGet(const ReadOptions&, const Slice& key, void* arg,
-                       void (*handle_result)(void* arg, const Slice& k, const Slice& v));
+                       bool (*handle_result)(void* arg, const Slice& k, const Slice& v));
+    // InternalGet() for keys[0, n), which must be in order, passing args[i]
+    // along for keys[i]. The filter is checked for all keys before any
+    // block is read, keys that fall into the same data block are looked up
+    // in a single read of it, and the blocks missing from the block cache
+    // are read all at once (see ReadBlocks()). The blocks are found with the
+    // learned index, if the table has one.
+    Status InternalMultiGet(const ReadOptions&, size_t n, const Slice* keys, void* const* args,
+                            bool (*handle_result)(void* arg, const Slice& k, const Slice& v));
     void ReadMeta(const Footer& footer);
     void ReadFilter(const Slice& filter_handle_value);
+    void ReadRangeDelBlock(const Slice& handle_value);
+    void ReadLearnedIndex(const Slice& handle_value);
 
     Rep* const rep_;
 };
@@ -35,6 +35,14 @@ public:
     // REQUIRES : Finish() and Abandon() have not been called
     void Add(const Slice& key, const Slice& value);
 
+    // add a range tombstone: "begin_key" is the internal key the range
+    // starts at, "end_key" the user key it ends before. Tombstones are kept
+    // in a meta block of their own and do not count towards NumEntries().
+    // REQUIRES : begin_key is after the begin_key of any previously added
+    //            tombstone according to comparator.
+    // REQUIRES : Finish() and Abandon() have not been called
+    void AddRangeTombstone(const Slice& begin_key, const Slice& end_key);
+
     void Flush();
 
     Status status() const;
@@ -2,14 +2,14 @@
 #define STORAGE_LEVELDB_INCLUDE_WRITE_BATCH_H_
 
 #include <string>
+#include <vector>
 
 #include "leveldb/export.h"
+#include "leveldb/slice.h"
 #include "leveldb/status.h"
 
 namespace leveldb {
 
-class Slice;
-
 class LEVELDB_EXPORT WriteBatch {
 public:
     class LEVELDB_EXPORT Handler {
@@ -17,6 +17,11 @@ public:
         virtual ~Handler();
         virtual void Put(const Slice& key, const Slice& value) = 0;
         virtual void Delete(const Slice& key) = 0;
+        // the default ignores range tombstones, so that handlers written
+        // before DeleteRange() existed still compile and replay the rest
+        virtual void DeleteRange(const Slice& begin_key, const Slice& end_key);
+        // likewise ignores merge operands by default
+        virtual void Merge(const Slice& key, const Slice& operand);
     };
 
     WriteBatch();
@@ -29,9 +34,27 @@ public:
 
     void Put(const Slice& key, const Slice& value);
 
+    // like Put(), but a large value is not copied: the batch only keeps a
+    // reference to the bytes of "value", and they go to the log and the
+    // memtable straight from the caller's buffer.
+    //
+    // the caller must keep those bytes alive and unchanged until the batch
+    // is cleared or destroyed, and also until any batch this one has been
+    // Append()ed to is.
+    void PutRef(const Slice& key, const Slice& value);
+
     // if db contains key, erase it, else do noting
     void Delete(const Slice& key);
 
+    // erases every key in ["begin_key", "end_key") with a single range
+    // tombstone, however many keys that is. Does nothing unless
+    // begin_key < end_key.
+    void DeleteRange(const Slice& begin_key, const Slice& end_key);
+
+    // records "operand" for Options::merge_operator to combine with the
+    // value "key" has at that point once the key is read.
+    void Merge(const Slice& key, const Slice& operand);
+
     // clear all buffer in this batch
     void Clear();
 
@@ -46,7 +69,17 @@ public:
 
 private:
     friend class WriteBatchInternal;
+
+    // a value added with PutRef(), which belongs at "offset" of rep_
+    // (right after its length) but is kept out of it
+    struct ValueRef {
+        size_t offset;
+        Slice value;
+    };
+
     std::string rep_;
+    std::vector<ValueRef> refs_;  // ordered by offset
+    size_t ref_bytes_;            // total size of the referenced values
 };
 
 }  // namespace leveldb
@@ -0,0 +1,80 @@
+#ifndef STORAGE_LEVELDB_INCLUDE_WRITE_BUFFER_MANAGER_H_
+#define STORAGE_LEVELDB_INCLUDE_WRITE_BUFFER_MANAGER_H_
+
+#include <stddef.h>
+
+#include "leveldb/export.h"
+
+namespace leveldb {
+
+class Cache;
+
+// a WriteBufferManager puts the memtables of every DB it is shared with
+// (through Options::write_buffer_manager) under one memory budget. Once
+// the memtables being written to take up most of the budget, the DB with
+// the largest one is asked to flush it, on top of each DB flushing its
+// memtable at its own write_buffer_size.
+//
+// a WriteBufferManager must outlive the DBs that use it. It is safe to use
+// from multiple threads without external synchronization.
+class LEVELDB_EXPORT WriteBufferManager {
+public:
+    // "buffer_size" is the budget for all memtables. 0 only keeps track of
+    // their memory. If "cache" is non-null, memtable memory is also charged
+    // to it, so memtables and cached blocks share the cache's capacity.
+    explicit WriteBufferManager(size_t buffer_size, Cache* cache = nullptr);
+
+    WriteBufferManager(const WriteBufferManager&) = delete;
+    WriteBufferManager& operator=(const WriteBufferManager&) = delete;
+
+    ~WriteBufferManager();
+
+    size_t buffer_size() const;
+
+    // memory of all memtables, including those waiting to be flushed
+    size_t memory_usage() const;
+
+    // memory of the memtables that are still being written to
+    size_t mutable_memtable_memory_usage() const;
+
+    // the rest of this interface is used by DB implementations.
+
+    // a DB whose memtables are charged to the manager
+    class Consumer {
+    public:
+        virtual ~Consumer();
+
+        // memory of the memtable the consumer currently writes to
+        virtual size_t MutableMemoryUsage() const = 0;
+
+        // asks the consumer to switch to a new memtable and flush the
+        // current one soon. Must not block or call into the manager.
+        virtual void RequestFlush() = 0;
+    };
+
+    void Register(Consumer* consumer);
+    void Unregister(Consumer* consumer);
+
+    // memory is reserved as a memtable grows, stops counting as mutable
+    // once the memtable becomes immutable, and is freed with the memtable.
+    void ReserveMem(size_t mem);
+    void ScheduleFreeMem(size_t mem);
+    void FreeMem(size_t mem);
+
+    // true if some memtable should be flushed to stay within the budget
+    bool ShouldFlush() const;
+
+    // finds the registered consumer with the most mutable memory. Returns
+    // true if that is "caller", which should then flush itself; otherwise
+    // asks that consumer to flush and returns false.
+    bool FlushLargest(Consumer* caller);
+
+private:
+    struct Rep;
+
+    Rep* const rep_;
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_WRITE_BUFFER_MANAGER_H_
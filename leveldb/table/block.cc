@@ -0,0 +1,310 @@
+// decodes the blocks generated by block_builder.cc
+
+#include "table/block.h"
+
+#include <algorithm>
+#include <string>
+
+#include "db/dbformat.h"
+#include "leveldb/comparator.h"
+#include "table/data_block_hash_index.h"
+#include "table/format.h"
+#include "util/coding.h"
+
+namespace leveldb {
+
+Block::Block(const BlockContents& contents)
+    : data_(contents.data.data()),
+      size_(contents.data.size()),
+      restart_offset_(0),
+      num_restarts_(0),
+      owned_(contents.heap_allocated),
+      hash_index_(nullptr) {
+    if (size_ < sizeof(uint32_t)) {
+        size_ = 0;  // error marker
+        return;
+    }
+    const uint32_t footer = DecodeFixed32(data_ + size_ - sizeof(uint32_t));
+    size_t limit = size_ - sizeof(uint32_t);  // end of the restart array
+    uint32_t num_buckets = 0;
+    if ((footer & DataBlockHashIndex::kHashIndexFlag) != 0) {
+        if (limit < sizeof(uint32_t)) {
+            size_ = 0;
+            return;
+        }
+        num_buckets = DecodeFixed32(data_ + limit - sizeof(uint32_t));
+        limit -= sizeof(uint32_t);
+        if (num_buckets == 0 || num_buckets > limit) {
+            size_ = 0;
+            return;
+        }
+        limit -= num_buckets;
+    }
+    num_restarts_ = footer & ~DataBlockHashIndex::kHashIndexFlag;
+    if (num_restarts_ > limit / sizeof(uint32_t)) {
+        // the size is too small for num_restarts_
+        size_ = 0;
+        return;
+    }
+    restart_offset_ = static_cast<uint32_t>(limit - num_restarts_ * sizeof(uint32_t));
+    if (num_buckets != 0) {
+        hash_index_ = new DataBlockHashIndex(data_ + limit, num_buckets);
+    }
+}
+
+Block::~Block() {
+    delete hash_index_;
+    if (owned_) {
+        delete[] data_;
+    }
+}
+
+// helper routine: decode the next block entry starting at "p",
+// storing the number of shared key bytes, non_shared key bytes,
+// and the length of the value in "*shared", "*non_shared", and
+// "*value_length", respectively. Will not dereference past "limit".
+//
+// if any errors are detected, returns nullptr. Otherwise, returns a
+// pointer to the key delta (just past the three decoded values).
+static inline const char* DecodeEntry(const char* p, const char* limit, uint32_t* shared,
+                                      uint32_t* non_shared, uint32_t* value_length) {
+    if (limit - p < 3) return nullptr;
+    *shared = reinterpret_cast<const uint8_t*>(p)[0];
+    *non_shared = reinterpret_cast<const uint8_t*>(p)[1];
+    *value_length = reinterpret_cast<const uint8_t*>(p)[2];
+    if ((*shared | *non_shared | *value_length) < 128) {
+        // fast path: all three values are encoded in one byte each
+        p += 3;
+    } else {
+        if ((p = GetVarint32Ptr(p, limit, shared)) == nullptr) return nullptr;
+        if ((p = GetVarint32Ptr(p, limit, non_shared)) == nullptr) return nullptr;
+        if ((p = GetVarint32Ptr(p, limit, value_length)) == nullptr) return nullptr;
+    }
+
+    if (static_cast<uint32_t>(limit - p) < (*non_shared + *value_length)) {
+        return nullptr;
+    }
+    return p;
+}
+
+class Block::Iter : public Iterator {
+public:
+    Iter(const Comparator* comparator, const char* data, uint32_t restarts,
+         uint32_t num_restarts, const DataBlockHashIndex* hash_index)
+        : comparator_(comparator),
+          data_(data),
+          restarts_(restarts),
+          num_restarts_(num_restarts),
+          hash_index_(hash_index),
+          current_(restarts_),
+          restart_index_(num_restarts_) {
+        assert(num_restarts_ > 0);
+    }
+
+    bool Valid() const override { return current_ < restarts_; }
+    Status status() const override { return status_; }
+    Slice key() const override {
+        assert(Valid());
+        return key_;
+    }
+    Slice value() const override {
+        assert(Valid());
+        return value_;
+    }
+
+    void Next() override {
+        assert(Valid());
+        ParseNextKey();
+    }
+
+    void Prev() override {
+        assert(Valid());
+
+        // scan backwards to a restart point before current_
+        const uint32_t original = current_;
+        while (GetRestartPoint(restart_index_) >= original) {
+            if (restart_index_ == 0) {
+                // no more entries
+                current_ = restarts_;
+                restart_index_ = num_restarts_;
+                return;
+            }
+            restart_index_--;
+        }
+
+        SeekToRestartPoint(restart_index_);
+        do {
+            // loop until end of current entry hits the start of original entry
+        } while (ParseNextKey() && NextEntryOffset() < original);
+    }
+
+    void Seek(const Slice& target) override {
+        if (hash_index_ != nullptr && SeekWithHashIndex(target)) {
+            return;
+        }
+
+        // binary search in restart array to find the last restart point
+        // with a key < target
+        uint32_t left = 0;
+        uint32_t right = num_restarts_ - 1;
+        while (left < right) {
+            uint32_t mid = (left + right + 1) / 2;
+            uint32_t region_offset = GetRestartPoint(mid);
+            uint32_t shared, non_shared, value_length;
+            const char* key_ptr = DecodeEntry(data_ + region_offset, data_ + restarts_, &shared,
+                                              &non_shared, &value_length);
+            if (key_ptr == nullptr || (shared != 0)) {
+                CorruptionError();
+                return;
+            }
+            Slice mid_key(key_ptr, non_shared);
+            if (Compare(mid_key, target) < 0) {
+                // key at "mid" is smaller than "target". Therefore all
+                // blocks before "mid" are uninteresting.
+                left = mid;
+            } else {
+                // key at "mid" is >= "target". Therefore all blocks at or
+                // after "mid" are uninteresting.
+                right = mid - 1;
+            }
+        }
+
+        // linear search (within restart block) for first key >= target
+        SeekToRestartPoint(left);
+        while (true) {
+            if (!ParseNextKey()) {
+                return;
+            }
+            if (Compare(key_, target) >= 0) {
+                return;
+            }
+        }
+    }
+
+    void SeekToFirst() override {
+        SeekToRestartPoint(0);
+        ParseNextKey();
+    }
+
+    void SeekToLast() override {
+        SeekToRestartPoint(num_restarts_ - 1);
+        while (ParseNextKey() && NextEntryOffset() < restarts_) {
+            // keep skipping
+        }
+    }
+
+private:
+    inline int Compare(const Slice& a, const Slice& b) const {
+        return comparator_->Compare(a, b);
+    }
+
+    // return the offset in data_ just past the end of the current entry
+    inline uint32_t NextEntryOffset() const {
+        return static_cast<uint32_t>((value_.data() + value_.size()) - data_);
+    }
+
+    uint32_t GetRestartPoint(uint32_t index) {
+        assert(index < num_restarts_);
+        return DecodeFixed32(data_ + restarts_ + index * sizeof(uint32_t));
+    }
+
+    void SeekToRestartPoint(uint32_t index) {
+        key_.clear();
+        restart_index_ = index;
+        // current_ will be fixed by ParseNextKey();
+
+        // ParseNextKey() starts at the end of value_, so set value_ accordingly
+        uint32_t offset = GetRestartPoint(index);
+        value_ = Slice(data_ + offset, 0);
+    }
+
+    // Seek() for a target whose user key the hash index knows the restart
+    // interval of. Scans from the start of that interval, which is where
+    // the binary search would have led if the user key is in the block.
+    // Returns false, for Seek() to fall back to the binary search, if the
+    // hash index does not know the interval or the entry found does not
+    // have the user key of the target, in which case the scan may have
+    // started past the first entry >= target.
+    bool SeekWithHashIndex(const Slice& target) {
+        if (target.size() < 8) {
+            return false;
+        }
+        const Slice user_key = ExtractUserKey(target);
+        const uint8_t restart_index = hash_index_->Lookup(user_key);
+        if (restart_index >= num_restarts_) {
+            return false;  // kNoEntry, kCollision, or a corrupt bucket
+        }
+        SeekToRestartPoint(restart_index);
+        while (ParseNextKey()) {
+            if (Compare(key_, target) >= 0) {
+                return ExtractUserKey(key_) == user_key;
+            }
+        }
+        // ran off the block, or hit corruption and left the iterator
+        // invalid with the error
+        return !status_.ok();
+    }
+
+    void CorruptionError() {
+        current_ = restarts_;
+        restart_index_ = num_restarts_;
+        status_ = Status::Corruption("bad entry in block");
+        key_.clear();
+        value_.clear();
+    }
+
+    bool ParseNextKey() {
+        current_ = NextEntryOffset();
+        const char* p = data_ + current_;
+        const char* limit = data_ + restarts_;  // restarts come right after data
+        if (p >= limit) {
+            // no more entries to return. mark as invalid
+            current_ = restarts_;
+            restart_index_ = num_restarts_;
+            return false;
+        }
+
+        // decode next entry
+        uint32_t shared, non_shared, value_length;
+        p = DecodeEntry(p, limit, &shared, &non_shared, &value_length);
+        if (p == nullptr || key_.size() < shared) {
+            CorruptionError();
+            return false;
+        } else {
+            key_.resize(shared);
+            key_.append(p, non_shared);
+            value_ = Slice(p + non_shared, value_length);
+            while (restart_index_ + 1 < num_restarts_ &&
+                   GetRestartPoint(restart_index_ + 1) < current_) {
+                ++restart_index_;
+            }
+            return true;
+        }
+    }
+
+    const Comparator* const comparator_;
+    const char* const data_;       // underlying block contents
+    uint32_t const restarts_;      // offset of restart array (list of fixed32)
+    uint32_t const num_restarts_;  // number of uint32_t entries in restart array
+    // nullptr if the block has no hash index
+    const DataBlockHashIndex* const hash_index_;
+
+    // current_ is offset in data_ of current entry. >= restarts_ if !Valid
+    uint32_t current_;
+    uint32_t restart_index_;  // index of restart block in which current_ falls
+    std::string key_;
+    Slice value_;
+    Status status_;
+};
+
+Iterator* Block::NewIterator(const Comparator* comparator) {
+    if (size_ < sizeof(uint32_t)) {
+        return NewErrorIterator(Status::Corruption("bad block contents"));
+    }
+    if (num_restarts_ == 0) {
+        return NewEmptyIterator();
+    }
+    return new Iter(comparator, data_, restart_offset_, num_restarts_, hash_index_);
+}
+
+}  // namespace leveldb
@@ -0,0 +1,43 @@
+#ifndef STORAGE_LEVELDB_TABLE_BLOCK_H_
+#define STORAGE_LEVELDB_TABLE_BLOCK_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "leveldb/iterator.h"
+
+namespace leveldb {
+
+struct BlockContents;
+class Comparator;
+class DataBlockHashIndex;
+
+class Block {
+public:
+    // initialize the block with the specified contents
+    explicit Block(const BlockContents& contents);
+
+    Block(const Block&) = delete;
+    Block& operator=(const Block&) = delete;
+
+    ~Block();
+
+    size_t size() const { return size_; }
+    Iterator* NewIterator(const Comparator* comparator);
+
+private:
+    class Iter;
+
+    const char* data_;
+    size_t size_;
+    uint32_t restart_offset_;  // offset in data_ of restart array
+    uint32_t num_restarts_;
+    bool owned_;               // block owns data_[]
+    // nullptr unless the block has a hash index (see
+    // table/data_block_hash_index.h)
+    DataBlockHashIndex* hash_index_;
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_TABLE_BLOCK_H_
@@ -0,0 +1,133 @@
+// BlockBuilder generates blocks where keys are prefix-compressed:
+//
+// when we store a key, we drop the prefix shared with the previous
+// string. This helps reduce the space requirement significantly.
+// furthermore, once every K keys, we do not apply the prefix
+// compression and store the entire key. We call this a "restart
+// point". The tail end of the block stores the offsets of all of the
+// restart points, and can be used to do a binary search when looking
+// for a particular key. Values are stored as-is (without compression)
+// immediately following the corresponding key.
+//
+// an entry for a particular key-value pair has the form:
+//     shared_bytes: varint32
+//     unshared_bytes: varint32
+//     value_length: varint32
+//     key_delta: char[unshared_bytes]
+//     value: char[value_length]
+// shared_bytes == 0 for restart points.
+//
+// the trailer of the block has the form:
+//     restarts: uint32[num_restarts]
+//     num_restarts: uint32
+// restarts[i] contains the offset within the block of the ith restart point.
+//
+// if options.data_block_hash_table_util_ratio is set, a hash index goes
+// between the restarts and num_restarts (see table/data_block_hash_index.h).
+
+#include "table/block_builder.h"
+
+#include <assert.h>
+
+#include <algorithm>
+
+#include "db/dbformat.h"
+#include "leveldb/comparator.h"
+#include "leveldb/options.h"
+#include "util/coding.h"
+
+namespace leveldb {
+
+BlockBuilder::BlockBuilder(const Options* options)
+    : options_(options),
+      restarts_(),
+      counter_(0),
+      finished_(false),
+      use_hash_index_(options->data_block_hash_table_util_ratio > 0),
+      internal_keys_(true),
+      hash_index_(options->data_block_hash_table_util_ratio) {
+    assert(options->block_restart_interval >= 1);
+    restarts_.push_back(0);  // first restart point is at offset 0
+}
+
+void BlockBuilder::Reset() {
+    buffer_.clear();
+    restarts_.clear();
+    restarts_.push_back(0);  // first restart point is at offset 0
+    counter_ = 0;
+    finished_ = false;
+    last_key_.clear();
+    internal_keys_ = true;
+    hash_index_.Reset();
+}
+
+size_t BlockBuilder::CurrentSizeEstimate() const {
+    size_t estimate = buffer_.size() +                       // raw data buffer
+                      restarts_.size() * sizeof(uint32_t) +  // restart array
+                      sizeof(uint32_t);                      // restart array length
+    if (use_hash_index_ && internal_keys_ && hash_index_.Valid()) {
+        estimate += hash_index_.EstimateSize();
+    }
+    return estimate;
+}
+
+Slice BlockBuilder::Finish() {
+    // append restart array
+    for (size_t i = 0; i < restarts_.size(); i++) {
+        PutFixed32(&buffer_, restarts_[i]);
+    }
+    uint32_t footer = static_cast<uint32_t>(restarts_.size());
+    if (use_hash_index_ && internal_keys_ && hash_index_.Valid()) {
+        hash_index_.Finish(&buffer_);
+        footer |= DataBlockHashIndex::kHashIndexFlag;
+    }
+    PutFixed32(&buffer_, footer);
+    finished_ = true;
+    return Slice(buffer_);
+}
+
+void BlockBuilder::Add(const Slice& key, const Slice& value) {
+    Slice last_key_piece(last_key_);
+    assert(!finished_);
+    assert(counter_ <= options_->block_restart_interval);
+    assert(buffer_.empty()  // no values yet?
+           || options_->comparator->Compare(key, last_key_piece) > 0);
+    size_t shared = 0;
+    if (counter_ < options_->block_restart_interval) {
+        // see how much sharing to do with previous string
+        const size_t min_length = std::min(last_key_piece.size(), key.size());
+        while ((shared < min_length) && (last_key_piece[shared] == key[shared])) {
+            shared++;
+        }
+    } else {
+        // restart compression
+        restarts_.push_back(static_cast<uint32_t>(buffer_.size()));
+        counter_ = 0;
+    }
+    const size_t non_shared = key.size() - shared;
+
+    if (use_hash_index_ && internal_keys_) {
+        if (key.size() >= 8) {
+            hash_index_.Add(ExtractUserKey(key), restarts_.size() - 1);
+        } else {
+            internal_keys_ = false;
+        }
+    }
+
+    // add "<shared><non_shared><value_size>" to buffer_
+    PutVarint32(&buffer_, static_cast<uint32_t>(shared));
+    PutVarint32(&buffer_, static_cast<uint32_t>(non_shared));
+    PutVarint32(&buffer_, static_cast<uint32_t>(value.size()));
+
+    // add string delta to buffer_ followed by value
+    buffer_.append(key.data() + shared, non_shared);
+    buffer_.append(value.data(), value.size());
+
+    // update state
+    last_key_.resize(shared);
+    last_key_.append(key.data() + shared, non_shared);
+    assert(Slice(last_key_) == key);
+    counter_++;
+}
+
+}  // namespace leveldb
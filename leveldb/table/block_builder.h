@@ -4,6 +4,7 @@
 #include <vector>
 
 #include "leveldb/slice.h"
+#include "table/data_block_hash_index.h"
 
 namespace leveldb {
 
@@ -36,6 +37,13 @@ private:
     int counter_;                       // Number of entries emitted since restart
     bool finished_;                     // Has Finish() been called?
     std::string last_key_;
+    // whether the block gets a hash index over the user keys of its
+    // entries, which then must be internal keys
+    const bool use_hash_index_;
+    // false once a key too short to be an internal key was added, which
+    // leaves the block without a hash index
+    bool internal_keys_;
+    DataBlockHashIndexBuilder hash_index_;
 };
 
 }  // namespace leveldb
@@ -0,0 +1,151 @@
+#include "table/block.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "db/dbformat.h"
+#include "leveldb/comparator.h"
+#include "leveldb/iterator.h"
+#include "leveldb/options.h"
+#include "table/block_builder.h"
+#include "table/data_block_hash_index.h"
+#include "table/format.h"
+#include "util/coding.h"
+
+namespace leveldb {
+
+static std::string UserKey(int i) {
+    char buf[100];
+    std::snprintf(buf, sizeof(buf), "key%06d", i);
+    return std::string(buf);
+}
+
+// whether the block "contents" ends in a hash index
+static bool HasHashIndex(const Slice& contents) {
+    const uint32_t footer = DecodeFixed32(contents.data() + contents.size() - 4);
+    return (footer & DataBlockHashIndex::kHashIndexFlag) != 0;
+}
+
+class BlockTest : public testing::Test {
+public:
+    BlockTest() : icmp_(BytewiseComparator()) {
+        options_.comparator = &icmp_;
+        options_.block_restart_interval = 4;
+    }
+
+    // a block of the entries of "keys", as BlockBuilder writes it
+    Slice Build(const std::vector<std::string>& keys) {
+        BlockBuilder builder(&options_);
+        for (size_t i = 0; i < keys.size(); i++) {
+            builder.Add(keys[i], "v" + std::to_string(i));
+        }
+        contents_ = builder.Finish().ToString();
+        return Slice(contents_);
+    }
+
+    // internal keys for the even user keys, each at two sequence numbers
+    std::vector<std::string> EvenKeys(int n) {
+        std::vector<std::string> keys;
+        for (int i = 0; i < n; i += 2) {
+            keys.push_back(InternalKey(UserKey(i), 200, kTypeValue).Encode().ToString());
+            keys.push_back(InternalKey(UserKey(i), 100, kTypeValue).Encode().ToString());
+        }
+        return keys;
+    }
+
+    // checks that seeking the block finds what the binary search does
+    void CheckSeeks(const Slice& contents, int n) {
+        BlockContents block_contents;
+        block_contents.data = contents;
+        block_contents.cachable = false;
+        block_contents.heap_allocated = false;
+        Block block(block_contents);
+        Iterator* iter = block.NewIterator(&icmp_);
+        for (int i = 0; i < n + 1; i++) {
+            for (SequenceNumber seq : {SequenceNumber(300), SequenceNumber(150),
+                                       SequenceNumber(50)}) {
+                const InternalKey target(UserKey(i), seq, kValueTypeForSeek);
+                iter->Seek(target.Encode());
+                ASSERT_TRUE(iter->status().ok());
+                // the first entry at or past the target: the newer entry
+                // of the next even key, unless an entry of key i is old
+                // enough
+                int k = (i % 2 == 0) ? i : i + 1;
+                SequenceNumber expected = 200;
+                if (k == i && seq < 200) {
+                    if (seq >= 100) {
+                        expected = 100;
+                    } else {
+                        k += 2;
+                    }
+                }
+                if (k >= n) {
+                    ASSERT_FALSE(iter->Valid()) << i;
+                    continue;
+                }
+                ASSERT_TRUE(iter->Valid()) << i;
+                ParsedInternalKey parsed;
+                ASSERT_TRUE(ParseInternalKey(iter->key(), &parsed));
+                ASSERT_EQ(UserKey(k), parsed.user_key.ToString()) << i << " " << seq;
+                ASSERT_EQ(expected, parsed.sequence) << i << " " << seq;
+            }
+        }
+        delete iter;
+    }
+
+    InternalKeyComparator icmp_;
+    Options options_;
+    std::string contents_;
+};
+
+TEST_F(BlockTest, WithoutHashIndex) {
+    const Slice contents = Build(EvenKeys(200));
+    ASSERT_FALSE(HasHashIndex(contents));
+    CheckSeeks(contents, 200);
+}
+
+TEST_F(BlockTest, HashIndex) {
+    options_.data_block_hash_table_util_ratio = 0.75;
+    const Slice contents = Build(EvenKeys(200));
+    ASSERT_TRUE(HasHashIndex(contents));
+    CheckSeeks(contents, 200);
+}
+
+TEST_F(BlockTest, TooManyRestartsForHashIndex) {
+    options_.data_block_hash_table_util_ratio = 0.75;
+    options_.block_restart_interval = 1;
+    const Slice contents = Build(EvenKeys(600));
+    ASSERT_FALSE(HasHashIndex(contents));
+    CheckSeeks(contents, 600);
+}
+
+TEST_F(BlockTest, ShortKeysGetNoHashIndex) {
+    // keys too short to be internal keys, as in meta blocks, leave the
+    // block without a hash index instead of being read past
+    options_.comparator = BytewiseComparator();
+    options_.data_block_hash_table_util_ratio = 0.75;
+    std::vector<std::string> keys = {"a", "b", "c"};
+    Slice contents = Build(keys);
+    ASSERT_FALSE(HasHashIndex(contents));
+
+    // and so does a single short key among longer ones
+    keys = {"a", "bbbbbbbbbbbb", "cccccccccccc"};
+    contents = Build(keys);
+    ASSERT_FALSE(HasHashIndex(contents));
+}
+
+TEST_F(BlockTest, ResetAllowsHashIndexAgain) {
+    options_.data_block_hash_table_util_ratio = 0.75;
+    BlockBuilder builder(&options_);
+    builder.Add("a", "v");
+    ASSERT_FALSE(HasHashIndex(builder.Finish()));
+    builder.Reset();
+    for (const std::string& key : EvenKeys(20)) {
+        builder.Add(key, "v");
+    }
+    ASSERT_TRUE(HasHashIndex(builder.Finish()));
+}
+
+}  // namespace leveldb
@@ -0,0 +1,69 @@
+#include "table/data_block_hash_index.h"
+
+#include <assert.h>
+
+#include "util/coding.h"
+#include "util/hash.h"
+
+namespace leveldb {
+
+const uint8_t DataBlockHashIndex::kNoEntry;
+const uint8_t DataBlockHashIndex::kCollision;
+const uint8_t DataBlockHashIndex::kMaxRestarts;
+const uint32_t DataBlockHashIndex::kHashIndexFlag;
+
+uint32_t DataBlockHash(const Slice& user_key) {
+    return Hash(user_key.data(), user_key.size(), 0x7c0e3a1b);
+}
+
+DataBlockHashIndexBuilder::DataBlockHashIndexBuilder(double util_ratio)
+    : bucket_per_key_(util_ratio > 0 ? 1 / util_ratio : 1), valid_(true) {}
+
+void DataBlockHashIndexBuilder::Add(const Slice& user_key, size_t restart_index) {
+    if (restart_index > DataBlockHashIndex::kMaxRestarts) {
+        valid_ = false;
+        return;
+    }
+    hash_and_restart_.emplace_back(DataBlockHash(user_key),
+                                   static_cast<uint8_t>(restart_index));
+}
+
+size_t DataBlockHashIndexBuilder::NumBuckets() const {
+    size_t num_buckets = static_cast<size_t>(hash_and_restart_.size() * bucket_per_key_);
+    if (num_buckets == 0) {
+        num_buckets = 1;
+    }
+    // an odd number spreads the hashes better than a power of two would
+    return num_buckets | 1;
+}
+
+void DataBlockHashIndexBuilder::Finish(std::string* buffer) {
+    assert(valid_);
+    const size_t num_buckets = NumBuckets();
+    std::vector<uint8_t> buckets(num_buckets, DataBlockHashIndex::kNoEntry);
+    for (const auto& entry : hash_and_restart_) {
+        uint8_t& bucket = buckets[entry.first % num_buckets];
+        if (bucket == DataBlockHashIndex::kNoEntry) {
+            bucket = entry.second;
+        } else if (bucket != entry.second) {
+            bucket = DataBlockHashIndex::kCollision;
+        }
+    }
+    buffer->append(reinterpret_cast<const char*>(buckets.data()), num_buckets);
+    PutFixed32(buffer, static_cast<uint32_t>(num_buckets));
+}
+
+size_t DataBlockHashIndexBuilder::EstimateSize() const {
+    return NumBuckets() + sizeof(uint32_t);
+}
+
+void DataBlockHashIndexBuilder::Reset() {
+    valid_ = true;
+    hash_and_restart_.clear();
+}
+
+uint8_t DataBlockHashIndex::Lookup(const Slice& user_key) const {
+    return static_cast<uint8_t>(buckets_[DataBlockHash(user_key) % num_buckets_]);
+}
+
+}  // namespace leveldb
@@ -0,0 +1,90 @@
+#ifndef STORAGE_LEVELDB_TABLE_DATA_BLOCK_HASH_INDEX_H_
+#define STORAGE_LEVELDB_TABLE_DATA_BLOCK_HASH_INDEX_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "leveldb/slice.h"
+
+namespace leveldb {
+
+// a hash index inside a data block maps the user key of an entry to the
+// restart interval that holds it, so a point lookup can jump to that
+// restart point instead of binary-searching the restart array.
+//
+// the index is a table of one byte buckets, each holding the restart
+// index of the keys that hash to it, kNoEntry if none do, or kCollision
+// if keys of different restart intervals do. All entries of a user key
+// that is in the block are in the interval its bucket names, unless the
+// bucket is a collision.
+//
+// a block with a hash index ends in:
+//    restarts: num_restarts * fixed32
+//    buckets: num_buckets * uint8
+//    num_buckets: fixed32
+//    footer: fixed32, num_restarts with kHashIndexFlag set
+//
+// blocks of more than kMaxRestarts restart intervals get no hash index.
+class DataBlockHashIndexBuilder {
+public:
+    // "util_ratio" is the number of keys per bucket
+    explicit DataBlockHashIndexBuilder(double util_ratio);
+
+    DataBlockHashIndexBuilder(const DataBlockHashIndexBuilder&) = delete;
+    DataBlockHashIndexBuilder& operator=(const DataBlockHashIndexBuilder&) = delete;
+
+    // false once a key of a restart interval past kMaxRestarts was added
+    bool Valid() const { return valid_; }
+
+    void Add(const Slice& user_key, size_t restart_index);
+
+    // appends the buckets and num_buckets to *buffer
+    // REQUIRES: Valid()
+    void Finish(std::string* buffer);
+
+    // the number of bytes Finish() would append
+    size_t EstimateSize() const;
+
+    void Reset();
+
+private:
+    size_t NumBuckets() const;
+
+    const double bucket_per_key_;
+    bool valid_;
+    std::vector<std::pair<uint32_t, uint8_t>> hash_and_restart_;
+};
+
+class DataBlockHashIndex {
+public:
+    static const uint8_t kNoEntry = 255;
+    static const uint8_t kCollision = 254;
+    static const uint8_t kMaxRestarts = 253;
+    static const uint32_t kHashIndexFlag = 1u << 31;
+
+    // REQUIRES: "buckets" outlives the index
+    DataBlockHashIndex(const char* buckets, uint32_t num_buckets)
+        : buckets_(buckets), num_buckets_(num_buckets) {}
+
+    DataBlockHashIndex(const DataBlockHashIndex&) = delete;
+    DataBlockHashIndex& operator=(const DataBlockHashIndex&) = delete;
+
+    // the restart index of the interval that holds "user_key" if it is in
+    // the block, kNoEntry if it is not, or kCollision if that is not known
+    uint8_t Lookup(const Slice& user_key) const;
+
+private:
+    const char* const buckets_;
+    const uint32_t num_buckets_;
+};
+
+// hashes keys to buckets for both the builder and the index
+uint32_t DataBlockHash(const Slice& user_key);
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_TABLE_DATA_BLOCK_HASH_INDEX_H_
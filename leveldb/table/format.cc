@@ -0,0 +1,137 @@
+#include "table/format.h"
+
+#include <vector>
+
+#include "leveldb/env.h"
+#include "leveldb/options.h"
+#include "port/port.h"
+#include "util/coding.h"
+#include "util/crc32c.h"
+
+namespace leveldb {
+
+// checks the trailer of the block that "handle" points to and uncompresses
+// it, given "contents", the bytes read for it. Takes ownership of "buf",
+// the scratch space they were read into.
+static Status DecodeBlock(const BlockHandle& handle, const ReadOptions& options,
+                          const Slice& contents, char* buf, BlockContents* result) {
+    result->data = Slice();
+    result->cachable = false;
+    result->heap_allocated = false;
+
+    const size_t n = static_cast<size_t>(handle.size());
+    if (contents.size() != n + kBlockTrailerSize) {
+        delete[] buf;
+        return Status::Corruption("truncated block read");
+    }
+
+    // check the crc of the type and the block contents
+    const char* data = contents.data();  // pointer to where Read put the data
+    if (options.verify_checksums) {
+        const uint32_t crc = crc32c::Unmask(DecodeFixed32(data + n + 1));
+        const uint32_t actual = crc32c::Value(data, n + 1);
+        if (actual != crc) {
+            delete[] buf;
+            return Status::Corruption("block checksum mismatch");
+        }
+    }
+
+    size_t ulength = 0;
+    switch (static_cast<CompressionType>(data[n])) {
+        case kNoCompression:
+            if (data != buf) {
+                // file implementation gave us pointer to some other data.
+                // use it directly under the assumption that it will be live
+                // while the file is open.
+                delete[] buf;
+                result->data = Slice(data, n);
+                result->heap_allocated = false;
+                result->cachable = false;  // do not double-cache
+            } else {
+                result->data = Slice(buf, n);
+                result->heap_allocated = true;
+                result->cachable = true;
+            }
+            return Status::OK();
+        case kSnappyCompression: {
+            if (!port::Snappy_GetUncompressedLength(data, n, &ulength)) {
+                delete[] buf;
+                return Status::Corruption("corrupted compressed block contents");
+            }
+            char* ubuf = new char[ulength];
+            if (!port::Snappy_Uncompress(data, n, ubuf)) {
+                delete[] buf;
+                delete[] ubuf;
+                return Status::Corruption("corrupted compressed block contents");
+            }
+            delete[] buf;
+            result->data = Slice(ubuf, ulength);
+            result->heap_allocated = true;
+            result->cachable = true;
+            return Status::OK();
+        }
+        case kZstdCompression: {
+            if (!port::Zstd_GetUncompressedLength(data, n, &ulength)) {
+                delete[] buf;
+                return Status::Corruption("corrupted compressed block contents");
+            }
+            char* ubuf = new char[ulength];
+            if (!port::Zstd_Uncompress(data, n, ubuf)) {
+                delete[] buf;
+                delete[] ubuf;
+                return Status::Corruption("corrupted compressed block contents");
+            }
+            delete[] buf;
+            result->data = Slice(ubuf, ulength);
+            result->heap_allocated = true;
+            result->cachable = true;
+            return Status::OK();
+        }
+        default:
+            delete[] buf;
+            return Status::Corruption("bad block type");
+    }
+}
+
+Status ReadBlock(RandomAccessFile* file, const ReadOptions& options,
+                 const BlockHandle& handle, BlockContents* result) {
+    // read the block contents as well as the type/crc footer.
+    const size_t n = static_cast<size_t>(handle.size());
+    char* buf = new char[n + kBlockTrailerSize];
+    Slice contents;
+    Status s = file->Read(handle.offset(), n + kBlockTrailerSize, &contents, buf);
+    if (!s.ok()) {
+        delete[] buf;
+        result->data = Slice();
+        result->cachable = false;
+        result->heap_allocated = false;
+        return s;
+    }
+    return DecodeBlock(handle, options, contents, buf, result);
+}
+
+void ReadBlocks(RandomAccessFile* file, const ReadOptions& options, size_t n,
+                const BlockHandle* handles, BlockContents* results, Status* statuses) {
+    std::vector<RandomAccessFile::ReadRequest> reqs(n);
+    for (size_t i = 0; i < n; i++) {
+        const size_t size = static_cast<size_t>(handles[i].size()) + kBlockTrailerSize;
+        reqs[i].offset = handles[i].offset();
+        reqs[i].n = size;
+        reqs[i].scratch = new char[size];
+    }
+    file->MultiRead(reqs.data(), n);
+    for (size_t i = 0; i < n; i++) {
+        if (!reqs[i].status.ok()) {
+            delete[] reqs[i].scratch;
+            results[i].data = Slice();
+            results[i].cachable = false;
+            results[i].heap_allocated = false;
+            statuses[i] = reqs[i].status;
+        } else {
+            statuses[i] = DecodeBlock(handles[i], options, reqs[i].result, reqs[i].scratch,
+                                      &results[i]);
+        }
+    }
+}
+
+}  // namespace leveldb
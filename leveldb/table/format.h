@@ -1,8 +1,11 @@
 #ifndef STORAGE_LEVELDB_TABLE_FORMAT_H_
 #define STORAGE_LEVELDB_TABLE_FORMAT_H_
 
+#include <stddef.h>
 #include <stdint.h>
 
+#include <string>
+
 #include "leveldb/status.h"
 #include "leveldb/slice.h"
 
@@ -37,6 +40,14 @@ private:
     uint64_t size_;
 };
 
+// name of the meta block that holds the range tombstones of a table, if it
+// has any (see db/range_del.h)
+static const char kRangeDelBlockName[] = "leveldb.range_del";
+
+// name of the meta block that holds the learned index of a table, if it
+// has one (see table/learned_index.h)
+static const char kLearnedIndexBlockName[] = "leveldb.learned_index";
+
 // footer encapsulates the fixed information stored at the tail
 // end of every table file.
 class Footer {
@@ -55,6 +66,20 @@ struct BlockContents {
     bool heap_allocated;    // True if caller should delete[] data.data()
 };
 
+// 1-byte type + 32-bit crc
+static const size_t kBlockTrailerSize = 5;
+
+// read the block identified by "handle" from "file". On failure
+// return non-OK. On success fill *result and return OK.
+Status ReadBlock(RandomAccessFile* file, const ReadOptions& options,
+                 const BlockHandle& handle, BlockContents* result);
+
+// ReadBlock() for handles[0, n), storing the outcome of each in results[i]
+// and statuses[i]. The reads are handed to the file together (see
+// RandomAccessFile::MultiRead), so they may all be in flight at once.
+void ReadBlocks(RandomAccessFile* file, const ReadOptions& options, size_t n,
+                const BlockHandle* handles, BlockContents* results, Status* statuses);
+
 }  // namespace leveldb
 
 #endif  // STORAGE_LEVELDB_TABLE_FORMAT_H_
\ No newline at end of file
@@ -0,0 +1,231 @@
+#include "table/learned_index.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "db/dbformat.h"
+#include "leveldb/comparator.h"
+#include "util/coding.h"
+
+namespace leveldb {
+
+// the first 8 bytes of "user_key" as a big-endian number, padded with zeros
+static uint64_t KeyCode(const Slice& user_key) {
+    const size_t n = std::min<size_t>(user_key.size(), 8);
+    uint64_t code = 0;
+    for (size_t i = 0; i < 8; i++) {
+        const uint64_t byte = (i < n) ? static_cast<unsigned char>(user_key[i]) : 0;
+        code = (code << 8) | byte;
+    }
+    return code;
+}
+
+static const size_t kSegmentSize = 8 + 4 + 8;
+
+bool LearnedIndexFits(const Comparator* icmp) {
+    return static_cast<const InternalKeyComparator*>(icmp)->user_comparator() ==
+           BytewiseComparator();
+}
+
+LearnedIndexBuilder::LearnedIndexBuilder(int max_error) : max_error_(std::max(max_error, 0)) {}
+
+void LearnedIndexBuilder::AddBlock(const Slice& last_user_key, const BlockHandle& handle) {
+    if (offsets_.empty()) {
+        offsets_.push_back(handle.offset());
+    }
+    assert(offsets_.back() == handle.offset());
+    codes_.push_back(KeyCode(last_user_key));
+    offsets_.push_back(handle.offset() + handle.size() + kBlockTrailerSize);
+}
+
+Slice LearnedIndexBuilder::Finish() {
+    const size_t n = codes_.size();
+    if (offsets_.empty()) {
+        offsets_.push_back(0);
+    }
+
+    // greedily grow each segment for as long as some line through its
+    // first point stays within max_error_ of every point added: [lo, hi]
+    // is the range of slopes that still do
+    struct Segment {
+        uint64_t first_code;
+        uint32_t first_block;
+        double slope;
+    };
+    std::vector<Segment> segments;
+    const double error = max_error_;
+    const double kInfinity = std::numeric_limits<double>::infinity();
+    size_t start = 0;
+    double lo = -kInfinity;
+    double hi = kInfinity;
+    for (size_t i = 0; i <= n; i++) {
+        bool fits = (i < n);
+        if (fits && i > start) {
+            const double dy = static_cast<double>(i - start);
+            if (codes_[i] == codes_[start]) {
+                fits = (dy <= error);
+            } else {
+                const double dx = static_cast<double>(codes_[i] - codes_[start]);
+                const double new_lo = std::max(lo, (dy - error) / dx);
+                const double new_hi = std::min(hi, (dy + error) / dx);
+                fits = (new_lo <= new_hi);
+                if (fits) {
+                    lo = new_lo;
+                    hi = new_hi;
+                }
+            }
+        }
+        if (!fits && start < n) {
+            Segment segment;
+            segment.first_code = codes_[start];
+            segment.first_block = static_cast<uint32_t>(start);
+            // hi is above 0 once set, so a negative middle can be raised
+            // to 0, keeping the model monotonic
+            segment.slope = (lo == -kInfinity) ? 0 : std::max((lo + hi) / 2, 0.0);
+            segments.push_back(segment);
+            start = i;
+            lo = -kInfinity;
+            hi = kInfinity;
+        }
+    }
+
+    result_.clear();
+    PutFixed32(&result_, static_cast<uint32_t>(max_error_));
+    PutFixed32(&result_, static_cast<uint32_t>(n));
+    for (uint64_t code : codes_) {
+        PutFixed64(&result_, code);
+    }
+    for (uint64_t offset : offsets_) {
+        PutFixed64(&result_, offset);
+    }
+    PutFixed32(&result_, static_cast<uint32_t>(segments.size()));
+    for (const Segment& segment : segments) {
+        uint64_t slope_bits;
+        std::memcpy(&slope_bits, &segment.slope, sizeof(slope_bits));
+        PutFixed64(&result_, segment.first_code);
+        PutFixed32(&result_, segment.first_block);
+        PutFixed64(&result_, slope_bits);
+    }
+    return Slice(result_);
+}
+
+LearnedIndex::LearnedIndex(const Slice& contents) : ok_(false), max_error_(0) {
+    const char* p = contents.data();
+    const char* limit = p + contents.size();
+    if (limit - p < 8) {
+        return;
+    }
+    max_error_ = DecodeFixed32(p);
+    const uint32_t n = DecodeFixed32(p + 4);
+    p += 8;
+    // n codes and n + 1 offsets, then the segment count
+    if (static_cast<uint64_t>(limit - p) < (2 * static_cast<uint64_t>(n) + 1) * 8 + 4) {
+        return;
+    }
+    codes_.resize(n);
+    for (uint32_t i = 0; i < n; i++, p += 8) {
+        codes_[i] = DecodeFixed64(p);
+    }
+    offsets_.resize(n + 1);
+    for (uint32_t i = 0; i <= n; i++, p += 8) {
+        offsets_[i] = DecodeFixed64(p);
+        if (i > 0 && offsets_[i] < offsets_[i - 1] + kBlockTrailerSize) {
+            return;
+        }
+    }
+    const uint32_t num_segments = DecodeFixed32(p);
+    p += 4;
+    if (static_cast<uint64_t>(limit - p) != num_segments * kSegmentSize ||
+            (n > 0 && num_segments == 0)) {
+        return;
+    }
+    segments_.resize(num_segments);
+    for (uint32_t i = 0; i < num_segments; i++, p += kSegmentSize) {
+        Segment* segment = &segments_[i];
+        segment->first_code = DecodeFixed64(p);
+        segment->first_block = DecodeFixed32(p + 8);
+        const uint64_t slope_bits = DecodeFixed64(p + 12);
+        std::memcpy(&segment->slope, &slope_bits, sizeof(slope_bits));
+        if (segment->first_block >= n ||
+            (i > 0 && (segment->first_block <= segments_[i - 1].first_block ||
+                       segment->first_code < segments_[i - 1].first_code))) {
+            return;
+        }
+    }
+    // FindBlock() relies on the codes being sorted, and on the first
+    // segment covering every key past codes_[0], from the first block on
+    for (uint32_t i = 1; i < n; i++) {
+        if (codes_[i] < codes_[i - 1]) {
+            return;
+        }
+    }
+    if (n > 0 && (segments_[0].first_block != 0 || segments_[0].first_code > codes_[0])) {
+        return;
+    }
+    ok_ = true;
+}
+
+size_t LearnedIndex::FindBlock(const Slice& user_key, bool* exact) const {
+    const size_t n = codes_.size();
+    const uint64_t code = KeyCode(user_key);
+    if (n == 0 || code <= codes_[0]) {
+        *exact = (n == 0 || code != codes_[0]);
+        return 0;
+    }
+
+    // the segment of the key is the last one that starts at or before it.
+    // the block looked for is at or past its first block, and at or before
+    // the first block of the next segment, whose code is past the key's
+    auto after = std::upper_bound(segments_.begin(), segments_.end(), code,
+                                  [](uint64_t c, const Segment& s) { return c < s.first_code; });
+    const Segment& segment = *(after - 1);
+    const double first = segment.first_block;
+    const double last = (after == segments_.end()) ? n : after->first_block;
+
+    // search the codes within the error bound of the prediction. one more
+    // block on either side, since the block looked for is the one after
+    // the last code before the key
+    const double predicted =
+            first + segment.slope * static_cast<double>(code - segment.first_code);
+    const double error = static_cast<double>(max_error_) + 1;
+    const size_t lo = static_cast<size_t>(std::min(std::max(std::floor(predicted - error), first), last));
+    const size_t hi = static_cast<size_t>(std::min(std::max(std::ceil(predicted + error), first), last));
+    size_t block = std::lower_bound(codes_.begin() + lo, codes_.begin() + std::min(hi + 1, n), code) -
+                   codes_.begin();
+
+    // the model is only trusted as far as it checks out, rounding errors
+    // included
+    if ((block > 0 && codes_[block - 1] >= code) || (block < n && codes_[block] < code)) {
+        block = std::lower_bound(codes_.begin(), codes_.end(), code) - codes_.begin();
+    }
+    *exact = (block == n || codes_[block] != code);
+    return block;
+}
+
+BlockHandle LearnedIndex::block_handle(size_t block) const {
+    assert(block < codes_.size());
+    BlockHandle handle;
+    handle.set_offset(offsets_[block]);
+    handle.set_size(offsets_[block + 1] - offsets_[block] - kBlockTrailerSize);
+    return handle;
+}
+
+bool LearnedIndex::NextBlock(BlockHandle* handle) const {
+    const uint64_t next = handle->offset() + handle->size() + kBlockTrailerSize;
+    auto it = std::lower_bound(offsets_.begin(), offsets_.end(), next);
+    if (it == offsets_.end() || *it != next || it + 1 == offsets_.end()) {
+        return false;
+    }
+    *handle = block_handle(it - offsets_.begin());
+    return true;
+}
+
+size_t LearnedIndex::ApproximateMemoryUsage() const {
+    return sizeof(*this) + codes_.capacity() * sizeof(uint64_t) +
+           offsets_.capacity() * sizeof(uint64_t) + segments_.capacity() * sizeof(Segment);
+}
+
+}  // namespace leveldb
@@ -0,0 +1,115 @@
+#ifndef STORAGE_LEVELDB_TABLE_LEARNED_INDEX_H_
+#define STORAGE_LEVELDB_TABLE_LEARNED_INDEX_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "leveldb/comparator.h"
+#include "leveldb/slice.h"
+#include "table/format.h"
+
+namespace leveldb {
+
+// a learned index maps a key to the data block of a table it may be in,
+// without searching the index block. Keys are mapped to integers by their
+// first 8 bytes, read as a big-endian number ("codes", which order keys
+// like the bytewise comparator does wherever they differ), and a
+// piecewise-linear model predicts the block number from the code, off by
+// at most max_error blocks. For keys that are spread evenly, a handful of
+// segments cover a whole table.
+//
+// the index also keeps the code of the last key of every block, so a
+// prediction is narrowed down to the exact block by a search of those
+// within the error bound, and the offset of every block.
+//
+// stored in the kLearnedIndexBlockName meta block:
+//    max_error: fixed32
+//    num_blocks: fixed32
+//    last key codes: num_blocks * fixed64
+//    block offsets: (num_blocks + 1) * fixed64, the last one being where
+//                   the block after the last one would start
+//    num_segments: fixed32
+//    segments: num_segments * (first code: fixed64, first block: fixed32,
+//                              slope: fixed64 holding a double)
+// whether codes order the keys of tables whose internal keys are ordered
+// by "icmp", which a learned index needs: only if the user comparator is
+// the bytewise one. Tables built or read with any other ignore
+// learned_index_max_error and the meta block.
+bool LearnedIndexFits(const Comparator* icmp);
+
+class LearnedIndexBuilder {
+public:
+    explicit LearnedIndexBuilder(int max_error);
+
+    LearnedIndexBuilder(const LearnedIndexBuilder&) = delete;
+    LearnedIndexBuilder& operator=(const LearnedIndexBuilder&) = delete;
+
+    // adds the next data block, which "handle" points to and whose last
+    // entry has the user key "last_user_key".
+    // REQUIRES: data blocks are added in the order they are written, and
+    //           written one right after the other
+    void AddBlock(const Slice& last_user_key, const BlockHandle& handle);
+
+    // fits the model and returns the contents of the meta block, which
+    // stay valid until the builder is destroyed
+    Slice Finish();
+
+private:
+    const int max_error_;
+    std::vector<uint64_t> codes_;
+    std::vector<uint64_t> offsets_;
+    std::string result_;
+};
+
+class LearnedIndex {
+public:
+    // parses "contents", the kLearnedIndexBlockName meta block. Check ok()
+    // before use.
+    explicit LearnedIndex(const Slice& contents);
+
+    LearnedIndex(const LearnedIndex&) = delete;
+    LearnedIndex& operator=(const LearnedIndex&) = delete;
+
+    // false if the meta block could not be parsed, or does not describe
+    // sorted codes and segments starting from the first block
+    bool ok() const { return ok_; }
+
+    size_t num_blocks() const { return codes_.size(); }
+
+    // the first block that may hold keys at or after "user_key", or
+    // num_blocks() if there is none. Sets *exact to whether it is the block
+    // the index block would lead to. If not, the code of the key is that of
+    // the last key of the block, and the key may be past that key, in the
+    // block after or further on.
+    size_t FindBlock(const Slice& user_key, bool* exact) const;
+
+    // REQUIRES: block < num_blocks()
+    BlockHandle block_handle(size_t block) const;
+
+    // moves *handle to the data block after the one it points to. Returns
+    // false if that was the last one.
+    bool NextBlock(BlockHandle* handle) const;
+
+    // memory used by the index
+    size_t ApproximateMemoryUsage() const;
+
+private:
+    struct Segment {
+        uint64_t first_code;
+        uint32_t first_block;
+        double slope;
+    };
+
+    bool ok_;
+    uint32_t max_error_;
+    std::vector<uint64_t> codes_;
+    std::vector<uint64_t> offsets_;
+    std::vector<Segment> segments_;
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_TABLE_LEARNED_INDEX_H_
@@ -0,0 +1,193 @@
+#include "table/learned_index.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "db/dbformat.h"
+#include "leveldb/comparator.h"
+#include "util/coding.h"
+#include "util/random.h"
+
+namespace leveldb {
+
+// a fixed-width big-endian number, the keys a learned index fits best
+static std::string Key(uint64_t k) {
+    std::string result;
+    PutFixed64(&result, 0);
+    for (int i = 0; i < 8; i++) {
+        result[i] = static_cast<char>(k >> (56 - 8 * i));
+    }
+    return result;
+}
+
+class LearnedIndexTest : public testing::Test {
+public:
+    // adds a block of "size" bytes whose last key is "last_key"
+    void AddBlock(const std::string& last_key, uint64_t size) {
+        BlockHandle handle;
+        handle.set_offset(offset_);
+        handle.set_size(size);
+        builder_.AddBlock(last_key, handle);
+        offset_ += size + kBlockTrailerSize;
+        last_keys_.push_back(last_key);
+    }
+
+    // what seeking the index block finds: the first block whose last key
+    // is at or past "key"
+    size_t Expected(const std::string& key) const {
+        return std::lower_bound(last_keys_.begin(), last_keys_.end(), key) - last_keys_.begin();
+    }
+
+    LearnedIndexBuilder builder_{2};
+    uint64_t offset_ = 0;
+    std::vector<std::string> last_keys_;
+};
+
+TEST_F(LearnedIndexTest, Empty) {
+    LearnedIndex index(builder_.Finish());
+    ASSERT_TRUE(index.ok());
+    ASSERT_EQ(0, index.num_blocks());
+    bool exact;
+    ASSERT_EQ(0, index.FindBlock(Key(5), &exact));
+}
+
+TEST_F(LearnedIndexTest, FindsTheBlocksOfTheIndexBlock) {
+    // evenly spread keys, then a dense run, then sparse ones, so that the
+    // model needs several segments
+    Random rnd(301);
+    uint64_t k = 1000;
+    for (int i = 0; i < 2000; i++) {
+        if (i < 800) {
+            k += 1000 + rnd.Uniform(10);
+        } else if (i < 1200) {
+            k += 1 + rnd.Uniform(3);
+        } else {
+            k += rnd.Uniform(1 << 20) + 1;
+        }
+        AddBlock(Key(k), 100 + rnd.Uniform(4000));
+    }
+    LearnedIndex index(builder_.Finish());
+    ASSERT_TRUE(index.ok());
+    ASSERT_EQ(last_keys_.size(), index.num_blocks());
+
+    for (int i = 0; i < 20000; i++) {
+        const std::string key = Key(rnd.Uniform(static_cast<int>(k + 100)));
+        bool exact;
+        const size_t block = index.FindBlock(key, &exact);
+        ASSERT_EQ(Expected(key), block) << i;
+        ASSERT_TRUE(exact);
+    }
+    for (size_t b = 0; b < last_keys_.size(); b++) {
+        bool exact;
+        ASSERT_EQ(b, index.FindBlock(last_keys_[b], &exact));
+    }
+
+    // the handles lead from one block to the next
+    BlockHandle handle = index.block_handle(0);
+    ASSERT_EQ(0, handle.offset());
+    for (size_t b = 1; b < index.num_blocks(); b++) {
+        ASSERT_TRUE(index.NextBlock(&handle));
+        ASSERT_EQ(index.block_handle(b).offset(), handle.offset());
+        ASSERT_EQ(index.block_handle(b).size(), handle.size());
+    }
+    ASSERT_FALSE(index.NextBlock(&handle));
+}
+
+TEST_F(LearnedIndexTest, TiedCodesAreNotExact) {
+    // keys past the first 8 bytes tie, so the block found is only the
+    // first one the key may be in
+    for (int i = 0; i < 10; i++) {
+        AddBlock(Key(7) + std::to_string(i), 1000);
+    }
+    AddBlock(Key(8), 1000);
+    LearnedIndex index(builder_.Finish());
+    ASSERT_TRUE(index.ok());
+    bool exact;
+    ASSERT_EQ(0, index.FindBlock(Key(7) + "5", &exact));
+    ASSERT_FALSE(exact);
+    ASSERT_EQ(0, index.FindBlock(Key(7) + "\xff", &exact));
+    ASSERT_FALSE(exact);
+    ASSERT_EQ(10, index.FindBlock(Key(8), &exact));
+    ASSERT_FALSE(exact);
+    ASSERT_EQ(11, index.FindBlock(Key(9), &exact));
+    ASSERT_TRUE(exact);
+}
+
+class LearnedIndexCorruptionTest : public LearnedIndexTest {
+public:
+    LearnedIndexCorruptionTest() {
+        for (int i = 0; i < 100; i++) {
+            AddBlock(Key(1000 + (i * i) * 100), 1000);
+        }
+        contents_ = builder_.Finish().ToString();
+        segments_ = 8 + 100 * 8 + 101 * 8 + 4;
+    }
+
+    // offset of the "field"-th byte of segment "i"
+    size_t Segment(int i, size_t field) const { return segments_ + i * 20 + field; }
+
+    std::string contents_;
+    size_t segments_;  // where the segments start
+};
+
+TEST_F(LearnedIndexCorruptionTest, Intact) {
+    LearnedIndex index(contents_);
+    ASSERT_TRUE(index.ok());
+    ASSERT_GT(DecodeFixed32(&contents_[segments_ - 4]), 1);
+}
+
+TEST_F(LearnedIndexCorruptionTest, Truncated) {
+    LearnedIndex index(Slice(contents_.data(), contents_.size() - 1));
+    ASSERT_FALSE(index.ok());
+}
+
+TEST_F(LearnedIndexCorruptionTest, UnsortedCodes) {
+    EncodeFixed64(&contents_[8 + 50 * 8], 0);
+    LearnedIndex index(contents_);
+    ASSERT_FALSE(index.ok());
+}
+
+TEST_F(LearnedIndexCorruptionTest, FirstSegmentPastFirstCode) {
+    EncodeFixed64(&contents_[Segment(0, 0)], DecodeFixed64(&contents_[8]) + 1);
+    LearnedIndex index(contents_);
+    ASSERT_FALSE(index.ok());
+}
+
+TEST_F(LearnedIndexCorruptionTest, FirstSegmentPastFirstBlock) {
+    EncodeFixed32(&contents_[Segment(0, 8)], 1);
+    // the next segment must still start past it
+    if (DecodeFixed32(&contents_[Segment(1, 8)]) <= 1) {
+        EncodeFixed32(&contents_[Segment(1, 8)], 2);
+    }
+    LearnedIndex index(contents_);
+    ASSERT_FALSE(index.ok());
+}
+
+TEST_F(LearnedIndexCorruptionTest, UnsortedSegments) {
+    EncodeFixed64(&contents_[Segment(1, 0)], DecodeFixed64(&contents_[Segment(0, 0)]) - 1);
+    LearnedIndex index(contents_);
+    ASSERT_FALSE(index.ok());
+}
+
+TEST(LearnedIndexFitsTest, BytewiseOnly) {
+    InternalKeyComparator bytewise(BytewiseComparator());
+    ASSERT_TRUE(LearnedIndexFits(&bytewise));
+
+    class ReverseComparator : public Comparator {
+    public:
+        const char* Name() const override { return "test.ReverseComparator"; }
+        int Compare(const Slice& a, const Slice& b) const override {
+            return -BytewiseComparator()->Compare(a, b);
+        }
+        void FindShortestSeparator(std::string* start, const Slice& limit) const override {}
+        void FindShortSuccessor(std::string* key) const override {}
+    };
+    ReverseComparator reverse;
+    InternalKeyComparator reversed(&reverse);
+    ASSERT_FALSE(LearnedIndexFits(&reversed));
+}
+
+}  // namespace leveldb
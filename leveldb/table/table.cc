@@ -1,5 +1,9 @@
 #include "leveldb/table.h"
 
+#include <string>
+#include <vector>
+
+#include "db/dbformat.h"
 #include "leveldb/cache.h"
 #include "leveldb/comparator.h"
 #include "leveldb/env.h"
@@ -8,6 +12,7 @@
 #include "table/block.h"
 #include "table/filter_block.h"
 #include "table/format.h"
+#include "table/learned_index.h"
 #include "table/two_level_iterator.h"
 #include "util/coding.h"
 
@@ -18,6 +23,8 @@ struct Table::Rep {
         delete filter;
         delete[] filter_data;
         delete index_block;
+        delete range_del_block;
+        delete learned_index;
     }
 
     Options options;
@@ -29,6 +36,11 @@ struct Table::Rep {
 
     BlockHandle metaindex_handle;  // handle to metaindex_block: saved from footer
     Block* index_block;
+    Block* range_del_block;  // nullptr if the table has no range tombstones
+    // used instead of index_block to find the blocks of a batched lookup.
+    // nullptr if the table has none, it could not be read, or the user
+    // comparator is not the bytewise one
+    LearnedIndex* learned_index;
 };
 
 Status Table::Open(const Options& options, RandomAccessFile* file,
@@ -68,6 +80,8 @@ Status Table::Open(const Options& options, RandomAccessFile* file,
         rep->cache_id = (options.block_cache ? options->blcok_cache->NewId() : 0);
         rep->filter_data = nullptr;
         rep->filter = nullptr;
+        rep->range_del_block = nullptr;
+        rep->learned_index = nullptr;
         *table = new Table(rep);
         (*table)->ReadMeta(footer);
     }
@@ -76,10 +90,6 @@ Status Table::Open(const Options& options, RandomAccessFile* file,
 }
 
 void Table::ReadMeta(const Footer& footer) {
-    if (rep_->options->filter_policy == nullptr) {
-        return;  // no need any meta
-    }
-
     ReadOptions opt;
     if (rep_->options->paranoid_checks) {
         opt.verify_checksums = true;
@@ -92,16 +102,55 @@ void Table::ReadMeta(const Footer& footer) {
     Block* meta = new Block(contents);
 
     Iterator* iter = meta->NewIterator(BytewiseComparator());
-    std::string key = "filter.";
-    key.append(rep_->options.filter_policy->Name());
-    iter->Seek(key);
-    if (iter->Valid() && iter.key() == Slice(key)) {
-        ReadFilter(iter->value());
+    if (rep_->options.filter_policy != nullptr) {
+        std::string key = "filter.";
+        key.append(rep_->options.filter_policy->Name());
+        iter->Seek(key);
+        if (iter->Valid() && iter.key() == Slice(key)) {
+            ReadFilter(iter->value());
+        }
+    }
+    iter->Seek(kRangeDelBlockName);
+    if (iter->Valid() && iter->key() == Slice(kRangeDelBlockName)) {
+        ReadRangeDelBlock(iter->value());
+    }
+    if (LearnedIndexFits(rep_->options.comparator)) {
+        iter->Seek(kLearnedIndexBlockName);
+        if (iter->Valid() && iter->key() == Slice(kLearnedIndexBlockName)) {
+            ReadLearnedIndex(iter->value());
+        }
     }
     delete iter;
     delete meta;
 }
 
+void Table::ReadRangeDelBlock(const Slice& handle_value) {
+    Slice v = handle_value;
+    BlockHandle handle;
+    ReadOptions opt;
+    if (rep_->options.paranoid_checks) {
+        opt.verify_checksums = true;
+    }
+    BlockContents contents;
+    if (!handle.DecodeFrom(&v).ok() || !ReadBlock(rep_->file, opt, handle, &contents).ok()) {
+        // unlike a missing filter, missing tombstones would bring deleted
+        // keys back, so report the error to whoever asks for them
+        rep_->status = Status::Corruption("cannot read range tombstones");
+        return;
+    }
+    rep_->range_del_block = new Block(contents);
+}
+
+Iterator* Table::NewRangeTombstoneIterator(const ReadOptions& options) const {
+    if (!rep_->status.ok()) {
+        return NewErrorIterator(rep_->status);
+    }
+    if (rep_->range_del_block == nullptr) {
+        return nullptr;
+    }
+    return rep_->range_del_block->NewIterator(rep_->options.comparator);
+}
+
 void Table::ReadFilter(const Slice& filter_handle_value) {
     Slice v = filter_handle_value;
     BlockHandle filter_handle;
@@ -123,64 +172,255 @@ void Table::ReadFilter(const Slice& filter_handle_value) {
     rep_->filter = new FilterBlockReader(rep__>options.filter_policy, block.data);
 }
 
+void Table::ReadLearnedIndex(const Slice& handle_value) {
+    Slice v = handle_value;
+    BlockHandle handle;
+    if (!handle.DecodeFrom(&v).ok()) {
+        return;
+    }
+
+    ReadOptions opt;
+    if (rep_->options.paranoid_checks) {
+        opt.verify_checksums = true;
+    }
+    BlockContents block;
+    if (!ReadBlock(rep_->file, opt, handle, &block).ok()) {
+        // lookups go through the index block instead
+        return;
+    }
+    // the index copies what it needs out of the block
+    LearnedIndex* index = new LearnedIndex(block.data);
+    if (block.heap_allocated) {
+        delete[] block.data.data();
+    }
+    if (index->ok()) {
+        rep_->learned_index = index;
+    } else {
+        delete index;
+    }
+}
+
 Table::~Table() { delete rep_; }
 
 static void DeleteBlock(void* arg, void* ignore)
 
+// the key of the block at "offset" of the table "cache_id" in the block cache
+static Slice BlockCacheKey(uint64_t cache_id, uint64_t offset, char* buf) {
+    EncodeFixed64(buf, cache_id);
+    EncodeFixed64(buf + 8, offset);
+    return Slice(buf, 16);
+}
+
+Iterator* Table::CachedBlockIterator(const BlockHandle& handle) const {
+    Cache* block_cache = rep_->options.block_cache;
+    if (block_cache == nullptr) {
+        return nullptr;
+    }
+    char cache_key_buffer[16];
+    Cache::Handle* cache_handle =
+            block_cache->Lookup(BlockCacheKey(rep_->cache_id, handle.offset(), cache_key_buffer));
+    if (cache_handle == nullptr) {
+        return nullptr;
+    }
+    Block* block = reinterpret_cast<Block*>(block_cache->Value(cache_handle));
+    Iterator* iter = block->NewIterator(rep_->options.comparator);
+    iter->RegisterCleanup(&ReleaseBlock, block_cache, cache_handle);
+    return iter;
+}
+
+Iterator* Table::NewBlockIterator(const ReadOptions& options, const BlockHandle& handle,
+                                  const BlockContents& contents) const {
+    Cache* block_cache = rep_->options.block_cache;
+    Block* block = new Block(contents);
+    Cache::Handle* cache_handle = nullptr;
+    if (block_cache != nullptr && contents.cachable && options.fill_cache) {
+        char cache_key_buffer[16];
+        cache_handle = block_cache->Insert(
+                BlockCacheKey(rep_->cache_id, handle.offset(), cache_key_buffer),
+                block, block->size(), &DeleteCachedBlock);
+    }
+
+    Iterator* iter = block->NewIterator(rep_->options.comparator);
+    if (cache_handle == nullptr) {
+        iter->RegisterCleanup(&DeleteBlock, block, nullptr);
+    } else {
+        iter->RegisterCleanup(&ReleaseBlock, block_cache, cache_handle);
+    }
+    return iter;
+}
+
 // convert an index iterator value (i.e. an encoded BlockHandle)
 // into an iterator over the contents of the corresponding block
-Iterator* Table::BlockReader(void* arg, const Readoptions& options,
+Iterator* Table::BlockReader(void* arg, const ReadOptions& options,
                              const Slice& index_value) {
     Table* table = reinterpret_cast<Table*>(arg);
-    Cache* block_cache = table->rep_->options.block_cache;
-    Block* block = nullptr;
-    Cache::Handle* cache_handle = nullptr;
 
     BlockHandle handle;
     Slice input = index_value;
     Status s = handle.DecodeFrom(&input);
     // we intentionally allow extra stuff in index_value so that we
     // can add more features in the future
+    if (!s.ok()) {
+        return NewErrorIterator(s);
+    }
 
-    if (s.ok()) {
+    Iterator* iter = table->CachedBlockIterator(handle);
+    if (iter == nullptr) {
         BlockContents contents;
-        if (block_cache != nullptr) {
-            char cache_key_buffer[16];
-            EncodeFixed64(cache_key_buffer, table->rep_->cache_id);
-            EncodeFixed64(cache_key_buffer + 8, handle.offset());
-            Slice key(cache_key_buffer, sizeof(cache_key_buffer));
-            cache_handle = block_cache->Lookup(key);
-            if (cache_handle != nullptr) {
-                block = reinterpret_cast<Block*>(block_cache->Value(cache_handle));
-            } else {
-                s = ReadBlock(table->rep_->file, options, handle, &contents);
-                if (s.ok()) {
-                    block = new Block(contents);
-                    if (contents.cachable && options.fill_cache) {
-                        cache_handle = block_cache->Insert(key, block, block->size(), &DeleteCachedBlock);
-                    }
-                }
+        s = ReadBlock(table->rep_->file, options, handle, &contents);
+        iter = s.ok() ? table->NewBlockIterator(options, handle, contents) : NewErrorIterator(s);
+    }
+    return iter;
+}
+
+Status Table::InternalMultiGet(const ReadOptions& options, size_t n, const Slice* keys,
+                               void* const* args,
+                               bool (*handle_result)(void*, const Slice&, const Slice&)) {
+    // a data block some of the keys fall into
+    struct BlockRead {
+        std::string handle_value;  // encoded BlockHandle
+        BlockHandle handle;
+        Iterator* iter;
+    };
+    struct Lookup {
+        size_t key;
+        size_t block;  // index into blocks
+    };
+
+    // find the block of every key and drop the keys the filter rules out,
+    // so that no block is read only to find a key absent. The keys are in
+    // order, so the keys of a block are adjacent.
+    //
+    // the learned index, if the table has one, finds the block from the
+    // user key alone. That block holds the first entry of the user key, if
+    // any, so the entry for the sequence number of the key may be in a
+    // later block, which the lookup below walks on to.
+    const LearnedIndex* learned = rep_->learned_index;
+    std::vector<BlockRead> blocks;
+    std::vector<Lookup> lookups;
+    Iterator* iiter = rep_->index_block->NewIterator(rep_->options.comparator);
+    for (size_t i = 0; i < n; i++) {
+        std::string handle_value;
+        BlockHandle handle;
+        Status s;
+        bool exact = true;
+        if (learned != nullptr) {
+            const size_t b = learned->FindBlock(ExtractUserKey(keys[i]), &exact);
+            if (b == learned->num_blocks()) {
+                break;  // the keys from here on are past the last block
             }
+            handle = learned->block_handle(b);
+            handle.EncodeTo(&handle_value);
         } else {
-            s = ReadBlock(table->rep_->file, options, handle, &contents);
-            if (s.ok()) {
-                block = new Block(contents);
+            iiter->Seek(keys[i]);
+            if (!iiter->Valid()) {
+                break;
             }
+            handle_value = iiter->value().ToString();
+            Slice input = iiter->value();
+            s = handle.DecodeFrom(&input);
+        }
+        // if the block is not exact, the key may be in a later block, whose
+        // filter the one of this block says nothing about
+        FilterBlockReader* filter = rep_->filter;
+        if (s.ok() && exact && filter != nullptr &&
+            !filter->KeyMayMatch(handle.offset(), keys[i])) {
+            continue;  // not found
         }
+        if (blocks.empty() || blocks.back().handle_value != handle_value) {
+            BlockRead block;
+            block.handle_value = std::move(handle_value);
+            block.handle = handle;
+            block.iter = s.ok() ? nullptr : NewErrorIterator(s);
+            blocks.push_back(std::move(block));
+        }
+        Lookup lookup;
+        lookup.key = i;
+        lookup.block = blocks.size() - 1;
+        lookups.push_back(lookup);
     }
+    Status s = iiter->status();
 
-    Iterator* iter;
-    if (block != nullptr) {
-        iter = block->NewIterator(table->rep_->options.comparator);
-        if (cache_handle == nullptr) {
-            iter->RegisterCleanup(&DeleteBlock, block, nullptr);
-        } else {
-            iter->RegisterCleanup(&ReleaseBlock, block_cache, cache_handle);
+    // take what the block cache has, and read all the other blocks at once
+    std::vector<size_t> missing;
+    std::vector<BlockHandle> missing_handles;
+    for (size_t b = 0; b < blocks.size(); b++) {
+        if (blocks[b].iter == nullptr) {
+            blocks[b].iter = CachedBlockIterator(blocks[b].handle);
+        }
+        if (blocks[b].iter == nullptr) {
+            missing.push_back(b);
+            missing_handles.push_back(blocks[b].handle);
         }
-    } else {
-        iter = NewErrorIterator(s);
     }
-    return iter;
+    if (!missing.empty()) {
+        std::vector<BlockContents> contents(missing.size());
+        std::vector<Status> statuses(missing.size());
+        ReadBlocks(rep_->file, options, missing.size(), missing_handles.data(),
+                   contents.data(), statuses.data());
+        for (size_t m = 0; m < missing.size(); m++) {
+            blocks[missing[m]].iter =
+                    statuses[m].ok() ? NewBlockIterator(options, missing_handles[m], contents[m])
+                                     : NewErrorIterator(statuses[m]);
+        }
+    }
+
+    for (size_t i = 0; i < lookups.size() && s.ok(); i++) {
+        const Lookup& lookup = lookups[i];
+        const Slice& key = keys[lookup.key];
+        void* arg = args[lookup.key];
+        Iterator* block_iter = blocks[lookup.block].iter;
+        BlockHandle block_handle = blocks[lookup.block].handle;
+        std::string block_handle_value = blocks[lookup.block].handle_value;
+        Iterator* next_block_iter = nullptr;  // owned here, unlike block_iter
+        block_iter->Seek(key);
+        for (;;) {
+            if (block_iter->Valid()) {
+                if (!(*handle_result)(arg, block_iter->key(), block_iter->value())) {
+                    break;
+                }
+                block_iter->Next();
+                continue;
+            }
+            if (!block_iter->status().ok()) {
+                break;
+            }
+            // the key is past the block the learned index led to, or the
+            // entries handle_result asks for go on in the next block
+            if (learned != nullptr) {
+                if (!learned->NextBlock(&block_handle)) {
+                    break;
+                }
+                block_handle_value.clear();
+                block_handle.EncodeTo(&block_handle_value);
+            } else {
+                iiter->Seek(key);
+                while (iiter->Valid() && iiter->value() != Slice(block_handle_value)) {
+                    iiter->Next();
+                }
+                if (iiter->Valid()) {
+                    iiter->Next();
+                }
+                if (!iiter->Valid()) {
+                    break;
+                }
+                block_handle_value = iiter->value().ToString();
+            }
+            delete next_block_iter;
+            block_iter = next_block_iter = BlockReader(this, options, block_handle_value);
+            block_iter->SeekToFirst();
+        }
+        s = block_iter->status();
+        delete next_block_iter;
+    }
+    if (s.ok()) {
+        s = iiter->status();
+    }
+    for (const BlockRead& block : blocks) {
+        delete block.iter;
+    }
+    delete iiter;
+    return s;
 }
 
 }  // namespace leveldb
\ No newline at end of file
@@ -1,24 +1,39 @@
 #include "leveldb/table_builder.h"
 #include "leveldb/options.h"
+#include "table/format.h"
+#include "table/learned_index.h"
 
 namespace leveldb {
 
 struct TableBuilder::Rep {
+    // the options of the index block and the meta blocks, set before the
+    // blocks are built from them. Only data blocks get a hash index: the
+    // keys of meta blocks are not internal keys, and the index block has a
+    // restart point at every entry already
+    static Options IndexBlockOptions(const Options& opt) {
+        Options result = opt;
+        result.block_restart_interval = 1;
+        result.data_block_hash_table_util_ratio = 0;
+        return result;
+    }
+
     Rep(const Options& opt, WritableFile* f)
         : options(opt),
-          index_block_options(opt),
+          index_block_options(IndexBlockOptions(opt)),
           file(f),
           offset(0),
           data_block(&options),
-          index_block(&options),
+          index_block(&index_block_options),
+          range_del_block(&index_block_options),
           num_entries(0),
           closed(false),
           filter_block(opt.filter_policy == nullptr
                        ? nullptr
                        : new FilterBlockBuilder(opt.filter_policy));
-          pending_index_entry(false) {
-        index_block_options.block_restart_interval = 1;
-    }
+          learned_index(opt.learned_index_max_error > 0 && LearnedIndexFits(opt.comparator)
+                        ? new LearnedIndexBuilder(opt.learned_index_max_error)
+                        : nullptr),
+          pending_index_entry(false) {}
 
     Options options;
     Options index_block_options;
@@ -27,10 +42,18 @@ struct TableBuilder::Rep {
     Status status;
     BlockBuilder data_block;
     BlockBuilder index_block;
+    // range tombstones, which Finish() writes out as the kRangeDelBlockName
+    // meta block unless there are none
+    BlockBuilder range_del_block;
     std::string last_key;
     int64_t num_entries;
     bool closed;
     FilterBlockBuilder* filter_block;
+    // the model of the data blocks of the table, which the
+    // kLearnedIndexBlockName meta block is made of. nullptr unless
+    // options.learned_index_max_error is set and the user comparator is
+    // the bytewise one (see LearnedIndexFits())
+    LearnedIndexBuilder* learned_index;
 
     // we don't emit the index entry for a block until we have seen the 
     // first key for the next data blcok. This allows us to use shorter
@@ -56,6 +79,7 @@ TableBuilder::TableBuilder(const Options& options, WritableFile* file)
 TableBuilder::~TableBuilder() {
     assert(rep_->closed);  // catch errors where caller forgot to call Finish()
     delete rep_->filter_block;
+    delete rep_->learned_index;
     delete rep_;
 }
 
@@ -67,4 +91,11 @@ void Add() {
     
 }
 
+void TableBuilder::AddRangeTombstone(const Slice& begin_key, const Slice& end_key) {
+    Rep* r = rep_;
+    assert(!r->closed);
+    if (!ok()) return;
+    r->range_del_block.Add(begin_key, end_key);
+}
+
 }  // namespace leveldb
\ No newline at end of file
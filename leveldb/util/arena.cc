@@ -0,0 +1,260 @@
+#include "util/arena.h"
+
+#include <algorithm>
+#include <thread>
+
+#if defined(LEVELDB_PLATFORM_POSIX)
+#include <sys/mman.h>
+#endif  // defined(LEVELDB_PLATFORM_POSIX)
+
+#if defined(HAVE_MAP_HUGETLB)
+#include <cstdio>
+#endif  // defined(HAVE_MAP_HUGETLB)
+
+#if defined(HAVE_MBIND)
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif  // defined(HAVE_MBIND)
+
+namespace leveldb {
+
+static const int kBlockSize = 4096;
+
+// upper bound on the size of the blocks of the shards of a concurrent arena
+static const size_t kMaxShardBlockSize = 128 << 10;
+
+// the shard, out of "num_shards", the calling thread allocates from.
+// threads are numbered as they first get here, so consecutive ones get
+// different shards
+static size_t ShardIndex(size_t num_shards) {
+    static std::atomic<size_t> next_thread(0);
+    static thread_local const size_t thread_number =
+            next_thread.fetch_add(1, std::memory_order_relaxed);
+    return thread_number & (num_shards - 1);
+}
+
+Arena::Arena(bool concurrent, size_t huge_page_size, bool numa_local)
+    : concurrent_(concurrent),
+      num_shards_(0),
+      shard_block_size_(0),
+      shards_(nullptr),
+      huge_page_size_(huge_page_size),
+      numa_local_(numa_local),
+      block_size_(huge_page_size != 0 ? huge_page_size : kBlockSize),
+      alloc_ptr_(nullptr),
+      alloc_bytes_remaining_(0),
+      memory_usage_(0) {
+    if (concurrent_) {
+        // one shard per hardware thread, so threads rarely share one
+        const size_t threads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+        num_shards_ = 1;
+        while (num_shards_ < threads) {
+            num_shards_ *= 2;
+        }
+        // a refill is carved out of a shared huge page block, or is an
+        // ordinary block of its own
+        shard_block_size_ =
+                std::min(kMaxShardBlockSize, std::max<size_t>(block_size_ / 8, kBlockSize));
+        shards_ = new Shard[num_shards_];
+    }
+}
+
+Arena::~Arena() {
+    delete[] shards_;
+    for (size_t i = 0; i < blocks_.size(); i++) {
+        delete[] blocks_[i];
+    }
+#if defined(LEVELDB_PLATFORM_POSIX)
+    for (size_t i = 0; i < huge_blocks_.size(); i++) {
+        ::munmap(huge_blocks_[i].first, huge_blocks_[i].second);
+    }
+#endif  // defined(LEVELDB_PLATFORM_POSIX)
+}
+
+char* Arena::AllocateConcurrently(size_t bytes, bool aligned) {
+    assert(bytes > 0);
+    if (bytes > shard_block_size_ / 4) {
+        // as in AllocateFallback(), large objects get a block of their own,
+        // or come out of the shared block if they fit there
+        MutexLock l(&mu_);
+        return aligned ? AllocateAlignedLocked(bytes) : AllocateLocked(bytes);
+    }
+
+    Shard* shard = &shards_[ShardIndex(num_shards_)];
+    MutexLock l(&shard->mu);
+    size_t slop = 0;
+    if (aligned) {
+        const int align = (sizeof(void*) > 8) ? sizeof(void*) : 8;
+        const size_t current_mod = reinterpret_cast<uintptr_t>(shard->alloc_ptr) & (align - 1);
+        slop = (current_mod == 0 ? 0 : align - current_mod);
+    }
+    if (bytes + slop > shard->alloc_bytes_remaining) {
+        // refill from the shared blocks. the rest of the old block is
+        // wasted, and the new one starts aligned
+        {
+            MutexLock arena_lock(&mu_);
+            shard->alloc_ptr = AllocateAlignedLocked(shard_block_size_);
+        }
+        shard->alloc_bytes_remaining = shard_block_size_;
+        slop = 0;
+    }
+    char* result = shard->alloc_ptr + slop;
+    shard->alloc_ptr += bytes + slop;
+    shard->alloc_bytes_remaining -= bytes + slop;
+    return result;
+}
+
+char* Arena::AllocateFallback(size_t bytes) {
+    if (bytes > block_size_ / 4) {
+        // object is more than a quarter of our block size. allocate it separately
+        // to avoid wasting too much space in leftover bytes.
+        char* result = AllocateNewBlock(bytes);
+        return result;
+    }
+
+    // we waste the remaining space in the current block.
+    alloc_ptr_ = AllocateNewBlock(block_size_);
+    alloc_bytes_remaining_ = block_size_;
+
+    char* result = alloc_ptr_;
+    alloc_ptr_ += bytes;
+    alloc_bytes_remaining_ -= bytes;
+    return result;
+}
+
+char* Arena::AllocateAlignedLocked(size_t bytes) {
+    const int align = (sizeof(void*) > 8) ? sizeof(void*) : 8;
+    static_assert((align & (align - 1)) == 0,
+                  "Pointer size should be a power of 2");
+    size_t current_mod = reinterpret_cast<uintptr_t>(alloc_ptr_) & (align - 1);
+    size_t slop = (current_mod == 0 ? 0 : align - current_mod);
+    size_t needed = bytes + slop;
+    char* result;
+    if (needed <= alloc_bytes_remaining_) {
+        result = alloc_ptr_ + slop;
+        alloc_ptr_ += needed;
+        alloc_bytes_remaining_ -= needed;
+    } else {
+        // AllocateFallback always returned aligned memory
+        result = AllocateFallback(bytes);
+    }
+    assert((reinterpret_cast<uintptr_t>(result) & (align - 1)) == 0);
+    return result;
+}
+
+char* Arena::AllocateNewBlock(size_t block_bytes) {
+    if (huge_page_size_ != 0 && block_bytes == huge_page_size_) {
+        size_t mapped_bytes;
+        char* result = MapHugeBlock(&mapped_bytes);
+        if (result != nullptr) {
+            huge_blocks_.emplace_back(result, mapped_bytes);
+            memory_usage_.fetch_add(mapped_bytes + sizeof(char*),
+                                    std::memory_order_relaxed);
+            return result;
+        }
+        // no huge pages to be had, use ordinary memory
+    }
+    char* result = new char[block_bytes];
+    blocks_.push_back(result);
+    memory_usage_.fetch_add(block_bytes + sizeof(char*),
+                            std::memory_order_relaxed);
+    return result;
+}
+
+#if defined(HAVE_MAP_HUGETLB)
+// the size of the pages MAP_HUGETLB maps when no size is asked for, as
+// /proc/meminfo reports it, or 0 if it can not be read
+static size_t DefaultHugePageSize() {
+    static const size_t page_size = []() -> size_t {
+        std::FILE* f = std::fopen("/proc/meminfo", "r");
+        if (f == nullptr) {
+            return 0;
+        }
+        size_t kb = 0;
+        char line[256];
+        while (std::fgets(line, sizeof(line), f) != nullptr) {
+            if (std::sscanf(line, "Hugepagesize: %zu kB", &kb) == 1) {
+                break;
+            }
+        }
+        std::fclose(f);
+        return kb * 1024;
+    }();
+    return page_size;
+}
+#endif  // defined(HAVE_MAP_HUGETLB)
+
+char* Arena::MapHugeBlock(size_t* mapped_bytes) {
+#if !defined(LEVELDB_PLATFORM_POSIX)
+    return nullptr;
+#else
+    const size_t size = huge_page_size_;
+    void* block = MAP_FAILED;
+#if defined(HAVE_MAP_HUGETLB)
+    // pages from the pool reserved through /proc/sys/vm/nr_hugepages
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB;
+    size_t page_size = DefaultHugePageSize();
+#if defined(MAP_HUGE_SHIFT)
+    if ((size & (size - 1)) == 0) {
+        // ask for this page size rather than the system default
+        int shift = 0;
+        while ((size_t{1} << shift) < size) shift++;
+        flags |= shift << MAP_HUGE_SHIFT;
+        page_size = size;
+    }
+#endif  // defined(MAP_HUGE_SHIFT)
+    if (page_size != 0) {
+        // the mapping is made of whole huge pages, and munmap() needs its
+        // length to be too
+        const size_t length = (size + page_size - 1) / page_size * page_size;
+        block = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, flags, -1, 0);
+        *mapped_bytes = length;
+    }
+#endif  // defined(HAVE_MAP_HUGETLB)
+
+    if (block == MAP_FAILED) {
+        // ask for transparent huge pages instead, which only back ranges
+        // aligned to the huge page size, so map more and trim the ends
+        const size_t mapped_size = size + size;
+        void* mapped = ::mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapped == MAP_FAILED) {
+            return nullptr;
+        }
+        const uintptr_t start = reinterpret_cast<uintptr_t>(mapped);
+        const uintptr_t aligned = (start + size - 1) / size * size;
+        const size_t head = aligned - start;
+        if (head > 0) {
+            ::munmap(mapped, head);
+        }
+        if (mapped_size - head - size > 0) {
+            ::munmap(reinterpret_cast<char*>(aligned) + size, mapped_size - head - size);
+        }
+        block = reinterpret_cast<void*>(aligned);
+        *mapped_bytes = size;
+#if defined(HAVE_MADV_HUGEPAGE)
+        ::madvise(block, size, MADV_HUGEPAGE);
+#endif  // defined(HAVE_MADV_HUGEPAGE)
+    }
+
+#if defined(HAVE_MBIND)
+    if (numa_local_) {
+        // pages are only placed when first touched, so setting the policy
+        // before handing the block out is enough
+        unsigned cpu, node;
+        if (::syscall(SYS_getcpu, &cpu, &node, nullptr) == 0 && node < 1024) {
+            unsigned long nodemask[1024 / (8 * sizeof(unsigned long))] = {};
+            nodemask[node / (8 * sizeof(unsigned long))] |=
+                    1ul << (node % (8 * sizeof(unsigned long)));
+            // failing leaves the default policy, which is fine
+            ::syscall(SYS_mbind, block, size, MPOL_PREFERRED, nodemask,
+                      sizeof(nodemask) * 8 + 1, 0);
+        }
+    }
+#endif  // defined(HAVE_MBIND)
+    return reinterpret_cast<char*>(block);
+#endif  // !defined(LEVELDB_PLATFORM_POSIX)
+}
+
+}  // namespace leveldb
@@ -0,0 +1,130 @@
+#ifndef STORAGE_LEVELDB_UTIL_ARENA_H_
+#define STORAGE_LEVELDB_UTIL_ARENA_H_
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "port/port.h"
+#include "util/mutexlock.h"
+
+namespace leveldb {
+
+class Arena {
+public:
+    // if "concurrent" is true, Allocate() and AllocateAligned() may be
+    // called by several threads at once. Each thread then allocates from
+    // a small block of its shard, and only takes the arena's lock to
+    // refill it. the default single-threaded arena leaves synchronization
+    // to the caller.
+    //
+    // if "huge_page_size" is non-zero, memory is handed out from blocks of
+    // that size mapped with huge pages, or, if none are reserved, from
+    // blocks the kernel is asked to back with transparent huge pages.
+    // if "numa_local" is also true, each such block is placed on the NUMA
+    // node of the thread that makes the allocation that needs it. blocks
+    // that fall back to new[] when no huge pages can be mapped are not.
+    explicit Arena(bool concurrent = false, size_t huge_page_size = 0,
+                   bool numa_local = false);
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    ~Arena();
+
+    // return a pointer to a newly allocated memory block of "bytes" bytes.
+    char* Allocate(size_t bytes);
+
+    // allocate memory with the normal alignment guarantees provided by malloc.
+    char* AllocateAligned(size_t bytes);
+
+    // returns an estimate of the total memory usage of data allocated
+    // by the arena.
+    size_t MemoryUsage() const {
+        return memory_usage_.load(std::memory_order_relaxed);
+    }
+
+private:
+    // a small block that the threads mapped to the shard allocate from,
+    // on a cache line of its own
+    struct alignas(64) Shard {
+        port::Mutex mu;
+        char* alloc_ptr GUARDED_BY(mu) = nullptr;
+        size_t alloc_bytes_remaining GUARDED_BY(mu) = 0;
+    };
+
+    // Allocate() or, if "aligned", AllocateAligned() when concurrent_
+    char* AllocateConcurrently(size_t bytes, bool aligned);
+
+    char* AllocateLocked(size_t bytes);
+    char* AllocateAlignedLocked(size_t bytes);
+    char* AllocateFallback(size_t bytes);
+    char* AllocateNewBlock(size_t block_bytes);
+
+    // maps a block of at least huge_page_size_ bytes and sets
+    // *mapped_bytes to its length; returns nullptr on failure
+    char* MapHugeBlock(size_t* mapped_bytes);
+
+    // serializes allocations from the state below when concurrent_ is set
+    const bool concurrent_;
+    port::Mutex mu_;
+
+    // per-thread allocation state when concurrent_ is set, else nullptr.
+    // num_shards_ is a power of two
+    size_t num_shards_;
+    size_t shard_block_size_;
+    Shard* shards_;
+
+    const size_t huge_page_size_;  // 0 if huge pages are not used
+    const bool numa_local_;
+    const size_t block_size_;  // size of the blocks small allocations share
+
+    // allocation state
+    char* alloc_ptr_;
+    size_t alloc_bytes_remaining_;
+
+    // array of new[] allocated memory blocks
+    std::vector<char*> blocks_;
+
+    // blocks mapped by MapHugeBlock(), with their mapped lengths
+    std::vector<std::pair<char*, size_t>> huge_blocks_;
+
+    // total memory usage of the arena. atomic, so MemoryUsage() may be
+    // called while another thread allocates
+    std::atomic<size_t> memory_usage_;
+};
+
+inline char* Arena::Allocate(size_t bytes) {
+    if (concurrent_) {
+        return AllocateConcurrently(bytes, false);
+    }
+    return AllocateLocked(bytes);
+}
+
+inline char* Arena::AllocateAligned(size_t bytes) {
+    if (concurrent_) {
+        return AllocateConcurrently(bytes, true);
+    }
+    return AllocateAlignedLocked(bytes);
+}
+
+inline char* Arena::AllocateLocked(size_t bytes) {
+    // the semantics of what to return are a bit messy if we allow
+    // 0-byte allocations, so we disallow them here (we don't need
+    // them for our internal use).
+    assert(bytes > 0);
+    if (bytes <= alloc_bytes_remaining_) {
+        char* result = alloc_ptr_;
+        alloc_ptr_ += bytes;
+        alloc_bytes_remaining_ -= bytes;
+        return result;
+    }
+    return AllocateFallback(bytes);
+}
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_UTIL_ARENA_H_
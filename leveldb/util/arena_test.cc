@@ -0,0 +1,132 @@
+#include "util/arena.h"
+
+#include <cstring>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "util/random.h"
+
+namespace leveldb {
+
+// allocates a mix of small and large pieces from "arena", fills each with
+// a pattern and checks none of them got overwritten. the arena may use
+// "slack" bytes more than the usual bound, for a partly used large block.
+static void CheckAllocations(Arena* arena, size_t slack) {
+    std::vector<std::pair<size_t, char*>> allocated;
+    const int N = 100000;
+    size_t bytes = 0;
+    Random rnd(301);
+    for (int i = 0; i < N; i++) {
+        size_t s;
+        if (i % (N / 10) == 0) {
+            s = i;
+        } else {
+            s = rnd.OneIn(4000)
+                    ? rnd.Uniform(6000)
+                    : (rnd.OneIn(10) ? rnd.Uniform(100) : rnd.Uniform(20));
+        }
+        if (s == 0) {
+            // our arena disallows size 0 allocations.
+            s = 1;
+        }
+        char* r;
+        if (rnd.OneIn(10)) {
+            r = arena->AllocateAligned(s);
+        } else {
+            r = arena->Allocate(s);
+        }
+
+        for (size_t b = 0; b < s; b++) {
+            // fill the "i"th allocation with a known bit pattern
+            r[b] = i % 256;
+        }
+        bytes += s;
+        allocated.push_back(std::make_pair(s, r));
+        ASSERT_GE(arena->MemoryUsage(), bytes);
+        if (i > N / 10) {
+            ASSERT_LE(arena->MemoryUsage(), bytes * 1.10 + slack);
+        }
+    }
+    for (size_t i = 0; i < allocated.size(); i++) {
+        size_t num_bytes = allocated[i].first;
+        const char* p = allocated[i].second;
+        for (size_t b = 0; b < num_bytes; b++) {
+            // check the "i"th allocation for the known bit pattern
+            ASSERT_EQ(int(p[b]) & 0xff, i % 256);
+        }
+    }
+}
+
+TEST(ArenaTest, Empty) { Arena arena; }
+
+TEST(ArenaTest, Simple) {
+    Arena arena;
+    CheckAllocations(&arena, 0);
+}
+
+TEST(ArenaTest, HugePages) {
+    // with or without huge pages to be had, the memory works the same
+    Arena arena(false, 2 << 20);
+    CheckAllocations(&arena, 2 << 20);
+}
+
+TEST(ArenaTest, HugePagesNotPowerOfTwo) {
+    // blocks of 3MB take whole huge pages from the pool, which have to be
+    // unmapped in full
+    Arena arena(false, 3 << 20, true /* numa_local */);
+    char* p = arena.Allocate(100);
+    p[0] = 'x';
+    ASSERT_GE(arena.MemoryUsage(), size_t{3 << 20});
+    // the rest of the block is there to be used
+    char* rest = arena.AllocateAligned((3 << 20) - 200);
+    rest[(3 << 20) - 201] = 'y';
+    ASSERT_EQ('x', p[0]);
+}
+
+TEST(ArenaTest, Concurrent) {
+    // threads allocate from blocks of their own shards and from the shared
+    // blocks at once, and no two allocations overlap
+    for (size_t huge_page_size : {size_t{0}, size_t{2 << 20}}) {
+        Arena arena(true, huge_page_size);
+        const int kThreads = 8;
+        const int kAllocations = 20000;
+        std::vector<std::vector<std::pair<size_t, char*>>> allocated(kThreads);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < kThreads; t++) {
+            threads.emplace_back([&arena, &allocated, t]() {
+                Random rnd(301 + t);
+                for (int i = 0; i < kAllocations; i++) {
+                    const size_t s = 1 + (rnd.OneIn(100) ? rnd.Uniform(3000) : rnd.Uniform(100));
+                    char* r;
+                    if (rnd.OneIn(2)) {
+                        r = arena.AllocateAligned(s);
+                        ASSERT_EQ(0, reinterpret_cast<uintptr_t>(r) & 7);
+                    } else {
+                        r = arena.Allocate(s);
+                    }
+                    std::memset(r, t * 31 + i % 7, s);
+                    allocated[t].push_back(std::make_pair(s, r));
+                }
+            });
+        }
+        size_t bytes = 0;
+        for (int t = 0; t < kThreads; t++) {
+            threads[t].join();
+        }
+        for (int t = 0; t < kThreads; t++) {
+            for (int i = 0; i < kAllocations; i++) {
+                const size_t num_bytes = allocated[t][i].first;
+                const char* p = allocated[t][i].second;
+                for (size_t b = 0; b < num_bytes; b++) {
+                    ASSERT_EQ(static_cast<char>(t * 31 + i % 7), p[b]);
+                }
+                bytes += num_bytes;
+            }
+        }
+        ASSERT_GE(arena.MemoryUsage(), bytes);
+    }
+}
+
+}  // namespace leveldb
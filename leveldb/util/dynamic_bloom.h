@@ -0,0 +1,117 @@
+#ifndef STORAGE_LEVELDB_UTIL_DYNAMIC_BLOOM_H_
+#define STORAGE_LEVELDB_UTIL_DYNAMIC_BLOOM_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+#include "leveldb/slice.h"
+#include "util/arena.h"
+#include "util/hash.h"
+
+namespace leveldb {
+
+// a bloom filter that keys are added to one at a time, e.g. as they are
+// inserted into a memtable, and that may be probed while keys are added.
+//
+// all probes for a key fall into one 64 byte block, so an add or a probe
+// touches a single cache line.
+class DynamicBloom {
+public:
+    // "total_bits" is rounded up to a whole number of blocks. The bits are
+    // allocated from "arena", which must outlive the filter.
+    DynamicBloom(Arena* arena, size_t total_bits, int num_probes = 6)
+        : num_blocks_((total_bits + kBlockBits - 1) / kBlockBits),
+          num_probes_(num_probes) {
+        if (num_blocks_ == 0) num_blocks_ = 1;
+        const size_t words = num_blocks_ * kWordsPerBlock;
+        // over-allocate to align the blocks with cache lines
+        char* raw = arena->AllocateAligned(words * sizeof(uint64_t) + kBlockBytes);
+        const uintptr_t aligned =
+                (reinterpret_cast<uintptr_t>(raw) + kBlockBytes - 1) & ~uintptr_t{kBlockBytes - 1};
+        data_ = reinterpret_cast<std::atomic<uint64_t>*>(aligned);
+        for (size_t i = 0; i < words; i++) {
+            new (&data_[i]) std::atomic<uint64_t>(0);
+        }
+    }
+
+    DynamicBloom(const DynamicBloom&) = delete;
+    DynamicBloom& operator=(const DynamicBloom&) = delete;
+
+    // REQUIRES: no other thread adds keys at the same time
+    void Add(const Slice& key) {
+        std::atomic<uint64_t>* block;
+        uint32_t h, delta;
+        Locate(key, &block, &h, &delta);
+        for (int i = 0; i < num_probes_; i++) {
+            const uint32_t bit = h & (kBlockBits - 1);
+            std::atomic<uint64_t>& word = block[bit / 64];
+            word.store(word.load(std::memory_order_relaxed) | (uint64_t{1} << (bit % 64)),
+                       std::memory_order_relaxed);
+            h += delta;
+        }
+    }
+
+    // same as Add(), but safe to call from several threads at once
+    void AddConcurrently(const Slice& key) {
+        std::atomic<uint64_t>* block;
+        uint32_t h, delta;
+        Locate(key, &block, &h, &delta);
+        for (int i = 0; i < num_probes_; i++) {
+            const uint32_t bit = h & (kBlockBits - 1);
+            const uint64_t mask = uint64_t{1} << (bit % 64);
+            std::atomic<uint64_t>& word = block[bit / 64];
+            // skip the locked instruction if the bit is set already
+            if ((word.load(std::memory_order_relaxed) & mask) == 0) {
+                word.fetch_or(mask, std::memory_order_relaxed);
+            }
+            h += delta;
+        }
+    }
+
+    // false if "key" was certainly never added. Keys whose addition
+    // happened before the call are always found.
+    bool MayContain(const Slice& key) const {
+        std::atomic<uint64_t>* block;
+        uint32_t h, delta;
+        Locate(key, &block, &h, &delta);
+        for (int i = 0; i < num_probes_; i++) {
+            const uint32_t bit = h & (kBlockBits - 1);
+            if ((block[bit / 64].load(std::memory_order_relaxed) &
+                 (uint64_t{1} << (bit % 64))) == 0) {
+                return false;
+            }
+            h += delta;
+        }
+        return true;
+    }
+
+private:
+    enum : size_t {
+        kBlockBytes = 64,
+        kBlockBits = kBlockBytes * 8,
+        kWordsPerBlock = kBlockBytes / sizeof(uint64_t),
+    };
+
+    // picks the block of "key" and the start and step of its probes
+    void Locate(const Slice& key, std::atomic<uint64_t>** block, uint32_t* h,
+                uint32_t* delta) const {
+        const uint32_t hash = Hash(key.data(), key.size(), 0xbc9f1d34);
+        // the block comes from the high bits of a remix, the probes from the
+        // hash itself, so the two are not correlated
+        const uint32_t mixed = hash * 0x9e3779b9u;
+        const size_t index = (static_cast<uint64_t>(mixed) * num_blocks_) >> 32;
+        *block = data_ + index * kWordsPerBlock;
+        *h = hash;
+        *delta = (hash >> 17) | (hash << 15);  // rotate right 17 bits
+    }
+
+    size_t num_blocks_;
+    const int num_probes_;
+    std::atomic<uint64_t>* data_;  // allocated from the arena
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_UTIL_DYNAMIC_BLOOM_H_
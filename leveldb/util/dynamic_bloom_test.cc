@@ -0,0 +1,83 @@
+#include "util/dynamic_bloom.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "util/arena.h"
+
+namespace leveldb {
+
+static std::string Key(int i) { return "key" + std::to_string(i); }
+
+// fraction of 10000 keys that were never added that "bloom" still matches
+static double FalsePositiveRate(const DynamicBloom& bloom) {
+    int result = 0;
+    for (int i = 0; i < 10000; i++) {
+        if (bloom.MayContain(Key(i + 1000000000))) {
+            result++;
+        }
+    }
+    return result / 10000.0;
+}
+
+TEST(DynamicBloomTest, Empty) {
+    Arena arena;
+    DynamicBloom bloom(&arena, 1000);
+    ASSERT_TRUE(!bloom.MayContain("hello"));
+    ASSERT_TRUE(!bloom.MayContain("world"));
+}
+
+TEST(DynamicBloomTest, Small) {
+    Arena arena;
+    DynamicBloom bloom(&arena, 0);  // rounded up to one block
+    bloom.Add("hello");
+    bloom.Add("world");
+    ASSERT_TRUE(bloom.MayContain("hello"));
+    ASSERT_TRUE(bloom.MayContain("world"));
+    ASSERT_TRUE(!bloom.MayContain("x"));
+    ASSERT_TRUE(!bloom.MayContain("foo"));
+}
+
+TEST(DynamicBloomTest, VaryingLengths) {
+    for (int length = 1; length <= 10000; length *= 10) {
+        Arena arena;
+        // 10 bits per key
+        DynamicBloom bloom(&arena, length * 10);
+        for (int i = 0; i < length; i++) {
+            bloom.Add(Key(i));
+        }
+        for (int i = 0; i < length; i++) {
+            ASSERT_TRUE(bloom.MayContain(Key(i))) << "length " << length << "; key " << i;
+        }
+        if (length >= 1000) {
+            ASSERT_LE(FalsePositiveRate(bloom), 0.03) << "length " << length;
+        }
+    }
+}
+
+TEST(DynamicBloomTest, AddConcurrently) {
+    const int kThreads = 4;
+    const int kPerThread = 10000;
+    Arena arena;
+    DynamicBloom bloom(&arena, kThreads * kPerThread * 10);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; t++) {
+        threads.emplace_back([&bloom, t]() {
+            for (int i = 0; i < kPerThread; i++) {
+                bloom.AddConcurrently(Key(i * kThreads + t));
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    // no bit set by one thread got lost to another thread's update
+    for (int i = 0; i < kThreads * kPerThread; i++) {
+        ASSERT_TRUE(bloom.MayContain(Key(i))) << i;
+    }
+    ASSERT_LE(FalsePositiveRate(bloom), 0.03);
+}
+
+}  // namespace leveldb
@@ -0,0 +1,42 @@
+#include "leveldb/env.h"
+
+#include "leveldb/slice.h"
+
+namespace leveldb {
+
+Env::Env() = default;
+
+Env::~Env() = default;
+
+Status Env::ReuseWritableFile(const std::string& fname,
+                              const std::string& old_fname,
+                              WritableFile** result) {
+    Status s = RenameFile(old_fname, fname);
+    if (!s.ok()) {
+        *result = nullptr;
+        return s;
+    }
+    return NewWritableFile(fname, result);
+}
+
+SequentialFile::~SequentialFile() = default;
+
+RandomAccessFile::~RandomAccessFile() = default;
+
+void RandomAccessFile::MultiRead(ReadRequest* reqs, size_t n) const {
+    for (size_t i = 0; i < n; i++) {
+        reqs[i].status = Read(reqs[i].offset, reqs[i].n, &reqs[i].result, reqs[i].scratch);
+    }
+}
+
+WritableFile::~WritableFile() = default;
+
+Status WritableFile::AppendV(const Slice* data, size_t n) {
+    Status s;
+    for (size_t i = 0; i < n && s.ok(); i++) {
+        s = Append(data[i]);
+    }
+    return s;
+}
+
+}  // namespace leveldb
@@ -1,56 +1,803 @@
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <climits>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(HAVE_IO_URING)
+#include <liburing.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#endif  // defined(HAVE_IO_URING)
 
 #include "leveldb/env.h"
+#include "leveldb/slice.h"
 
 namespace leveldb {
 
 namespace {
 
+// Common flags defined for all posix open operations
+#if defined(HAVE_O_CLOEXEC)
+constexpr const int kOpenBaseFlags = O_CLOEXEC;
+#else
+constexpr const int kOpenBaseFlags = 0;
+#endif  // defined(HAVE_O_CLOEXEC)
+
+constexpr const size_t kWritableFileBufferSize = 65536;
+
+// AppendV() writes a gather at least this big straight from the caller's
+// memory instead of copying it into the write buffer.
+constexpr const size_t kDirectWriteThreshold = kWritableFileBufferSize / 4;
+
+#if defined(HAVE_IO_URING)
+// Submission queue size of the ring behind an asynchronously written file.
+// Each SubmitAsync() takes at most two entries.
+constexpr const unsigned kIoUringQueueDepth = 64;
+constexpr const size_t kMaxAsyncOpsInFlight = kIoUringQueueDepth / 2;
+#endif  // defined(HAVE_IO_URING)
+
+Status PosixError(const std::string& context, int error_number) {
+    if (error_number == ENOENT) {
+        return Status::NotFound(context, std::strerror(error_number));
+    } else {
+        return Status::IOError(context, std::strerror(error_number));
+    }
+}
+
+// implements sequential read access in a file using read().
+//
+// instances of this class are thread-friendly but not thread-safe, as required
+// by the SequentialFile API.
+class PosixSequentialFile final : public SequentialFile {
+public:
+    PosixSequentialFile(std::string filename, int fd)
+        : fd_(fd), filename_(std::move(filename)) {}
+    ~PosixSequentialFile() override { close(fd_); }
+
+    Status Read(size_t n, Slice* result, char* scratch) override {
+        Status status;
+        while (true) {
+            ::ssize_t read_size = ::read(fd_, scratch, n);
+            if (read_size < 0) {  // read error.
+                if (errno == EINTR) {
+                    continue;  // retry
+                }
+                status = PosixError(filename_, errno);
+                break;
+            }
+            *result = Slice(scratch, read_size);
+            break;
+        }
+        return status;
+    }
+
+    Status Skip(uint64_t n) override {
+        if (::lseek(fd_, n, SEEK_CUR) == static_cast<off_t>(-1)) {
+            return PosixError(filename_, errno);
+        }
+        return Status::OK();
+    }
+
+private:
+    const int fd_;
+    const std::string filename_;
+};
+
+#if defined(HAVE_IO_URING)
+// the ring a thread issues MultiRead() calls on, set up on first use and
+// torn down when the thread exits. A ring per thread rather than per file
+// needs no locking, and there are far fewer threads than open files.
+class PosixReadRing {
+public:
+    ~PosixReadRing() { Disable(); }
+
+    // nullptr if the calling thread cannot get a ring
+    static struct io_uring* Get() {
+        PosixReadRing* r = &thread_ring_;
+        if (r->state_ == kRingUnset) {
+            r->state_ = ::io_uring_queue_init(kIoUringQueueDepth, &r->ring_, 0) == 0
+                        ? kRingReady : kRingFailed;
+        }
+        return r->state_ == kRingReady ? &r->ring_ : nullptr;
+    }
+
+    // drops the ring of the calling thread, along with anything queued on
+    // it but not submitted. MultiRead() falls back to pread() from then on.
+    static void Fail() { thread_ring_.Disable(); }
+
+private:
+    enum RingState { kRingUnset, kRingReady, kRingFailed };
+
+    void Disable() {
+        if (state_ == kRingReady) {
+            ::io_uring_queue_exit(&ring_);
+        }
+        state_ = kRingFailed;
+    }
+
+    static thread_local PosixReadRing thread_ring_;
+
+    RingState state_ = kRingUnset;
+    struct io_uring ring_;
+};
+
+thread_local PosixReadRing PosixReadRing::thread_ring_;
+#endif  // defined(HAVE_IO_URING)
+
+// implements random read access in a file using pread().
+//
+// instances of this class are thread-safe, as required by the RandomAccessFile
+// API. When built with io_uring, MultiRead() submits all its reads to the
+// ring of the calling thread at once.
+class PosixRandomAccessFile final : public RandomAccessFile {
+public:
+    PosixRandomAccessFile(std::string filename, int fd)
+        : fd_(fd), filename_(std::move(filename)) {}
+    ~PosixRandomAccessFile() override { close(fd_); }
+
+    Status Read(uint64_t offset, size_t n, Slice* result,
+                char* scratch) const override {
+        Status status;
+        ::ssize_t read_size;
+        do {
+            read_size = ::pread(fd_, scratch, n, static_cast<off_t>(offset));
+        } while (read_size < 0 && errno == EINTR);
+        *result = Slice(scratch, (read_size < 0) ? 0 : read_size);
+        if (read_size < 0) {  // read error.
+            status = PosixError(filename_, errno);
+        }
+        return status;
+    }
+
+#if defined(HAVE_IO_URING)
+    void MultiRead(ReadRequest* reqs, size_t n) const override {
+        size_t done = 0;
+        while (done < n) {
+            struct io_uring* ring = (n - done > 1) ? PosixReadRing::Get() : nullptr;
+            if (ring == nullptr) {
+                RandomAccessFile::MultiRead(reqs + done, n - done);
+                return;
+            }
+            const size_t batch = std::min<size_t>(n - done, kIoUringQueueDepth);
+            if (!ReadBatch(ring, reqs + done, batch)) {
+                PosixReadRing::Fail();
+            }
+            done += batch;
+        }
+    }
+#endif  // defined(HAVE_IO_URING)
+
+private:
+#if defined(HAVE_IO_URING)
+    // issues reqs[0, n) on "ring" and waits for them. Returns false if the
+    // ring broke down, and should be dropped; every request is still
+    // complete then, the ones the ring did not take having been read with
+    // pread(), and none is still being read into.
+    bool ReadBatch(struct io_uring* ring, ReadRequest* reqs, size_t n) const {
+        std::vector<bool> completed(n, false);
+        for (size_t i = 0; i < n; i++) {
+            struct io_uring_sqe* sqe = ::io_uring_get_sqe(ring);
+            ::io_uring_prep_read(sqe, fd_, reqs[i].scratch,
+                                 static_cast<unsigned>(reqs[i].n), reqs[i].offset);
+            ::io_uring_sqe_set_data(sqe, reinterpret_cast<void*>(i));
+        }
+        int submit_result;
+        do {
+            submit_result = ::io_uring_submit(ring);
+        } while (submit_result == -EINTR);
+        const size_t submitted = (submit_result < 0) ? 0 : submit_result;
+
+        bool ring_ok = (submitted == n);
+        for (size_t reaped = 0; reaped < submitted; reaped++) {
+            struct io_uring_cqe* cqe = nullptr;
+            int wait_result;
+            do {
+                wait_result = ::io_uring_wait_cqe(ring, &cqe);
+            } while (wait_result == -EINTR);
+            if (wait_result != 0) {
+                // the ring is of no more use, but the reads in flight write
+                // into the caller's scratch space, so they have to be reaped
+                // before returning. Their completions still arrive in the
+                // completion queue, which is polled from here on.
+                ring_ok = false;
+                while (::io_uring_peek_cqe(ring, &cqe) != 0) {
+                    std::this_thread::yield();
+                }
+            }
+            const size_t i = reinterpret_cast<size_t>(::io_uring_cqe_get_data(cqe));
+            const int res = cqe->res;
+            ::io_uring_cqe_seen(ring, cqe);
+            Finish(&reqs[i], res);
+            completed[i] = true;
+        }
+        for (size_t i = 0; i < n; i++) {
+            if (!completed[i]) {
+                reqs[i].status = Read(reqs[i].offset, reqs[i].n, &reqs[i].result, reqs[i].scratch);
+            }
+        }
+        return ring_ok;
+    }
+
+    // fills in the result of a read the ring returned "res" for
+    void Finish(ReadRequest* req, int res) const {
+        if (res < 0) {
+            // let pread() retry it and report the error, if it persists
+            req->status = Read(req->offset, req->n, &req->result, req->scratch);
+        } else if (res == 0 || static_cast<size_t>(res) == req->n) {
+            req->result = Slice(req->scratch, res);
+            req->status = Status::OK();
+        } else {
+            // short read, which may be the end of the file. Read() tells
+            Slice rest;
+            req->status = Read(req->offset + res, req->n - res, &rest, req->scratch + res);
+            req->result = Slice(req->scratch, res + rest.size());
+        }
+    }
+#endif  // defined(HAVE_IO_URING)
+
+    const int fd_;
+    const std::string filename_;
+};
+
+// writes go through a user space buffer and then pwrite() at offset_.
+//
+// when built with io_uring, the file can also be written asynchronously:
+// after the first SubmitAsync() appends collect in pending_, and each
+// SubmitAsync() hands them to the ring as a write, linked to an fdatasync
+// for a sync submit. Positional writes keep the synchronous and the
+// asynchronous path from racing over the file position.
 class PosixWritableFile final : public WritableFile {
 public:
     PosixWritableFile(std::string filename, int fd)
         : pos_(0),
+          offset_(0),
           fd_(fd),
           is_manifest_(IsManifest(filename)),
           filename_(std::move(filename)),
           dirname_(Dirname(filename_)) {}
     ~PosixWritableFile() override {
-        if (fd >= 0) {
+        if (fd_ >= 0) {
+            // ignoring any potential errors
             Close();
         }
     }
 
     Status Append(const Slice& data) override {
-        return Status::OK();
+#if defined(HAVE_IO_URING)
+        if (async_) {
+            // only the thread appending touches pending_, no lock needed
+            pending_.append(data.data(), data.size());
+            return Status::OK();
+        }
+#endif  // defined(HAVE_IO_URING)
+        size_t write_size = data.size();
+        const char* write_data = data.data();
+
+        // fit as much as possible into buffer.
+        size_t copy_size = std::min(write_size, kWritableFileBufferSize - pos_);
+        std::memcpy(buf_ + pos_, write_data, copy_size);
+        write_data += copy_size;
+        write_size -= copy_size;
+        pos_ += copy_size;
+        if (write_size == 0) {
+            return Status::OK();
+        }
+
+        // can't fit in buffer, so need to do at least one write.
+        Status status = FlushBuffer();
+        if (!status.ok()) {
+            return status;
+        }
+
+        // small writes go to buffer, large writes are written directly.
+        if (write_size < kWritableFileBufferSize) {
+            std::memcpy(buf_, write_data, write_size);
+            pos_ = write_size;
+            return Status::OK();
+        }
+        return WriteUnbuffered(write_data, write_size);
     }
+
+    Status AppendV(const Slice* data, size_t n) override {
+        size_t total = 0;
+        for (size_t i = 0; i < n; i++) {
+            total += data[i].size();
+        }
+#if defined(HAVE_IO_URING)
+        if (async_) {
+            return WritableFile::AppendV(data, n);
+        }
+#endif  // defined(HAVE_IO_URING)
+        if (total < kDirectWriteThreshold) {
+            return WritableFile::AppendV(data, n);
+        }
+
+        // write out whatever is buffered and the pieces with one gathered
+        // write, without copying the pieces
+        std::vector<struct ::iovec> iov;
+        iov.reserve(n + 1);
+        if (pos_ > 0) {
+            iov.push_back({buf_, pos_});
+        }
+        for (size_t i = 0; i < n; i++) {
+            if (!data[i].empty()) {
+                iov.push_back({const_cast<char*>(data[i].data()), data[i].size()});
+            }
+        }
+        const size_t size = pos_ + total;
+        pos_ = 0;
+        Status status = PwritevFully(iov.data(), iov.size(), offset_);
+        offset_ += size;
+        return status;
+    }
+
     Status Close() override {
-        return Status::OK();
+        Status status;
+#if defined(HAVE_IO_URING)
+        if (async_) {
+            uint64_t ticket;
+            status = SubmitAsync(false, &ticket);
+            Status wait_status = WaitAsync(ticket);
+            if (status.ok()) {
+                status = wait_status;
+            }
+        }
+        if (ring_state_ == kRingReady) {
+            ::io_uring_queue_exit(&ring_);
+            ring_state_ = kRingFailed;
+        }
+#endif  // defined(HAVE_IO_URING)
+        Status flush_status = FlushBuffer();
+        if (status.ok()) {
+            status = flush_status;
+        }
+        const int close_result = ::close(fd_);
+        if (close_result < 0 && status.ok()) {
+            status = PosixError(filename_, errno);
+        }
+        fd_ = -1;
+        return status;
     }
+
     Status Flush() override {
-        return Status::OK();
+#if defined(HAVE_IO_URING)
+        if (async_) {
+            uint64_t ticket;
+            Status status = SubmitAsync(false, &ticket);
+            Status wait_status = WaitAsync(ticket);
+            return status.ok() ? wait_status : status;
+        }
+#endif  // defined(HAVE_IO_URING)
+        return FlushBuffer();
     }
+
     Status Sync() override {
+        // ensure new files referred to by the manifest are in the filesystem.
+        //
+        // this needs to happen before the manifest file is flushed to disk, to
+        // avoid crashing in a state where the manifest refers to files that are
+        // not yet on disk.
+        Status status = SyncDirIfManifest();
+        if (!status.ok()) {
+            return status;
+        }
+#if defined(HAVE_IO_URING)
+        if (async_) {
+            uint64_t ticket;
+            status = SubmitAsync(true, &ticket);
+            Status wait_status = WaitAsync(ticket);
+            return status.ok() ? wait_status : status;
+        }
+#endif  // defined(HAVE_IO_URING)
+
+        status = FlushBuffer();
+        if (!status.ok()) {
+            return status;
+        }
+
+        return SyncFd(fd_, filename_);
+    }
+
+    Status Allocate(uint64_t offset, uint64_t len) override {
+#if defined(HAVE_FALLOCATE)
+        // FALLOC_FL_KEEP_SIZE reserves the blocks without changing the file
+        // size, so a reader still stops at the last byte actually written.
+        if (::fallocate(fd_, FALLOC_FL_KEEP_SIZE, static_cast<off_t>(offset),
+                        static_cast<off_t>(len)) != 0) {
+            return PosixError(filename_, errno);
+        }
+#else
+        (void)offset;
+        (void)len;
+#endif  // defined(HAVE_FALLOCATE)
         return Status::OK();
     }
 
+#if defined(HAVE_IO_URING)
+    Status SubmitAsync(bool sync, uint64_t* ticket) override {
+        if (!EnsureRing()) {
+            // no ring available, do it the synchronous way
+            return WritableFile::SubmitAsync(sync, ticket);
+        }
+        std::unique_lock<std::mutex> lock(async_mu_);
+        if (!async_) {
+            // switch to asynchronous mode, anything buffered goes first
+            pending_.assign(buf_, pos_);
+            pos_ = 0;
+            async_ = true;
+        }
+        while (in_flight_.size() >= kMaxAsyncOpsInFlight && async_status_.ok()) {
+            // keep the submission queue from overflowing
+            ReapLocked(&lock, in_flight_.front()->ticket);
+        }
+        if (!async_status_.ok()) {
+            *ticket = submitted_;
+            return async_status_;
+        }
+
+        AsyncOp* op = new AsyncOp;
+        op->ticket = ++submitted_;
+        op->data.swap(pending_);
+        op->offset = offset_;
+        op->sync = sync;
+        offset_ += op->data.size();
+        in_flight_.push_back(op);
+        *ticket = op->ticket;
+
+        // a sync only covers the writes that completed before it started, so
+        // when earlier writes are still in flight let it wait for them.
+        const bool drain = sync && in_flight_.size() > 1;
+        if (!op->data.empty()) {
+            struct io_uring_sqe* sqe = ::io_uring_get_sqe(&ring_);
+            ::io_uring_prep_write(sqe, fd_, op->data.data(),
+                                  static_cast<unsigned>(op->data.size()), op->offset);
+            sqe->flags |= (sync ? IOSQE_IO_LINK : 0) | (drain ? IOSQE_IO_DRAIN : 0);
+            ::io_uring_sqe_set_data(sqe, &op->write_request);
+            op->pending++;
+        }
+        if (sync) {
+            struct io_uring_sqe* sqe = ::io_uring_get_sqe(&ring_);
+            ::io_uring_prep_fsync(sqe, fd_, IORING_FSYNC_DATASYNC);
+            if (op->data.empty() && drain) {
+                sqe->flags |= IOSQE_IO_DRAIN;
+            }
+            ::io_uring_sqe_set_data(sqe, &op->sync_request);
+            op->pending++;
+        }
+        if (op->pending > 0) {
+            const int submit_result = ::io_uring_submit(&ring_);
+            if (submit_result < 0) {
+                // the kernel never saw this op, so nothing will ever complete
+                // it. Take it back out, or waiters for its ticket would reap
+                // forever. The sqes it leaves in the ring are never submitted,
+                // since nothing is submitted once async_status_ is set.
+                in_flight_.pop_back();
+                delete op;
+                if (async_status_.ok()) {
+                    async_status_ = PosixError(filename_, -submit_result);
+                }
+                RetireLocked();
+                async_cv_.notify_all();
+                return async_status_;
+            }
+        } else {
+            RetireLocked();
+        }
+        return Status::OK();
+    }
+
+    Status WaitAsync(uint64_t ticket) override {
+        std::unique_lock<std::mutex> lock(async_mu_);
+        if (!async_) {
+            return Status::OK();  // submits were synchronous
+        }
+        while (completed_ < ticket) {
+            if (!async_status_.ok() && in_flight_.empty()) {
+                break;  // failed, and nothing left that could complete
+            }
+            ReapLocked(&lock, ticket);
+        }
+        return async_status_;
+    }
+#endif  // defined(HAVE_IO_URING)
+
 private:
+#if defined(HAVE_IO_URING)
+    struct AsyncOp;
+
+    // io_uring user data, tells the write and the sync of an op apart
+    struct AsyncRequest {
+        AsyncOp* op;
+        bool is_sync;
+    };
+
+    struct AsyncOp {
+        AsyncOp() : ticket(0), offset(0), sync(false), pending(0) {
+            write_request = {this, false};
+            sync_request = {this, true};
+        }
+
+        uint64_t ticket;
+        std::string data;     // must stay put until the write completes
+        uint64_t offset;
+        bool sync;
+        int pending;          // completions still outstanding
+        bool redo_sync = false;  // linked sync was cancelled by a short write
+        Status status;
+        AsyncRequest write_request;
+        AsyncRequest sync_request;
+    };
+
+    enum RingState { kRingUnset, kRingReady, kRingFailed };
+
+    bool EnsureRing() {
+        if (ring_state_ == kRingUnset) {
+            ring_state_ = ::io_uring_queue_init(kIoUringQueueDepth, &ring_, 0) == 0
+                          ? kRingReady : kRingFailed;
+        }
+        return ring_state_ == kRingReady;
+    }
+
+    // Waits for one completion, unless another thread is already doing so,
+    // in which case waits for that thread to make progress.
+    // REQUIRES: *lock holds async_mu_
+    void ReapLocked(std::unique_lock<std::mutex>* lock, uint64_t ticket) {
+        if (reaping_) {
+            async_cv_.wait(*lock);
+            return;
+        }
+        reaping_ = true;
+        lock->unlock();
+        struct io_uring_cqe* cqe = nullptr;
+        int wait_result;
+        do {
+            wait_result = ::io_uring_wait_cqe(&ring_, &cqe);
+        } while (wait_result == -EINTR);
+        AsyncRequest* request = nullptr;
+        int res = 0;
+        if (wait_result == 0) {
+            request = static_cast<AsyncRequest*>(::io_uring_cqe_get_data(cqe));
+            res = cqe->res;
+            ::io_uring_cqe_seen(&ring_, cqe);
+        }
+        lock->lock();
+        reaping_ = false;
+
+        if (wait_result != 0) {
+            // the ring is unusable, fail everything in flight
+            if (async_status_.ok()) {
+                async_status_ = PosixError(filename_, -wait_result);
+            }
+            for (AsyncOp* op : in_flight_) {
+                op->pending = 0;
+            }
+        } else {
+            Complete(request, res);
+        }
+        RetireLocked();
+        async_cv_.notify_all();
+    }
+
+    // REQUIRES: async_mu_ held
+    void Complete(AsyncRequest* request, int res) {
+        AsyncOp* op = request->op;
+        op->pending--;
+        if (!request->is_sync) {
+            if (res < 0) {
+                op->status = PosixError(filename_, -res);
+            } else if (static_cast<size_t>(res) < op->data.size()) {
+                // short write: finish it by hand. A linked sync gets
+                // cancelled in this case, so that has to be redone too.
+                op->status = PwriteFully(op->data.data() + res,
+                                         op->data.size() - res, op->offset + res);
+                op->redo_sync = op->sync;
+            }
+        } else if (res == -ECANCELED && op->redo_sync) {
+            if (op->status.ok()) {
+                op->status = SyncFd(fd_, filename_);
+            }
+        } else if (res < 0 && op->status.ok()) {
+            op->status = PosixError(filename_, -res);
+        }
+    }
+
+    // Retires finished ops in submission order, so completed_ only moves
+    // past an op once every earlier one is done too.
+    // REQUIRES: async_mu_ held
+    void RetireLocked() {
+        while (!in_flight_.empty() && in_flight_.front()->pending == 0) {
+            AsyncOp* op = in_flight_.front();
+            in_flight_.pop_front();
+            if (!op->status.ok() && async_status_.ok()) {
+                async_status_ = op->status;
+            }
+            completed_ = op->ticket;
+            delete op;
+        }
+        if (in_flight_.empty()) {
+            completed_ = submitted_;
+        }
+    }
+#endif  // defined(HAVE_IO_URING)
+
+    Status FlushBuffer() {
+        Status status = WriteUnbuffered(buf_, pos_);
+        pos_ = 0;
+        return status;
+    }
+
+    Status WriteUnbuffered(const char* data, size_t size) {
+        Status status = PwriteFully(data, size, offset_);
+        offset_ += size;
+        return status;
+    }
+
+    Status PwriteFully(const char* data, size_t size, uint64_t offset) {
+        while (size > 0) {
+            ssize_t write_result = ::pwrite(fd_, data, size, static_cast<off_t>(offset));
+            if (write_result < 0) {
+                if (errno == EINTR) {
+                    continue;  // retry
+                }
+                return PosixError(filename_, errno);
+            }
+            data += write_result;
+            size -= write_result;
+            offset += write_result;
+        }
+        return Status::OK();
+    }
+
+    // like PwriteFully(), for the concatenation of iov[0,count-1].
+    // modifies *iov to keep track of partial writes.
+    Status PwritevFully(struct ::iovec* iov, size_t count, uint64_t offset) {
+        while (count > 0) {
+            const int batch = static_cast<int>(std::min<size_t>(count, IOV_MAX));
+            ssize_t write_result = ::pwritev(fd_, iov, batch, static_cast<off_t>(offset));
+            if (write_result < 0) {
+                if (errno == EINTR) {
+                    continue;  // retry
+                }
+                return PosixError(filename_, errno);
+            }
+            offset += write_result;
+            size_t written = static_cast<size_t>(write_result);
+            while (count > 0 && written >= iov->iov_len) {
+                written -= iov->iov_len;
+                iov++;
+                count--;
+            }
+            if (written > 0) {
+                iov->iov_base = static_cast<char*>(iov->iov_base) + written;
+                iov->iov_len -= written;
+            }
+        }
+        return Status::OK();
+    }
+
+    Status SyncDirIfManifest() {
+        Status status;
+        if (!is_manifest_) {
+            return status;
+        }
+
+        int fd = ::open(dirname_.c_str(), O_RDONLY | kOpenBaseFlags);
+        if (fd < 0) {
+            status = PosixError(dirname_, errno);
+        } else {
+            status = SyncFd(fd, dirname_);
+            ::close(fd);
+        }
+        return status;
+    }
+
+    // ensures that all the caches associated with the given file descriptor's
+    // data are flushed all the way to durable media, and can withstand power
+    // failures.
+    //
+    // the path argument is only used to populate the description string in the
+    // returned Status if an error occurs.
+    static Status SyncFd(int fd, const std::string& fd_path) {
+#if HAVE_FULLFSYNC
+        // on macOS and iOS, fsync() doesn't guarantee durability past power
+        // failures. fcntl(F_FULLFSYNC) is required for that purpose. Some
+        // filesystems don't support fcntl(F_FULLFSYNC), and require a fallback to
+        // fsync().
+        if (::fcntl(fd, F_FULLFSYNC) == 0) {
+            return Status::OK();
+        }
+#endif  // HAVE_FULLFSYNC
+
+#if HAVE_FDATASYNC
+        bool sync_success = ::fdatasync(fd) == 0;
+#else
+        bool sync_success = ::fsync(fd) == 0;
+#endif  // HAVE_FDATASYNC
+
+        if (sync_success) {
+            return Status::OK();
+        }
+        return PosixError(fd_path, errno);
+    }
+
+    // returns the directory name in a path pointing to a file.
+    //
+    // returns "." if the path does not contain any directory separator.
     static std::string Dirname(const std::string& filename) {
         std::string::size_type separator_pos = filename.rfind('/');
         if (separator_pos == std::string::npos) {
             return std::string(".");
         }
-        assert(filename.find('/', separator_pos + 1) == std::string:npos);
+        // the filename component should not contain a path separator. If it does,
+        // the splitting was done incorrectly.
+        assert(filename.find('/', separator_pos + 1) == std::string::npos);
 
         return filename.substr(0, separator_pos);
     }
 
+    // extracts the file name from a path pointing to a file.
+    //
+    // the returned Slice points to |filename|'s data buffer, so it is only valid
+    // while |filename| is alive and unchanged.
+    static Slice Basename(const std::string& filename) {
+        std::string::size_type separator_pos = filename.rfind('/');
+        if (separator_pos == std::string::npos) {
+            return Slice(filename);
+        }
+        // the filename component should not contain a path separator. If it does,
+        // the splitting was done incorrectly.
+        assert(filename.find('/', separator_pos + 1) == std::string::npos);
+
+        return Slice(filename.data() + separator_pos + 1,
+                     filename.length() - separator_pos - 1);
+    }
+
+    // true if the given file is a manifest file.
     static bool IsManifest(const std::string& filename) {
-        reeturn true;
+        return Basename(filename).starts_with("MANIFEST");
     }
+
+    // buf_[0, pos_ - 1] contains data to be written to fd_.
+    char buf_[kWritableFileBufferSize];
     size_t pos_;
+    uint64_t offset_;  // file offset the next write goes to
     int fd_;
-    const bool is_manifest_;
+
+#if defined(HAVE_IO_URING)
+    // set by the first SubmitAsync() that gets a ring. Only the appending
+    // thread writes it, under async_mu_; other threads read it under
+    // async_mu_ too.
+    bool async_ = false;
+    std::string pending_;    // appends since the last SubmitAsync()
+    RingState ring_state_ = kRingUnset;
+    struct io_uring ring_;
+
+    std::mutex async_mu_;
+    std::condition_variable async_cv_;
+    bool reaping_ = false;            // a thread is blocked on the ring
+    uint64_t submitted_ = 0;          // last ticket handed out
+    uint64_t completed_ = 0;          // every ticket up to this one is done
+    std::deque<AsyncOp*> in_flight_;  // in submission order
+    Status async_status_;             // first error of any async op
+#endif  // defined(HAVE_IO_URING)
+
+    const bool is_manifest_;  // true if the file's name starts with MANIFEST.
     const std::string filename_;
-    const std::string dirname_;
+    const std::string dirname_;  // the directory of filename_.
 };
 
 class PosixEnv : public Env {
@@ -58,20 +805,107 @@ public:
     PosixEnv() {}
     ~PosixEnv() {}
 
+    Status NewSequentialFile(const std::string& filename,
+                             SequentialFile** result) override {
+        int fd = ::open(filename.c_str(), O_RDONLY | kOpenBaseFlags);
+        if (fd < 0) {
+            *result = nullptr;
+            return PosixError(filename, errno);
+        }
+
+        *result = new PosixSequentialFile(filename, fd);
+        return Status::OK();
+    }
+
+    Status NewRandomAccessFile(const std::string& filename,
+                               RandomAccessFile** result) override {
+        *result = nullptr;
+        int fd = ::open(filename.c_str(), O_RDONLY | kOpenBaseFlags);
+        if (fd < 0) {
+            return PosixError(filename, errno);
+        }
+
+        *result = new PosixRandomAccessFile(filename, fd);
+        return Status::OK();
+    }
+
     Status NewWritableFile(const std::string& filename,
                            WritableFile** result) override {
-        int fd = ::open(filename->c_str(),
+        int fd = ::open(filename.c_str(),
                         O_TRUNC | O_WRONLY | O_CREAT | kOpenBaseFlags, 0644);
         if (fd < 0) {
             *result = nullptr;
-            //return PosixError(filename, errno);
-            return Status::OK();
+            return PosixError(filename, errno);
         }
 
         *result = new PosixWritableFile(filename, fd);
         return Status::OK();
     }
-}
+
+    Status ReuseWritableFile(const std::string& filename,
+                             const std::string& old_filename,
+                             WritableFile** result) override {
+        *result = nullptr;
+        if (std::rename(old_filename.c_str(), filename.c_str()) != 0) {
+            return PosixError(old_filename, errno);
+        }
+        // no O_TRUNC: the old blocks stay allocated and are overwritten from
+        // offset 0, so appends do not have to grow the file.
+        int fd = ::open(filename.c_str(), O_WRONLY | kOpenBaseFlags, 0644);
+        if (fd < 0) {
+            return PosixError(filename, errno);
+        }
+
+        *result = new PosixWritableFile(filename, fd);
+        return Status::OK();
+    }
+
+    Status GetChildren(const std::string& directory_path,
+                       std::vector<std::string>* result) override {
+        result->clear();
+        ::DIR* dir = ::opendir(directory_path.c_str());
+        if (dir == nullptr) {
+            return PosixError(directory_path, errno);
+        }
+        struct ::dirent* entry;
+        while ((entry = ::readdir(dir)) != nullptr) {
+            result->emplace_back(entry->d_name);
+        }
+        ::closedir(dir);
+        return Status::OK();
+    }
+
+    Status RemoveFile(const std::string& filename) override {
+        if (::unlink(filename.c_str()) != 0) {
+            return PosixError(filename, errno);
+        }
+        return Status::OK();
+    }
+
+    Status RenameFile(const std::string& from, const std::string& to) override {
+        if (std::rename(from.c_str(), to.c_str()) != 0) {
+            return PosixError(from, errno);
+        }
+        return Status::OK();
+    }
+
+    void StartThread(void (*thread_main)(void* thread_main_arg),
+                     void* thread_main_arg) override {
+        std::thread new_thread(thread_main, thread_main_arg);
+        new_thread.detach();
+    }
+
+    uint64_t NowMicros() override {
+        static constexpr uint64_t kUsecondsPerSecond = 1000000;
+        struct ::timeval tv;
+        ::gettimeofday(&tv, nullptr);
+        return static_cast<uint64_t>(tv.tv_sec) * kUsecondsPerSecond + tv.tv_usec;
+    }
+
+    void SleepForMicroseconds(int micros) override {
+        std::this_thread::sleep_for(std::chrono::microseconds(micros));
+    }
+};
 
 }  // namespace
 
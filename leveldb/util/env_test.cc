@@ -0,0 +1,134 @@
+#include "leveldb/env.h"
+
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace leveldb {
+
+class EnvTest : public testing::Test {
+public:
+    EnvTest() : env_(Env::Default()) {}
+
+    std::string ReadFile(const std::string& fname) {
+        SequentialFile* file;
+        EXPECT_TRUE(env_->NewSequentialFile(fname, &file).ok());
+        std::string contents;
+        char scratch[4096];
+        while (true) {
+            Slice fragment;
+            EXPECT_TRUE(file->Read(sizeof(scratch), &fragment, scratch).ok());
+            if (fragment.empty()) {
+                break;
+            }
+            contents.append(fragment.data(), fragment.size());
+        }
+        delete file;
+        return contents;
+    }
+
+    Env* env_;
+};
+
+TEST_F(EnvTest, AsyncWrites) {
+    const std::string fname = testing::TempDir() + "env_test_async";
+    WritableFile* file;
+    ASSERT_TRUE(env_->NewWritableFile(fname, &file).ok());
+
+    // appends keep going while earlier submits are in flight, and another
+    // thread waits for them, the way the log is written with
+    // enable_async_log_write
+    std::string expected;
+    uint64_t last_ticket = 0;
+    std::thread waiter;
+    for (int i = 0; i < 200; i++) {
+        const std::string record(100 + i, static_cast<char>('a' + i % 26));
+        ASSERT_TRUE(file->Append(record).ok());
+        expected += record;
+        uint64_t ticket;
+        ASSERT_TRUE(file->SubmitAsync(i % 10 == 9, &ticket).ok());
+        ASSERT_GE(ticket, last_ticket);
+        last_ticket = ticket;
+        if (i == 100) {
+            waiter = std::thread([file, ticket]() {
+                ASSERT_TRUE(file->WaitAsync(ticket).ok());
+            });
+        }
+    }
+    waiter.join();
+    ASSERT_TRUE(file->WaitAsync(last_ticket).ok());
+    // plain appends after async ones still go after them
+    ASSERT_TRUE(file->Append("tail").ok());
+    expected += "tail";
+    ASSERT_TRUE(file->Sync().ok());
+    ASSERT_TRUE(file->Close().ok());
+    delete file;
+
+    ASSERT_EQ(expected, ReadFile(fname));
+    env_->RemoveFile(fname);
+}
+
+TEST_F(EnvTest, WaitAsyncWithoutSubmit) {
+    const std::string fname = testing::TempDir() + "env_test_wait";
+    WritableFile* file;
+    ASSERT_TRUE(env_->NewWritableFile(fname, &file).ok());
+    ASSERT_TRUE(file->Append("foo").ok());
+    // nothing was submitted, so there is nothing to wait for
+    ASSERT_TRUE(file->WaitAsync(0).ok());
+    ASSERT_TRUE(file->Close().ok());
+    delete file;
+    ASSERT_EQ("foo", ReadFile(fname));
+    env_->RemoveFile(fname);
+}
+
+TEST_F(EnvTest, MultiRead) {
+    const std::string fname = testing::TempDir() + "env_test_multi_read";
+    std::string contents;
+    for (int i = 0; i < 100000; i++) {
+        contents.push_back(static_cast<char>('a' + i % 26));
+    }
+    WritableFile* wfile;
+    ASSERT_TRUE(env_->NewWritableFile(fname, &wfile).ok());
+    ASSERT_TRUE(wfile->Append(contents).ok());
+    ASSERT_TRUE(wfile->Close().ok());
+    delete wfile;
+
+    RandomAccessFile* file;
+    ASSERT_TRUE(env_->NewRandomAccessFile(fname, &file).ok());
+    // more reads than fit on a ring at once, one running past the end of
+    // the file and one starting there
+    const size_t kReads = 300;
+    std::vector<RandomAccessFile::ReadRequest> reqs(kReads);
+    std::vector<std::string> scratch(kReads, std::string(1000, '\0'));
+    for (size_t i = 0; i < kReads; i++) {
+        reqs[i].offset = (i * 7919) % (contents.size() - 1000);
+        reqs[i].n = 1 + i % 1000;
+        reqs[i].scratch = &scratch[i][0];
+    }
+    reqs[10].offset = contents.size() - 5;
+    reqs[10].n = 100;
+    reqs[11].offset = contents.size();
+    file->MultiRead(reqs.data(), reqs.size());
+
+    for (size_t i = 0; i < kReads; i++) {
+        ASSERT_TRUE(reqs[i].status.ok()) << i;
+        const size_t expected_size =
+                std::min<size_t>(reqs[i].n, contents.size() - reqs[i].offset);
+        ASSERT_EQ(contents.substr(reqs[i].offset, expected_size), reqs[i].result.ToString())
+                << i;
+    }
+    ASSERT_EQ(5, reqs[10].result.size());
+    ASSERT_EQ(0, reqs[11].result.size());
+
+    // a single read works the same
+    file->MultiRead(&reqs[5], 1);
+    ASSERT_TRUE(reqs[5].status.ok());
+    ASSERT_EQ(contents.substr(reqs[5].offset, reqs[5].n), reqs[5].result.ToString());
+    delete file;
+    env_->RemoveFile(fname);
+}
+
+}  // namespace leveldb
@@ -0,0 +1,7 @@
+#include "leveldb/merge_operator.h"
+
+namespace leveldb {
+
+MergeOperator::~MergeOperator() = default;
+
+}  // namespace leveldb
@@ -0,0 +1,149 @@
+#include "util/thread_local.h"
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+
+#include "port/port.h"
+#include "port/thread_annotations.h"
+#include "util/mutexlock.h"
+
+namespace leveldb {
+
+namespace {
+// the copies of one thread, indexed by ThreadLocalPtr id. Only the thread
+// itself adds entries, and it does so with StaticMeta::mu_ held, so other
+// threads may read them while holding mu_. A deque, since growing it must
+// not move the entries.
+struct ThreadData {
+    std::deque<std::atomic<void*>> entries;
+};
+}  // namespace
+
+// keeps track of the ids in use and the ThreadData of every thread
+class ThreadLocalPtr::StaticMeta {
+public:
+    // never destroyed, threads may exit after static destructors have run
+    static StaticMeta* Instance() {
+        static StaticMeta* meta = new StaticMeta;
+        return meta;
+    }
+
+    uint32_t NewId(UnrefHandler handler) {
+        MutexLock l(&mu_);
+        if (!free_ids_.empty()) {
+            const uint32_t id = free_ids_.back();
+            free_ids_.pop_back();
+            handlers_[id] = handler;
+            return id;
+        }
+        handlers_.push_back(handler);
+        return static_cast<uint32_t>(handlers_.size() - 1);
+    }
+
+    // hands the copies still set to the handler of "id", then frees it
+    void ReclaimId(uint32_t id) {
+        MutexLock l(&mu_);
+        for (ThreadData* data : threads_) {
+            if (id < data->entries.size()) {
+                void* ptr = data->entries[id].exchange(nullptr, std::memory_order_acquire);
+                if (ptr != nullptr && handlers_[id] != nullptr) {
+                    handlers_[id](ptr);
+                }
+            }
+        }
+        handlers_[id] = nullptr;
+        free_ids_.push_back(id);
+    }
+
+    // the calling thread's copy for "id"
+    std::atomic<void*>* Slot(uint32_t id) {
+        ThreadData* data = holder_.data;
+        if (data == nullptr || id >= data->entries.size()) {
+            MutexLock l(&mu_);
+            if (data == nullptr) {
+                data = holder_.data = new ThreadData;
+                threads_.push_back(data);
+            }
+            while (data->entries.size() <= id) {
+                data->entries.emplace_back(nullptr);
+            }
+        }
+        return &data->entries[id];
+    }
+
+    void Scrape(uint32_t id, std::vector<void*>* ptrs, void* replacement) {
+        MutexLock l(&mu_);
+        for (ThreadData* data : threads_) {
+            if (id < data->entries.size()) {
+                void* ptr = data->entries[id].exchange(replacement, std::memory_order_acquire);
+                if (ptr != nullptr) {
+                    ptrs->push_back(ptr);
+                }
+            }
+        }
+    }
+
+private:
+    // unregisters the ThreadData of a thread when it exits
+    struct Holder {
+        ~Holder() {
+            if (data != nullptr) {
+                Instance()->OnThreadExit(data);
+            }
+        }
+
+        ThreadData* data = nullptr;
+    };
+
+    StaticMeta() = default;
+
+    void OnThreadExit(ThreadData* data) {
+        MutexLock l(&mu_);
+        threads_.erase(std::find(threads_.begin(), threads_.end(), data));
+        for (size_t id = 0; id < data->entries.size(); id++) {
+            void* ptr = data->entries[id].load(std::memory_order_acquire);
+            if (ptr != nullptr && handlers_[id] != nullptr) {
+                handlers_[id](ptr);
+            }
+        }
+        delete data;
+    }
+
+    static thread_local Holder holder_;
+
+    port::Mutex mu_;
+    std::vector<ThreadData*> threads_ GUARDED_BY(mu_);
+    std::vector<UnrefHandler> handlers_ GUARDED_BY(mu_);  // by id
+    std::vector<uint32_t> free_ids_ GUARDED_BY(mu_);
+};
+
+thread_local ThreadLocalPtr::StaticMeta::Holder ThreadLocalPtr::StaticMeta::holder_;
+
+ThreadLocalPtr::ThreadLocalPtr(UnrefHandler handler)
+    : id_(StaticMeta::Instance()->NewId(handler)) {}
+
+ThreadLocalPtr::~ThreadLocalPtr() { StaticMeta::Instance()->ReclaimId(id_); }
+
+void* ThreadLocalPtr::Get() const {
+    return StaticMeta::Instance()->Slot(id_)->load(std::memory_order_acquire);
+}
+
+void ThreadLocalPtr::Reset(void* ptr) {
+    StaticMeta::Instance()->Slot(id_)->store(ptr, std::memory_order_release);
+}
+
+void* ThreadLocalPtr::Swap(void* ptr) {
+    return StaticMeta::Instance()->Slot(id_)->exchange(ptr, std::memory_order_acquire);
+}
+
+bool ThreadLocalPtr::CompareAndSwap(void* ptr, void*& expected) {
+    return StaticMeta::Instance()->Slot(id_)->compare_exchange_strong(
+            expected, ptr, std::memory_order_release, std::memory_order_acquire);
+}
+
+void ThreadLocalPtr::Scrape(std::vector<void*>* ptrs, void* replacement) {
+    StaticMeta::Instance()->Scrape(id_, ptrs, replacement);
+}
+
+}  // namespace leveldb
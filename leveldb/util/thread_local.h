@@ -0,0 +1,57 @@
+#ifndef STORAGE_LEVELDB_UTIL_THREAD_LOCAL_H_
+#define STORAGE_LEVELDB_UTIL_THREAD_LOCAL_H_
+
+#include <stdint.h>
+
+#include <vector>
+
+namespace leveldb {
+
+// a pointer of which every thread has a copy of its own, for each
+// ThreadLocalPtr object. Unlike a thread_local variable, a ThreadLocalPtr
+// may be a class member, and the copies of all threads can be taken back
+// at once with Scrape(), e.g. when the object they point to goes stale.
+//
+// Get(), Reset(), Swap() and CompareAndSwap() only touch the calling
+// thread's copy and take no lock, except the first time a thread uses a
+// ThreadLocalPtr.
+class ThreadLocalPtr {
+public:
+    // called with the value a thread's copy holds when the thread exits or
+    // the ThreadLocalPtr is destroyed, unless it is nullptr. Runs under a
+    // global lock, so it must not block on anything that may wait for
+    // Scrape().
+    typedef void (*UnrefHandler)(void* ptr);
+
+    explicit ThreadLocalPtr(UnrefHandler handler = nullptr);
+
+    ThreadLocalPtr(const ThreadLocalPtr&) = delete;
+    ThreadLocalPtr& operator=(const ThreadLocalPtr&) = delete;
+
+    ~ThreadLocalPtr();
+
+    // the calling thread's copy, nullptr until it is set
+    void* Get() const;
+
+    void Reset(void* ptr);
+
+    // sets the calling thread's copy to "ptr" and returns the old value
+    void* Swap(void* ptr);
+
+    // sets the calling thread's copy to "ptr" if it is "expected".
+    // otherwise stores the current value in "expected" and returns false.
+    bool CompareAndSwap(void* ptr, void*& expected);
+
+    // replaces the copy of every thread with "replacement" and appends the
+    // old values that were not nullptr to *ptrs.
+    void Scrape(std::vector<void*>* ptrs, void* replacement);
+
+private:
+    class StaticMeta;
+
+    const uint32_t id_;
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_UTIL_THREAD_LOCAL_H_
@@ -0,0 +1,158 @@
+#include "util/thread_local.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace leveldb {
+
+static int values[8];
+
+// counts the values handed to the unref handler
+static std::atomic<int> unref_count(0);
+static void CountUnref(void* ptr) { unref_count.fetch_add(1); }
+
+// threads that each set their copy of a ThreadLocalPtr, then wait for the
+// test to let them go
+class ThreadGroup {
+public:
+    explicit ThreadGroup(ThreadLocalPtr* tls) : tls_(tls), ready_(0), release_(false) {}
+
+    ~ThreadGroup() { Join(); }
+
+    void Start(int n) {
+        for (int i = 0; i < n; i++) {
+            threads_.emplace_back([this, i]() {
+                tls_->Reset(&values[i]);
+                std::unique_lock<std::mutex> l(mu_);
+                ready_++;
+                cv_.notify_all();
+                cv_.wait(l, [this]() { return release_; });
+                seen_.push_back(tls_->Get());
+            });
+        }
+        std::unique_lock<std::mutex> l(mu_);
+        cv_.wait(l, [this, n]() { return ready_ == n; });
+    }
+
+    void Join() {
+        {
+            std::lock_guard<std::mutex> l(mu_);
+            release_ = true;
+            cv_.notify_all();
+        }
+        for (std::thread& thread : threads_) {
+            thread.join();
+        }
+        threads_.clear();
+    }
+
+    // what the threads' copies held once they were let go
+    std::vector<void*> seen_;
+
+private:
+    ThreadLocalPtr* const tls_;
+    std::vector<std::thread> threads_;
+    std::mutex mu_;
+    std::condition_variable cv_;
+    int ready_;
+    bool release_;
+};
+
+TEST(ThreadLocalTest, Basic) {
+    ThreadLocalPtr tls;
+    ASSERT_EQ(nullptr, tls.Get());
+    tls.Reset(&values[0]);
+    ASSERT_EQ(&values[0], tls.Get());
+    ASSERT_EQ(&values[0], tls.Swap(&values[1]));
+    ASSERT_EQ(&values[1], tls.Get());
+
+    void* expected = &values[0];
+    ASSERT_FALSE(tls.CompareAndSwap(&values[2], expected));
+    ASSERT_EQ(&values[1], expected);
+    ASSERT_TRUE(tls.CompareAndSwap(&values[2], expected));
+    ASSERT_EQ(&values[2], tls.Get());
+
+    // each ThreadLocalPtr has copies of its own
+    ThreadLocalPtr other;
+    ASSERT_EQ(nullptr, other.Get());
+}
+
+TEST(ThreadLocalTest, CopyPerThread) {
+    ThreadLocalPtr tls;
+    tls.Reset(&values[7]);
+    std::thread thread([&tls]() {
+        ASSERT_EQ(nullptr, tls.Get());
+        tls.Reset(&values[0]);
+        ASSERT_EQ(&values[0], tls.Get());
+    });
+    thread.join();
+    ASSERT_EQ(&values[7], tls.Get());
+}
+
+TEST(ThreadLocalTest, Scrape) {
+    ThreadLocalPtr tls;
+    tls.Reset(&values[7]);
+    ThreadGroup group(&tls);
+    group.Start(4);
+
+    std::vector<void*> ptrs;
+    tls.Scrape(&ptrs, nullptr);
+    ASSERT_EQ(5, ptrs.size());
+    for (int i = 0; i < 4; i++) {
+        ASSERT_NE(ptrs.end(), std::find(ptrs.begin(), ptrs.end(), &values[i]));
+    }
+    ASSERT_NE(ptrs.end(), std::find(ptrs.begin(), ptrs.end(), &values[7]));
+    ASSERT_EQ(nullptr, tls.Get());
+
+    // every thread's copy got the replacement
+    ptrs.clear();
+    tls.Reset(&values[6]);
+    tls.Scrape(&ptrs, &values[5]);
+    ASSERT_EQ(1, ptrs.size());
+    group.Join();
+    ASSERT_EQ(4, group.seen_.size());
+    for (void* seen : group.seen_) {
+        ASSERT_EQ(&values[5], seen);
+    }
+}
+
+TEST(ThreadLocalTest, UnrefHandler) {
+    unref_count.store(0);
+    {
+        ThreadLocalPtr tls(&CountUnref);
+        // a thread's copy is handed over when the thread exits
+        std::thread thread([&tls]() { tls.Reset(&values[0]); });
+        thread.join();
+        ASSERT_EQ(1, unref_count.load());
+
+        std::thread unset([&tls]() { tls.Get(); });
+        unset.join();
+        ASSERT_EQ(1, unref_count.load());
+
+        // and the copies of live threads when the ThreadLocalPtr goes
+        tls.Reset(&values[1]);
+        ThreadGroup group(&tls);
+        group.Start(3);
+        ASSERT_EQ(1, unref_count.load());
+        group.Join();
+        ASSERT_EQ(4, unref_count.load());
+    }
+    ASSERT_EQ(5, unref_count.load());
+}
+
+TEST(ThreadLocalTest, ReusedIdStartsEmpty) {
+    ThreadLocalPtr* tls = new ThreadLocalPtr;
+    tls->Reset(&values[0]);
+    delete tls;
+    // whatever id the next one gets, it is unset in this thread
+    ThreadLocalPtr reused;
+    ASSERT_EQ(nullptr, reused.Get());
+}
+
+}  // namespace leveldb
@@ -0,0 +1,163 @@
+#include "leveldb/write_buffer_manager.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <string>
+#include <vector>
+
+#include "leveldb/cache.h"
+#include "port/port.h"
+#include "port/thread_annotations.h"
+#include "util/coding.h"
+#include "util/mutexlock.h"
+
+namespace leveldb {
+
+// memtable memory is charged to the cache in entries of this size
+static const size_t kCacheChargeUnit = 1 << 20;
+
+static void DeleteCacheCharge(const Slice& key, void* value) {}
+
+struct WriteBufferManager::Rep {
+    Rep(size_t size, Cache* c)
+        : buffer_size(size),
+          mutable_limit(size - size / 8),
+          cache(c),
+          cache_id(c != nullptr ? c->NewId() : 0),
+          memory_used(0),
+          memory_active(0) {}
+
+    // keeps the entries charged to the cache in step with memory_used
+    void UpdateCacheCharge() EXCLUSIVE_LOCKS_REQUIRED(mu);
+    std::string CacheKey(size_t index) const;
+
+    const size_t buffer_size;
+    const size_t mutable_limit;  // mutable memory that triggers a flush
+    Cache* const cache;
+    const uint64_t cache_id;
+
+    std::atomic<size_t> memory_used;
+    std::atomic<size_t> memory_active;  // part of memory_used still mutable
+
+    port::Mutex mu;
+    std::vector<Consumer*> consumers GUARDED_BY(mu);
+    // pinned entries of kCacheChargeUnit each, the i-th under CacheKey(i)
+    std::vector<Cache::Handle*> cache_charges GUARDED_BY(mu);
+};
+
+std::string WriteBufferManager::Rep::CacheKey(size_t index) const {
+    std::string key;
+    PutFixed64(&key, cache_id);
+    PutFixed64(&key, index);
+    return key;
+}
+
+void WriteBufferManager::Rep::UpdateCacheCharge() {
+    const size_t used = memory_used.load(std::memory_order_relaxed);
+    // the charge is usage rounded up to whole units
+    while (cache_charges.size() * kCacheChargeUnit < used) {
+        cache_charges.push_back(cache->Insert(CacheKey(cache_charges.size()), nullptr,
+                                              kCacheChargeUnit, &DeleteCacheCharge));
+    }
+    while (!cache_charges.empty() &&
+           (cache_charges.size() - 1) * kCacheChargeUnit >= used) {
+        cache->Release(cache_charges.back());
+        cache_charges.pop_back();
+        cache->Erase(CacheKey(cache_charges.size()));
+    }
+}
+
+WriteBufferManager::Consumer::~Consumer() = default;
+
+WriteBufferManager::WriteBufferManager(size_t buffer_size, Cache* cache)
+    : rep_(new Rep(buffer_size, cache)) {}
+
+WriteBufferManager::~WriteBufferManager() {
+    {
+        MutexLock l(&rep_->mu);
+        assert(rep_->consumers.empty());
+        for (size_t i = 0; i < rep_->cache_charges.size(); i++) {
+            rep_->cache->Release(rep_->cache_charges[i]);
+            rep_->cache->Erase(rep_->CacheKey(i));
+        }
+    }
+    delete rep_;
+}
+
+size_t WriteBufferManager::buffer_size() const { return rep_->buffer_size; }
+
+size_t WriteBufferManager::memory_usage() const {
+    return rep_->memory_used.load(std::memory_order_relaxed);
+}
+
+size_t WriteBufferManager::mutable_memtable_memory_usage() const {
+    return rep_->memory_active.load(std::memory_order_relaxed);
+}
+
+void WriteBufferManager::Register(Consumer* consumer) {
+    MutexLock l(&rep_->mu);
+    rep_->consumers.push_back(consumer);
+}
+
+void WriteBufferManager::Unregister(Consumer* consumer) {
+    MutexLock l(&rep_->mu);
+    auto iter = std::find(rep_->consumers.begin(), rep_->consumers.end(), consumer);
+    assert(iter != rep_->consumers.end());
+    rep_->consumers.erase(iter);
+}
+
+void WriteBufferManager::ReserveMem(size_t mem) {
+    rep_->memory_used.fetch_add(mem, std::memory_order_relaxed);
+    rep_->memory_active.fetch_add(mem, std::memory_order_relaxed);
+    if (rep_->cache != nullptr) {
+        MutexLock l(&rep_->mu);
+        rep_->UpdateCacheCharge();
+    }
+}
+
+void WriteBufferManager::ScheduleFreeMem(size_t mem) {
+    rep_->memory_active.fetch_sub(mem, std::memory_order_relaxed);
+}
+
+void WriteBufferManager::FreeMem(size_t mem) {
+    rep_->memory_used.fetch_sub(mem, std::memory_order_relaxed);
+    if (rep_->cache != nullptr) {
+        MutexLock l(&rep_->mu);
+        rep_->UpdateCacheCharge();
+    }
+}
+
+bool WriteBufferManager::ShouldFlush() const {
+    if (rep_->buffer_size == 0) {
+        return false;
+    }
+    const size_t active = rep_->memory_active.load(std::memory_order_relaxed);
+    if (active > rep_->mutable_limit) {
+        return true;
+    }
+    // over budget, but if most of it is taken by memtables that are being
+    // flushed already, switching more memtables would not free much
+    return rep_->memory_used.load(std::memory_order_relaxed) >= rep_->buffer_size &&
+           active >= rep_->buffer_size / 2;
+}
+
+bool WriteBufferManager::FlushLargest(Consumer* caller) {
+    MutexLock l(&rep_->mu);
+    Consumer* largest = nullptr;
+    size_t largest_usage = 0;
+    for (Consumer* consumer : rep_->consumers) {
+        const size_t usage = consumer->MutableMemoryUsage();
+        if (largest == nullptr || usage > largest_usage) {
+            largest = consumer;
+            largest_usage = usage;
+        }
+    }
+    if (largest == nullptr || largest == caller) {
+        return true;
+    }
+    largest->RequestFlush();
+    return false;
+}
+
+}  // namespace leveldb
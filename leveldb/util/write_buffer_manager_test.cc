@@ -0,0 +1,95 @@
+#include "leveldb/write_buffer_manager.h"
+
+#include "gtest/gtest.h"
+
+namespace leveldb {
+
+// a DB with a fixed amount of mutable memory that counts flush requests
+class FakeConsumer : public WriteBufferManager::Consumer {
+public:
+    explicit FakeConsumer(size_t usage) : usage_(usage), flush_requests_(0) {}
+
+    size_t MutableMemoryUsage() const override { return usage_; }
+    void RequestFlush() override { flush_requests_++; }
+
+    size_t usage_;
+    int flush_requests_;
+};
+
+TEST(WriteBufferManagerTest, MemoryUsage) {
+    WriteBufferManager manager(1000);
+    ASSERT_EQ(1000, manager.buffer_size());
+    manager.ReserveMem(300);
+    manager.ReserveMem(200);
+    ASSERT_EQ(500, manager.memory_usage());
+    ASSERT_EQ(500, manager.mutable_memtable_memory_usage());
+    // a memtable becoming immutable still counts until it is freed
+    manager.ScheduleFreeMem(300);
+    ASSERT_EQ(500, manager.memory_usage());
+    ASSERT_EQ(200, manager.mutable_memtable_memory_usage());
+    manager.FreeMem(300);
+    ASSERT_EQ(200, manager.memory_usage());
+    ASSERT_EQ(200, manager.mutable_memtable_memory_usage());
+    manager.ScheduleFreeMem(200);
+    manager.FreeMem(200);
+    ASSERT_EQ(0, manager.memory_usage());
+}
+
+TEST(WriteBufferManagerTest, ShouldFlush) {
+    WriteBufferManager manager(100);
+    manager.ReserveMem(80);
+    ASSERT_FALSE(manager.ShouldFlush());
+    // mutable memory past 7/8 of the budget
+    manager.ReserveMem(10);
+    ASSERT_TRUE(manager.ShouldFlush());
+    manager.ScheduleFreeMem(90);
+    ASSERT_FALSE(manager.ShouldFlush());
+
+    // over budget, but mostly with memtables being flushed already
+    manager.ReserveMem(45);
+    ASSERT_FALSE(manager.ShouldFlush());
+    // over budget, and half of it mutable
+    manager.ReserveMem(10);
+    ASSERT_TRUE(manager.ShouldFlush());
+    manager.FreeMem(90);
+    ASSERT_FALSE(manager.ShouldFlush());
+    manager.ScheduleFreeMem(55);
+    manager.FreeMem(55);
+}
+
+TEST(WriteBufferManagerTest, NoBudget) {
+    WriteBufferManager manager(0);
+    manager.ReserveMem(1 << 30);
+    ASSERT_FALSE(manager.ShouldFlush());
+    ASSERT_EQ(1 << 30, manager.memory_usage());
+    manager.ScheduleFreeMem(1 << 30);
+    manager.FreeMem(1 << 30);
+}
+
+TEST(WriteBufferManagerTest, FlushLargest) {
+    WriteBufferManager manager(100);
+    FakeConsumer small(10), large(50);
+    manager.Register(&small);
+    manager.Register(&large);
+
+    // the largest consumer is asked to flush
+    ASSERT_FALSE(manager.FlushLargest(&small));
+    ASSERT_EQ(0, small.flush_requests_);
+    ASSERT_EQ(1, large.flush_requests_);
+
+    // unless it is the caller, which flushes by itself
+    ASSERT_TRUE(manager.FlushLargest(&large));
+    ASSERT_EQ(1, large.flush_requests_);
+
+    small.usage_ = 60;
+    ASSERT_FALSE(manager.FlushLargest(&large));
+    ASSERT_EQ(1, small.flush_requests_);
+
+    // unregistered consumers are not asked
+    manager.Unregister(&small);
+    ASSERT_TRUE(manager.FlushLargest(&large));
+    ASSERT_EQ(1, small.flush_requests_);
+    manager.Unregister(&large);
+}
+
+}  // namespace leveldb